@@ -13,19 +13,13 @@
 
 
 // ----------------------------------------------------------------
-// 1. IR SEND PIPELINE (build-time selection)
+// 1. IR ADAPTER (default, runtime-selectable)
 // ----------------------------------------------------------------
-// 1 = use IRremoteESP8266 adapters (MHI88/MHI152)
-// 0 = use raw IR modulator (based on PJA502A704AA remote)
-#define USE_ACU_ADAPTER 1
-
-// Model string reported in identity messages
-// Example values: "MHI_64", "MHI_88", "MHI_152"
-#if USE_ACU_ADAPTER
-  #define ACU_REMOTE_MODEL "MHI_88"
-#else
-  #define ACU_REMOTE_MODEL "MHI_64"
-#endif
+// Registry key of the IR adapter selected at boot. It is also reported as
+// acu_remote_model in identity messages and can be changed at runtime via
+// CONTROL_PATH/<floor>/<room>/<unit>/config {"adapter":"MHI_152"}.
+// Values: "MHI_64" (raw modulator, PJA502A704AA based), "MHI_88", "MHI_152"
+#define ACU_REMOTE_MODEL "MHI_88"
 
 
 // ----------------------------------------------------------------
@@ -43,6 +37,12 @@
 #define MQTT_USER "user"
 #define MQTT_PASS "pass"
 
+// Optional: TLS (MQTT_PORT defaults to 8883). The broker certificate is pinned
+// by its SHA-1 fingerprint, e.g. from
+//   openssl x509 -in broker.crt -noout -fingerprint -sha1
+// #define MQTT_USE_TLS 1
+// #define MQTT_TLS_FINGERPRINT "AA:BB:CC:DD:EE:FF:00:11:22:33:44:55:66:77:88:99:AA:BB:CC:DD"
+
 #define STATE_PATH   "modules"
 #define CONTROL_PATH "commands"
 
@@ -55,6 +55,10 @@
 #define DEFINED_ROOM  "Room_Topic"
 #define DEFINED_UNIT  "ACU_Topic"
 
+// Optional: drive several ACUs from this module, "unit_id[:model[:pin]],..."
+// (max 3; model/pin default to ACU_REMOTE_MODEL and GPIO4). Overrides DEFINED_UNIT.
+// #define DEFINED_UNITS "ACU1:MHI_88:4,ACU2:MHI_152:5"
+
 // Room type ID: IR=1, IL=2, CA=3, OR=4, SR=5
 #define DEFINED_ROOM_TYPE_ID 1
 #define DEFINED_DEPARTMENT "School of Engineering"
@@ -64,6 +68,8 @@
 // ----------------------------------------------------------------
 #define NTP_SERVER_1 "pool.ntp.org"
 #define NTP_SERVER_2 "time.nist.gov"
+#define NTP_UTC_OFFSET_S (8 * 3600)   // Local time offset for timestamps and schedules
+// #define NTP_TIMESTAMP_EPOCH 1      // Publish timestamps as UTC epoch seconds
 
 
 // ----------------------------------------------------------------
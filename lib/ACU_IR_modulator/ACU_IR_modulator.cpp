@@ -5,110 +5,73 @@ namespace {
 constexpr const char* k_log_tag = "IR";
 } // namespace
 
-// Convert a 64-bit binary command into IR durations for sending via IR LED
-bool parseBinaryToDurations(uint64_t binary_input, uint16_t *durations, size_t &len)
-{
-    len = 0;  // Reset length for durations array
-
-    // Add header mark and space signals at the start of the IR transmission
-    durations[len++] = g_selected_protocol->hdr_mark;
-    durations[len++] = g_selected_protocol->hdr_space;
+uint16_t g_durations[raw_data_length];                        // Pulse duration buffer
+const IRProtocolConfig* g_selected_protocol = &k_mitsubishi_heavy_64;
 
-    // Loop through each bit from MSB to LSB
-    for (int i = 63; i >= 0; --i)
+void sendIRFrame(IRsend &ir, const IRProtocolConfig &protocol, const uint16_t *durations, size_t len)
+{
+    ir.enableIROut(protocol.carrier_khz, protocol.duty_cycle);
+    for (size_t i = 0; i < len; ++i)
     {
-        // Prevent buffer overflow before adding new durations
-        if (len + 2 > raw_data_length)
-        {
-            // Error: Durations array overflow!
-            return false;
-        }
-
-        // Extract the current bit value (0 or 1)
-        bool bit = (binary_input >> i) & 1;
-        durations[len++] = g_selected_protocol->bit_mark;          // Add mark duration for bit start
-        durations[len++] = bit ? g_selected_protocol->one_space : g_selected_protocol->zero_space;  // Add space duration depending on bit value
+        if (i % 2 == 0) ir.mark(durations[i]);
+        else            ir.space(durations[i]);
     }
+    ir.space(0); // Make sure the LED is left off
+}
 
-    // Add trailing sequence if buffer space allows (protocol-dependent)
-    if (len + 2 <= raw_data_length)
-    {
-        durations[len++] = g_selected_protocol->bit_mark;
-        durations[len++] = g_selected_protocol->hdr_space;
-        durations[len++] = g_selected_protocol->bit_mark;
-    } 
-    else 
+// Convert a 64-bit binary command into IR durations for sending via IR LED
+bool parseBinaryToDurations(uint64_t binary_input, uint16_t *durations, size_t &len)
+{
+    // Pack MSB-first into bytes so bit order is handled by the protocol description
+    uint8_t data[sizeof(uint64_t)];
+    for (size_t i = 0; i < sizeof(data); ++i)
     {
-        // Error: Unable to add ending sequence due to array size.
-        return false; // Not a critical failure, but indicates truncation.
+        data[i] = (uint8_t)(binary_input >> (8 * (sizeof(data) - 1 - i)));
     }
-    return true;
+    return buildIRFrame(*g_selected_protocol, data, durations, raw_data_length, len);
 }
 
-// Legacy method to convert a binary string (e.g. "110010...") into IR durations
-bool parseBinaryToDurations(const String &binary_input, uint16_t *durations, size_t &len) {
-    len = 0;  // Reset durations length
-
-    // Add header mark and space durations
-    durations[len++] = g_selected_protocol->hdr_mark;
-    durations[len++] = g_selected_protocol->hdr_space;
+// Convert a binary string (e.g. "110010...") into IR durations
+bool parseBinaryToDurations(const char *binary_input, uint16_t *durations, size_t &len) {
+    return buildIRFrameFromBits(*g_selected_protocol, binary_input, durations, raw_data_length, len);
+}
 
-    // Iterate over each character (bit) in the string
-    for (size_t i = 0; i < binary_input.length(); i++) {
-        // Check buffer size before adding durations
-        if (len + 2 > raw_data_length) {
-            // Error: Durations array overflow!
-            return false;
+// Debug helper function: reads 64-bit binary input from Serial and converts it to IR durations
+bool debugIRInput(uint16_t *durations, size_t &len) {
+    static char line[80];
+    static size_t line_len = 0;
+    static bool is_overflow = false;
+
+    len = 0;
+    while (Serial.available()) {
+        int c = Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            // Keep only bit characters; spaces and separators are dropped
+            if (c != '0' && c != '1') continue;
+            if (line_len < sizeof(line) - 1) line[line_len++] = (char)c;
+            else is_overflow = true;
+            continue;
         }
 
-        char bit = binary_input[i];
-        durations[len++] = g_selected_protocol->bit_mark;  // Add mark duration
-
-        // Add space duration depending on bit value
-        if (bit == '1') {
-            durations[len++] = g_selected_protocol->one_space;
-        } else if (bit == '0') {
-            durations[len++] = g_selected_protocol->zero_space;
-        }
-    }
-
-    // Add trailing sequence if there is space
-    if (len + 2 <= raw_data_length) {
-        durations[len++] = g_selected_protocol->bit_mark;
-        durations[len++] = g_selected_protocol->hdr_space;
-        durations[len++] = g_selected_protocol->bit_mark;
-    } else {
-        // Error: Unable to add ending sequence due to array size.
-        return false; // Not a critical failure, but indicates truncation.
-    }
-    return true;
-}
-
-// Debug helper function: reads 64-bit binary input from Serial, converts, and sends IR
-void debugIRInput() {
-    if (Serial.available()) {
-        // Read input line from Serial
-        String binary_input = Serial.readStringUntil('\n');
-        binary_input.trim();                // Remove whitespace
-        binary_input.replace(" ", "");     // Remove spaces
+        line[line_len] = '\0';
+        size_t bit_count = line_len;
+        bool was_overflow = is_overflow;
+        line_len = 0;
+        is_overflow = false;
 
         // Validate input length (must be exactly 64 bits)
-        if (binary_input.length() != 64) {
+        if (was_overflow || bit_count != 64) {
             logWarn(k_log_tag, "Invalid input! Please enter exactly 64 bits.");
-            return;
+            return false;
         }
 
-        uint16_t local_durations[raw_data_length];
-        size_t len = 0;
-
         // Convert binary string to durations array
-        if (parseBinaryToDurations(binary_input, local_durations, len)) {
-            // Send IR signal at 38 kHz carrier frequency
-            g_ir_send.sendRaw(local_durations, len, 38);
-
-            logInfo(k_log_tag, "IR sent.");
-        } else {
-            logError(k_log_tag, "Failed to parse binary string into IR durations.");
+        if (parseBinaryToDurations(line, durations, len)) {
+            return true;
         }
+        logError(k_log_tag, "Failed to parse binary string into IR durations.");
+        return false;
     }
+    return false;
 }
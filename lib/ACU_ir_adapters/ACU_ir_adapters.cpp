@@ -1,4 +1,12 @@
 #include "ACU_ir_adapters.h"
+#include "ACU_IR_modulator.h"
+#include "logging.h"
+
+#include <new>
+
+namespace {
+constexpr const char* k_log_tag = "IR";
+} // namespace
 
 static uint8_t mapModeToMHI(ACUMode mode) {
   switch (mode) {
@@ -59,8 +67,35 @@ static uint8_t mapSwingV152(uint8_t louver) {
   }
 }
 
+MHI64RawAdapter::MHI64RawAdapter(uint16_t pin)
+  : ir(pin), encoder(ACURemoteSignature::MitsubishiHeavy64) {}
+
+void MHI64RawAdapter::begin() {
+  ir.begin();
+}
+
+bool MHI64RawAdapter::send(const ACUState &state) {
+  encoder.setState(state.fan_speed, state.temperature, state.mode, state.louver, state.power);
+  uint64_t command = encoder.encodeCommand();
+
+  size_t len = 0;
+  if (!parseBinaryToDurations(command, g_durations, len)) return false;
+  sendIRFrame(ir, *g_selected_protocol, g_durations, len);
+  return true;
+}
+
+bool MHI64RawAdapter::sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) {
+  if (durations == nullptr || len == 0) return false;
+  ir.sendRaw(durations, len, khz);
+  return true;
+}
+
+const char* MHI64RawAdapter::name() const {
+  return "MHI-64";
+}
+
 MHI88Adapter::MHI88Adapter(uint16_t pin)
-  : ir(pin) {}
+  : ir(pin), raw_ir(pin) {}
 
 void MHI88Adapter::begin() {
   ir.begin();
@@ -78,12 +113,18 @@ bool MHI88Adapter::send(const ACUState &state) {
   return true;
 }
 
+bool MHI88Adapter::sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) {
+  if (durations == nullptr || len == 0) return false;
+  raw_ir.sendRaw(durations, len, khz);
+  return true;
+}
+
 const char* MHI88Adapter::name() const {
   return "MHI-88";
 }
 
 MHI152Adapter::MHI152Adapter(uint16_t pin)
-  : ir(pin) {}
+  : ir(pin), raw_ir(pin) {}
 
 void MHI152Adapter::begin() {
   ir.begin();
@@ -101,6 +142,98 @@ bool MHI152Adapter::send(const ACUState &state) {
   return true;
 }
 
+bool MHI152Adapter::sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) {
+  if (durations == nullptr || len == 0) return false;
+  raw_ir.sendRaw(durations, len, khz);
+  return true;
+}
+
 const char* MHI152Adapter::name() const {
   return "MHI-152";
 }
+
+// ====== Runtime Registry ======
+
+namespace {
+
+template <typename T>
+IACUAdapter* constructAdapter(void* storage, uint16_t pin) {
+  return new (storage) T(pin);
+}
+
+struct ACUAdapterEntry {
+  const char* model;
+  IACUAdapter* (*create)(void* storage, uint16_t pin);
+};
+
+// Add new adapters here; the storage slot below grows to fit the largest one.
+constexpr ACUAdapterEntry k_adapter_registry[] = {
+  {"MHI_64",  constructAdapter<MHI64RawAdapter>},
+  {"MHI_88",  constructAdapter<MHI88Adapter>},
+  {"MHI_152", constructAdapter<MHI152Adapter>},
+};
+
+template <typename T>
+constexpr size_t maxSize(size_t a) { return (sizeof(T) > a) ? sizeof(T) : a; }
+
+constexpr size_t k_adapter_storage_size =
+  maxSize<MHI64RawAdapter>(maxSize<MHI88Adapter>(maxSize<MHI152Adapter>(0)));
+
+struct AdapterSlot {
+  alignas(alignof(max_align_t)) uint8_t storage[k_adapter_storage_size];
+  IACUAdapter* adapter = nullptr;
+  const char* model = "none";
+  uint16_t pin = 4;
+};
+
+AdapterSlot g_adapter_slots[k_acu_adapter_slots];
+
+const ACUAdapterEntry* findAdapterEntry(const char* model) {
+  if (model == nullptr) return nullptr;
+  for (const ACUAdapterEntry& entry : k_adapter_registry) {
+    if (strcmp(entry.model, model) == 0) return &entry;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+IACUAdapter* selectACUAdapter(uint8_t slot, const char* model, uint16_t pin) {
+  if (slot >= k_acu_adapter_slots) return nullptr;
+
+  const ACUAdapterEntry* entry = findAdapterEntry(model);
+  if (entry == nullptr) {
+    logWarn(k_log_tag, "Unknown ACU adapter: %s", model ? model : "null");
+    return nullptr;
+  }
+
+  AdapterSlot& target = g_adapter_slots[slot];
+  if (target.adapter != nullptr) {
+    target.adapter->~IACUAdapter();
+    target.adapter = nullptr;
+  }
+
+  target.adapter = entry->create(target.storage, pin);
+  target.adapter->begin();
+  target.model = entry->model;
+  target.pin = pin;
+  logInfo(k_log_tag, "ACU adapter selected: slot=%u %s (%s) pin=%u",
+          slot, target.model, target.adapter->name(), pin);
+  return target.adapter;
+}
+
+IACUAdapter* getACUAdapter(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].adapter : nullptr;
+}
+
+const char* getACUAdapterModel(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].model : "none";
+}
+
+uint16_t getACUAdapterPin(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].pin : 0;
+}
+
+bool isACUAdapterModelKnown(const char* model) {
+  return findAdapterEntry(model) != nullptr;
+}
@@ -1,13 +1,18 @@
 /*
  * ACU_ir_adapters.h
  *
- * Protocol adapters that map a generic ACUState to specific IRremoteESP8266
- * Mitsubishi Heavy protocol implementations.
+ * Protocol adapters that map a generic ACUState to specific IR protocol
+ * implementations, plus a runtime registry that selects one adapter by name.
+ *
+ * Only the selected adapters are instantiated (placement-new into static
+ * slots sized for the largest adapter, one per logical ACU unit), so
+ * switching models at runtime does not grow RAM usage.
  */
 
 #pragma once
 
 #include <Arduino.h>
+#include <IRsend.h>
 #include <ir_MitsubishiHeavy.h>
 #include "ACU_remote_encoder.h"
 
@@ -17,19 +22,36 @@ public:
   virtual ~IACUAdapter() = default;
   virtual void begin() = 0;
   virtual bool send(const ACUState &state) = 0;
+  virtual bool sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) = 0;
   virtual const char* name() const = 0;
 };
 
+// Raw 64-bit modulator adapter (PJA502A704AA based)
+class MHI64RawAdapter : public IACUAdapter {
+public:
+  explicit MHI64RawAdapter(uint16_t pin = 4);
+  void begin() override;
+  bool send(const ACUState &state) override;
+  bool sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) override;
+  const char* name() const override;
+
+private:
+  IRsend ir;
+  ACURemote encoder;
+};
+
 // Mitsubishi Heavy 88-bit adapter
 class MHI88Adapter : public IACUAdapter {
 public:
   explicit MHI88Adapter(uint16_t pin = 4);
   void begin() override;
   bool send(const ACUState &state) override;
+  bool sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) override;
   const char* name() const override;
 
 private:
   IRMitsubishiHeavy88Ac ir;
+  IRsend raw_ir;
 };
 
 // Mitsubishi Heavy 152-bit adapter
@@ -38,8 +60,44 @@ public:
   explicit MHI152Adapter(uint16_t pin = 4);
   void begin() override;
   bool send(const ACUState &state) override;
+  bool sendRaw(const uint16_t* durations, uint16_t len, uint16_t khz) override;
   const char* name() const override;
 
 private:
   IRMitsubishiHeavy152Ac ir;
+  IRsend raw_ir;
 };
+
+constexpr uint8_t k_acu_adapter_slots = 3; // One per logical ACU unit
+
+/**
+ * @brief Select and instantiate the adapter registered under a model name.
+ *
+ * The adapter previously held by the slot (if any) is destroyed first.
+ *
+ * @param slot Adapter slot (logical unit index, < k_acu_adapter_slots).
+ * @param model Registry key (e.g. "MHI_64", "MHI_88", "MHI_152").
+ * @param pin IR LED GPIO.
+ * @return Active adapter, or nullptr if the slot/model is invalid (previous adapter is kept).
+ */
+IACUAdapter* selectACUAdapter(uint8_t slot, const char* model, uint16_t pin);
+
+/**
+ * @brief Adapter held by a slot (nullptr before the first selection).
+ */
+IACUAdapter* getACUAdapter(uint8_t slot = 0);
+
+/**
+ * @brief Registry key of the adapter held by a slot ("none" before the first selection).
+ */
+const char* getACUAdapterModel(uint8_t slot = 0);
+
+/**
+ * @brief IR LED GPIO used by a slot.
+ */
+uint16_t getACUAdapterPin(uint8_t slot = 0);
+
+/**
+ * @brief Check whether a model name is present in the registry.
+ */
+bool isACUAdapterModelKnown(const char* model);
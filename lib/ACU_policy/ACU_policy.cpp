@@ -0,0 +1,234 @@
+#include "ACU_policy.h"
+#include "logging.h"
+#include "Watchdog.h"
+
+#include <LittleFS.h>
+
+namespace {
+
+constexpr const char* k_log_tag = "POLICY";
+constexpr const char* k_policy_path = "/policy.bin";
+constexpr uint8_t k_magic_lo = 0x41; // "AP", little endian 0x5041
+constexpr uint8_t k_magic_hi = 0x50;
+constexpr uint8_t k_rule_set_version = 1;
+constexpr size_t k_header_len = 4;
+constexpr size_t k_rule_set_max = k_header_len + k_policy_rules_max * sizeof(PolicyRuleRecord) + 1;
+constexpr uint32_t k_ms_per_minute = 60000UL;
+
+struct PolicyUnitState {
+  ACUState state = {};
+  bool has_state = false;
+  uint32_t last_command_ms = 0;
+  uint32_t power_on_ms = 0;
+  uint32_t last_ramp_ms = 0;
+  bool has_occupancy = false;
+  bool is_occupied = true;
+  uint32_t vacant_since_ms = 0;
+};
+
+PolicyRuleRecord g_rules[k_policy_rules_max];
+uint8_t g_rule_count = 0;
+uint8_t g_next_rule = 0;
+PolicyUnitState g_units[k_policy_units_max];
+
+uint8_t g_rule_set[k_rule_set_max]; // Installed blob, kept for change detection
+size_t g_rule_set_len = 0;
+bool g_is_fs_ready = false;
+
+bool hasElapsed(uint32_t now_ms, uint32_t since_ms, uint16_t minutes) {
+  return (now_ms - since_ms) >= (uint32_t)minutes * k_ms_per_minute;
+}
+
+bool isRuleValid(const PolicyRuleRecord& rule) {
+  if (rule.unit >= k_policy_units_max || rule.minutes == 0) return false;
+  switch ((PolicyRuleType)rule.type) {
+    case PolicyRuleType::Ramp:
+    case PolicyRuleType::MaxRuntime:
+    case PolicyRuleType::EcoRevert:
+    case PolicyRuleType::Vacancy:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool isSetpointRule(const PolicyRuleRecord& rule) {
+  return rule.type == (uint8_t)PolicyRuleType::Ramp || rule.type == (uint8_t)PolicyRuleType::EcoRevert;
+}
+
+// Rules are not arbitrated at run time, so two setpoint rules on one unit must
+// agree or they take turns undoing each other. Power-off rules never conflict.
+bool isRuleConflict(const PolicyRuleRecord& a, const PolicyRuleRecord& b) {
+  if (a.unit != b.unit || !isSetpointRule(a) || !isSetpointRule(b)) return false;
+  if (a.temperature != b.temperature) return true;
+  return a.type == (uint8_t)PolicyRuleType::EcoRevert && b.type == (uint8_t)PolicyRuleType::EcoRevert &&
+         a.fan_speed != b.fan_speed;
+}
+
+bool parseRuleSet(const uint8_t* data, size_t len, PolicyRuleRecord* rules, uint8_t& count) {
+  count = 0;
+  if (len == 0) return true;
+  if (data == nullptr || len < k_header_len + 1 || len > k_rule_set_max) return false;
+  if (data[0] != k_magic_lo || data[1] != k_magic_hi || data[2] != k_rule_set_version) return false;
+
+  count = data[3];
+  if (count > k_policy_rules_max || len != k_header_len + count * sizeof(PolicyRuleRecord) + 1) return false;
+
+  uint8_t checksum = 0;
+  for (size_t i = 0; i < len - 1; ++i) checksum ^= data[i];
+  if (checksum != data[len - 1]) return false;
+
+  memcpy(rules, data + k_header_len, count * sizeof(PolicyRuleRecord));
+  for (uint8_t i = 0; i < count; ++i) {
+    if (!isRuleValid(rules[i])) return false;
+    for (uint8_t j = 0; j < i; ++j) {
+      if (isRuleConflict(rules[j], rules[i])) return false;
+    }
+  }
+  return true;
+}
+
+void installRuleSet(const uint8_t* data, size_t len, const PolicyRuleRecord* rules, uint8_t count) {
+  memcpy(g_rules, rules, count * sizeof(PolicyRuleRecord));
+  g_rule_count = count;
+  g_next_rule = 0;
+  if (len > 0) memcpy(g_rule_set, data, len);
+  g_rule_set_len = len;
+}
+
+void saveRuleSet() {
+  if (!g_is_fs_ready) return;
+  WatchdogScope fs_wdt(WatchdogSection::Storage);
+  if (g_rule_set_len == 0) {
+    LittleFS.remove(k_policy_path);
+    return;
+  }
+  File file = LittleFS.open(k_policy_path, "w");
+  if (!file) return;
+  if (file.write(g_rule_set, g_rule_set_len) != g_rule_set_len) logError(k_log_tag, "Failed to save rule set.");
+  file.close();
+}
+
+bool evaluateRule(const PolicyRuleRecord& rule, uint32_t now_ms, ACUState& next) {
+  const PolicyUnitState& unit = g_units[rule.unit];
+  if (!unit.has_state || !unit.state.power) return false;
+  next = unit.state;
+
+  switch ((PolicyRuleType)rule.type) {
+    case PolicyRuleType::Ramp:
+      if (unit.state.temperature == rule.temperature) return false;
+      if (!hasElapsed(now_ms, unit.last_ramp_ms, rule.minutes)) return false;
+      next.temperature += (rule.temperature > unit.state.temperature) ? 1 : -1;
+      return true;
+
+    case PolicyRuleType::MaxRuntime:
+      if (!hasElapsed(now_ms, unit.power_on_ms, rule.minutes)) return false;
+      next.power = false;
+      return true;
+
+    case PolicyRuleType::EcoRevert:
+      if (unit.state.temperature == rule.temperature && unit.state.fan_speed == rule.fan_speed) return false;
+      if (!hasElapsed(now_ms, unit.last_command_ms, rule.minutes)) return false;
+      next.temperature = rule.temperature;
+      next.fan_speed = rule.fan_speed;
+      return true;
+
+    case PolicyRuleType::Vacancy:
+      if (!unit.has_occupancy || unit.is_occupied) return false;
+      if (!hasElapsed(now_ms, unit.vacant_since_ms, rule.minutes)) return false;
+      next.power = false;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+} // namespace
+
+bool beginPolicy() {
+  g_is_fs_ready = LittleFS.begin();
+  if (!g_is_fs_ready) {
+    logError(k_log_tag, "LittleFS mount failed.");
+    return false;
+  }
+
+  File file = LittleFS.open(k_policy_path, "r");
+  if (!file) return true;
+  uint8_t data[k_rule_set_max];
+  size_t len = file.read(data, sizeof(data));
+  file.close();
+
+  PolicyRuleRecord rules[k_policy_rules_max];
+  uint8_t count = 0;
+  if (!parseRuleSet(data, len, rules, count)) {
+    logWarn(k_log_tag, "Stored rule set is invalid, ignoring it.");
+    return true;
+  }
+  installRuleSet(data, len, rules, count);
+  logInfo(k_log_tag, "Loaded %u rules.", g_rule_count);
+  return true;
+}
+
+bool loadPolicyRuleSet(const uint8_t* data, size_t len) {
+  PolicyRuleRecord rules[k_policy_rules_max];
+  uint8_t count = 0;
+  if (!parseRuleSet(data, len, rules, count)) return false;
+
+  // Retained rule sets are redelivered on every reconnect; only touch flash on change
+  if (len == g_rule_set_len && (len == 0 || memcmp(data, g_rule_set, len) == 0)) return true;
+
+  installRuleSet(data, len, rules, count);
+  saveRuleSet();
+  logInfo(k_log_tag, "Installed %u rules.", g_rule_count);
+  return true;
+}
+
+uint8_t getPolicyRuleCount() {
+  return g_rule_count;
+}
+
+void notePolicyState(uint8_t unit, const ACUState& state, uint32_t now_ms, bool is_command) {
+  if (unit >= k_policy_units_max) return;
+  PolicyUnitState& target = g_units[unit];
+
+  bool was_on = target.has_state && target.state.power;
+  if (state.power && !was_on) target.power_on_ms = now_ms;
+  if (is_command) target.last_command_ms = now_ms;
+  target.last_ramp_ms = now_ms; // Every change restarts the ramp interval
+  target.state = state;
+  target.has_state = true;
+}
+
+void notePolicyOccupancy(uint8_t unit, bool is_occupied, uint32_t now_ms) {
+  if (unit >= k_policy_units_max) return;
+  PolicyUnitState& target = g_units[unit];
+
+  if (!is_occupied && (target.is_occupied || !target.has_occupancy)) target.vacant_since_ms = now_ms;
+  target.is_occupied = is_occupied;
+  target.has_occupancy = true;
+}
+
+bool pollPolicy(uint32_t now_ms, PolicyAction& action) {
+  if (g_rule_count == 0) return false;
+  if (g_next_rule >= g_rule_count) g_next_rule = 0;
+
+  uint8_t index = g_next_rule++;
+  const PolicyRuleRecord& rule = g_rules[index];
+  if (!evaluateRule(rule, now_ms, action.state)) return false;
+
+  action.rule = index;
+  action.unit = rule.unit;
+  action.type = (PolicyRuleType)rule.type;
+  return true;
+}
+
+const char* policyRuleTypeName(PolicyRuleType type) {
+  switch (type) {
+    case PolicyRuleType::Ramp:       return "ramp";
+    case PolicyRuleType::MaxRuntime: return "max_runtime";
+    case PolicyRuleType::EcoRevert:  return "eco";
+    case PolicyRuleType::Vacancy:    return "vacancy";
+    default:                         return "none";
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/*
+ * ACU_policy.h
+ *
+ * Small on-device rule engine for routine thermal control.
+ *
+ * - Rules arrive as a compact binary rule set (8 bytes per rule, see
+ *   PolicyRuleRecord) and are persisted to LittleFS.
+ * - One rule is evaluated per call, round-robin, so the cost per loop() stays
+ *   constant regardless of the rule count.
+ * - The engine only observes unit states and proposes new ones; the caller
+ *   transmits them and reports back through notePolicyState().
+ * - Rules are not arbitrated at run time, so a rule set is rejected when two
+ *   setpoint rules (ramp, eco revert) on the same unit disagree on the
+ *   temperature, or two eco reverts on the fan speed.
+ *
+ * Rule set layout (little endian):
+ *   uint16 magic 0x5041 ("AP"), uint8 version (1), uint8 rule count,
+ *   PolicyRuleRecord[count], uint8 checksum (XOR of all preceding bytes)
+ */
+
+#include <Arduino.h>
+#include "ACU_remote_encoder.h"
+
+constexpr uint8_t k_policy_rules_max = 8;
+constexpr uint8_t k_policy_units_max = 3;
+
+enum class PolicyRuleType : uint8_t {
+  None = 0,
+  Ramp = 1,        // Step the setpoint 1 C towards 'temperature' every 'minutes'
+  MaxRuntime = 2,  // Power off after 'minutes' of continuous runtime
+  EcoRevert = 3,   // Apply 'temperature'/'fan_speed' after 'minutes' without a command
+  Vacancy = 4      // Power off after the room has been vacant for 'minutes'
+};
+
+struct __attribute__((packed)) PolicyRuleRecord {
+  uint8_t type;        // PolicyRuleType
+  uint8_t unit;        // Unit index
+  uint16_t minutes;
+  uint8_t temperature; // Ramp target / eco setpoint
+  uint8_t fan_speed;   // Eco fan speed
+  uint8_t reserved[2];
+};
+
+static_assert(sizeof(PolicyRuleRecord) == 8, "Rule records are 8 bytes on the wire");
+
+struct PolicyAction {
+  uint8_t rule = 0;
+  uint8_t unit = 0;
+  PolicyRuleType type = PolicyRuleType::None;
+  ACUState state = {};
+};
+
+/**
+ * @brief Mount the filesystem and load the persisted rule set.
+ */
+bool beginPolicy();
+
+/**
+ * @brief Validate and install a binary rule set, persisting it if it changed.
+ *
+ * An empty rule set (length 0) removes all rules.
+ *
+ * @return false if the blob is malformed or has conflicting rules (the
+ *         current rules are kept).
+ */
+bool loadPolicyRuleSet(const uint8_t* data, size_t len);
+
+/**
+ * @brief Number of installed rules.
+ */
+uint8_t getPolicyRuleCount();
+
+/**
+ * @brief Report a unit's new state.
+ *
+ * @param is_command true for dashboard/schedule commands (restarts idle timers),
+ *                   false for states applied by the engine itself.
+ */
+void notePolicyState(uint8_t unit, const ACUState& state, uint32_t now_ms, bool is_command);
+
+/**
+ * @brief Report room occupancy for a unit (from a sensor or the dashboard).
+ */
+void notePolicyOccupancy(uint8_t unit, bool is_occupied, uint32_t now_ms);
+
+/**
+ * @brief Evaluate the next rule (call from loop()).
+ *
+ * @param now_ms millis().
+ * @param action Filled with the state to apply.
+ * @return true if the evaluated rule wants to change a unit's state.
+ */
+bool pollPolicy(uint32_t now_ms, PolicyAction& action);
+
+/**
+ * @brief Short name of a rule type ("ramp", "max_runtime", "eco", "vacancy").
+ */
+const char* policyRuleTypeName(PolicyRuleType type);
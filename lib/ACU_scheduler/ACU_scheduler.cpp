@@ -0,0 +1,212 @@
+#include "ACU_scheduler.h"
+#include "logging.h"
+#include "Watchdog.h"
+
+#include <LittleFS.h>
+
+namespace {
+
+constexpr const char* k_log_tag = "SCHED";
+constexpr const char* k_schedule_path = "/schedule.bin";
+constexpr uint32_t k_schedule_magic = 0x43534341; // "ACSC"
+constexpr uint8_t k_schedule_version = 1;
+
+struct __attribute__((packed)) ScheduleHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t count;
+  uint8_t checksum; // XOR of record bytes
+  uint8_t reserved;
+};
+
+struct __attribute__((packed)) ScheduleRecord {
+  uint8_t slot;
+  uint8_t unit;
+  ACUState state;
+  uint64_t minutes;
+  uint32_t hours;
+  uint32_t days;
+  uint16_t months;
+  uint8_t weekdays;
+  uint8_t flags; // bit0 = day any, bit1 = weekday any
+};
+
+ScheduleEntry g_entries[k_schedule_entries_max];
+uint16_t g_jitter_s = 0;
+CronClock g_clock;
+uint32_t g_pending_mask = 0;
+bool g_is_fs_ready = false;
+
+static_assert(k_schedule_entries_max <= 32, "g_pending_mask holds one bit per slot");
+
+ScheduleRecord toRecord(uint8_t slot, const ScheduleEntry& entry) {
+  ScheduleRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.slot = slot;
+  rec.unit = entry.unit;
+  rec.state = entry.state;
+  rec.minutes = entry.when.minutes;
+  rec.hours = entry.when.hours;
+  rec.days = entry.when.days;
+  rec.months = entry.when.months;
+  rec.weekdays = entry.when.weekdays;
+  rec.flags = (entry.when.is_day_any ? 1 : 0) | (entry.when.is_weekday_any ? 2 : 0);
+  return rec;
+}
+
+void fromRecord(const ScheduleRecord& rec, ScheduleEntry& entry) {
+  entry = ScheduleEntry();
+  entry.unit = rec.unit;
+  entry.state = rec.state;
+  entry.when.minutes = rec.minutes;
+  entry.when.hours = rec.hours;
+  entry.when.days = rec.days;
+  entry.when.months = rec.months;
+  entry.when.weekdays = rec.weekdays;
+  entry.when.is_day_any = rec.flags & 1;
+  entry.when.is_weekday_any = rec.flags & 2;
+  entry.is_active = true;
+}
+
+uint8_t recordChecksum(const ScheduleRecord& rec, uint8_t sum) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&rec);
+  for (size_t i = 0; i < sizeof(rec); ++i) sum ^= bytes[i];
+  return sum;
+}
+
+bool saveSchedule() {
+  if (!g_is_fs_ready) return false;
+  WatchdogScope fs_wdt(WatchdogSection::Storage);
+
+  ScheduleHeader header = {k_schedule_magic, k_schedule_version, 0, 0, 0};
+  for (uint8_t slot = 0; slot < k_schedule_entries_max; ++slot) {
+    if (!g_entries[slot].is_active) continue;
+    header.count++;
+    header.checksum = recordChecksum(toRecord(slot, g_entries[slot]), header.checksum);
+  }
+
+  File file = LittleFS.open(k_schedule_path, "w");
+  if (!file) return false;
+  bool is_ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  for (uint8_t slot = 0; slot < k_schedule_entries_max && is_ok; ++slot) {
+    if (!g_entries[slot].is_active) continue;
+    ScheduleRecord rec = toRecord(slot, g_entries[slot]);
+    is_ok = file.write(reinterpret_cast<const uint8_t*>(&rec), sizeof(rec)) == sizeof(rec);
+  }
+  file.close();
+
+  if (!is_ok) logError(k_log_tag, "Failed to save schedule.");
+  return is_ok;
+}
+
+bool loadSchedule() {
+  File file = LittleFS.open(k_schedule_path, "r");
+  if (!file) return false;
+
+  ScheduleHeader header;
+  bool is_ok = file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+               header.magic == k_schedule_magic && header.version == k_schedule_version &&
+               header.count <= k_schedule_entries_max;
+
+  ScheduleEntry loaded[k_schedule_entries_max];
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; is_ok && i < header.count; ++i) {
+    ScheduleRecord rec;
+    is_ok = file.read(reinterpret_cast<uint8_t*>(&rec), sizeof(rec)) == sizeof(rec) && rec.slot < k_schedule_entries_max;
+    if (!is_ok) break;
+    checksum = recordChecksum(rec, checksum);
+    fromRecord(rec, loaded[rec.slot]);
+  }
+  file.close();
+
+  if (!is_ok || checksum != header.checksum) {
+    logWarn(k_log_tag, "Stored schedule is corrupt, ignoring it.");
+    return false;
+  }
+  memcpy(g_entries, loaded, sizeof(g_entries));
+  return true;
+}
+
+void markDueEntries(time_t minute_start) {
+  struct tm local_time;
+  localtime_r(&minute_start, &local_time);
+  for (uint8_t slot = 0; slot < k_schedule_entries_max; ++slot) {
+    const ScheduleEntry& entry = g_entries[slot];
+    if (entry.is_active && isCronMatch(entry.when, local_time)) {
+      g_pending_mask |= (uint32_t)1 << slot;
+    }
+  }
+}
+
+} // namespace
+
+bool beginSchedule() {
+  g_is_fs_ready = LittleFS.begin();
+  if (!g_is_fs_ready) {
+    logError(k_log_tag, "LittleFS mount failed.");
+    return false;
+  }
+  if (loadSchedule()) logInfo(k_log_tag, "Loaded %u schedule entries.", getScheduleEntryCount());
+  return true;
+}
+
+void setScheduleJitter(uint16_t jitter_s) {
+  g_jitter_s = (jitter_s > k_schedule_jitter_max_s) ? k_schedule_jitter_max_s : jitter_s;
+}
+
+bool setScheduleEntry(uint8_t slot, const char* cron, uint8_t unit, const ACUState& state) {
+  if (slot >= k_schedule_entries_max) return false;
+
+  ScheduleEntry entry;
+  if (!parseCronExpression(cron, entry.when)) return false;
+  entry.unit = unit;
+  entry.state = state;
+  entry.is_active = true;
+
+  // Retained entries are redelivered on every reconnect; only touch flash on change
+  ScheduleRecord current = toRecord(slot, g_entries[slot]);
+  ScheduleRecord updated = toRecord(slot, entry);
+  if (g_entries[slot].is_active && memcmp(&current, &updated, sizeof(ScheduleRecord)) == 0) return true;
+
+  g_entries[slot] = entry;
+  saveSchedule();
+  return true;
+}
+
+bool clearScheduleEntry(uint8_t slot) {
+  if (slot >= k_schedule_entries_max) return false;
+  if (!g_entries[slot].is_active) return true;
+
+  g_entries[slot] = ScheduleEntry();
+  g_pending_mask &= ~((uint32_t)1 << slot);
+  saveSchedule();
+  return true;
+}
+
+uint8_t getScheduleEntryCount() {
+  uint8_t count = 0;
+  for (const ScheduleEntry& entry : g_entries) {
+    if (entry.is_active) count++;
+  }
+  return count;
+}
+
+bool pollSchedule(time_t now, ScheduleHit& hit) {
+  time_t first = 0;
+  time_t last = 0;
+  if (advanceCronClock(g_clock, now, g_jitter_s, first, last)) {
+    for (time_t m = first; m <= last; ++m) markDueEntries(m * 60);
+  }
+
+  for (uint8_t slot = 0; slot < k_schedule_entries_max && g_pending_mask != 0; ++slot) {
+    uint32_t bit = (uint32_t)1 << slot;
+    if (!(g_pending_mask & bit)) continue;
+    g_pending_mask &= ~bit;
+
+    hit.slot = slot;
+    hit.unit = g_entries[slot].unit;
+    hit.state = g_entries[slot].state;
+    return true;
+  }
+  return false;
+}
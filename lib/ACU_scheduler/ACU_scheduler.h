@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * ACU_scheduler.h
+ *
+ * On-device schedule table of cron-like entries mapped to ACU states.
+ *
+ * - Entries use the 5-field cron syntax from Cron.h.
+ * - Evaluation runs against local time from time(); each wall-clock minute is
+ *   evaluated once, shifted by a per-device jitter so a floor of modules does
+ *   not fire in lockstep.
+ * - The table is persisted to LittleFS so it survives reboots while the broker
+ *   is unreachable.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include "ACU_remote_encoder.h"
+#include "Cron.h"
+
+constexpr uint8_t k_schedule_entries_max = 16;
+constexpr uint16_t k_schedule_jitter_max_s = 59; // Keeps every entry inside its own minute
+
+struct ScheduleEntry {
+  CronSpec when;
+  ACUState state = {};
+  uint8_t unit = 0;
+  bool is_active = false;
+};
+
+struct ScheduleHit {
+  uint8_t slot = 0;
+  uint8_t unit = 0;
+  ACUState state = {};
+};
+
+/**
+ * @brief Mount the filesystem and load the persisted table.
+ */
+bool beginSchedule();
+
+/**
+ * @brief Set the per-device firing offset in seconds (clamped to k_schedule_jitter_max_s).
+ */
+void setScheduleJitter(uint16_t jitter_s);
+
+/**
+ * @brief Store an entry in a slot and persist the table if it changed.
+ *
+ * @return false if the slot is out of range or the expression is invalid.
+ */
+bool setScheduleEntry(uint8_t slot, const char* cron, uint8_t unit, const ACUState& state);
+
+/**
+ * @brief Remove the entry in a slot and persist the table if it changed.
+ */
+bool clearScheduleEntry(uint8_t slot);
+
+/**
+ * @brief Number of active entries.
+ */
+uint8_t getScheduleEntryCount();
+
+/**
+ * @brief Return the next entry due at 'now' (call repeatedly from loop()).
+ *
+ * Each minute is evaluated once (see advanceCronClock()). Short stalls are
+ * caught up, large forward jumps (e.g. the first NTP sync) only evaluate the
+ * current minute, and a backward step re-evaluates nothing.
+ *
+ * @param now UTC epoch seconds from time().
+ * @param hit Filled with the due entry.
+ * @return true if an entry is due.
+ */
+bool pollSchedule(time_t now, ScheduleHit& hit);
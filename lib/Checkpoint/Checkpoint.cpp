@@ -0,0 +1,59 @@
+#include "Checkpoint.h"
+#include "ESP_system.h"
+
+#include <coredecls.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+
+constexpr uint32_t k_checkpoint_magic = 0x50544B43; // "CKTP"
+
+struct Header {
+  uint32_t magic;
+  uint32_t layout; // version << 16 | payload length
+  uint32_t crc;    // Over layout and payload
+};
+static_assert(sizeof(Header) == k_checkpoint_header_len, "Header is three RTC blocks");
+
+uint32_t layoutOf(size_t len, uint16_t version) {
+  return ((uint32_t)version << 16) | (uint32_t)len;
+}
+
+uint32_t checkpointCrc(uint32_t layout, const void* payload, size_t len) {
+  return crc32(payload, len, crc32(&layout, sizeof(layout)));
+}
+
+} // namespace
+
+void saveCheckpoint(const void* payload, size_t len, uint16_t version) {
+  if (len == 0 || len % 4 != 0 || len > k_checkpoint_payload_max) return;
+
+  Header header;
+  header.magic = k_checkpoint_magic;
+  header.layout = layoutOf(len, version);
+  header.crc = checkpointCrc(header.layout, payload, len);
+
+  // Payload first: a reset between the writes leaves a header whose CRC fails
+  ESP.rtcUserMemoryWrite(k_checkpoint_rtc_block + sizeof(Header) / 4,
+                         const_cast<uint32_t*>(static_cast<const uint32_t*>(payload)), len);
+  ESP.rtcUserMemoryWrite(k_checkpoint_rtc_block, reinterpret_cast<uint32_t*>(&header), sizeof(header));
+}
+
+bool loadCheckpoint(void* payload, size_t len, uint16_t version) {
+  if (!isWarmBoot() || len == 0 || len % 4 != 0 || len > k_checkpoint_payload_max) return false;
+
+  Header header;
+  if (!ESP.rtcUserMemoryRead(k_checkpoint_rtc_block, reinterpret_cast<uint32_t*>(&header), sizeof(header))) return false;
+  if (header.magic != k_checkpoint_magic || header.layout != layoutOf(len, version)) return false;
+
+  if (!ESP.rtcUserMemoryRead(k_checkpoint_rtc_block + sizeof(Header) / 4, static_cast<uint32_t*>(payload), len)) return false;
+  return header.crc == checkpointCrc(header.layout, payload, len);
+}
+
+void clearCheckpoint() {
+  Header header = {};
+  ESP.rtcUserMemoryWrite(k_checkpoint_rtc_block, reinterpret_cast<uint32_t*>(&header), sizeof(header));
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * Checkpoint.h
+ *
+ * One record of runtime state in RTC user memory. It survives a soft reset
+ * (WDT, exception, ESP.restart()) but not a power cycle, so a warm boot can
+ * pick up where the previous boot stopped instead of starting from zero.
+ *
+ * The record carries a magic, the payload's layout version and length, and a
+ * CRC32 over all of it. Random contents after a power-on, a write cut short
+ * by the reset, or a firmware with another layout are all rejected.
+ *
+ * RTC user memory blocks 0-31 hold the OTA boot loader command and 32-37 the
+ * watchdog breadcrumb; the checkpoint starts at block 40.
+ */
+
+#include <Arduino.h>
+
+constexpr uint32_t k_checkpoint_rtc_block = 40;
+constexpr size_t k_checkpoint_header_len = 12;
+constexpr size_t k_checkpoint_payload_max = (128 - k_checkpoint_rtc_block) * 4 - k_checkpoint_header_len;
+
+/**
+ * @brief Replace the record with a payload.
+ *
+ * @param payload 4-byte aligned, len a multiple of 4 and at most k_checkpoint_payload_max.
+ * @param version Layout version; loadCheckpoint() only accepts the same one.
+ */
+void saveCheckpoint(const void* payload, size_t len, uint16_t version);
+
+/**
+ * @brief Read the record the previous boot saved.
+ *
+ * @return false on a cold boot, or if the record is missing, has another
+ *         version or length, or fails its CRC (payload is then undefined).
+ */
+bool loadCheckpoint(void* payload, size_t len, uint16_t version);
+
+/**
+ * @brief Invalidate the record until the next saveCheckpoint().
+ */
+void clearCheckpoint();
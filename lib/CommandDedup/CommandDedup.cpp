@@ -0,0 +1,57 @@
+#include "CommandDedup.h"
+
+#include <string.h>
+
+namespace {
+
+// Further back than the window: not a redelivery, the sender counts from a new start
+bool isSenderRestart(const DedupSender& slot, uint32_t seq) {
+  return seq < slot.highest_seq && slot.highest_seq - seq >= k_dedup_window_bits;
+}
+
+} // namespace
+
+bool isDuplicateSeq(const DedupSender* slots, const char* sender, uint32_t seq) {
+  for (uint8_t i = 0; i < k_dedup_sender_slots; ++i) {
+    const DedupSender& slot = slots[i];
+    if (slot.sender[0] == '\0' || strcmp(slot.sender, sender) != 0) continue;
+
+    if (seq > slot.highest_seq || isSenderRestart(slot, seq)) return false;
+    return (slot.seen_mask >> (slot.highest_seq - seq)) & 1;
+  }
+  return false;
+}
+
+void markSeqSeen(DedupSender* slots, const char* sender, uint32_t seq, unsigned long now_ms) {
+  DedupSender* target = nullptr;
+  DedupSender* oldest = &slots[0];
+
+  for (uint8_t i = 0; i < k_dedup_sender_slots; ++i) {
+    DedupSender& slot = slots[i];
+    if (slot.sender[0] != '\0' && strcmp(slot.sender, sender) == 0) {
+      target = &slot;
+      break;
+    }
+    // Prefer an empty slot, otherwise the least recently used one
+    if (oldest->sender[0] == '\0') continue;
+    if (slot.sender[0] == '\0' || (now_ms - slot.last_used_ms) > (now_ms - oldest->last_used_ms)) {
+      oldest = &slot;
+    }
+  }
+
+  if (target == nullptr || isSenderRestart(*target, seq)) {
+    if (target == nullptr) target = oldest;
+    *target = DedupSender();
+    strncpy(target->sender, sender, sizeof(target->sender) - 1);
+    target->highest_seq = seq;
+    target->seen_mask = 1;
+  } else if (seq > target->highest_seq) {
+    uint32_t shift = seq - target->highest_seq;
+    target->seen_mask = (shift >= k_dedup_window_bits) ? 0 : (target->seen_mask << shift);
+    target->seen_mask |= 1;
+    target->highest_seq = seq;
+  } else {
+    target->seen_mask |= (uint32_t)1 << (target->highest_seq - seq);
+  }
+  target->last_used_ms = now_ms;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * CommandDedup.h
+ *
+ * Per-sender idempotency windows for sequenced commands. A QoS1 redelivery
+ * of a command that already ran is recognised by (sender, seq) and not
+ * executed twice.
+ *
+ * Each sender keeps the highest sequence number seen plus a bitmask of the
+ * k_dedup_window_bits numbers behind it. A sequence number further back than
+ * that cannot be a redelivery of a tracked command: the sender restarted its
+ * counter, and the window starts over from it.
+ *
+ * No Arduino dependencies, so it also builds for the native test env.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr size_t k_sender_id_max = 16;
+constexpr uint8_t k_dedup_sender_slots = 4;
+constexpr uint8_t k_dedup_window_bits = 32; // Sequence numbers tracked behind the highest seen
+
+// Bit i of seen_mask marks (highest_seq - i) as executed.
+struct DedupSender {
+  char sender[k_sender_id_max] = {0};
+  uint32_t highest_seq = 0;
+  uint32_t seen_mask = 0;
+  unsigned long last_used_ms = 0;
+};
+
+/**
+ * @brief true if seq from sender already ran within the sender's window.
+ *
+ * @param slots k_dedup_sender_slots entries.
+ */
+bool isDuplicateSeq(const DedupSender* slots, const char* sender, uint32_t seq);
+
+/**
+ * @brief Record seq from sender as executed.
+ *
+ * An unknown sender takes an empty slot, or else the least recently used one.
+ * A seq more than the window behind the highest one restarts the sender's window.
+ *
+ * @param slots k_dedup_sender_slots entries.
+ * @param now_ms millis(), for the LRU eviction.
+ */
+void markSeqSeen(DedupSender* slots, const char* sender, uint32_t seq, unsigned long now_ms);
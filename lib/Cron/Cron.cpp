@@ -0,0 +1,112 @@
+#include "Cron.h"
+
+#include <string.h>
+
+namespace {
+
+bool parseNumber(const char* text, uint8_t& value) {
+  if (text == nullptr || *text == '\0') return false;
+  uint16_t result = 0;
+  for (const char* p = text; *p != '\0'; ++p) {
+    if (*p < '0' || *p > '9') return false;
+    result = result * 10 + (*p - '0');
+    if (result > 255) return false;
+  }
+  value = (uint8_t)result;
+  return true;
+}
+
+// format: "*", "N", "A-B", any of them with "/step", comma-separated
+bool parseCronField(char* field, uint8_t min_value, uint8_t max_value, uint64_t& mask, bool& is_any) {
+  mask = 0;
+  is_any = strcmp(field, "*") == 0;
+
+  char* item_save = nullptr;
+  for (char* item = strtok_r(field, ",", &item_save); item != nullptr; item = strtok_r(nullptr, ",", &item_save)) {
+    uint8_t step = 1;
+    char* slash = strchr(item, '/');
+    if (slash != nullptr) {
+      *slash = '\0';
+      if (!parseNumber(slash + 1, step) || step == 0) return false;
+    }
+
+    uint8_t lo = min_value;
+    uint8_t hi = max_value;
+    if (strcmp(item, "*") != 0) {
+      char* dash = strchr(item, '-');
+      if (dash != nullptr) {
+        *dash = '\0';
+        if (!parseNumber(item, lo) || !parseNumber(dash + 1, hi)) return false;
+      } else {
+        if (!parseNumber(item, lo)) return false;
+        hi = (slash != nullptr) ? max_value : lo; // "N/step" runs to the end of the range
+      }
+    }
+    if (lo < min_value || hi > max_value || lo > hi) return false;
+
+    for (uint16_t v = lo; v <= hi; v += step) mask |= (uint64_t)1 << v;
+  }
+  return mask != 0;
+}
+
+} // namespace
+
+bool parseCronExpression(const char* expr, CronSpec& spec) {
+  if (expr == nullptr || strlen(expr) >= k_cron_expression_max) return false;
+
+  char buffer[k_cron_expression_max];
+  strncpy(buffer, expr, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+
+  char* fields[5];
+  uint8_t field_count = 0;
+  char* field_save = nullptr;
+  for (char* field = strtok_r(buffer, " ", &field_save); field != nullptr; field = strtok_r(nullptr, " ", &field_save)) {
+    if (field_count >= 5) return false;
+    fields[field_count++] = field;
+  }
+  if (field_count != 5) return false;
+
+  spec = CronSpec();
+  uint64_t mask = 0;
+  bool is_any = false;
+
+  if (!parseCronField(fields[0], 0, 59, mask, is_any)) return false;
+  spec.minutes = mask;
+  if (!parseCronField(fields[1], 0, 23, mask, is_any)) return false;
+  spec.hours = (uint32_t)mask;
+  if (!parseCronField(fields[2], 1, 31, mask, spec.is_day_any)) return false;
+  spec.days = (uint32_t)mask;
+  if (!parseCronField(fields[3], 1, 12, mask, is_any)) return false;
+  spec.months = (uint16_t)mask;
+  if (!parseCronField(fields[4], 0, 7, mask, spec.is_weekday_any)) return false;
+  if (mask & (1 << 7)) mask |= 1; // 7 is also Sunday
+  spec.weekdays = (uint8_t)(mask & 0x7F);
+  return true;
+}
+
+bool isCronMatch(const CronSpec& spec, const struct tm& local_time) {
+  if (!((spec.minutes >> local_time.tm_min) & 1)) return false;
+  if (!((spec.hours >> local_time.tm_hour) & 1)) return false;
+  if (!((spec.months >> (local_time.tm_mon + 1)) & 1)) return false;
+
+  bool is_day_match = (spec.days >> local_time.tm_mday) & 1;
+  bool is_weekday_match = (spec.weekdays >> local_time.tm_wday) & 1;
+  if (!spec.is_day_any && !spec.is_weekday_any) return is_day_match || is_weekday_match;
+  return is_day_match && is_weekday_match;
+}
+
+bool advanceCronClock(CronClock& clock, time_t now, uint16_t jitter_s, time_t& first_minute, time_t& last_minute) {
+  if (now < k_clock_valid_after_s) return false;
+
+  time_t minute = (now - jitter_s) / 60;
+  if (minute <= clock.last_minute) return false; // Same minute, or the clock stepped back
+
+  first_minute = minute;
+  if (clock.last_minute >= 0 && minute - clock.last_minute <= k_catchup_minutes_max) {
+    first_minute = clock.last_minute + 1;
+  }
+  last_minute = minute;
+  clock.last_minute = minute;
+  return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+ * Cron.h
+ *
+ * Cron expressions compiled into bitmasks, and the minute clock that decides
+ * which wall-clock minutes are due for evaluation.
+ *
+ * - Expressions use the classic 5-field syntax "min hour dom month dow"
+ *   (*, N, A-B, lists and /step), so matching a minute is a handful of AND
+ *   operations.
+ * - The clock is passed in by the caller, so both can be driven by a fake
+ *   clock. No Arduino dependencies.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+constexpr size_t k_cron_expression_max = 48;
+constexpr time_t k_clock_valid_after_s = 1672531200; // 2023-01-01, anything earlier is unsynced
+constexpr time_t k_catchup_minutes_max = 3;
+
+struct CronSpec {
+  uint64_t minutes = 0;   // Bits 0-59
+  uint32_t hours = 0;     // Bits 0-23
+  uint32_t days = 0;      // Bits 1-31
+  uint16_t months = 0;    // Bits 1-12
+  uint8_t weekdays = 0;   // Bits 0-6, Sunday = 0
+  bool is_day_any = true;     // Day-of-month field was "*"
+  bool is_weekday_any = true; // Day-of-week field was "*"
+};
+
+// Last minute handed out, as (epoch seconds - jitter) / 60. -1 before the first one.
+struct CronClock {
+  time_t last_minute = -1;
+};
+
+/**
+ * @brief Compile a 5-field cron expression.
+ *
+ * @return false on syntax or range errors ('spec' is left unspecified).
+ */
+bool parseCronExpression(const char* expr, CronSpec& spec);
+
+/**
+ * @brief Check whether a broken-down local time matches a compiled expression.
+ *
+ * Follows cron semantics: when both day-of-month and day-of-week are
+ * restricted, either one matching is enough.
+ */
+bool isCronMatch(const CronSpec& spec, const struct tm& local_time);
+
+/**
+ * @brief Advance the clock to 'now' and return the minutes that became due.
+ *
+ * Minute boundaries are shifted by jitter_s, so "21:00" is due at 21:00:jitter.
+ * Each minute is handed out once. Up to k_catchup_minutes_max skipped minutes
+ * are caught up; a larger forward jump (e.g. the first NTP sync) only yields
+ * the current minute. A backward step yields nothing until the clock passes
+ * the last minute handed out again, so entries do not fire twice.
+ *
+ * @param now UTC epoch seconds from time(); ignored until the clock is synced.
+ * @param first_minute,last_minute Due range, in minutes since the epoch (inclusive).
+ * @return true if at least one minute is due.
+ */
+bool advanceCronClock(CronClock& clock, time_t now, uint16_t jitter_s, time_t& first_minute, time_t& last_minute);
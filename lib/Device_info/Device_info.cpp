@@ -0,0 +1,38 @@
+#include "Device_info.h"
+
+#include <stdio.h>
+
+void formatDeviceId(char* buf, size_t len, uint32_t chip_id) {
+  if (buf == nullptr || len == 0) return;
+  snprintf(buf, len, "ESP8266Client-%06X", (unsigned int)chip_id);
+}
+
+void formatMacAddress(char* buf, size_t len, const uint8_t mac[6]) {
+  if (buf == nullptr || len == 0) return;
+  snprintf(buf, len, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+void formatIpAddress(char* buf, size_t len, uint32_t ip) {
+  if (buf == nullptr || len == 0) return;
+  snprintf(buf, len, "%u.%u.%u.%u", (unsigned int)(ip & 0xFF), (unsigned int)((ip >> 8) & 0xFF),
+           (unsigned int)((ip >> 16) & 0xFF), (unsigned int)(ip >> 24));
+}
+
+const char* resetReasonName(uint32_t reason) {
+  static const char* const k_reset_reasons[] = {
+    "Power On",
+    "Hardware Watchdog",
+    "Exception",
+    "Software Watchdog",
+    "Software/System restart",
+    "Deep-Sleep Wake",
+    "External System",
+  };
+  if (reason >= sizeof(k_reset_reasons) / sizeof(k_reset_reasons[0])) return "Unknown";
+  return k_reset_reasons[reason];
+}
+
+bool isCrashResetReason(uint32_t reason) {
+  return reason == k_reset_reason_wdt || reason == k_reset_reason_exception || reason == k_reset_reason_soft_wdt;
+}
+
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * Device_info.h
+ *
+ * Text fields of the retained identity and deployment records: device id,
+ * MAC and IP text, reset cause names. The callers (mqtt_publish.cpp,
+ * WiFiManager, ESP_system) read the values from the core; the helpers take
+ * plain integers and fixed buffers and never allocate.
+ *
+ * No Arduino dependencies, so it also builds for the native test env.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// rst_info::reason values of the ESP8266 SDK
+constexpr uint32_t k_reset_reason_wdt = 1;
+constexpr uint32_t k_reset_reason_exception = 2;
+constexpr uint32_t k_reset_reason_soft_wdt = 3;
+
+/**
+ * @brief "ESP8266Client-XXXXXX" from the chip id.
+ */
+void formatDeviceId(char* buf, size_t len, uint32_t chip_id);
+
+/**
+ * @brief "AA:BB:CC:DD:EE:FF"; needs 18 bytes.
+ */
+void formatMacAddress(char* buf, size_t len, const uint8_t mac[6]);
+
+/**
+ * @brief Dotted quad; needs 16 bytes.
+ *
+ * @param ip As IPAddress stores it: first octet in the low byte.
+ */
+void formatIpAddress(char* buf, size_t len, uint32_t ip);
+
+/**
+ * @brief Name of a reset cause (same strings as ESP.getResetReason()), "Unknown" if out of range.
+ */
+const char* resetReasonName(uint32_t reason);
+
+/**
+ * @brief true for a hardware/software WDT reset or an exception.
+ */
+bool isCrashResetReason(uint32_t reason);
@@ -0,0 +1,23 @@
+#include "ESP_system.h"
+#include "Device_info.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+uint32_t getResetReason() {
+  const rst_info* info = ESP.getResetInfoPtr();
+  return (info != nullptr) ? info->reason : REASON_DEFAULT_RST;
+}
+
+const char* getResetReasonName() {
+  return resetReasonName(getResetReason());
+}
+
+bool isCrashReset() {
+  return isCrashResetReason(getResetReason());
+}
+
+bool isWarmBoot() {
+  return isCrashReset() || getResetReason() == REASON_SOFT_RESTART;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * ESP_system.h
+ *
+ * Reset cause helpers over the SDK's rst_info, shared by the modules that
+ * behave differently after a crash or a soft reset (Watchdog, Checkpoint).
+ * None of them allocate; the names and the crash test are in Device_info.
+ */
+
+#include <Arduino.h>
+
+/**
+ * @brief rst_info::reason of the last reset (REASON_DEFAULT_RST if the SDK has none).
+ */
+uint32_t getResetReason();
+
+/**
+ * @brief Name of the last reset cause (same strings as ESP.getResetReason()), without heap use.
+ */
+const char* getResetReasonName();
+
+/**
+ * @brief true if the last reset was a hardware/software WDT or an exception.
+ */
+bool isCrashReset();
+
+/**
+ * @brief true if this boot followed a soft reset (WDT, exception or ESP.restart()).
+ */
+bool isWarmBoot();
@@ -0,0 +1,79 @@
+#include "IR_frame.h"
+
+namespace {
+
+bool isBitSet(const IRProtocolConfig &protocol, const uint8_t *data, uint16_t index) {
+    uint8_t byte_value = data[index / 8];
+    uint8_t bit_in_byte = index % 8;
+    if (protocol.bit_order == IRBitOrder::MSBFirst) {
+        return (byte_value >> (7 - bit_in_byte)) & 1;
+    }
+    return (byte_value >> bit_in_byte) & 1;
+}
+
+} // namespace
+
+// Generic table-driven frame builder
+bool buildIRFrame(const IRProtocolConfig &protocol, const uint8_t *data, uint16_t *durations, size_t capacity, size_t &len)
+{
+    len = 0;  // Reset length for durations array
+    if (data == nullptr || durations == nullptr) return false;
+    if (irFrameLength(protocol) > capacity) {
+        // Error: Durations array overflow!
+        return false;
+    }
+
+    for (uint8_t frame = 0; frame <= protocol.repeat_count; ++frame)
+    {
+        if (frame > 0)
+        {
+            // Separate repeated frames with the gap. Durations must alternate
+            // mark/space, so extend a trailing space instead of adding a new one.
+            if (len % 2 == 0) {
+                uint32_t merged = (uint32_t)durations[len - 1] + protocol.gap;
+                durations[len - 1] = (merged > UINT16_MAX) ? UINT16_MAX : (uint16_t)merged;
+            } else {
+                durations[len++] = protocol.gap;
+            }
+        }
+
+        // Add header mark and space signals at the start of the IR transmission
+        durations[len++] = protocol.hdr_mark;
+        durations[len++] = protocol.hdr_space;
+
+        // Payload bits in protocol bit order
+        for (uint16_t i = 0; i < protocol.bit_count; ++i)
+        {
+            durations[len++] = protocol.bit_mark;          // Add mark duration for bit start
+            durations[len++] = isBitSet(protocol, data, i) ? protocol.one_space : protocol.zero_space;
+        }
+
+        // Add trailing sequence (protocol-dependent)
+        for (uint8_t i = 0; i < protocol.footer_len; ++i)
+        {
+            durations[len++] = protocol.footer[i];
+        }
+    }
+    return true;
+}
+
+bool buildIRFrameFromBits(const IRProtocolConfig &protocol, const char *bits, uint16_t *durations, size_t capacity, size_t &len)
+{
+    len = 0;
+    if (bits == nullptr) return false;
+
+    uint8_t data[k_ir_frame_text_bits_max / 8] = {0};
+    size_t bit_count = 0;
+
+    // Pack '0'/'1' characters MSB-first, ignoring anything else
+    for (const char *p = bits; *p != '\0'; ++p) {
+        char bit = *p;
+        if (bit != '0' && bit != '1') continue;
+        if (bit_count >= k_ir_frame_text_bits_max) return false;
+        if (bit == '1') data[bit_count / 8] |= (uint8_t)(0x80 >> (bit_count % 8));
+        bit_count++;
+    }
+
+    if (bit_count != protocol.bit_count) return false;
+    return buildIRFrame(protocol, data, durations, capacity, len);
+}
@@ -0,0 +1,96 @@
+/*
+ * IR_frame.h
+ *
+ * Declarative IR protocol descriptions and the table-driven engine that turns
+ * any described protocol into IR signal durations.
+ *
+ * - Describes a pulse-distance protocol as data: header, bit timings, bit count,
+ *   bit order, footer sequence, repeat count, inter-frame gap, carrier frequency
+ *   and duty cycle (e.g. Mitsubishi Heavy 64-bit protocol).
+ * - buildIRFrame() generates the mark/space sequence for any described protocol,
+ *   so new ACU brands are added as data instead of code.
+ *
+ * No Arduino dependencies; transmission lives in ACU_IR_modulator.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum class IRBitOrder : uint8_t {
+  MSBFirst, // Byte 0 bit 7 is sent first
+  LSBFirst  // Byte 0 bit 0 is sent first
+};
+
+// Declarative pulse-distance protocol description. All timings are in microseconds.
+// Frame layout: hdr_mark, hdr_space, (bit_mark, one_space|zero_space) x bit_count, footer...
+// The frame is sent 1 + repeat_count times, separated by 'gap'.
+struct IRProtocolConfig {
+  const uint16_t hdr_mark;
+  const uint16_t hdr_space;
+  const uint16_t bit_mark;
+  const uint16_t one_space;
+  const uint16_t zero_space;
+  const uint16_t bit_count;
+  const IRBitOrder bit_order;
+  const uint16_t* const footer; // Alternating mark/space sequence, starting with a mark
+  const uint8_t footer_len;
+  const uint8_t repeat_count;
+  const uint16_t gap;
+  const uint16_t carrier_khz;
+  const uint8_t duty_cycle;     // Percent
+};
+
+// Number of duration entries generated for one transmission of a protocol
+constexpr size_t irFrameLength(const IRProtocolConfig& protocol) {
+  return (2 + 2 * (size_t)protocol.bit_count + protocol.footer_len) * (1 + (size_t)protocol.repeat_count)
+         + protocol.repeat_count; // One gap entry between frames at most
+}
+
+// ACU-specific timing config
+constexpr uint16_t k_mitsubishi_heavy_64_footer[] = {500, 7300, 500};
+constexpr IRProtocolConfig k_mitsubishi_heavy_64 = {
+  6000,   // hdr_mark
+  7300,   // hdr_space
+  500,    // bit_mark
+  3300,   // one_space
+  1400,   // zero_space
+  64,     // bit_count
+  IRBitOrder::MSBFirst,
+  k_mitsubishi_heavy_64_footer,
+  3,      // footer_len
+  0,      // repeat_count
+  0,      // gap
+  38,     // carrier_khz
+  50      // duty_cycle
+};
+
+// Example default protocol (optional)
+constexpr uint16_t k_default_protocol_footer[] = {400};
+constexpr IRProtocolConfig k_default_protocol = {
+  5000,  // hdr_mark (placeholder)
+  5000,  // hdr_space
+  400,   // bit_mark
+  2000,  // one_space
+  1000,  // zero_space
+  64,    // bit_count
+  IRBitOrder::MSBFirst,
+  k_default_protocol_footer,
+  1,     // footer_len
+  0,     // repeat_count
+  0,     // gap
+  38,    // carrier_khz
+  50     // duty_cycle
+};
+
+// Generic engine: build the full mark/space sequence for 'protocol' from packed payload bytes.
+// 'data' must hold at least ceil(protocol.bit_count / 8) bytes.
+bool buildIRFrame(const IRProtocolConfig &protocol, const uint8_t *data, uint16_t *durations, size_t capacity, size_t &len);
+
+// Payload bits a '0'/'1' string may carry into buildIRFrameFromBits()
+constexpr size_t k_ir_frame_text_bits_max = 128;
+
+// Same, from a '0'/'1' string (MSB first, anything else ignored, e.g. spaces).
+// Fails unless it holds exactly protocol.bit_count bits.
+bool buildIRFrameFromBits(const IRProtocolConfig &protocol, const char *bits, uint16_t *durations, size_t capacity, size_t &len);
@@ -0,0 +1,335 @@
+#include "IR_learning.h"
+#include "logging.h"
+#include "Watchdog.h"
+
+#include <IRrecv.h>
+#include <LittleFS.h>
+#include <new>
+
+namespace {
+
+constexpr const char* k_log_tag = "LEARN";
+constexpr const char* k_library_path = "/ir_codes.bin";
+constexpr const char* k_library_tmp_path = "/ir_codes.tmp";
+constexpr uint32_t k_library_magic = 0x4C435249; // "IRCL"
+constexpr uint8_t k_library_version = 1;
+constexpr uint8_t k_learned_codes_max = 48;
+
+constexpr unsigned long k_learn_timeout_ms = 15000;
+constexpr uint8_t k_capture_timeout_ms = 50;     // AC frames have long inter-section gaps
+constexpr uint16_t k_capture_buffer_len = k_learned_entries_max + 2;
+constexpr uint8_t k_symbol_tolerance_pct = 20;
+constexpr uint16_t k_default_carrier_khz = 38;   // Receiver cannot measure the carrier
+
+struct __attribute__((packed)) LibraryHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved[3];
+};
+
+// Followed by symbols[symbol_count] (uint16) and ceil(entry_count / 2) packed nibbles
+struct __attribute__((packed)) LearnedCodeRecord {
+  char name[k_learned_name_max];
+  uint16_t khz;
+  uint8_t symbol_count;
+  uint8_t checksum;       // XOR of symbol and nibble bytes
+  uint16_t entry_count;
+};
+
+bool g_is_fs_ready = false;
+IRLearnResult g_learn_result;
+IRLearnStatus g_learn_state = IRLearnStatus::Idle;
+unsigned long g_learn_start_ms = 0;
+
+alignas(IRrecv) uint8_t g_irrecv_storage[sizeof(IRrecv)];
+IRrecv* g_irrecv = nullptr;
+decode_results g_capture;
+
+// Shared between capture and replay; only one is active at a time
+uint16_t g_raw_durations[k_learned_entries_max];
+uint16_t g_symbols[k_learned_symbols_max];
+uint8_t g_packed[(k_learned_entries_max + 1) / 2];
+
+size_t packedLength(uint16_t entry_count) {
+  return (entry_count + 1) / 2;
+}
+
+size_t recordPayloadLength(const LearnedCodeRecord& rec) {
+  return rec.symbol_count * sizeof(uint16_t) + packedLength(rec.entry_count);
+}
+
+uint8_t payloadChecksum(const uint16_t* symbols, uint8_t symbol_count, const uint8_t* packed, size_t packed_len) {
+  uint8_t sum = 0;
+  const uint8_t* symbol_bytes = reinterpret_cast<const uint8_t*>(symbols);
+  for (size_t i = 0; i < symbol_count * sizeof(uint16_t); ++i) sum ^= symbol_bytes[i];
+  for (size_t i = 0; i < packed_len; ++i) sum ^= packed[i];
+  return sum;
+}
+
+void stopCapture() {
+  if (g_irrecv == nullptr) return;
+  g_irrecv->disableIRIn();
+  g_irrecv->~IRrecv();
+  g_irrecv = nullptr;
+}
+
+// Cluster durations into at most k_learned_symbols_max timing symbols and pack
+// one 4-bit symbol index per duration.
+bool quantiseDurations(const uint16_t* durations, uint16_t len, uint8_t& symbol_count) {
+  uint32_t sums[k_learned_symbols_max] = {0};
+  uint16_t counts[k_learned_symbols_max] = {0};
+  symbol_count = 0;
+
+  for (uint16_t i = 0; i < len; ++i) {
+    uint16_t d = durations[i];
+    uint8_t match = k_learned_symbols_max;
+    for (uint8_t s = 0; s < symbol_count; ++s) {
+      uint32_t tolerance = (uint32_t)g_symbols[s] * k_symbol_tolerance_pct / 100;
+      uint32_t diff = (d > g_symbols[s]) ? d - g_symbols[s] : g_symbols[s] - d;
+      if (diff <= tolerance) {
+        match = s;
+        break;
+      }
+    }
+    if (match == k_learned_symbols_max) {
+      if (symbol_count >= k_learned_symbols_max) return false; // Too many distinct timings
+      match = symbol_count++;
+    }
+    sums[match] += d;
+    counts[match]++;
+    g_symbols[match] = (uint16_t)(sums[match] / counts[match]); // Running cluster centre
+    watchdogFeed();
+  }
+
+  memset(g_packed, 0, packedLength(len));
+  for (uint16_t i = 0; i < len; ++i) {
+    // Re-assign to the nearest final centre
+    uint8_t best = 0;
+    uint32_t best_diff = UINT32_MAX;
+    for (uint8_t s = 0; s < symbol_count; ++s) {
+      uint32_t diff = (durations[i] > g_symbols[s]) ? durations[i] - g_symbols[s] : g_symbols[s] - durations[i];
+      if (diff < best_diff) {
+        best_diff = diff;
+        best = s;
+      }
+    }
+    g_packed[i / 2] |= (i % 2 == 0) ? best : (uint8_t)(best << 4);
+  }
+  return true;
+}
+
+bool readLibraryHeader(File& file) {
+  LibraryHeader header;
+  if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)) return false;
+  return header.magic == k_library_magic && header.version == k_library_version;
+}
+
+bool copyBytes(File& src, File& dst, size_t len) {
+  uint8_t chunk[64];
+  while (len > 0) {
+    size_t n = (len < sizeof(chunk)) ? len : sizeof(chunk);
+    if (src.read(chunk, n) != n) return false;
+    if (dst.write(chunk, n) != n) return false;
+    len -= n;
+  }
+  return true;
+}
+
+// Rewrite the library with 'rec' replacing any existing record of the same name
+bool storeLearnedCode(const LearnedCodeRecord& rec) {
+  WatchdogScope fs_wdt(WatchdogSection::Storage);
+  File dst = LittleFS.open(k_library_tmp_path, "w");
+  if (!dst) return false;
+
+  LibraryHeader header = {k_library_magic, k_library_version, {0, 0, 0}};
+  bool is_ok = dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  uint8_t code_count = 0;
+
+  File src = LittleFS.open(k_library_path, "r");
+  if (src && readLibraryHeader(src)) {
+    LearnedCodeRecord existing;
+    while (is_ok && src.read(reinterpret_cast<uint8_t*>(&existing), sizeof(existing)) == sizeof(existing)) {
+      size_t payload_len = recordPayloadLength(existing);
+      if (strncmp(existing.name, rec.name, k_learned_name_max) == 0) {
+        is_ok = src.seek(src.position() + payload_len);
+        continue;
+      }
+      if (++code_count >= k_learned_codes_max) {
+        logWarn(k_log_tag, "Code library full (%u codes).", (unsigned int)k_learned_codes_max);
+        is_ok = false;
+        break;
+      }
+      is_ok = dst.write(reinterpret_cast<const uint8_t*>(&existing), sizeof(existing)) == sizeof(existing) &&
+              copyBytes(src, dst, payload_len);
+      watchdogFeed();
+    }
+  }
+  if (src) src.close();
+
+  size_t symbol_bytes = rec.symbol_count * sizeof(uint16_t);
+  size_t packed_len = packedLength(rec.entry_count);
+  is_ok = is_ok &&
+          dst.write(reinterpret_cast<const uint8_t*>(&rec), sizeof(rec)) == sizeof(rec) &&
+          dst.write(reinterpret_cast<const uint8_t*>(g_symbols), symbol_bytes) == symbol_bytes &&
+          dst.write(g_packed, packed_len) == packed_len;
+  dst.close();
+
+  if (!is_ok) {
+    LittleFS.remove(k_library_tmp_path);
+    return false;
+  }
+  LittleFS.remove(k_library_path);
+  return LittleFS.rename(k_library_tmp_path, k_library_path);
+}
+
+void finishCapture() {
+  uint16_t len = (g_capture.rawlen > 1) ? g_capture.rawlen - 1 : 0; // rawbuf[0] is the leading gap
+  stopCapture();
+
+  if (len == 0 || len > k_learned_entries_max || g_capture.overflow) {
+    logError(k_log_tag, "Capture rejected (entries=%u overflow=%d).", len, g_capture.overflow ? 1 : 0);
+    g_learn_state = IRLearnStatus::Failed;
+    return;
+  }
+
+  for (uint16_t i = 0; i < len; ++i) {
+    uint32_t us = (uint32_t)g_capture.rawbuf[i + 1] * kRawTick;
+    g_raw_durations[i] = (us > UINT16_MAX) ? UINT16_MAX : (uint16_t)us;
+  }
+
+  uint8_t symbol_count = 0;
+  if (!quantiseDurations(g_raw_durations, len, symbol_count)) {
+    logError(k_log_tag, "Capture has more than %u distinct timings.", (unsigned int)k_learned_symbols_max);
+    g_learn_state = IRLearnStatus::Failed;
+    return;
+  }
+
+  LearnedCodeRecord rec = {};
+  strncpy(rec.name, g_learn_result.name, sizeof(rec.name) - 1);
+  rec.khz = k_default_carrier_khz;
+  rec.symbol_count = symbol_count;
+  rec.entry_count = len;
+  rec.checksum = payloadChecksum(g_symbols, symbol_count, g_packed, packedLength(len));
+
+  if (!g_is_fs_ready || !storeLearnedCode(rec)) {
+    logError(k_log_tag, "Failed to store code: %s", rec.name);
+    g_learn_state = IRLearnStatus::Failed;
+    return;
+  }
+
+  g_learn_result.entry_count = len;
+  g_learn_result.symbol_count = symbol_count;
+  g_learn_result.stored_bytes = sizeof(rec) + recordPayloadLength(rec);
+  g_learn_state = IRLearnStatus::Stored;
+  logInfo(k_log_tag, "Stored code %s (entries=%u symbols=%u bytes=%u).",
+          rec.name, len, symbol_count, g_learn_result.stored_bytes);
+}
+
+} // namespace
+
+bool beginIRCodeLibrary() {
+  g_is_fs_ready = LittleFS.begin();
+  if (!g_is_fs_ready) logError(k_log_tag, "LittleFS mount failed.");
+  return g_is_fs_ready;
+}
+
+bool isLearnedCodeNameValid(const char* name) {
+  if (name == nullptr) return false;
+  size_t len = strlen(name);
+  if (len == 0 || len >= k_learned_name_max) return false;
+  for (size_t i = 0; i < len; ++i) {
+    char c = name[i];
+    bool is_ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!is_ok) return false;
+  }
+  return true;
+}
+
+bool startIRLearning(const char* name) {
+  if (g_learn_state == IRLearnStatus::Capturing) return false;
+  if (!isLearnedCodeNameValid(name)) return false;
+
+  g_learn_result = IRLearnResult();
+  strncpy(g_learn_result.name, name, sizeof(g_learn_result.name) - 1);
+
+  g_irrecv = new (g_irrecv_storage) IRrecv(IR_RX_PIN, k_capture_buffer_len, k_capture_timeout_ms, false);
+  g_irrecv->enableIRIn();
+  g_learn_start_ms = millis();
+  g_learn_state = IRLearnStatus::Capturing;
+  logInfo(k_log_tag, "Learning armed for %s.", name);
+  return true;
+}
+
+IRLearnStatus handleIRLearning() {
+  if (g_learn_state != IRLearnStatus::Capturing) {
+    IRLearnStatus finished = g_learn_state;
+    g_learn_state = IRLearnStatus::Idle;
+    g_learn_result.status = finished;
+    return finished;
+  }
+
+  if (g_irrecv->decode(&g_capture)) {
+    finishCapture();
+  } else if (millis() - g_learn_start_ms >= k_learn_timeout_ms) {
+    stopCapture();
+    logWarn(k_log_tag, "Learning timed out for %s.", g_learn_result.name);
+    g_learn_state = IRLearnStatus::Timeout;
+  }
+
+  g_learn_result.status = g_learn_state;
+  return IRLearnStatus::Capturing;
+}
+
+const IRLearnResult& getIRLearnResult() {
+  return g_learn_result;
+}
+
+const uint16_t* loadLearnedIRCode(const char* name, uint16_t& len, uint16_t& khz) {
+  len = 0;
+  khz = 0;
+  if (!g_is_fs_ready || !isLearnedCodeNameValid(name)) return nullptr;
+
+  File file = LittleFS.open(k_library_path, "r");
+  if (!file) return nullptr;
+  if (!readLibraryHeader(file)) {
+    file.close();
+    return nullptr;
+  }
+
+  const uint16_t* result = nullptr;
+  LearnedCodeRecord rec;
+  while (file.read(reinterpret_cast<uint8_t*>(&rec), sizeof(rec)) == sizeof(rec)) {
+    if (strncmp(rec.name, name, k_learned_name_max) != 0) {
+      if (!file.seek(file.position() + recordPayloadLength(rec))) break;
+      continue;
+    }
+
+    if (rec.symbol_count > k_learned_symbols_max || rec.entry_count > k_learned_entries_max) break;
+    size_t symbol_bytes = rec.symbol_count * sizeof(uint16_t);
+    size_t packed_len = packedLength(rec.entry_count);
+    if (file.read(reinterpret_cast<uint8_t*>(g_symbols), symbol_bytes) != symbol_bytes) break;
+    if (file.read(g_packed, packed_len) != packed_len) break;
+    if (payloadChecksum(g_symbols, rec.symbol_count, g_packed, packed_len) != rec.checksum) {
+      logError(k_log_tag, "Checksum mismatch for code %s.", name);
+      break;
+    }
+
+    for (uint16_t i = 0; i < rec.entry_count; ++i) {
+      uint8_t index = (i % 2 == 0) ? (g_packed[i / 2] & 0x0F) : (g_packed[i / 2] >> 4);
+      if (index >= rec.symbol_count) {
+        len = 0;
+        break;
+      }
+      g_raw_durations[i] = g_symbols[index];
+      len = i + 1;
+    }
+    if (len == rec.entry_count) {
+      khz = rec.khz;
+      result = g_raw_durations;
+    }
+    break;
+  }
+
+  file.close();
+  return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * IR_learning.h
+ *
+ * IR learning mode and flash-backed code library.
+ *
+ * - Captures a raw frame from the IR receiver (IRrecv is only constructed while
+ *   learning is active).
+ * - Quantises the mark/space durations into at most 16 timing symbols, so each
+ *   duration is stored as a 4-bit index (a typical 100-200 bit AC frame fits in
+ *   ~150 bytes).
+ * - Stores codes by name in a single LittleFS file and expands them back into
+ *   durations for replay.
+ */
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+#include <Arduino.h>
+
+#ifndef IR_RX_PIN
+  #define IR_RX_PIN 5 // ESP01M IR module receiver pin
+#endif
+
+constexpr size_t k_learned_name_max = 16;        // Including null terminator
+constexpr uint16_t k_learned_entries_max = 320;  // Mark/space entries per code
+constexpr uint8_t k_learned_symbols_max = 16;    // 4-bit symbol indices
+
+enum class IRLearnStatus : uint8_t {
+  Idle,
+  Capturing,
+  Stored,
+  Timeout,
+  Failed
+};
+
+struct IRLearnResult {
+  IRLearnStatus status = IRLearnStatus::Idle;
+  char name[k_learned_name_max] = {0};
+  uint16_t entry_count = 0;
+  uint8_t symbol_count = 0;
+  uint16_t stored_bytes = 0;
+};
+
+/**
+ * @brief Mount the filesystem that holds the code library.
+ *
+ * @return true if the filesystem is available.
+ */
+bool beginIRCodeLibrary();
+
+/**
+ * @brief Check that a code name is 1-15 chars of [A-Za-z0-9_-].
+ */
+bool isLearnedCodeNameValid(const char* name);
+
+/**
+ * @brief Arm the receiver and start capturing a code for 'name'.
+ *
+ * @return false if the name is invalid or learning is already active.
+ */
+bool startIRLearning(const char* name);
+
+/**
+ * @brief Run the learning state machine (call from loop()).
+ *
+ * @return Current status. Stored/Timeout/Failed are returned once, after which
+ *         the state returns to Idle.
+ */
+IRLearnStatus handleIRLearning();
+
+/**
+ * @brief Details of the last finished learning session.
+ */
+const IRLearnResult& getIRLearnResult();
+
+/**
+ * @brief Load a stored code and expand it into durations.
+ *
+ * The returned buffer is shared and only valid until the next load or capture.
+ *
+ * @param name Code name.
+ * @param len Number of duration entries.
+ * @param khz Carrier frequency in kHz.
+ * @return Pointer to the durations, or nullptr if the code is missing/corrupt.
+ */
+const uint16_t* loadLearnedIRCode(const char* name, uint16_t& len, uint16_t& khz);
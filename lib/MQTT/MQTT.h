@@ -4,29 +4,101 @@
  * MQTT.h
  *
  * Public MQTT module interface for setup, loop handling, and telemetry updates.
+ *
+ * All MQTT state lives in an MQTTContext (see mqtt_internal.h). The firmware
+ * uses one, g_mqtt_context; the overloads without a context act on it and
+ * compile to a direct call.
+ */
+
+#include "WiFiData.h"
+
+struct MQTTContext;
+
+extern MQTTContext g_mqtt_context;
+
+/**
+ * @brief Parse DEFINED_UNITS and select one IR adapter per logical ACU unit.
+ *
+ * Must run before setupMQTTTopics().
  */
+void setupACUUnits(MQTTContext& ctx);
+inline void setupACUUnits() { setupACUUnits(g_mqtt_context); }
 
 /**
- * @brief Build MQTT topic strings for this device.
+ * @brief Build MQTT topic strings for this device and its units.
  */
-void setupMQTTTopics();
+void setupMQTTTopics(MQTTContext& ctx);
+inline void setupMQTTTopics() { setupMQTTTopics(g_mqtt_context); }
 
 /**
  * @brief Configure MQTT client (server, callbacks, buffers).
  */
-void setupMQTT();
+void setupMQTT(MQTTContext& ctx);
+inline void setupMQTT() { setupMQTT(g_mqtt_context); }
 
 /**
  * @brief Run MQTT loop processing and publish heartbeats.
  */
-void handleMQTT();
+void handleMQTT(MQTTContext& ctx);
+inline void handleMQTT() { handleMQTT(g_mqtt_context); }
+
+/**
+ * @brief Load the on-device schedule and derive this device's firing jitter.
+ */
+void setupACUSchedule();
+
+/**
+ * @brief Execute at most one due schedule entry (runs without a broker connection).
+ */
+void handleSchedule(MQTTContext& ctx);
+inline void handleSchedule() { handleSchedule(g_mqtt_context); }
+
+/**
+ * @brief Load the persisted policy rule set.
+ */
+void setupACUPolicy();
+
+/**
+ * @brief Evaluate one policy rule and apply its state change, if any.
+ */
+void handlePolicy(MQTTContext& ctx);
+inline void handlePolicy() { handlePolicy(g_mqtt_context); }
+
+/**
+ * @brief true when no IR frame was sent recently and learning is not active.
+ *
+ * Used as the Wi-Fi roam gate.
+ */
+bool isIRIdle(const MQTTContext& ctx);
+inline bool isIRIdle() { return isIRIdle(g_mqtt_context); }
+
+/**
+ * @brief Publish the WiFi manager's roaming counters with the metrics.
+ */
+void setWiFiRoamStats(MQTTContext& ctx, const CustomWiFi::WiFiRoamStats* stats);
+inline void setWiFiRoamStats(const CustomWiFi::WiFiRoamStats* stats) { setWiFiRoamStats(g_mqtt_context, stats); }
 
 /**
  * @brief Update cached connection metrics used by telemetry.
  */
-void updateConnectionStats();
+void updateConnectionStats(MQTTContext& ctx);
+inline void updateConnectionStats() { updateConnectionStats(g_mqtt_context); }
+
+/**
+ * @brief After a warm boot, restore what the previous boot checkpointed to RTC memory.
+ *
+ * Unit states, counters and the command dedup window are restored; uptime and
+ * connection timestamps describe the new boot and start over. Must run after
+ * setupACUUnits() and setupACUPolicy().
+ *
+ * @param link Set to the access point the previous boot was on (channel 0 if none).
+ * @return false after a power-on or if there is no valid checkpoint.
+ */
+bool restoreMQTTCheckpoint(MQTTContext& ctx, CustomWiFi::WiFiLink& link);
+inline bool restoreMQTTCheckpoint(CustomWiFi::WiFiLink& link) { return restoreMQTTCheckpoint(g_mqtt_context, link); }
 
 /**
  * @brief Disconnect MQTT client if connected.
  */
-void mqttDisconnect();
+void mqttDisconnect(MQTTContext& ctx);
+inline void mqttDisconnect() { mqttDisconnect(g_mqtt_context); }
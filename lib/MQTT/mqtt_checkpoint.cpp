@@ -0,0 +1,166 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#include <coredecls.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+constexpr uint16_t k_checkpoint_version = 1; // Bump whenever MQTTCheckpoint changes
+
+struct CheckpointSender {
+  char sender[k_sender_id_max];
+  uint32_t highest_seq;
+  uint32_t seen_mask;
+};
+
+// What a warm boot carries over. Only counters that accumulate across
+// connections are kept; uptime and connection timestamps belong to one boot.
+struct MQTTCheckpoint {
+  uint32_t units_crc; // Over the unit ids, so states never land on another unit
+  uint32_t warm_boots;
+  uint32_t wifi_connected_total_s;
+  uint32_t mqtt_connected_total_s;
+  uint32_t wifi_disconnects;
+  uint32_t mqtt_disconnects;
+  uint32_t commands_received;
+  uint32_t commands_executed;
+  uint32_t commands_failed_parse;
+  uint32_t commands_failed_struct;
+  uint32_t commands_failed_ir;
+  uint32_t commands_duplicate;
+  uint32_t commands_scheduled;
+  uint32_t commands_policy;
+  uint32_t publish_failures;
+  uint32_t log_stream_dropped;
+  uint32_t avg_cmd_latency_ms;
+  CheckpointSender senders[k_dedup_sender_slots];
+  ACUState unit_states[k_max_acu_units];
+  uint8_t unit_state_mask;
+  uint8_t wifi_channel;
+  uint8_t wifi_bssid[6];
+};
+static_assert(sizeof(MQTTCheckpoint) % 4 == 0, "RTC memory is written in 4-byte blocks");
+static_assert(sizeof(MQTTCheckpoint) <= k_checkpoint_payload_max, "Checkpoint must fit RTC user memory");
+static_assert(k_max_acu_units <= 8, "unit_state_mask has one bit per unit");
+
+uint32_t unitIdsCrc(const MQTTContext& ctx) {
+  uint32_t crc = 0xffffffff;
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    crc = crc32(ctx.units[i].id, strlen(ctx.units[i].id) + 1, crc);
+  }
+  return crc;
+}
+} // namespace
+
+// Also remembers the current access point, which outlives a Wi-Fi drop in the checkpoint
+void saveMQTTCheckpoint(MQTTContext& ctx) {
+  ctx.last_checkpoint_ms = millis();
+  if (WiFi.status() == WL_CONNECTED) {
+    memcpy(ctx.wifi_link.bssid, WiFi.BSSID(), sizeof(ctx.wifi_link.bssid));
+    ctx.wifi_link.channel = (uint8_t)WiFi.channel();
+  }
+
+  MQTTCheckpoint checkpoint = {};
+  checkpoint.units_crc = unitIdsCrc(ctx);
+  checkpoint.warm_boots = ctx.warm_boots;
+  checkpoint.wifi_connected_total_s = ctx.wifi_connected_total_s;
+  checkpoint.mqtt_connected_total_s = ctx.mqtt_connected_total_s;
+  checkpoint.wifi_disconnects = ctx.wifi_disconnect_counter;
+  checkpoint.mqtt_disconnects = ctx.mqtt_disconnect_counter;
+  checkpoint.commands_received = ctx.commands_received_counter;
+  checkpoint.commands_executed = ctx.commands_executed_counter;
+  checkpoint.commands_failed_parse = ctx.commands_failed_parse;
+  checkpoint.commands_failed_struct = ctx.commands_failed_struct;
+  checkpoint.commands_failed_ir = ctx.commands_failed_ir;
+  checkpoint.commands_duplicate = ctx.commands_duplicate;
+  checkpoint.commands_scheduled = ctx.commands_scheduled;
+  checkpoint.commands_policy = ctx.commands_policy;
+  checkpoint.publish_failures = ctx.publish_failures;
+  checkpoint.log_stream_dropped = ctx.log_stream_dropped;
+  checkpoint.avg_cmd_latency_ms = ctx.avg_cmd_latency_ms;
+
+  for (uint8_t i = 0; i < k_dedup_sender_slots; ++i) {
+    const DedupSender& slot = ctx.dedup_senders[i];
+    memcpy(checkpoint.senders[i].sender, slot.sender, sizeof(slot.sender));
+    checkpoint.senders[i].highest_seq = slot.highest_seq;
+    checkpoint.senders[i].seen_mask = slot.seen_mask;
+  }
+
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    if (!ctx.units[i].has_state) continue;
+    checkpoint.unit_states[i] = ctx.units[i].last_state;
+    checkpoint.unit_state_mask |= (uint8_t)(1 << i);
+  }
+
+  checkpoint.wifi_channel = ctx.wifi_link.channel;
+  memcpy(checkpoint.wifi_bssid, ctx.wifi_link.bssid, sizeof(checkpoint.wifi_bssid));
+
+  saveCheckpoint(&checkpoint, sizeof(checkpoint), k_checkpoint_version);
+}
+
+bool restoreMQTTCheckpoint(MQTTContext& ctx, CustomWiFi::WiFiLink& link) {
+  link = CustomWiFi::WiFiLink();
+  if (!isWarmBoot()) {
+    clearCheckpoint(); // An external reset keeps RTC memory; its record must not outlive this boot
+    return false;
+  }
+
+  MQTTCheckpoint checkpoint;
+  if (!loadCheckpoint(&checkpoint, sizeof(checkpoint), k_checkpoint_version)) {
+    if (isCrashReset()) {
+      logWarn(k_log_tag, "Warm boot without a valid checkpoint");
+    } else {
+      logInfo(k_log_tag, "Restart without a checkpoint (e.g. into an update), starting from zero");
+    }
+    return false;
+  }
+
+  ctx.warm_boots = checkpoint.warm_boots + 1;
+  ctx.wifi_connected_total_s = checkpoint.wifi_connected_total_s;
+  ctx.mqtt_connected_total_s = checkpoint.mqtt_connected_total_s;
+  ctx.wifi_disconnect_counter = checkpoint.wifi_disconnects;
+  ctx.mqtt_disconnect_counter = checkpoint.mqtt_disconnects;
+  ctx.commands_received_counter = checkpoint.commands_received;
+  ctx.commands_executed_counter = checkpoint.commands_executed;
+  ctx.commands_failed_parse = checkpoint.commands_failed_parse;
+  ctx.commands_failed_struct = checkpoint.commands_failed_struct;
+  ctx.commands_failed_ir = checkpoint.commands_failed_ir;
+  ctx.commands_duplicate = checkpoint.commands_duplicate;
+  ctx.commands_scheduled = checkpoint.commands_scheduled;
+  ctx.commands_policy = checkpoint.commands_policy;
+  ctx.publish_failures = checkpoint.publish_failures;
+  ctx.log_stream_dropped = checkpoint.log_stream_dropped;
+  ctx.avg_cmd_latency_ms = checkpoint.avg_cmd_latency_ms;
+
+  // Redelivered commands stay deduplicated across the reset
+  for (uint8_t i = 0; i < k_dedup_sender_slots; ++i) {
+    DedupSender& slot = ctx.dedup_senders[i];
+    slot = DedupSender();
+    memcpy(slot.sender, checkpoint.senders[i].sender, sizeof(slot.sender) - 1);
+    slot.highest_seq = checkpoint.senders[i].highest_seq;
+    slot.seen_mask = checkpoint.senders[i].seen_mask;
+  }
+
+  uint8_t states = 0;
+  if (checkpoint.units_crc == unitIdsCrc(ctx)) {
+    for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+      if ((checkpoint.unit_state_mask & (1 << i)) == 0) continue;
+      ACUUnit& unit = ctx.units[i];
+      unit.last_state = checkpoint.unit_states[i];
+      unit.has_state = true;
+      notePolicyState(i, unit.last_state, millis(), false);
+      states++;
+    }
+  }
+
+  link.channel = checkpoint.wifi_channel;
+  memcpy(link.bssid, checkpoint.wifi_bssid, sizeof(link.bssid));
+  ctx.wifi_link = link;
+
+  logInfo(k_log_tag, "Warm boot %u: restored counters and %u unit states", (unsigned int)ctx.warm_boots, states);
+  saveMQTTCheckpoint(ctx); // warm_boots, in case this boot ends before the next save
+  return true;
+}
@@ -4,132 +4,269 @@
 #error "ESP8266 only"
 #endif
 
-bool isTopicMatchingModule(char* topic) {
-  return strcmp(topic, g_mqtt_topic_sub_unit) == 0;
+bool isTopicMatchingConfig(const MQTTContext& ctx, const char* topic) {
+  return isMQTTTopic(ctx, topic, MQTTTopic::Config);
 }
 
-void handleReceivedCommand(char* topic, byte* payload, unsigned int length) {
+// Device configuration (retained by the dashboard so it is reapplied after reboot).
+// format: {"adapter":"MHI_152","occupied":false,"unit":"ACU2"} ("unit" defaults to the primary unit)
+//         {"log_level":"debug","log_stream":true} (device-wide)
+void handleConfigMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length) {
+  JsonLease lease(ctx.json_arena, k_json_budget_rx);
+  JsonDocument& doc = lease.doc();
+  DeserializationError err = deserializeJson(doc, payload, length);
+  if (err) {
+    logError(k_log_tag, "Config parse failed: %s (topic=%s len=%u)", err.c_str(), topic, length);
+    publishMQTTErrorContext(ctx, "config_parse_failed", topic, payload, length, 0);
+    return;
+  }
+
+  if (doc["log_level"].is<const char*>()) {
+    LogLevel level;
+    if (parseLogLevel(doc["log_level"].as<const char*>(), level)) {
+      setLogLevel(level);
+      logInfo(k_log_tag, "Log level: %s", logLevelName(getLogLevel()));
+    } else {
+      publishMQTTErrorContext(ctx, "config_invalid_log_level", topic, payload, length, 0);
+    }
+  }
+  if (doc["log_stream"].is<bool>()) {
+    setLogStreaming(ctx, doc["log_stream"].as<bool>());
+  }
+
+  ACUUnit* unit = doc["unit"].is<const char*>() ? findUnitById(ctx, doc["unit"]) : &ctx.units[0];
+  if (unit == nullptr) {
+    publishMQTTErrorContext(ctx, "config_unknown_unit", topic, payload, length, 0);
+    return;
+  }
+  uint8_t slot = getUnitIndex(ctx, *unit);
+
+  if (doc["occupied"].is<bool>()) {
+    notePolicyOccupancy(slot, doc["occupied"].as<bool>(), millis());
+  }
+
+  if (doc["adapter"].is<const char*>()) {
+    const char* model = doc["adapter"];
+    if (strcmp(model, getACUAdapterModel(slot)) == 0) {
+      logDebug(k_log_tag, "Adapter unchanged: %s (unit=%s)", model, unit->id);
+    } else if (selectACUAdapter(slot, model, getACUAdapterPin(slot)) != nullptr) {
+      publishIdentity(ctx); // Report the new acu_remote_model
+    } else {
+      publishMQTTErrorContext(ctx, "config_unknown_adapter", topic, payload, length, 0);
+    }
+  }
+}
+
+bool isDuplicateCommand(const MQTTContext& ctx, const char* sender, uint32_t seq) {
+  return isDuplicateSeq(ctx.dedup_senders, sender, seq);
+}
+
+void markCommandSeen(MQTTContext& ctx, const char* sender, uint32_t seq) {
+  markSeqSeen(ctx.dedup_senders, sender, seq, millis());
+  saveMQTTCheckpoint(ctx); // A redelivery after a reset must still be recognised
+}
+
+void serviceIRLearning(MQTTContext& ctx) {
+  IRLearnStatus status = handleIRLearning();
+  if (status == IRLearnStatus::Stored || status == IRLearnStatus::Timeout || status == IRLearnStatus::Failed) {
+    publishLearnResult(ctx, getIRLearnResult());
+  }
+}
+
+namespace {
+
+// format: {"learn":"name"} - arms the receiver; the result follows on the ack topic
+void handleLearnCommand(MQTTContext& ctx, const char* name, char* topic, byte* payload, unsigned int length, CommandAck& ack) {
+  if (!startIRLearning(name)) {
+    logError(k_log_tag, "Cannot start learning (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "learn_rejected", topic, payload, length, 0);
+    ctx.commands_failed_struct++;
+    publishCommandAck(ctx, ack);
+    return;
+  }
+
+  if (ack.has_seq) markCommandSeen(ctx, ack.sender, ack.seq);
+  ack.status = "executed";
+  publishCommandAck(ctx, ack);
+}
+
+// format: {"raw":"name"} - replays a learned code through the unit's adapter
+void handleRawReplayCommand(MQTTContext& ctx, ACUUnit& unit, const char* name, char* topic, byte* payload, unsigned int length, CommandAck& ack) {
+  uint16_t len = 0;
+  uint16_t khz = 0;
+  const uint16_t* durations = loadLearnedIRCode(name, len, khz);
+  if (durations == nullptr) {
+    logError(k_log_tag, "Unknown learned code (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "raw_code_not_found", topic, payload, length, 0);
+    ctx.commands_failed_struct++;
+    publishCommandAck(ctx, ack);
+    return;
+  }
+
+  if (!transmitUnitRaw(ctx, unit, durations, len, khz, ack)) {
+    logError(k_log_tag, "Failed to send raw code (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "ir_send_failed", topic, payload, length, 0);
+    ctx.commands_failed_ir++;
+    ack.status = "ir_failed";
+    publishCommandAck(ctx, ack);
+    return;
+  }
+
+  ctx.commands_executed_counter++;
+  if (ack.has_seq) markCommandSeen(ctx, ack.sender, ack.seq);
+  ack.status = "executed";
+  publishCommandAck(ctx, ack);
+}
+
+} // namespace
+
+void handleReceivedCommand(MQTTContext& ctx, ACUUnit& unit, char* topic, byte* payload, unsigned int length, uint64_t rx_ts_ms) {
   unsigned long rx_time_ms = millis();
 
+  CommandAck ack;
+  ack.rx_ts_ms = rx_ts_ms;
+  if (ctx.unit_count > 1) ack.unit = unit.id;
+
   // Deserialize incoming JSON
-  g_rx_doc.clear();
-  DeserializationError err = deserializeJson(g_rx_doc, payload, length);
+  JsonLease lease(ctx.json_arena, k_json_budget_rx);
+  JsonDocument& doc = lease.doc();
+  DeserializationError err = deserializeJson(doc, payload, length);
   if (err) {
     logError(k_log_tag, "JSON parse failed: %s (topic=%s len=%u)", err.c_str(), topic, length);
-    publishMQTTErrorContext("json_parse_failed", topic, payload, length, 0);
-    g_commands_failed_parse++;
+    publishMQTTErrorContext(ctx, "json_parse_failed", topic, payload, length, 0);
+    ctx.commands_failed_parse++;
+    publishCommandAck(ctx, ack);
     return;
   }
 
-  g_commands_received_counter++;
+  ctx.commands_received_counter++;
+
+  // Optional tracing and idempotency fields supplied by the dashboard
+  if (doc["id"].is<const char*>()) {
+    strncpy(ack.id, doc["id"].as<const char*>(), sizeof(ack.id) - 1);
+  }
+  if (doc["sent_ts"].is<uint64_t>()) {
+    ack.sent_ts_ms = doc["sent_ts"].as<uint64_t>();
+  }
+  if (doc["sender"].is<const char*>() && doc["seq"].is<uint32_t>()) {
+    strncpy(ack.sender, doc["sender"].as<const char*>(), sizeof(ack.sender) - 1);
+    ack.seq = doc["seq"].as<uint32_t>();
+    ack.has_seq = true;
+  }
+
+  if (ack.has_seq && isDuplicateCommand(ctx, ack.sender, ack.seq)) {
+    logInfo(k_log_tag, "Duplicate command skipped (sender=%s seq=%u).", ack.sender, (unsigned int)ack.seq);
+    ctx.commands_duplicate++;
+    ack.status = "duplicate";
+    publishCommandAck(ctx, ack);
+    return;
+  }
+
+  if (doc["learn"].is<const char*>()) {
+    handleLearnCommand(ctx, doc["learn"].as<const char*>(), topic, payload, length, ack);
+    return;
+  }
+  if (doc["raw"].is<const char*>()) {
+    handleRawReplayCommand(ctx, unit, doc["raw"].as<const char*>(), topic, payload, length, ack);
+    return;
+  }
 
   // Handle potential nested "state" object
-  JsonObjectConst state_obj = g_rx_doc.containsKey("state") ? g_rx_doc["state"] : g_rx_doc.as<JsonObjectConst>();
+  JsonObjectConst state_obj = doc.containsKey("state") ? doc["state"] : doc.as<JsonObjectConst>();
 
-  if (!g_acu_remote.fromJSON(state_obj)) {
+  if (!ctx.acu_remote.fromJSON(state_obj)) {
     logError(k_log_tag, "Invalid command structure (topic=%s len=%u).", topic, length);
-    publishMQTTErrorContext("invalid_command_structure", topic, payload, length, 0);
-    g_commands_failed_struct++;
+    publishMQTTErrorContext(ctx, "invalid_command_structure", topic, payload, length, 0);
+    ctx.commands_failed_struct++;
+    publishCommandAck(ctx, ack);
     return;
   }
 
-#if USE_ACU_ADAPTER
-  logDebug(k_log_tag, "JSON parsed. Adapter: %s", g_acu_adapter.name());
-#else
-  logDebug(k_log_tag, "JSON parsed. Using MHI_64 IR modulator.");
-#endif
+  logDebug(k_log_tag, "JSON parsed. Unit: %s", unit.id);
 
-  yield(); // Allow ESP8266 background tasks
+  watchdogFeed(); // Allow ESP8266 background tasks
 
-#if USE_ACU_ADAPTER
-  // Send IR using adapter
-  if (g_acu_adapter.send(g_acu_remote.getState())) {
-    g_commands_executed_counter++;
+  // Send IR using the unit's adapter
+  ACUState current_state = ctx.acu_remote.getState();
+  if (transmitUnitState(ctx, unit, current_state, ack)) {
+    ctx.commands_executed_counter++;
   } else {
     logError(k_log_tag, "Failed to send IR command (topic=%s len=%u).", topic, length);
-    publishMQTTErrorContext("ir_send_failed", topic, payload, length, 0);
-    g_commands_failed_ir++;
-    return; // Stop processing this command
-  }
-#else
-  // Legacy IR modulator path
-  uint64_t command = g_acu_remote.encodeCommand();
-  size_t len = 0;
-  if (parseBinaryToDurations(command, g_durations, len)) {
-    g_ir_send.sendRaw(g_durations, len, 38);
-    g_commands_executed_counter++;
-  } else {
-    logError(k_log_tag, "Failed to parse command for IR sending (topic=%s len=%u).", topic, length);
-    publishMQTTErrorContext("ir_parse_failed", topic, payload, length, 0);
-    g_commands_failed_ir++;
+    publishMQTTErrorContext(ctx, "ir_send_failed", topic, payload, length, 0);
+    ctx.commands_failed_ir++;
+    ack.status = "ir_failed";
+    publishCommandAck(ctx, ack);
     return; // Stop processing this command
   }
-#endif
+
+  // Only executed commands enter the dedup window, so failed sends can be retried
+  if (ack.has_seq) markCommandSeen(ctx, ack.sender, ack.seq);
+  ack.status = "executed";
 
   // Update latency metrics
   unsigned long tx_time_ms = millis();
-  g_last_cmd_latency_ms = tx_time_ms - rx_time_ms;
-  g_avg_cmd_latency_ms = (g_avg_cmd_latency_ms * 9 + g_last_cmd_latency_ms) / 10;
-
-  ACUState current_state = g_acu_remote.getState();
-  bool is_state_changed = memcmp(&current_state, &g_last_state, sizeof(ACUState)) != 0;
-
-  if (is_state_changed) {
-    char time_buffer[30];
-    getTimestamp(time_buffer, sizeof(time_buffer));
-    strncpy(g_last_change_timestamp, time_buffer, sizeof(g_last_change_timestamp));
+  ctx.last_cmd_latency_ms = tx_time_ms - rx_time_ms;
+  ctx.avg_cmd_latency_ms = (ctx.avg_cmd_latency_ms * 9 + ctx.last_cmd_latency_ms) / 10;
 
-    // Publish updated ACU state
-    g_temp_state_doc.clear();
-    g_acu_remote.toJSON(g_temp_state_doc.to<JsonObject>());
-    publishACUState(g_temp_state_doc.as<JsonObject>());
+  publishCommandAck(ctx, ack);
 
-    // Update the stored previous state
-    g_last_state = current_state;
-  }
+  recordUnitState(ctx, unit, current_state);
 
   // Update last command timestamp (for diagnostics)
-  char time_buffer[30];
-  getTimestamp(time_buffer, sizeof(time_buffer));
-  strncpy(g_last_command_timestamp, time_buffer, sizeof(g_last_command_timestamp));
+  ctx.last_command_timestamp = getEpochSeconds();
 
   // Publish diagnostics or metrics (alternate)
-  static bool is_send_diag = true;
-  if (is_send_diag) publishDiagnostics();
-  else             publishMetrics();
-  is_send_diag = !is_send_diag;
+  if (ctx.is_next_report_diag) publishDiagnostics(ctx);
+  else                         publishMetrics(ctx);
+  ctx.is_next_report_diag = !ctx.is_next_report_diag;
 }
 
-void processMQTTQueue() {
-  while (g_mqtt_queue_head != g_mqtt_queue_tail) {
+void processMQTTQueue(MQTTContext& ctx) {
+  while (ctx.queue_head != ctx.queue_tail) {
     // Process tail
-    MQTTQueueItem* item = &g_mqtt_queue[g_mqtt_queue_tail];
+    MQTTQueueItem* item = &ctx.queue[ctx.queue_tail];
 
     logDebug(k_log_tag, "Processing topic: %s", item->topic);
 
-    if (isTopicMatchingModule(item->topic)) {
-      handleReceivedCommand(item->topic, (byte*)item->payload, item->length);
+    ACUUnit* unit = findUnitByTopic(ctx, item->topic);
+    uint8_t schedule_slot = 0;
+    if (unit != nullptr) {
+      handleReceivedCommand(ctx, *unit, item->topic, (byte*)item->payload, item->length, item->rx_ts_ms);
+    } else if (isTopicMatchingConfig(ctx, item->topic)) {
+      handleConfigMessage(ctx, item->topic, (byte*)item->payload, item->length);
+    } else if (isTopicMatchingSchedule(ctx, item->topic, schedule_slot)) {
+      handleScheduleMessage(ctx, item->topic, schedule_slot, (byte*)item->payload, item->length);
+    } else if (isTopicMatchingPolicy(ctx, item->topic)) {
+      handlePolicyMessage(ctx, item->topic, (byte*)item->payload, item->length);
+    } else if (isTopicMatchingOTAOffer(ctx, item->topic)) {
+      handleOTAOfferMessage(ctx, item->topic, (byte*)item->payload, item->length);
     } else {
       logDebug(k_log_tag, "Topic rejected by filter.");
     }
 
     // Advance tail
-    g_mqtt_queue_tail = (g_mqtt_queue_tail + 1) % g_mqtt_queue_size;
-    yield();
+    ctx.queue_tail = (ctx.queue_tail + 1) % g_mqtt_queue_size;
+    watchdogFeed();
   }
 }
 
-void handleMQTTCallback(char* topic, byte* payload, unsigned int length) {
-  uint8_t next_head = (g_mqtt_queue_head + 1) % g_mqtt_queue_size;
-  if (next_head != g_mqtt_queue_tail) {
-    strncpy(g_mqtt_queue[g_mqtt_queue_head].topic, topic, sizeof(g_mqtt_queue[0].topic) - 1);
-    g_mqtt_queue[g_mqtt_queue_head].topic[sizeof(g_mqtt_queue[0].topic) - 1] = '\0';
+void handleMQTTCallback(MQTTContext& ctx, char* topic, byte* payload, unsigned int length) {
+  if (isTopicMatchingOTAChunk(ctx, topic)) {
+    handleOTAChunkMessage(ctx, payload, length); // Larger than a queue slot
+    return;
+  }
+
+  uint8_t next_head = (ctx.queue_head + 1) % g_mqtt_queue_size;
+  if (next_head != ctx.queue_tail) {
+    strncpy(ctx.queue[ctx.queue_head].topic, topic, sizeof(ctx.queue[0].topic) - 1);
+    ctx.queue[ctx.queue_head].topic[sizeof(ctx.queue[0].topic) - 1] = '\0';
 
-    unsigned int copy_len = (length < sizeof(g_mqtt_queue[0].payload)) ? length : sizeof(g_mqtt_queue[0].payload);
-    memcpy(g_mqtt_queue[g_mqtt_queue_head].payload, payload, copy_len);
-    if (copy_len < sizeof(g_mqtt_queue[0].payload)) g_mqtt_queue[g_mqtt_queue_head].payload[copy_len] = '\0';
-    g_mqtt_queue[g_mqtt_queue_head].length = copy_len;
+    unsigned int copy_len = (length < sizeof(ctx.queue[0].payload)) ? length : sizeof(ctx.queue[0].payload);
+    memcpy(ctx.queue[ctx.queue_head].payload, payload, copy_len);
+    if (copy_len < sizeof(ctx.queue[0].payload)) ctx.queue[ctx.queue_head].payload[copy_len] = '\0';
+    ctx.queue[ctx.queue_head].length = copy_len;
+    ctx.queue[ctx.queue_head].rx_ts_ms = getEpochMs();
 
-    g_mqtt_queue_head = next_head;
+    ctx.queue_head = next_head;
   }
 }
@@ -4,137 +4,221 @@
 #error "ESP8266 only"
 #endif
 
-void reconnectMQTT() {
-  static unsigned long last_attempt_ms = 0;
+namespace {
+void reportMQTTConnectFailure(MQTTContext& ctx) {
+  int rc = ctx.client.state();
+  logError(k_log_tag, "Connect failed (rc=%d broker=%s port=%d), retrying...", rc, ctx.config.server, ctx.config.port);
+#if MQTT_USE_TLS
+  char tls_error[48];
+  int tls_rc = ctx.wifi_client.getLastSSLError(tls_error, sizeof(tls_error));
+  if (tls_rc != 0) logError(k_log_tag, "TLS error %d: %s", tls_rc, tls_error);
+#endif
+  publishMQTTErrorContext(ctx, "connect_failed", nullptr, nullptr, 0, rc);
+}
+
+#if MQTT_USE_TLS
+// The certificate is pinned by fingerprint, so no CA chain is parsed or kept in RAM.
+// The session is kept across connections so a reconnect resumes it (abbreviated
+// handshake, no key exchange); BearSSL's client resumes by session ID, not tickets.
+void setupMQTTTLS(MQTTContext& ctx) {
+  char fingerprint[k_tls_fingerprint_len];
+  strncpy_P(fingerprint, ctx.config.tls_fingerprint, sizeof(fingerprint) - 1);
+  fingerprint[sizeof(fingerprint) - 1] = '\0';
+  if (!ctx.wifi_client.setFingerprint(fingerprint)) {
+    logError(k_log_tag, "Invalid MQTT_TLS_FINGERPRINT, TLS connects will fail");
+  }
+  ctx.wifi_client.setSession(&ctx.tls_session);
+  ctx.client.setConnectTimeout(k_mqtt_tls_handshake_timeout_ms);
+}
+
+// Asks the broker for small records once per boot. The probe is a blocking TLS
+// connect of its own, so a refusal or an unreachable broker is not retried:
+// the connection then keeps the full 16 kB buffers until the next reboot.
+void probeMQTTTLSFragment(MQTTContext& ctx) {
+  if (ctx.is_tls_probed) return;
+  ctx.is_tls_probed = true;
+  if (!BearSSL::WiFiClientSecure::probeMaxFragmentLength(ctx.config.server, ctx.config.port, k_mqtt_tls_rx_fragment)) {
+    logWarn(k_log_tag, "Broker refused %u-byte TLS records (MFLN) or was unreachable, using 16 kB buffers",
+            (unsigned int)k_mqtt_tls_rx_fragment);
+    return;
+  }
+
+  ctx.wifi_client.setBufferSizes(k_mqtt_tls_rx_fragment, k_mqtt_tls_tx_fragment);
+  ctx.tls_fragment_len = k_mqtt_tls_rx_fragment;
+}
+
+void recordMQTTTLSHandshake(MQTTContext& ctx, uint32_t elapsed_ms, uint32_t heap_before) {
+  uint32_t heap_after = ESP.getFreeHeap();
+  ctx.tls_handshake_ms = elapsed_ms;
+  if (elapsed_ms > ctx.tls_handshake_max_ms) ctx.tls_handshake_max_ms = elapsed_ms;
+  ctx.tls_heap_bytes = (heap_before > heap_after) ? heap_before - heap_after : 0;
+  logInfo(k_log_tag, "TLS handshake %u ms, %u bytes heap", (unsigned int)elapsed_ms, (unsigned int)ctx.tls_heap_bytes);
+}
+#endif
+
+// The CONNACK (or a refusal or timeout) arrived for the attempt reconnectMQTT() started
+void completeMQTTConnect(MQTTContext& ctx) {
+  if (!ctx.client.connected()) {
+    reportMQTTConnectFailure(ctx);
+    return;
+  }
+
+  logInfo(k_log_tag, "Connected.");
+
+  ctx.mqtt_connect_ts = millis();
+  ctx.is_prev_mqtt_status = true;
+
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::Command, ctx.units[i].id), g_mqtt_qos);
+  }
+  ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::Config), g_mqtt_qos);
+  ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::Schedule), g_mqtt_qos);
+  ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::Policy), g_mqtt_qos);
+  ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::OTAOffer), g_mqtt_qos);
+  ctx.client.subscribe(buildMQTTTopic(ctx, MQTTTopic::OTAChunk), 0); // Not queued by the broker while offline; re-requested instead
+  publishOnReconnect(ctx);
+}
+} // namespace
+
+// Starts an attempt; the outcome arrives in a later handleMQTT() (completeMQTTConnect)
+void reconnectMQTT(MQTTContext& ctx) {
   constexpr unsigned long retry_interval_ms = 10000;
 
-  if (g_mqtt_client.connected()) return;
+  if (ctx.client.connected() || ctx.client.isConnecting()) return;
+#if MQTT_USE_TLS
+  // The handshake blocks loop() for seconds: never in the middle of IR traffic
+  if (!isIRIdle(ctx)) return;
+#endif
 
   unsigned long now_ms = millis();
-  if (now_ms - last_attempt_ms >= retry_interval_ms) {
-    last_attempt_ms = now_ms;
+  if (!ctx.has_connect_attempt || now_ms - ctx.last_connect_attempt_ms >= retry_interval_ms) {
+    ctx.has_connect_attempt = true;
+    ctx.last_connect_attempt_ms = now_ms;
 
     logInfo(k_log_tag, "Connecting...");
 
-    static char client_id[32];
-    static bool is_id_init = false;
-
-    if (!is_id_init) {
-      snprintf(client_id, sizeof(client_id),
+    if (!ctx.is_client_id_init) {
+      snprintf(ctx.client_id, sizeof(ctx.client_id),
                "ESP8266Client-%06X", ESP.getChipId());
       // Copy LWT message from PROGMEM to RAM buffer
-      strcpy_P(g_lwt_message, g_lwt_message_json);
-      is_id_init = true;
+      strcpy_P(ctx.lwt_message, g_lwt_message_json);
+      ctx.is_client_id_init = true;
     }
 
-    if (g_mqtt_client.connect(client_id, g_mqtt_user, g_mqtt_pass, g_mqtt_topic_pub_diagnostics, g_mqtt_qos, true, g_lwt_message, g_is_clean_session)) {
-      logInfo(k_log_tag, "Connected.");
-
-      g_mqtt_connect_ts = millis();
-      g_is_prev_mqtt_status = true;
-
-      // g_mqtt_client.subscribe(g_mqtt_topic_sub_floor, g_mqtt_qos);
-      // g_mqtt_client.subscribe(g_mqtt_topic_sub_room, g_mqtt_qos);
-      g_mqtt_client.subscribe(g_mqtt_topic_sub_unit, g_mqtt_qos);
-      publishOnReconnect();
-    } else {
-      int rc = g_mqtt_client.state();
-      logError(k_log_tag, "Connect failed (rc=%d broker=%s port=%d), retrying...", rc, g_mqtt_server, g_mqtt_port);
-      publishMQTTErrorContext("connect_failed", nullptr, nullptr, 0, rc);
+#if MQTT_USE_TLS
+    probeMQTTTLSFragment(ctx);
+    uint32_t heap_before = ESP.getFreeHeap();
+    unsigned long started_ms = millis();
+#endif
+    if (!ctx.client.connect(ctx.client_id, ctx.config.user, ctx.config.pass, buildMQTTTopic(ctx, MQTTTopic::Diagnostics), g_mqtt_qos, true, ctx.lwt_message, g_is_clean_session)) {
+      reportMQTTConnectFailure(ctx);
+      return;
     }
+#if MQTT_USE_TLS
+    recordMQTTTLSHandshake(ctx, millis() - started_ms, heap_before);
+#endif
   }
 }
 
-void updateConnectionStats() {
+void updateConnectionStats(MQTTContext& ctx) {
   unsigned long now_ms = millis();
 
   // Track millis() wrap to extend uptime range
-  if (g_last_uptime_ms != 0 && now_ms < g_last_uptime_ms) {
-    g_uptime_wraps++;
+  if (ctx.last_uptime_ms != 0 && now_ms < ctx.last_uptime_ms) {
+    ctx.uptime_wraps++;
   }
-  g_last_uptime_ms = now_ms;
+  ctx.last_uptime_ms = now_ms;
 
   // Snapshot uptime (seconds) from extended millisecond counter
-  uint64_t total_ms = ((uint64_t)g_uptime_wraps << 32) + (uint64_t)now_ms;
-  g_uptime_s_cached = total_ms / 1000ULL;
+  uint64_t total_ms = ((uint64_t)ctx.uptime_wraps << 32) + (uint64_t)now_ms;
+  ctx.uptime_s_cached = total_ms / 1000ULL;
 
   // WiFi Stats
   bool is_current_wifi = (WiFi.status() == WL_CONNECTED);
   if (is_current_wifi) {
-    if (g_last_wifi_update_ms == 0) {
-      g_last_wifi_update_ms = now_ms;
-    } else if (now_ms - g_last_wifi_update_ms >= 1000) {
-      g_wifi_connected_total_s += (now_ms - g_last_wifi_update_ms) / 1000;
-      g_last_wifi_update_ms = now_ms;
+    if (ctx.last_wifi_update_ms == 0) {
+      ctx.last_wifi_update_ms = now_ms;
+    } else if (now_ms - ctx.last_wifi_update_ms >= 1000) {
+      ctx.wifi_connected_total_s += (now_ms - ctx.last_wifi_update_ms) / 1000;
+      ctx.last_wifi_update_ms = now_ms;
     }
   } else {
-    g_last_wifi_update_ms = 0;
+    ctx.last_wifi_update_ms = 0;
   }
 
-  if (is_current_wifi && !g_is_prev_wifi_status) {
-    g_wifi_connect_ts = now_ms;
+  if (is_current_wifi && !ctx.is_prev_wifi_status) {
+    ctx.wifi_connect_ts = now_ms;
   }
-  else if (!is_current_wifi && g_is_prev_wifi_status) {
-    g_wifi_disconnect_counter++;
+  else if (!is_current_wifi && ctx.is_prev_wifi_status) {
+    ctx.wifi_disconnect_counter++;
   }
-  g_is_prev_wifi_status = is_current_wifi;
+  ctx.is_prev_wifi_status = is_current_wifi;
 
   // MQTT Stats
-  bool is_current_mqtt = g_mqtt_client.connected();
+  bool is_current_mqtt = ctx.client.connected();
   if (is_current_mqtt) {
-    if (g_last_mqtt_update_ms == 0) {
-      g_last_mqtt_update_ms = now_ms;
-    } else if (now_ms - g_last_mqtt_update_ms >= 1000) {
-      g_mqtt_connected_total_s += (now_ms - g_last_mqtt_update_ms) / 1000;
-      g_last_mqtt_update_ms = now_ms;
+    if (ctx.last_mqtt_update_ms == 0) {
+      ctx.last_mqtt_update_ms = now_ms;
+    } else if (now_ms - ctx.last_mqtt_update_ms >= 1000) {
+      ctx.mqtt_connected_total_s += (now_ms - ctx.last_mqtt_update_ms) / 1000;
+      ctx.last_mqtt_update_ms = now_ms;
     }
   } else {
-    g_last_mqtt_update_ms = 0;
+    ctx.last_mqtt_update_ms = 0;
   }
 
-  if (is_current_mqtt && !g_is_prev_mqtt_status) {
-    g_mqtt_connect_ts = now_ms;
+  if (is_current_mqtt && !ctx.is_prev_mqtt_status) {
+    ctx.mqtt_connect_ts = now_ms;
   }
-  else if (!is_current_mqtt && g_is_prev_mqtt_status) {
-    g_mqtt_disconnect_counter++;
+  else if (!is_current_mqtt && ctx.is_prev_mqtt_status) {
+    ctx.mqtt_disconnect_counter++;
   }
-  g_is_prev_mqtt_status = is_current_mqtt;
+  ctx.is_prev_mqtt_status = is_current_mqtt;
 
   // Snapshot derived metrics
-  g_wifi_uptime_s_cached = is_current_wifi ? (now_ms - g_wifi_connect_ts) / 1000 : 0;
-  g_mqtt_uptime_s_cached = is_current_mqtt ? (now_ms - g_mqtt_connect_ts) / 1000 : 0;
-  g_wifi_rssi_cached = is_current_wifi ? WiFi.RSSI() : -127;
-  g_free_heap_cached = ESP.getFreeHeap();
-  g_heap_frag_cached = ESP.getHeapFragmentation();
+  ctx.wifi_uptime_s_cached = is_current_wifi ? (now_ms - ctx.wifi_connect_ts) / 1000 : 0;
+  ctx.mqtt_uptime_s_cached = is_current_mqtt ? (now_ms - ctx.mqtt_connect_ts) / 1000 : 0;
+  ctx.wifi_rssi_cached = is_current_wifi ? WiFi.RSSI() : -127;
+  ctx.free_heap_cached = ESP.getFreeHeap();
+  ctx.heap_frag_cached = ESP.getHeapFragmentation();
+
+  if (now_ms - ctx.last_checkpoint_ms >= k_checkpoint_interval_ms) saveMQTTCheckpoint(ctx);
 }
 
-void setupMQTT() {
-  g_mqtt_client.setServer(g_mqtt_server, g_mqtt_port);
-  g_mqtt_client.setCallback(handleMQTTCallback);
-  g_mqtt_client.setKeepAlive(g_mqtt_keepalive_s); // seconds
-  g_mqtt_client.setBufferSize(g_mqtt_buffer_size); // For identity and metrics
-#if USE_ACU_ADAPTER
-  g_acu_adapter.begin();
+void setupMQTT(MQTTContext& ctx) {
+  ctx.client.setServer(ctx.config.server, ctx.config.port);
+  // Captures one pointer, which std::function stores inline (no heap)
+  ctx.client.setCallback([&ctx](char* topic, byte* payload, unsigned int length) {
+    handleMQTTCallback(ctx, topic, payload, length);
+  });
+  ctx.client.setKeepAlive(g_mqtt_keepalive_s); // seconds
+#if MQTT_USE_TLS
+  setupMQTTTLS(ctx);
 #endif
 }
 
-void handleMQTT() {
-  if (!g_mqtt_client.connected()) {
-    reconnectMQTT();
-    yield();
+void handleMQTT(MQTTContext& ctx) {
+  if (!ctx.client.connected()) {
+    reconnectMQTT(ctx);
+    watchdogFeed();
   }
 
-  g_mqtt_client.loop();
-  processMQTTQueue();
-  yield();
+  bool was_connecting = ctx.client.isConnecting();
+  ctx.client.loop();
+  if (was_connecting && !ctx.client.isConnecting()) completeMQTTConnect(ctx);
+  processMQTTQueue(ctx);
+  serviceIRLearning(ctx);
+  watchdogFeed();
+
+  if (shouldDeferLoopWork()) return; // Commands went first; OTA, heartbeat and log stream wait a loop
 
-  publishHeartbeat();
-  yield();
+  handleOTA(ctx);
+  publishHeartbeat(ctx);
+  handleLogStream(ctx);
+  watchdogFeed();
 
 }
 
-void mqttDisconnect() {
-  if (g_mqtt_client.connected()) {
-    g_mqtt_client.disconnect();
-  }
+void mqttDisconnect(MQTTContext& ctx) {
+  ctx.client.disconnect();
 }
@@ -7,19 +7,39 @@
 #endif
 
 #include <ArduinoJson.h>
-#include <PubSubClient.h>
 #include <ESP8266WiFi.h>
 #include <pgmspace.h>
 
 #include "logging.h"
 #include "secrets.h"
 #include "ACU_remote_encoder.h"
-#if USE_ACU_ADAPTER
-  #include "ACU_ir_adapters.h"
-#else
-  #include "ACU_IR_modulator.h"
-#endif
+#include "ACU_IR_modulator.h"
+#include "ACU_ir_adapters.h"
+#include "IR_learning.h"
 #include <NTP.h>
+#include "Profiler.h"
+#include "Watchdog.h"
+#include "Checkpoint.h"
+#include "ESP_system.h"
+#include "Device_info.h"
+#include "CommandDedup.h"
+#include "ACU_scheduler.h"
+#include "ACU_policy.h"
+#include "mqtt_json_arena.h"
+#include "OTA_update.h"
+#include "WiFiData.h"
+#include "MQTT.h"
+#include "MQTT_client.h"
+
+#ifndef MQTT_USE_TLS
+  #define MQTT_USE_TLS 0
+#endif
+#if MQTT_USE_TLS
+  #include <WiFiClientSecure.h>
+  #ifndef MQTT_TLS_FINGERPRINT
+    #error "MQTT_USE_TLS needs MQTT_TLS_FINGERPRINT (SHA-1 of the broker certificate)"
+  #endif
+#endif
 
 // =================================================================================
 // 0. SAFE DEFAULTS (avoid build errors if macros are missing)
@@ -28,7 +48,7 @@
   #define MQTT_SERVER "127.0.0.1"
 #endif
 #ifndef MQTT_PORT
-  #define MQTT_PORT 1883
+  #define MQTT_PORT (MQTT_USE_TLS ? 8883 : 1883)
 #endif
 #ifndef MQTT_USER
   #define MQTT_USER ""
@@ -36,6 +56,9 @@
 #ifndef MQTT_PASS
   #define MQTT_PASS ""
 #endif
+#ifndef MQTT_TLS_FINGERPRINT
+  #define MQTT_TLS_FINGERPRINT ""
+#endif
 #ifndef STATE_PATH
   #define STATE_PATH "state"
 #endif
@@ -51,15 +74,19 @@
 #ifndef DEFINED_UNIT
   #define DEFINED_UNIT "unknown_unit"
 #endif
+#ifndef ACU_REMOTE_MODEL
+  #define ACU_REMOTE_MODEL "MHI_88"
+#endif
+// format: "unit_id[:model[:pin]],..." (empty = single DEFINED_UNIT on ir_led_pin)
+#ifndef DEFINED_UNITS
+  #define DEFINED_UNITS ""
+#endif
 #ifndef DEFINED_ROOM_TYPE_ID
   #define DEFINED_ROOM_TYPE_ID 0
 #endif
 #ifndef DEFINED_DEPARTMENT
   #define DEFINED_DEPARTMENT "unknown_department"
 #endif
-#ifndef ACU_REMOTE_MODEL
-  #define ACU_REMOTE_MODEL "unknown_model"
-#endif
 #ifndef GIT_HASH
   #define GIT_HASH "unknown"
 #endif
@@ -79,14 +106,34 @@ constexpr size_t k_error_payload_buf = k_error_payload_max + 1;
 constexpr size_t k_error_str_max = 32;
 constexpr size_t k_error_topic_max = 64;
 constexpr size_t k_lwt_message_len = sizeof("{\"status\":\"offline\"}");
+constexpr size_t k_trace_id_max = 24;
+constexpr uint8_t k_max_acu_units = k_acu_adapter_slots;
+constexpr size_t k_unit_id_max = 16;
+static_assert(k_max_acu_units <= k_policy_units_max, "Policy engine must track every unit");
+constexpr unsigned long k_ir_idle_quiet_ms = 10000; // No IR activity for this long before Wi-Fi may roam
+constexpr unsigned long k_ir_frame_gap_ms = 100; // Quiet time between frames so nearby receivers do not merge them
+constexpr unsigned long k_checkpoint_interval_ms = 1000; // Counters and Wi-Fi link; unit states and the dedup window are saved as they change
+constexpr unsigned long k_retained_retry_interval_ms = 1000; // Identity or deployment that did not fit the publish ring
 
 constexpr uint8_t g_mqtt_qos = 1; // Quality of Service
 constexpr bool g_is_clean_session = false;
 constexpr unsigned long g_heartbeat_interval_ms = 15000; // 15 seconds
 constexpr unsigned long g_metrics_interval_ms = 120000;  // 120 seconds
 constexpr unsigned int g_mqtt_keepalive_s = 45;
-constexpr unsigned int g_mqtt_buffer_size = 512;
-constexpr uint8_t g_mqtt_queue_size = 5;
+constexpr uint8_t g_mqtt_queue_size = 8;
+constexpr size_t k_json_output_size = 832; // Shared serialization buffer (largest: metrics with roaming, TLS and watchdog fields)
+constexpr size_t k_log_frame_max = 512;
+constexpr size_t k_topic_max = 80;
+constexpr size_t k_topic_prefix_max = 52; // "<root>/floor_id/room_id/"
+constexpr size_t k_topic_suffix_max = 13; // "/diagnostics", "/ota/request"
+static_assert(k_topic_prefix_max + k_unit_id_max + k_topic_suffix_max - 2 <= k_topic_max, "Every topic must fit the topic buffer");
+// TLS (MQTT_USE_TLS). If the broker accepts 1 kB records (MFLN, RFC 6066), BearSSL
+// needs about 1.5 kB of record buffers instead of about 17 kB.
+constexpr uint16_t k_mqtt_tls_rx_fragment = 1024;
+constexpr uint16_t k_mqtt_tls_tx_fragment = 512;
+constexpr unsigned long k_mqtt_tls_handshake_timeout_ms = 8000; // Full handshake at 80 MHz with an RSA key
+constexpr size_t k_tls_fingerprint_len = sizeof("AA:BB:CC:DD:EE:FF:00:11:22:33:44:55:66:77:88:99:AA:BB:CC:DD");
+static_assert(k_ota_frame_header_len + k_ota_chunk_max + k_topic_max + 4 <= k_mqtt_rx_buffer_size, "An OTA chunk must fit the MQTT receive buffer");
 
 struct ErrorContextSnapshot {
   bool has_data = false;
@@ -99,126 +146,292 @@ struct ErrorContextSnapshot {
 };
 
 struct MQTTQueueItem {
-  char topic[64];
+  char topic[80];
   char payload[256];
   unsigned int length;
+  uint64_t rx_ts_ms; // Epoch ms at broker delivery (0 if clock unsynced)
+};
+
+// Every topic is "<root>/floor_id/room_id/<unit_id><suffix>". Only the two room
+// prefixes are kept; a topic is assembled on demand (buildMQTTTopic) or matched
+// piecewise (isMQTTTopic). Device-level topics use the primary unit.
+enum class MQTTTopic : uint8_t {
+  // Subscribed, under CONTROL_PATH
+  Command,     // Per unit
+  Config,
+  Schedule,    // Wildcard filter ".../schedule/+"
+  Policy,
+  OTAOffer,    // Retained update offer
+  OTAChunk,    // Firmware chunks (binary, bypass the queue)
+  // Published, under STATE_PATH
+  State,       // Per unit
+  Identity,
+  Deployment,
+  Diagnostics,
+  Metrics,
+  Error,
+  Ack,
+  Log,
+  OTAStatus,
+  OTARequest,
+  Count
+};
+
+// Command outcome reported on the ack topic, including dashboard-supplied
+// tracing fields. All timestamps are NTP-aligned UTC epoch milliseconds (0 = unknown).
+struct CommandAck {
+  const char* status = "invalid"; // executed | duplicate | invalid | ir_failed
+  const char* unit = nullptr;
+  char id[k_trace_id_max] = {0};
+  char sender[k_sender_id_max] = {0};
+  uint32_t seq = 0;
+  bool has_seq = false;
+  uint64_t sent_ts_ms = 0;
+  uint64_t rx_ts_ms = 0;
+  uint64_t ir_start_ts_ms = 0;
+  uint64_t ir_done_ts_ms = 0;
+};
+
+// Logical ACU driven by this module. Unit i uses adapter slot i.
+struct ACUUnit {
+  char id[k_unit_id_max] = {0};
+  ACUState last_state = {};
+  bool has_state = false;
+  uint32_t last_change_ts = 0; // UTC epoch seconds, 0 if unknown
 };
 
-extern ErrorContextSnapshot g_last_error_ctx;
-extern bool g_has_queued_error_ctx;
+// Broker and identity of one MQTT instance. The firmware's instance uses the
+// build flags (MQTT_SERVER, DEFINED_FLOOR, ...); see g_mqtt_context in mqtt.cpp.
+struct MQTTConfig {
+  const char* server;
+  int port;
+  const char* user;
+  const char* pass;
+  const char* tls_fingerprint; // In PROGMEM; SHA-1 of the broker certificate, "AA:BB:..." (MQTT_USE_TLS)
+  const char* state_root;   // format: "<state_root>/floor_id/room_id/unit_id/..."
+  const char* control_root;
+  const char* floor_id;
+  const char* room_id;
+  const char* unit_id;      // Used when units is empty
+  const char* units;        // format: "unit_id[:model[:pin]],..." (see setupACUUnits)
+};
+
+// Log stream frame being filled by the logger's sink (see mqtt_log.cpp)
+struct MQTTLogStream {
+  size_t frame_len = 0;
+  unsigned long frame_started_ms = 0;
+  unsigned long last_frame_ms = 0;
+  uint32_t lines_dropped = 0; // Since the last frame
+  bool is_enabled = false;
+  char frame[k_log_frame_max];
+};
+
+// Pull-based update session driven over MQTT (see mqtt_ota.cpp)
+struct MQTTOTASession {
+  bool has_offer = false;
+  bool has_patch_failed = false;     // Patch rejected for this offer, use the image
+  bool is_backing_off = false;
+  bool is_request_due = false;
+  bool is_chunk_dropped = false;     // Arrived while the previous one was still being applied
+  uint8_t stalls = 0;
+  uint32_t failed_session = 0;       // Not retried until a different offer arrives
+  uint32_t window_end = 0;
+  unsigned long last_progress_ms = 0;
+  unsigned long backoff_start_ms = 0;
+  uint32_t retries = 0;
+  uint32_t last_status_index = 0;
+  unsigned long ready_ms = 0;
+  OTAOffer offer;
+};
+
+// Everything one MQTT instance owns: client, topics, units, command queue,
+// counters and JSON memory. The firmware runs a single instance,
+// g_mqtt_context; host simulation and tests can create more. The IR adapters,
+// schedule, policy and OTA engines behind it are still one per process.
+//
+// Scalars come first and buffers last: Xtensa loads reach 1020 bytes past the
+// base (255 for byte loads), so the fields the handlers touch on every call
+// stay one instruction away.
+struct MQTTContext {
+  explicit MQTTContext(const MQTTConfig& mqtt_config);
+
+  MQTTContext(const MQTTContext&) = delete;
+  MQTTContext& operator=(const MQTTContext&) = delete;
+
+  MQTTConfig config;
+  const char* unit_id; // Primary unit; device-level topics live under it
+
+  uint8_t unit_count = 0;
+  uint8_t state_prefix_len = 0;
+  uint8_t control_prefix_len = 0;
+  volatile uint8_t queue_head = 0; // MQTT queue for ISR-safe decoupling
+  volatile uint8_t queue_tail = 0;
+  bool is_publish_in_progress = false; // lock to prevent overlapping publishes
+  bool has_queued_error_ctx = false;
+  bool has_identity_pending = false;   // Retained identity/deployment not yet accepted by the client;
+  bool has_deployment_pending = false; // retried from publishHeartbeat()
+  bool is_client_id_init = false;
+  bool is_next_report_diag = true; // Commands alternate diagnostics and metrics
+  bool has_ir_sent = false;
+  bool is_policy_paused = false; // Paused after a failed send instead of retrying every loop
+  bool has_connect_attempt = false; // The first attempt of a boot does not wait for the retry interval
+
+  unsigned long last_connect_attempt_ms = 0;
+  unsigned long last_heartbeat_time = 0;
+  unsigned long last_metrics_time = 0;
+  unsigned long last_retained_retry_ms = 0;
+  unsigned long last_ir_done_ms = 0;
+  unsigned long policy_failed_ms = 0;
+  unsigned long last_checkpoint_ms = 0;
+
+  // Connection Stats
+  unsigned long wifi_connect_ts = 0;
+  unsigned long mqtt_connect_ts = 0;
+  unsigned int wifi_disconnect_counter = 0;
+  unsigned int mqtt_disconnect_counter = 0;
+  unsigned int commands_received_counter = 0;
+  unsigned int commands_executed_counter = 0;
+  bool is_prev_wifi_status = false;
+  bool is_prev_mqtt_status = false;
+
+  // Cumulative availability counters
+  uint32_t wifi_connected_total_s = 0;
+  uint32_t mqtt_connected_total_s = 0;
+  unsigned long last_wifi_update_ms = 0;
+  unsigned long last_mqtt_update_ms = 0;
+
+  // Command latency metrics
+  uint32_t last_cmd_latency_ms = 0;
+  uint32_t avg_cmd_latency_ms = 0;
+
+  // Command failure counters
+  uint32_t commands_failed_parse = 0;
+  uint32_t commands_failed_struct = 0;
+  uint32_t commands_failed_ir = 0;
+  uint32_t commands_duplicate = 0;
+  uint32_t commands_scheduled = 0;
+  uint32_t commands_policy = 0;
+
+  uint32_t publish_failures = 0;
+  uint32_t log_stream_dropped = 0; // Log stream lines lost to a full frame buffer
+  uint32_t warm_boots = 0;         // Soft resets the counters above were carried across (RTC checkpoint)
+
+  // Uptime wrap tracking (millis() wraps ~49.7 days)
+  uint32_t uptime_wraps = 0;
+  unsigned long last_uptime_ms = 0;
+
+  // Cached metric snapshots (computed in updateConnectionStats)
+  uint64_t uptime_s_cached = 0;
+  uint32_t wifi_uptime_s_cached = 0;
+  uint32_t mqtt_uptime_s_cached = 0;
+  int32_t wifi_rssi_cached = -127;
+  uint32_t free_heap_cached = 0;
+  uint32_t heap_frag_cached = 0;
+
+#if MQTT_USE_TLS
+  // TLS connects; the time covers the whole blocking part of connect() (TCP + TLS)
+  uint32_t tls_handshake_ms = 0;     // Last
+  uint32_t tls_handshake_max_ms = 0;
+  uint32_t tls_heap_bytes = 0;       // Heap the last connection took
+  uint16_t tls_fragment_len = 0;     // Record size agreed with the broker, 0 = full 16 kB records
+  bool is_tls_probed = false;
+#endif
+
+  // Owned by the WiFi manager (see setWiFiRoamStats)
+  const CustomWiFi::WiFiRoamStats* wifi_roam_stats = nullptr;
+  CustomWiFi::WiFiLink wifi_link; // Last access point, kept through a disconnect for the checkpoint
 
-extern WiFiClient g_esp_client;
-extern PubSubClient g_mqtt_client;
-extern ACURemote g_acu_remote;
-#if USE_ACU_ADAPTER
-extern MHI88Adapter g_acu_adapter;
+#if MQTT_USE_TLS
+  BearSSL::WiFiClientSecure wifi_client;
+  BearSSL::Session tls_session; // Lets a reconnect resume the session instead of redoing the key exchange
+#else
+  WiFiClient wifi_client;
 #endif
+  ACURemote acu_remote;
+
+  // Redelivery dedup window (QoS1 + persistent session)
+  DedupSender dedup_senders[k_dedup_sender_slots];
+
+  MQTTOTASession ota;
+
+  // Logical ACU units (last known state per unit)
+  ACUUnit units[k_max_acu_units];
 
-extern const char* g_mqtt_server;
-extern const int g_mqtt_port;
-extern const char* g_mqtt_user;
-extern const char* g_mqtt_pass;
+  // Topic prefixes (see MQTTTopic) and the buffer topics are assembled in
+  char state_prefix[k_topic_prefix_max];
+  char control_prefix[k_topic_prefix_max];
+  char topic[k_topic_max];
 
-extern const char* g_state_root;
-extern const char* g_control_root;
-extern const char* g_floor_id;
-extern const char* g_room_id;
-extern const char* g_unit_id;
+  char client_id[32];
+  char lwt_message[k_lwt_message_len];
+  uint32_t last_command_timestamp = 0; // UTC epoch seconds, 0 if unknown
+
+  ErrorContextSnapshot last_error_ctx;
+  MQTTQueueItem queue[g_mqtt_queue_size];
+  MQTTLogStream log_stream;
+
+  // Serialization scratch shared by all publishers. Each publisher serializes and
+  // publishes before anything else can run; error contexts copy their payload first.
+  char json_output[k_json_output_size];
+  JsonArena json_arena;
+
+  // Last: mostly its own send/receive buffers, and its members are reached through 'this'
+  AsyncMQTTClient client;
+};
 
 extern const char g_lwt_message_json[] PROGMEM;
 
-extern char g_mqtt_topic_sub_unit[64];
-extern char g_mqtt_topic_pub_state[80];
-extern char g_mqtt_topic_pub_identity[80];
-extern char g_mqtt_topic_pub_deployment[80];
-extern char g_mqtt_topic_pub_diagnostics[80];
-extern char g_mqtt_topic_pub_metrics[80];
-extern char g_mqtt_topic_pub_error[80];
-
-extern MQTTQueueItem g_mqtt_queue[g_mqtt_queue_size];
-extern volatile uint8_t g_mqtt_queue_head;
-extern volatile uint8_t g_mqtt_queue_tail;
-
-extern char g_last_received_command_json[256];
-extern char g_last_command_timestamp[30];
-extern char g_last_change_timestamp[30];
-extern unsigned long g_last_heartbeat_time;
-extern unsigned long g_last_metrics_time;
-
-extern bool g_is_mqtt_publish_in_progress;
-
-extern uint32_t g_last_state_crc;
-extern bool g_is_state_initialized;
-extern char g_lwt_message[k_lwt_message_len];
-
-extern ACUState g_last_state;
-
-extern StaticJsonDocument<256> g_deployment_doc;
-extern StaticJsonDocument<160> g_diag_doc;
-extern StaticJsonDocument<384> g_metrics_doc;
-extern StaticJsonDocument<192> g_state_pub_doc;
-
-extern char g_deployment_output[224];
-extern char g_diag_output[192];
-extern char g_metrics_output[384];
-extern char g_state_pub_output[192];
-
-extern StaticJsonDocument<512> g_identity_doc;
-extern char g_identity_output[384];
-extern StaticJsonDocument<384> g_error_ctx_doc;
-extern char g_error_ctx_output[384];
-extern StaticJsonDocument<256> g_rx_doc;
-extern StaticJsonDocument<128> g_temp_state_doc;
-
-extern unsigned long g_wifi_connect_ts;
-extern unsigned long g_mqtt_connect_ts;
-extern unsigned int g_wifi_disconnect_counter;
-extern unsigned int g_mqtt_disconnect_counter;
-extern unsigned int g_commands_received_counter;
-extern unsigned int g_commands_executed_counter;
-extern bool g_is_prev_wifi_status;
-extern bool g_is_prev_mqtt_status;
-
-extern uint32_t g_wifi_connected_total_s;
-extern uint32_t g_mqtt_connected_total_s;
-extern unsigned long g_last_wifi_update_ms;
-extern unsigned long g_last_mqtt_update_ms;
-
-extern uint32_t g_last_cmd_latency_ms;
-extern uint32_t g_avg_cmd_latency_ms;
-
-extern uint32_t g_commands_failed_parse;
-extern uint32_t g_commands_failed_struct;
-extern uint32_t g_commands_failed_ir;
-
-extern uint32_t g_mqtt_publish_failures;
-
-extern uint32_t g_uptime_wraps;
-extern unsigned long g_last_uptime_ms;
-
-extern uint64_t g_uptime_s_cached;
-extern uint32_t g_wifi_uptime_s_cached;
-extern uint32_t g_mqtt_uptime_s_cached;
-extern int32_t g_wifi_rssi_cached;
-extern uint32_t g_free_heap_cached;
-extern uint32_t g_heap_frag_cached;
-
-void publishMQTTErrorContext(const char* error, const char* topic, const uint8_t* payload, unsigned int length, int rc);
-bool publishErrorContextSnapshot(const ErrorContextSnapshot& snapshot);
-void queueErrorContextSnapshot(const ErrorContextSnapshot& snapshot);
-void publishQueuedErrorContextIfAny();
-
-void publishACUState(const JsonObject& state_obj);
-void publishIdentity();
-void publishDeployment();
-void publishDiagnostics();
-void publishMetrics();
-void publishOnReconnect();
-void publishHeartbeat();
-
-void handleReceivedCommand(char* topic, byte* payload, unsigned int length);
-void processMQTTQueue();
-void handleMQTTCallback(char* topic, byte* payload, unsigned int length);
-bool isTopicMatchingModule(char* topic);
-
-void reconnectMQTT();
+// Assembles the topic in ctx.topic, valid until the next call
+const char* buildMQTTTopic(MQTTContext& ctx, MQTTTopic topic, const char* unit_id);
+inline const char* buildMQTTTopic(MQTTContext& ctx, MQTTTopic topic) { return buildMQTTTopic(ctx, topic, ctx.unit_id); }
+// Text after "<root>/floor_id/room_id/<unit_id>", or nullptr if the topic is not under it
+const char* matchMQTTTopicUnit(const MQTTContext& ctx, const char* topic, MQTTTopic kind, const char* unit_id);
+bool isMQTTTopic(const MQTTContext& ctx, const char* topic, MQTTTopic kind, const char* unit_id);
+inline bool isMQTTTopic(const MQTTContext& ctx, const char* topic, MQTTTopic kind) { return isMQTTTopic(ctx, topic, kind, ctx.unit_id); }
+const char* getMQTTTopicSuffix(MQTTTopic topic); // In PROGMEM
+
+void publishMQTTErrorContext(MQTTContext& ctx, const char* error, const char* topic, const uint8_t* payload, unsigned int length, int rc);
+bool publishErrorContextSnapshot(MQTTContext& ctx, const ErrorContextSnapshot& snapshot);
+void queueErrorContextSnapshot(MQTTContext& ctx, const ErrorContextSnapshot& snapshot);
+void publishQueuedErrorContextIfAny(MQTTContext& ctx);
+
+void publishACUState(MQTTContext& ctx, const ACUUnit& unit, const JsonObject& state_obj);
+void publishIdentity(MQTTContext& ctx);
+void publishDeployment(MQTTContext& ctx);
+void publishDiagnostics(MQTTContext& ctx);
+void publishMetrics(MQTTContext& ctx);
+void publishOnReconnect(MQTTContext& ctx);
+void publishHeartbeat(MQTTContext& ctx);
+void publishCommandAck(MQTTContext& ctx, const CommandAck& ack);
+void publishLearnResult(MQTTContext& ctx, const IRLearnResult& result);
+
+ACUUnit* findUnitByTopic(MQTTContext& ctx, const char* topic);
+ACUUnit* findUnitById(MQTTContext& ctx, const char* id);
+uint8_t getUnitIndex(const MQTTContext& ctx, const ACUUnit& unit);
+bool transmitUnitState(MQTTContext& ctx, ACUUnit& unit, const ACUState& state, CommandAck& ack);
+bool transmitUnitRaw(MQTTContext& ctx, ACUUnit& unit, const uint16_t* durations, uint16_t len, uint16_t khz, CommandAck& ack);
+void recordUnitState(MQTTContext& ctx, ACUUnit& unit, const ACUState& state, bool is_command = true);
+
+void handleReceivedCommand(MQTTContext& ctx, ACUUnit& unit, char* topic, byte* payload, unsigned int length, uint64_t rx_ts_ms);
+void processMQTTQueue(MQTTContext& ctx);
+void serviceIRLearning(MQTTContext& ctx);
+bool isDuplicateCommand(const MQTTContext& ctx, const char* sender, uint32_t seq);
+void markCommandSeen(MQTTContext& ctx, const char* sender, uint32_t seq);
+void handleMQTTCallback(MQTTContext& ctx, char* topic, byte* payload, unsigned int length);
+bool isTopicMatchingConfig(const MQTTContext& ctx, const char* topic);
+void handleConfigMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length);
+void setLogStreaming(MQTTContext& ctx, bool is_enabled);
+bool isLogStreaming(const MQTTContext& ctx);
+void handleLogStream(MQTTContext& ctx);
+bool isTopicMatchingSchedule(const MQTTContext& ctx, const char* topic, uint8_t& slot);
+void handleScheduleMessage(MQTTContext& ctx, char* topic, uint8_t slot, byte* payload, unsigned int length);
+bool isTopicMatchingPolicy(const MQTTContext& ctx, const char* topic);
+void handlePolicyMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length);
+bool isTopicMatchingOTAOffer(const MQTTContext& ctx, const char* topic);
+bool isTopicMatchingOTAChunk(const MQTTContext& ctx, const char* topic);
+void handleOTAOfferMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length);
+void handleOTAChunkMessage(MQTTContext& ctx, byte* payload, unsigned int length);
+void handleOTA(MQTTContext& ctx);
+
+void reconnectMQTT(MQTTContext& ctx);
+void saveMQTTCheckpoint(MQTTContext& ctx);
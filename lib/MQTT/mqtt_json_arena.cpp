@@ -0,0 +1,76 @@
+#include "mqtt_internal.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+void* JsonArena::allocate(size_t size) {
+  size_t payload = alignSize(size);
+  if (top_ + sizeof(BlockHeader) + payload > k_json_arena_size) {
+    failures_++;
+    return nullptr;
+  }
+
+  BlockHeader* block = header((uint16_t)top_);
+  block->size = (uint16_t)payload;
+  block->prev = last_;
+  block->is_free = 0;
+  last_ = (uint16_t)top_;
+  top_ += sizeof(BlockHeader) + payload;
+  if (top_ > peak_) peak_ = top_;
+  return block + 1;
+}
+
+void JsonArena::deallocate(void* ptr) {
+  if (ptr == nullptr) return;
+  header(offsetOf(ptr))->is_free = 1;
+
+  // Pop every free block from the top of the stack
+  while (last_ != k_no_block && header(last_)->is_free) {
+    top_ = last_;
+    last_ = header(last_)->prev;
+  }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t new_size) {
+  if (ptr == nullptr) return allocate(new_size);
+
+  uint16_t offset = offsetOf(ptr);
+  BlockHeader* block = header(offset);
+  size_t payload = alignSize(new_size);
+
+  // Top block: grow or shrink in place
+  if (offset == last_) {
+    if (offset + sizeof(BlockHeader) + payload > k_json_arena_size) {
+      failures_++;
+      return nullptr;
+    }
+    block->size = (uint16_t)payload;
+    top_ = offset + sizeof(BlockHeader) + payload;
+    if (top_ > peak_) peak_ = top_;
+    return ptr;
+  }
+
+  if (payload <= block->size) return ptr; // Inner block shrink: keep the slack
+
+  void* moved = allocate(new_size);
+  if (moved == nullptr) return nullptr;
+  memcpy(moved, ptr, block->size);
+  deallocate(ptr);
+  return moved;
+}
+
+JsonLease::JsonLease(JsonArena& arena, size_t budget)
+    : arena_(arena),
+      mark_(arena.used()),
+      budget_(budget),
+      doc_(&arena) {}
+
+JsonLease::~JsonLease() {
+  size_t used = arena_.used() - mark_;
+  if (used > budget_) logWarn(k_log_tag, "JSON lease over budget (%u > %u)", (unsigned int)used, (unsigned int)budget_);
+  if (doc_.overflowed()) logWarn(k_log_tag, "JSON arena exhausted");
+
+  doc_.clear(); // Return the memory before the next lease can start
+  if (arena_.used() != mark_) logWarn(k_log_tag, "JSON lease did not unwind (%u != %u)", (unsigned int)arena_.used(), (unsigned int)mark_);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+ * mqtt_json_arena.h
+ *
+ * Memory arena for the ArduinoJson documents of one MQTT context.
+ *
+ * Documents are leased for the duration of one handler/publisher (JsonLease)
+ * and give their memory back when the lease ends. Leases nest (e.g. a command
+ * handler holding the rx document while the ack and state documents are
+ * built), so the arena is a stack: freeing the top block pops it, freeing an
+ * inner block marks it and it is popped once everything above it is gone.
+ *
+ * The arena only has to cover the deepest chain of nested leases, which is
+ * checked at compile time against the per-document budgets below.
+ */
+
+#include <ArduinoJson.h>
+
+#ifndef JSON_ARENA_SIZE
+  #define JSON_ARENA_SIZE 1536
+#endif
+
+// Per-document budgets (bytes of arena, including allocation headers)
+constexpr size_t k_json_budget_rx = 384;        // Deserialized command/config (strings are copied)
+constexpr size_t k_json_budget_ack = 256;
+constexpr size_t k_json_budget_state = 192;     // Includes the temporary state document
+constexpr size_t k_json_budget_identity = 384;
+constexpr size_t k_json_budget_deployment = 256;
+constexpr size_t k_json_budget_diag = 192;
+constexpr size_t k_json_budget_metrics = 1024;
+constexpr size_t k_json_budget_error = 320;
+constexpr size_t k_json_budget_ota = 256;       // OTA status and chunk requests
+
+constexpr size_t jsonBudgetMax(size_t a, size_t b) { return (a > b) ? a : b; }
+
+// Deepest nesting: a command handler (rx) publishing metrics, identity, an ack,
+// an OTA status, or a state update whose publish fails and emits an error context.
+constexpr size_t k_json_state_chain = 2 * k_json_budget_state + k_json_budget_error;
+constexpr size_t k_json_peak_bytes = k_json_budget_rx +
+  jsonBudgetMax(k_json_budget_metrics,
+  jsonBudgetMax(k_json_budget_identity,
+  jsonBudgetMax(k_json_budget_ack,
+  jsonBudgetMax(k_json_budget_diag,
+  jsonBudgetMax(k_json_budget_ota,
+  jsonBudgetMax(k_json_budget_error, k_json_state_chain))))));
+
+constexpr size_t k_json_arena_size = JSON_ARENA_SIZE;
+
+static_assert(k_json_arena_size >= k_json_peak_bytes, "JSON_ARENA_SIZE is below the peak concurrent document budget");
+static_assert(k_json_arena_size < 0x8000, "Arena offsets are stored in 16 bits");
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t new_size) override;
+
+  size_t used() const { return top_; }
+  size_t peak() const { return peak_; }
+  uint32_t failures() const { return failures_; }
+
+private:
+  struct BlockHeader {
+    uint16_t size;    // Payload bytes (aligned)
+    uint16_t prev;    // Offset of the previous block header, k_no_block if none
+    uint8_t is_free;
+    uint8_t reserved[3];
+  };
+
+  static constexpr uint16_t k_no_block = 0xFFFF;
+  static constexpr size_t k_align = 8;
+
+  static size_t alignSize(size_t size) { return (size + k_align - 1) & ~(k_align - 1); }
+  BlockHeader* header(uint16_t offset) { return reinterpret_cast<BlockHeader*>(buffer_ + offset); }
+  uint16_t offsetOf(void* ptr) const { return (uint16_t)((uint8_t*)ptr - buffer_ - sizeof(BlockHeader)); }
+
+  alignas(k_align) uint8_t buffer_[k_json_arena_size];
+  size_t top_ = 0;
+  uint16_t last_ = k_no_block;
+  size_t peak_ = 0;
+  uint32_t failures_ = 0;
+};
+
+// Scoped JSON document backed by an MQTT context's arena
+class JsonLease {
+public:
+  JsonLease(JsonArena& arena, size_t budget);
+  ~JsonLease();
+
+  JsonLease(const JsonLease&) = delete;
+  JsonLease& operator=(const JsonLease&) = delete;
+
+  JsonDocument& doc() { return doc_; }
+
+private:
+  JsonArena& arena_;
+  size_t mark_;
+  size_t budget_;
+  JsonDocument doc_;
+};
@@ -0,0 +1,91 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+// Remote log stream: formatted records are batched into text frames on the
+// .../log topic, one line per record: "<millis> <E|W|I|D> <tag> <message>".
+// The sink itself must never log (it runs inside the logger's drain).
+
+namespace {
+
+constexpr size_t k_log_drop_note_max = 40;          // Reserved for the "dropped" line
+constexpr size_t k_log_flush_fill = k_log_frame_max / 2;
+constexpr unsigned long k_log_flush_age_ms = 5000;  // Oldest buffered line waits at most this long...
+constexpr unsigned long k_log_frame_interval_ms = 2000; // ...but frames go out at most this often
+
+// The logger has a single sink, so one context at a time streams it
+MQTTContext* g_log_stream_ctx = nullptr;
+
+char levelLetter(LogLevel level) {
+  switch (level) {
+    case LogLevel::Error: return 'E';
+    case LogLevel::Warn:  return 'W';
+    case LogLevel::Info:  return 'I';
+    case LogLevel::Debug: return 'D';
+  }
+  return 'I';
+}
+
+void appendLogLine(LogLevel level, uint32_t ms, const char* tag, const char* message) {
+  MQTTContext& ctx = *g_log_stream_ctx;
+  MQTTLogStream& stream = ctx.log_stream;
+  size_t room = k_log_frame_max - k_log_drop_note_max - stream.frame_len;
+  int n = snprintf(stream.frame + stream.frame_len, room, "%lu %c %s %s\n",
+                   (unsigned long)ms, levelLetter(level), tag, message);
+  if (n < 0 || (size_t)n >= room) {
+    stream.lines_dropped++; // Buffer full (or broker away); keep what is queued
+    ctx.log_stream_dropped++;
+    return;
+  }
+  if (stream.frame_len == 0) stream.frame_started_ms = millis();
+  stream.frame_len += (size_t)n;
+}
+
+} // namespace
+
+void setLogStreaming(MQTTContext& ctx, bool is_enabled) {
+  MQTTLogStream& stream = ctx.log_stream;
+  if (is_enabled == stream.is_enabled) return;
+  if (is_enabled) {
+    if (g_log_stream_ctx != nullptr) setLogStreaming(*g_log_stream_ctx, false); // Take the sink over
+    g_log_stream_ctx = &ctx;
+    setLogSink(appendLogLine);
+  } else {
+    g_log_stream_ctx = nullptr;
+    setLogSink(nullptr);
+    stream.frame_len = 0;
+    stream.lines_dropped = 0;
+  }
+  stream.is_enabled = is_enabled;
+}
+
+bool isLogStreaming(const MQTTContext& ctx) {
+  return ctx.log_stream.is_enabled;
+}
+
+void handleLogStream(MQTTContext& ctx) {
+  MQTTLogStream& stream = ctx.log_stream;
+  if (stream.frame_len == 0 && stream.lines_dropped == 0) return;
+  if (!ctx.client.connected()) return;
+
+  unsigned long now_ms = millis();
+  if (now_ms - stream.last_frame_ms < k_log_frame_interval_ms) return;
+  bool is_full = stream.frame_len >= k_log_flush_fill || stream.lines_dropped > 0;
+  if (!is_full && now_ms - stream.frame_started_ms < k_log_flush_age_ms) return;
+
+  if (stream.lines_dropped > 0) {
+    int n = snprintf(stream.frame + stream.frame_len, k_log_frame_max - stream.frame_len, "%lu W LOG %u lines dropped\n",
+                     now_ms, (unsigned int)stream.lines_dropped);
+    if (n > 0) stream.frame_len += (size_t)n;
+  }
+
+  if (!ctx.client.publish(buildMQTTTopic(ctx, MQTTTopic::Log), (const uint8_t*)stream.frame, stream.frame_len, false)) {
+    ctx.publish_failures++; // Frame is discarded; retrying would only grow the backlog
+  }
+  stream.last_frame_ms = now_ms;
+  stream.frame_len = 0;
+  stream.lines_dropped = 0;
+}
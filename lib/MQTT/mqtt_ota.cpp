@@ -0,0 +1,265 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+// Pull-based firmware updates (see OTA_update.h and scripts/ota_server.py).
+//
+// The server publishes a retained offer on .../ota; the device requests chunks
+// in small windows on .../ota/request and the server answers on .../ota/chunk.
+// Chunks bypass the command queue: they are validated in the MQTT callback and
+// applied from handleOTA(), a bounded amount per loop. A lost, corrupt or
+// dropped chunk is simply requested again, which is also how a transfer
+// resumes after the broker or Wi-Fi comes back.
+
+namespace {
+
+constexpr uint8_t k_ota_window = 4;                    // Chunks requested at a time
+constexpr unsigned long k_ota_chunk_timeout_ms = 5000; // Re-request if the window stalls this long
+constexpr uint8_t k_ota_retry_max = 6;                 // Consecutive stalls before backing off
+constexpr unsigned long k_ota_backoff_ms = 60000;
+constexpr uint32_t k_ota_progress_every = 32;          // Status publish interval in chunks
+constexpr unsigned long k_ota_reboot_delay_ms = 2000;  // Let the final status reach the broker
+
+bool isOfferForSameImage(const OTAOffer& a, const OTAOffer& b) {
+  return strcmp(a.version, b.version) == 0 && strcmp(a.md5, b.md5) == 0;
+}
+
+bool parseOTAOffer(const JsonDocument& doc, OTAOffer& offer) {
+  if (!doc["version"].is<const char*>() || !doc["md5"].is<const char*>()) return false;
+  const char* version = doc["version"].as<const char*>();
+  const char* md5 = doc["md5"].as<const char*>();
+  if (version[0] == '\0' || strlen(version) >= sizeof(offer.version)) return false;
+  if (strlen(md5) != sizeof(offer.md5) - 1) return false;
+
+  strncpy(offer.version, version, sizeof(offer.version) - 1);
+  strncpy(offer.md5, md5, sizeof(offer.md5) - 1);
+  offer.size = doc["size"].as<uint32_t>();
+  offer.chunk_size = doc["chunk"].as<uint16_t>();
+
+  JsonObjectConst patch = doc["patch"];
+  if (!patch.isNull() && patch["base"].is<const char*>()) {
+    const char* base = patch["base"].as<const char*>();
+    if (strlen(base) >= sizeof(offer.patch_base)) return true; // Image only
+    strncpy(offer.patch_base, base, sizeof(offer.patch_base) - 1);
+    offer.patch_size = patch["size"].as<uint32_t>();
+    offer.has_patch = base[0] != '\0' && offer.patch_size > 0;
+  }
+  return true;
+}
+
+void publishOTAStatus(MQTTContext& ctx) {
+  if (!ctx.client.connected()) return;
+
+  const OTAProgress& progress = getOTAProgress();
+  JsonLease lease(ctx.json_arena, k_json_budget_ota);
+  JsonDocument& doc = lease.doc();
+
+  doc["status"] = otaStatusName(progress.status);
+  doc["running"] = GIT_HASH;
+  if (ctx.ota.has_offer) {
+    doc["version"] = ctx.ota.offer.version;
+    doc["stream"] = otaStreamName(progress.stream);
+    doc["received"] = progress.received;
+    doc["size"] = progress.stream_size;
+    doc["crc_fail"] = progress.crc_failures;
+    doc["retries"] = ctx.ota.retries;
+  }
+  if (progress.status == OTAStatus::Failed) {
+    doc["error"] = otaErrorName(progress.error);
+    doc["update_err"] = progress.update_error;
+  }
+
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  if (!ctx.client.publish(buildMQTTTopic(ctx, MQTTTopic::OTAStatus), (const uint8_t*)ctx.json_output, n, true)) {
+    ctx.publish_failures++;
+  }
+  ctx.ota.last_status_index = progress.next_index;
+}
+
+void requestOTAWindow(MQTTContext& ctx) {
+  const OTAProgress& progress = getOTAProgress();
+  uint32_t count = progress.chunk_count - progress.next_index;
+  if (count > k_ota_window) count = k_ota_window;
+
+  JsonLease lease(ctx.json_arena, k_json_budget_ota);
+  JsonDocument& doc = lease.doc();
+  doc["version"] = ctx.ota.offer.version;
+  doc["base"] = GIT_HASH;
+  doc["stream"] = otaStreamName(progress.stream);
+  doc["index"] = progress.next_index;
+  doc["count"] = count;
+
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  if (!ctx.client.publish(buildMQTTTopic(ctx, MQTTTopic::OTARequest), (const uint8_t*)ctx.json_output, n, false)) {
+    ctx.publish_failures++;
+    return; // Still due; retried next loop
+  }
+  ctx.ota.window_end = progress.next_index + count;
+  ctx.ota.last_progress_ms = millis();
+  ctx.ota.is_request_due = false;
+}
+
+void startOTASession(MQTTContext& ctx) {
+  bool use_patch = ctx.ota.offer.has_patch && !ctx.ota.has_patch_failed && strcmp(ctx.ota.offer.patch_base, GIT_HASH) == 0;
+  ctx.ota.retries = 0;
+  ctx.ota.stalls = 0;
+  ctx.ota.is_backing_off = false;
+  if (startOTA(ctx.ota.offer, use_patch ? OTAStream::Patch : OTAStream::Image)) {
+    ctx.ota.is_request_due = true;
+  } else {
+    ctx.ota.failed_session = otaSessionId(ctx.ota.offer.md5);
+  }
+  publishOTAStatus(ctx);
+}
+
+// A failed patch (wrong base bytes, or the result does not match the MD5)
+// is retried once as a full image before the offer is given up on.
+void handleOTAFailure(MQTTContext& ctx) {
+  const OTAProgress& progress = getOTAProgress();
+  if (progress.stream == OTAStream::Patch && !ctx.ota.has_patch_failed && progress.error != OTAError::Offer) {
+    ctx.ota.has_patch_failed = true;
+    logWarn(k_log_tag, "OTA patch failed (%s), falling back to the full image.", otaErrorName(progress.error));
+    startOTASession(ctx);
+    return;
+  }
+  ctx.ota.failed_session = progress.session;
+  publishMQTTErrorContext(ctx, "ota_failed", buildMQTTTopic(ctx, MQTTTopic::OTAOffer), nullptr, 0, progress.update_error);
+  publishOTAStatus(ctx);
+}
+
+void checkOTAStall(MQTTContext& ctx) {
+  unsigned long now_ms = millis();
+  if (ctx.ota.is_backing_off) {
+    if (now_ms - ctx.ota.backoff_start_ms < k_ota_backoff_ms) return;
+    ctx.ota.is_backing_off = false;
+    ctx.ota.stalls = 0;
+    ctx.ota.is_request_due = true;
+    return;
+  }
+  if (now_ms - ctx.ota.last_progress_ms < k_ota_chunk_timeout_ms) return;
+
+  ctx.ota.retries++;
+  if (++ctx.ota.stalls >= k_ota_retry_max) {
+    logWarn(k_log_tag, "OTA server not answering, pausing at chunk %u.", getOTAProgress().next_index);
+    ctx.ota.is_backing_off = true;
+    ctx.ota.backoff_start_ms = now_ms;
+    publishOTAStatus(ctx);
+    return;
+  }
+  ctx.ota.is_request_due = true;
+}
+
+void rebootIntoUpdate(MQTTContext& ctx) {
+  if (millis() - ctx.ota.ready_ms < k_ota_reboot_delay_ms || !isIRIdle(ctx)) return;
+  logInfo(k_log_tag, "Rebooting into %s.", ctx.ota.offer.version);
+  flushLogs();
+  mqttDisconnect(ctx);
+  clearCheckpoint(); // The new image starts its counters from zero, like after a power cycle
+  ESP.restart();
+}
+
+} // namespace
+
+bool isTopicMatchingOTAOffer(const MQTTContext& ctx, const char* topic) {
+  return isMQTTTopic(ctx, topic, MQTTTopic::OTAOffer);
+}
+
+bool isTopicMatchingOTAChunk(const MQTTContext& ctx, const char* topic) {
+  return isMQTTTopic(ctx, topic, MQTTTopic::OTAChunk);
+}
+
+// Retained offer. format:
+// {"version":"a1b2c3d","size":412816,"md5":"<32 hex>","chunk":512,"patch":{"base":"9f8e7d6","size":48211}}
+// An empty payload withdraws the offer.
+void handleOTAOfferMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length) {
+  if (length == 0) {
+    if (isOTAActive()) abortOTA();
+    ctx.ota.has_offer = false;
+    publishOTAStatus(ctx);
+    return;
+  }
+
+  JsonLease lease(ctx.json_arena, k_json_budget_rx);
+  JsonDocument& doc = lease.doc();
+  OTAOffer offer;
+  if (deserializeJson(doc, payload, length) || !parseOTAOffer(doc, offer)) {
+    logError(k_log_tag, "Invalid OTA offer (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "ota_invalid_offer", topic, payload, length, 0);
+    return;
+  }
+
+  if (getOTAProgress().status == OTAStatus::Ready) return; // Reboot pending
+  if (strcmp(offer.version, GIT_HASH) == 0) {
+    if (isOTAActive()) abortOTA();
+    ctx.ota.has_offer = false;
+    publishOTAStatus(ctx);
+    return;
+  }
+
+  // Redelivered after a reconnect: keep the session and carry on from where it stopped
+  bool is_same = ctx.ota.has_offer && isOfferForSameImage(offer, ctx.ota.offer);
+  if (is_same && isOTAActive()) {
+    ctx.ota.is_request_due = true;
+    return;
+  }
+  if (is_same && ctx.ota.failed_session == otaSessionId(offer.md5)) return;
+
+  ctx.ota.offer = offer;
+  ctx.ota.has_offer = true;
+  ctx.ota.has_patch_failed = false;
+  startOTASession(ctx);
+}
+
+// Runs inside the MQTT callback: frame checks and a copy only
+void handleOTAChunkMessage(MQTTContext& ctx, byte* payload, unsigned int length) {
+  OTAChunkResult result = submitOTAChunk(payload, length);
+  if (result == OTAChunkResult::Corrupt) ctx.ota.is_request_due = true; // Resend from the next expected chunk
+  else if (result == OTAChunkResult::Busy) ctx.ota.is_chunk_dropped = true;
+}
+
+void handleOTA(MQTTContext& ctx) {
+  const OTAProgress& progress = getOTAProgress();
+  if (progress.status == OTAStatus::Ready) {
+    rebootIntoUpdate(ctx);
+    return;
+  }
+  if (progress.status != OTAStatus::Downloading) return;
+
+  bool has_progress = false;
+  {
+    WatchdogScope ota_wdt(WatchdogSection::OTA, progress.next_index);
+    has_progress = serviceOTA();
+  }
+  if (has_progress) {
+    ctx.ota.stalls = 0;
+    ctx.ota.last_progress_ms = millis();
+    if (progress.status == OTAStatus::Ready) {
+      ctx.ota.ready_ms = millis();
+      publishOTAStatus(ctx);
+      return;
+    }
+    if (progress.status == OTAStatus::Failed) {
+      handleOTAFailure(ctx);
+      return;
+    }
+    if (progress.next_index - ctx.ota.last_status_index >= k_ota_progress_every) publishOTAStatus(ctx);
+    if (progress.next_index >= ctx.ota.window_end || ctx.ota.is_chunk_dropped) {
+      ctx.ota.is_request_due = true;
+      ctx.ota.is_chunk_dropped = false;
+    }
+  }
+  if (isOTAChunkPending()) return; // Long patch copies span several loops
+
+  if (!ctx.client.connected()) {
+    ctx.ota.is_request_due = true; // Resume as soon as the broker is back
+    return;
+  }
+  if (ctx.ota.is_request_due && !ctx.ota.is_backing_off) {
+    requestOTAWindow(ctx);
+    return;
+  }
+  checkOTAStall(ctx);
+}
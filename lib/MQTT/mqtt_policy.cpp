@@ -0,0 +1,61 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+constexpr unsigned long k_policy_retry_ms = 60000; // Pause after a failed send instead of retrying every loop
+} // namespace
+
+bool isTopicMatchingPolicy(const MQTTContext& ctx, const char* topic) {
+  return isMQTTTopic(ctx, topic, MQTTTopic::Policy);
+}
+
+// Retained binary rule set (see ACU_policy.h); an empty payload removes all rules.
+void handlePolicyMessage(MQTTContext& ctx, char* topic, byte* payload, unsigned int length) {
+  if (!loadPolicyRuleSet(payload, length)) {
+    logError(k_log_tag, "Invalid policy rule set (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "policy_invalid_rule_set", topic, nullptr, 0, 0);
+    return;
+  }
+  logInfo(k_log_tag, "Policy rules active: %u", getPolicyRuleCount());
+}
+
+void setupACUPolicy() {
+  beginPolicy();
+}
+
+void handlePolicy(MQTTContext& ctx) {
+  if (ctx.is_policy_paused) {
+    if (millis() - ctx.policy_failed_ms < k_policy_retry_ms) return;
+    ctx.is_policy_paused = false;
+  }
+
+  PolicyAction action;
+  if (!pollPolicy(millis(), action)) return;
+  if (action.unit >= ctx.unit_count) return; // Unit removed from DEFINED_UNITS
+
+  ACUUnit& unit = ctx.units[action.unit];
+  CommandAck ack;
+  snprintf(ack.id, sizeof(ack.id), "policy/%u/%s", action.rule, policyRuleTypeName(action.type));
+  if (ctx.unit_count > 1) ack.unit = unit.id;
+  ack.rx_ts_ms = getEpochMs();
+
+  if (!transmitUnitState(ctx, unit, action.state, ack)) {
+    logError(k_log_tag, "Policy IR send failed (rule=%u unit=%s).", action.rule, unit.id);
+    ctx.commands_failed_ir++;
+    ack.status = "ir_failed";
+    publishCommandAck(ctx, ack);
+    ctx.policy_failed_ms = millis();
+    ctx.is_policy_paused = true;
+    return;
+  }
+
+  logInfo(k_log_tag, "Policy rule %u (%s) applied (unit=%s)", action.rule, policyRuleTypeName(action.type), unit.id);
+  ctx.commands_policy++;
+  ack.status = "executed";
+  publishCommandAck(ctx, ack);
+  recordUnitState(ctx, unit, action.state, false);
+}
@@ -5,173 +5,364 @@
 #endif
 
 namespace {
-void formatIpAddress(char* buf, size_t len, const IPAddress& ip) {
-  if (buf == nullptr || len == 0) return;
-  snprintf(buf, len, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+// Timestamps are kept as epoch seconds; only the local date string form is formatted
+void setTimestampField(JsonDocument& doc, const char* key, uint32_t epoch_s) {
+#if NTP_TIMESTAMP_EPOCH
+  doc[key] = epoch_s;
+#else
+  char timestamp[k_timestamp_len];
+  formatTimestamp(timestamp, sizeof(timestamp), epoch_s);
+  doc[key] = timestamp;
+#endif
 }
 } // namespace
 
-void publishACUState(const JsonObject& state_obj) {
-  if (!g_mqtt_client.connected()) {
+void publishACUState(MQTTContext& ctx, const ACUUnit& unit, const JsonObject& state_obj) {
+  if (!ctx.client.connected()) {
     logDebug(k_log_tag, "Not connected, skipping publish.");
     return;
   }
 
-  g_state_pub_doc.clear();
+  JsonLease lease(ctx.json_arena, k_json_budget_state);
+  JsonDocument& doc = lease.doc();
 
   // Map internal keys to schema
-  if (state_obj.containsKey("temperature")) g_state_pub_doc["temperature"] = state_obj["temperature"];
-  if (state_obj.containsKey("fan_speed"))    g_state_pub_doc["fan_speed"]    = state_obj["fan_speed"];
-  if (state_obj.containsKey("mode"))        g_state_pub_doc["mode"]        = state_obj["mode"];
-  if (state_obj.containsKey("louver"))      g_state_pub_doc["louver"]      = state_obj["louver"];
-  if (state_obj.containsKey("power"))        g_state_pub_doc["power"]        = state_obj["power"];
-
-  if (g_last_change_timestamp[0] != '\0') {
-    g_state_pub_doc["last_change_ts"] = g_last_change_timestamp;
+  if (state_obj.containsKey("temperature")) doc["temperature"] = state_obj["temperature"];
+  if (state_obj.containsKey("fan_speed"))    doc["fan_speed"]    = state_obj["fan_speed"];
+  if (state_obj.containsKey("mode"))        doc["mode"]        = state_obj["mode"];
+  if (state_obj.containsKey("louver"))      doc["louver"]      = state_obj["louver"];
+  if (state_obj.containsKey("power"))        doc["power"]        = state_obj["power"];
+
+  if (unit.last_change_ts != 0) {
+    setTimestampField(doc, "last_change_ts", unit.last_change_ts);
   }
 
-  size_t len = serializeJson(g_state_pub_doc, g_state_pub_output, sizeof(g_state_pub_output));
+  size_t len = 0;
+  {
+    ProfileScope ser_scope(ProfileStage::Serialize);
+    len = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  }
 
-  bool is_ok = g_mqtt_client.publish(g_mqtt_topic_pub_state, (const uint8_t*)g_state_pub_output, len, true); // retain = true
+  const char* topic = buildMQTTTopic(ctx, MQTTTopic::State, unit.id);
+  bool is_ok = false;
+  {
+    ProfileScope pub_scope(ProfileStage::Publish);
+    is_ok = ctx.client.publish(topic, (const uint8_t*)ctx.json_output, len, true, g_mqtt_qos); // Retained, held until acknowledged
+  }
   if (is_ok) {
-    logInfo(k_log_tag, "Published state: %s", g_state_pub_output);
+    logInfo(k_log_tag, "Published state: %s", ctx.json_output);
   } else {
-    logError(k_log_tag, "Publish failed (topic=%s len=%u).", g_mqtt_topic_pub_state, (unsigned int)len);
-    publishMQTTErrorContext("publish_failed", g_mqtt_topic_pub_state, (const uint8_t*)g_state_pub_output, len, 0);
-    g_mqtt_publish_failures++;
+    logError(k_log_tag, "Publish failed (topic=%s len=%u).", topic, (unsigned int)len);
+    publishMQTTErrorContext(ctx, "publish_failed", topic, (const uint8_t*)ctx.json_output, len, 0); // Copies the topic first
+    ctx.publish_failures++;
   }
 }
 
-void publishIdentity() {
-  if (!g_mqtt_client.connected()) return;
-  g_identity_doc.clear();
+void publishIdentity(MQTTContext& ctx) {
+  ctx.has_identity_pending = true;
+  if (!ctx.client.connected()) return; // Sent by publishOnReconnect()
 
-  char client_id_str[32];
-  snprintf(client_id_str, sizeof(client_id_str), "ESP8266Client-%06X", ESP.getChipId());
+  JsonLease lease(ctx.json_arena, k_json_budget_identity);
+  JsonDocument& doc = lease.doc();
 
-  g_identity_doc["device_id"] = client_id_str;
-  g_identity_doc["mac_address"] = WiFi.macAddress();
-  g_identity_doc["acu_remote_model"] = ACU_REMOTE_MODEL; 
-  // g_identity_doc["room_type"] = DEFINED_ROOM_TYPE;
-  g_identity_doc["room_type_id"] = DEFINED_ROOM_TYPE_ID;
-  g_identity_doc["department"] = DEFINED_DEPARTMENT;
+  char client_id_str[32];
+  formatDeviceId(client_id_str, sizeof(client_id_str), ESP.getChipId());
+
+  doc["device_id"] = client_id_str;
+  uint8_t mac[6];
+  char mac_str[18];
+  WiFi.macAddress(mac);
+  formatMacAddress(mac_str, sizeof(mac_str), mac);
+  doc["mac_address"] = mac_str;
+  doc["acu_remote_model"] = getACUAdapterModel(0);
+  if (ctx.unit_count > 1) {
+    JsonArray units = doc.createNestedArray("units");
+    for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+      JsonObject unit = units.createNestedObject();
+      unit["unit"] = ctx.units[i].id;
+      unit["model"] = getACUAdapterModel(i);
+      unit["pin"] = getACUAdapterPin(i);
+    }
+  }
+  // doc["room_type"] = DEFINED_ROOM_TYPE;
+  doc["room_type_id"] = DEFINED_ROOM_TYPE_ID;
+  doc["department"] = DEFINED_DEPARTMENT;
 
-  if (g_identity_doc.overflowed()) logWarn(k_log_tag, "Identity JSON doc overflow");
-  size_t n = serializeJson(g_identity_doc, g_identity_output, sizeof(g_identity_output));
-  if (n >= sizeof(g_identity_output)) logWarn(k_log_tag, "Identity output truncated");
+  if (doc.overflowed()) logWarn(k_log_tag, "Identity JSON doc overflow");
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  if (n >= sizeof(ctx.json_output)) logWarn(k_log_tag, "Identity output truncated");
 
-  g_mqtt_client.publish(g_mqtt_topic_pub_identity, g_identity_output, true); // Retain identity info
-  g_identity_doc.clear();
+  // The ring can still be full of the session's resends right after the CONNACK
+  if (ctx.client.publish(buildMQTTTopic(ctx, MQTTTopic::Identity), ctx.json_output, true)) { // Retain identity info
+    ctx.has_identity_pending = false;
+  } else {
+    logWarn(k_log_tag, "Identity publish failed, retrying");
+    ctx.publish_failures++;
+  }
 }
 
-void publishDeployment() {
-  if (!g_mqtt_client.connected()) return;
-  g_deployment_doc.clear();
-
-  char ip_buffer[16];
-  formatIpAddress(ip_buffer, sizeof(ip_buffer), WiFi.localIP());
-  g_deployment_doc["ip_address"] = ip_buffer;
-  g_deployment_doc["version_hash"] = GIT_HASH;
-  g_deployment_doc["build_timestamp"] = BUILD_TIMESTAMP;
-
-  // g_deployment_doc["build_host"] = BUILD_HOST;
-  // g_deployment_doc["build_user"] = BUILD_USER;
-  // g_deployment_doc["deployment_date"] = DEFINED_DEPLOYMENT_DATE;
-  // g_deployment_doc["version_hash"] = DEFINED_VERSION_HASH;
+void publishDeployment(MQTTContext& ctx) {
+  ctx.has_deployment_pending = true;
+  if (!ctx.client.connected()) return; // Sent by publishOnReconnect()
 
-  g_deployment_doc["reset_reason"] = ESP.getResetReason();
+  JsonLease lease(ctx.json_arena, k_json_budget_deployment);
+  JsonDocument& doc = lease.doc();
 
-  if (g_deployment_doc.overflowed()) logWarn(k_log_tag, "Deployment JSON doc overflow");
-  size_t n = serializeJson(g_deployment_doc, g_deployment_output, sizeof(g_deployment_output));
-  if (n >= sizeof(g_deployment_output)) logWarn(k_log_tag, "Deployment output truncated");
-  g_mqtt_client.publish(g_mqtt_topic_pub_deployment, g_deployment_output, true); // Retain deployment info
+  char ip_buffer[16];
+  formatIpAddress(ip_buffer, sizeof(ip_buffer), (uint32_t)WiFi.localIP());
+  doc["ip_address"] = ip_buffer;
+  doc["version_hash"] = GIT_HASH;
+  doc["build_timestamp"] = BUILD_TIMESTAMP;
+
+  // doc["build_host"] = BUILD_HOST;
+  // doc["build_user"] = BUILD_USER;
+  // doc["deployment_date"] = DEFINED_DEPLOYMENT_DATE;
+  // doc["version_hash"] = DEFINED_VERSION_HASH;
+
+  doc["reset_reason"] = getResetReasonName();
+
+  // Where the previous boot was when the WDT (or an exception) reset it
+  const WatchdogCrash* crash = getWatchdogCrash();
+  if (crash != nullptr) {
+    JsonObject crash_obj = doc.createNestedObject("crash");
+    crash_obj["section"] = watchdogSectionName(crash->section);
+    crash_obj["detail"] = crash->detail;
+    crash_obj["entered_ms"] = crash->entered_ms;
+    crash_obj["fed_ms"] = crash->fed_ms;
+    crash_obj["loops"] = crash->loops;
+  }
 
-  g_deployment_doc.clear();
+  if (doc.overflowed()) logWarn(k_log_tag, "Deployment JSON doc overflow");
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  if (n >= sizeof(ctx.json_output)) logWarn(k_log_tag, "Deployment output truncated");
+  if (ctx.client.publish(buildMQTTTopic(ctx, MQTTTopic::Deployment), ctx.json_output, true)) { // Retain deployment info
+    ctx.has_deployment_pending = false;
+  } else {
+    logWarn(k_log_tag, "Deployment publish failed, retrying");
+    ctx.publish_failures++;
+  }
 }
 
-void publishDiagnostics() {
-  if (!g_mqtt_client.connected()) return;
+void publishDiagnostics(MQTTContext& ctx) {
+  if (!ctx.client.connected()) return;
+
+  JsonLease lease(ctx.json_arena, k_json_budget_diag);
+  JsonDocument& doc = lease.doc();
 
   // Check lock
-  if (g_is_mqtt_publish_in_progress) return;
-  g_is_mqtt_publish_in_progress = true;
+  if (ctx.is_publish_in_progress) return;
+  ctx.is_publish_in_progress = true;
 
-  g_diag_doc["status"] = "online";
+  doc["status"] = "online";
 
-  char time_buffer[30];
-  getTimestamp(time_buffer, sizeof(time_buffer));
-  g_diag_doc["last_seen_ts"] = time_buffer;
+  setTimestampField(doc, "last_seen_ts", getEpochSeconds());
 
-  if (g_last_command_timestamp[0] != '\0') {
-    g_diag_doc["last_cmd_ts"] = g_last_command_timestamp;
+  if (ctx.last_command_timestamp != 0) {
+    setTimestampField(doc, "last_cmd_ts", ctx.last_command_timestamp);
   }
 
-  g_diag_doc["wifi_rssi"] = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : -127;
-  g_diag_doc["free_heap"] = ESP.getFreeHeap();
+  doc["wifi_rssi"] = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : -127;
+  doc["free_heap"] = ESP.getFreeHeap();
+  doc["log_level"] = logLevelName(getLogLevel());
+  if (isLogStreaming(ctx)) doc["log_stream"] = true;
 
   // Serialize into pre-allocated global buffer
-  size_t n = serializeJson(g_diag_doc, g_diag_output, sizeof(g_diag_output));
+  size_t n = 0;
+  {
+    ProfileScope ser_scope(ProfileStage::Serialize);
+    n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  }
 
-  bool is_ok = g_mqtt_client.publish(
-    g_mqtt_topic_pub_diagnostics,
-    (const uint8_t*)g_diag_output,
-    n,
-    false // no retain
-  );
+  bool is_ok = false;
+  {
+    ProfileScope pub_scope(ProfileStage::Publish);
+    is_ok = ctx.client.publish(
+      buildMQTTTopic(ctx, MQTTTopic::Diagnostics),
+      (const uint8_t*)ctx.json_output,
+      n,
+      false // no retain
+    );
+  }
 
-  if (!is_ok) g_mqtt_publish_failures++;
+  if (!is_ok) ctx.publish_failures++;
 
-  g_is_mqtt_publish_in_progress = false;
-  g_diag_doc.clear();
+  ctx.is_publish_in_progress = false;
 }
 
-void publishMetrics() {
-  if (!g_mqtt_client.connected()) return;
+void publishMetrics(MQTTContext& ctx) {
+  if (!ctx.client.connected()) return;
+
+  JsonLease lease(ctx.json_arena, k_json_budget_metrics);
+  JsonDocument& doc = lease.doc();
+
+  if (ctx.is_publish_in_progress) return;
+  ctx.is_publish_in_progress = true;
+
+  doc["uptime_s"] = ctx.uptime_s_cached;
+  doc["wifi_uptime_s"] = ctx.wifi_uptime_s_cached;
+  doc["mqtt_uptime_s"] = ctx.mqtt_uptime_s_cached;
+
+  doc["wifi_conn_total_s"] = ctx.wifi_connected_total_s;
+  doc["mqtt_conn_total_s"] = ctx.mqtt_connected_total_s;
+
+  doc["wifi_disc"] = ctx.wifi_disconnect_counter;
+  doc["mqtt_disc"] = ctx.mqtt_disconnect_counter;
+  doc["cmd_rx"] = ctx.commands_received_counter;
+  doc["cmd_exec"] = ctx.commands_executed_counter;
+  doc["cmd_fail_parse"] = ctx.commands_failed_parse;
+  doc["cmd_fail_struct"] = ctx.commands_failed_struct;
+  doc["cmd_fail_ir"] = ctx.commands_failed_ir;
+  doc["cmd_dup"] = ctx.commands_duplicate;
+  doc["cmd_sched"] = ctx.commands_scheduled;
+  doc["cmd_policy"] = ctx.commands_policy;
+  doc["cmd_latency_ms"] = ctx.last_cmd_latency_ms;
+  doc["cmd_latency_avg_ms"] = ctx.avg_cmd_latency_ms;
+
+  doc["free_heap"] = ctx.free_heap_cached;
+  doc["heap_frag"] = ctx.heap_frag_cached;
+  doc["mqtt_pub_fail"] = ctx.publish_failures;
+  doc["log_drop"] = getLogDropCount();
+  doc["log_stream_drop"] = ctx.log_stream_dropped;
+  doc["warm_boots"] = ctx.warm_boots;
+  if (ctx.wifi_roam_stats != nullptr) {
+    doc["wifi_roam_scans"] = ctx.wifi_roam_stats->roam_scans;
+    doc["wifi_roams"] = ctx.wifi_roam_stats->roams;
+    doc["wifi_roam_fail"] = ctx.wifi_roam_stats->roam_failures;
+    if (ctx.wifi_roam_stats->roams > 0) {
+      doc["wifi_roam_pre_rssi"] = ctx.wifi_roam_stats->last_pre_rssi;
+      doc["wifi_roam_post_rssi"] = ctx.wifi_roam_stats->last_post_rssi;
+    }
+  }
+  const NTPStats& ntp = getNTPStats();
+  doc["ntp_syncs"] = ntp.sync_count;
+  doc["ntp_drift_ppm"] = ntp.drift_ppm;
+  doc["ntp_offset_ms"] = ntp.last_offset_ms;
+  doc["json_peak"] = ctx.json_arena.peak();
+  doc["json_fail"] = ctx.json_arena.failures();
+#if MQTT_USE_TLS
+  doc["tls_hs_ms"] = ctx.tls_handshake_ms;
+  doc["tls_hs_max_ms"] = ctx.tls_handshake_max_ms;
+  doc["tls_heap"] = ctx.tls_heap_bytes;
+  doc["tls_frag"] = ctx.tls_fragment_len;
+#endif
+
+  // Latency histograms: [p50, p95, p99, max] in microseconds per stage.
+  // The window covers everything since the last metrics publish that went out.
+  JsonObject prof = doc.createNestedObject("prof_us");
+  for (uint8_t i = 0; i < static_cast<uint8_t>(ProfileStage::Count); ++i) {
+    ProfileStage stage = static_cast<ProfileStage>(i);
+    ProfileSummary summary;
+    if (!profilerSummarize(stage, summary)) continue;
+    JsonArray values = prof.createNestedArray(profileStageName(stage));
+    values.add(summary.p50_us);
+    values.add(summary.p95_us);
+    values.add(summary.p99_us);
+    values.add(summary.max_us);
+  }
 
-  if (g_is_mqtt_publish_in_progress) return;
-  g_is_mqtt_publish_in_progress = true;
+  // Longest stretch without a WDT feed per subsystem, in ms, over the same window
+  const WatchdogStats& wdt = getWatchdogStats();
+  JsonObject wdt_obj = doc.createNestedObject("wdt_ms");
+  for (uint8_t i = 0; i < static_cast<uint8_t>(WatchdogSection::Count); ++i) {
+    wdt_obj[watchdogSectionName(static_cast<WatchdogSection>(i))] = wdt.max_unfed_ms[i];
+  }
+  doc["loop_over"] = wdt.loop_overruns;
+  doc["loop_defer"] = wdt.loops_deferred;
 
-  g_metrics_doc["uptime_s"] = g_uptime_s_cached;
-  g_metrics_doc["wifi_uptime_s"] = g_wifi_uptime_s_cached;
-  g_metrics_doc["mqtt_uptime_s"] = g_mqtt_uptime_s_cached;
+  // Serialize into pre-allocated global buffer
+  size_t n = 0;
+  {
+    ProfileScope ser_scope(ProfileStage::Serialize);
+    n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  }
+  if (n >= sizeof(ctx.json_output) - 1) logWarn(k_log_tag, "Metrics output truncated");
+
+  bool is_ok = false;
+  {
+    ProfileScope pub_scope(ProfileStage::Publish);
+    is_ok = ctx.client.publish(
+      buildMQTTTopic(ctx, MQTTTopic::Metrics),
+      (const uint8_t*)ctx.json_output,
+      n,
+      false
+    );
+  }
 
-  g_metrics_doc["wifi_conn_total_s"] = g_wifi_connected_total_s;
-  g_metrics_doc["mqtt_conn_total_s"] = g_mqtt_connected_total_s;
+  if (is_ok) {
+    // Start the next window only once this one has left; a failed publish keeps accumulating
+    profilerReset();
+    resetWatchdogStats();
+  } else {
+    ctx.publish_failures++;
+  }
+
+  ctx.is_publish_in_progress = false;
 
-  g_metrics_doc["wifi_disc"] = g_wifi_disconnect_counter;
-  g_metrics_doc["mqtt_disc"] = g_mqtt_disconnect_counter;
-  g_metrics_doc["cmd_rx"] = g_commands_received_counter;
-  g_metrics_doc["cmd_exec"] = g_commands_executed_counter;
-  g_metrics_doc["cmd_fail_parse"] = g_commands_failed_parse;
-  g_metrics_doc["cmd_fail_struct"] = g_commands_failed_struct;
-  g_metrics_doc["cmd_fail_ir"] = g_commands_failed_ir;
-  g_metrics_doc["cmd_latency_ms"] = g_last_cmd_latency_ms;
-  g_metrics_doc["cmd_latency_avg_ms"] = g_avg_cmd_latency_ms;
+  // Optional debug
+  logDebug(k_log_tag, "Metrics published: %s", ctx.json_output);
+}
 
-  g_metrics_doc["free_heap"] = g_free_heap_cached;
-  g_metrics_doc["heap_frag"] = g_heap_frag_cached;
-  g_metrics_doc["mqtt_pub_fail"] = g_mqtt_publish_failures;
+void publishCommandAck(MQTTContext& ctx, const CommandAck& ack) {
+  if (!ctx.client.connected()) return;
 
-  // Serialize into pre-allocated global buffer
-  size_t n = serializeJson(g_metrics_doc, g_metrics_output, sizeof(g_metrics_output));
+  JsonLease lease(ctx.json_arena, k_json_budget_ack);
+  JsonDocument& doc = lease.doc();
 
-  bool is_ok = g_mqtt_client.publish(
-    g_mqtt_topic_pub_metrics,
-    (const uint8_t*)g_metrics_output,
+  doc["status"] = ack.status;
+  if (ack.unit != nullptr) doc["unit"] = ack.unit;
+  if (ack.id[0] != '\0') doc["id"] = ack.id;
+  if (ack.has_seq) {
+    doc["sender"] = ack.sender;
+    doc["seq"] = ack.seq;
+  }
+  if (ack.sent_ts_ms != 0) doc["sent_ts"] = ack.sent_ts_ms;
+  doc["rx_ts"] = ack.rx_ts_ms;
+  if (ack.ir_start_ts_ms != 0) doc["ir_start_ts"] = ack.ir_start_ts_ms;
+  if (ack.ir_done_ts_ms != 0) doc["ir_done_ts"] = ack.ir_done_ts_ms;
+
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  const char* topic = buildMQTTTopic(ctx, MQTTTopic::Ack);
+  bool is_ok = ctx.client.publish(
+    topic,
+    (const uint8_t*)ctx.json_output,
     n,
-    false
+    false,
+    g_mqtt_qos // Held until acknowledged, resent after a reconnect
   );
 
-  if (!is_ok) g_mqtt_publish_failures++;
+  if (!is_ok) {
+    logError(k_log_tag, "Publish failed (topic=%s len=%u).", topic, (unsigned int)n);
+    ctx.publish_failures++;
+  }
+}
+
+void publishLearnResult(MQTTContext& ctx, const IRLearnResult& result) {
+  if (!ctx.client.connected()) return;
 
-  g_is_mqtt_publish_in_progress = false;
-  g_metrics_doc.clear();
+  JsonLease lease(ctx.json_arena, k_json_budget_ack);
+  JsonDocument& doc = lease.doc();
 
-  // Optional debug
-  logDebug(k_log_tag, "Metrics published: %s", g_metrics_output);
+  const char* status_str = "learn_failed";
+  if (result.status == IRLearnStatus::Stored) status_str = "learned";
+  else if (result.status == IRLearnStatus::Timeout) status_str = "learn_timeout";
+
+  doc["status"] = status_str;
+  doc["learn"] = result.name;
+  if (result.status == IRLearnStatus::Stored) {
+    doc["entries"] = result.entry_count;
+    doc["symbols"] = result.symbol_count;
+    doc["bytes"] = result.stored_bytes;
+  }
+
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  const char* topic = buildMQTTTopic(ctx, MQTTTopic::Ack);
+  if (!ctx.client.publish(topic, (const uint8_t*)ctx.json_output, n, false)) {
+    logError(k_log_tag, "Publish failed (topic=%s len=%u).", topic, (unsigned int)n);
+    ctx.publish_failures++;
+  }
 }
 
-void publishMQTTErrorContext(const char* error, const char* topic, const uint8_t* payload, unsigned int length, int rc) {
+void publishMQTTErrorContext(MQTTContext& ctx, const char* error, const char* topic, const uint8_t* payload, unsigned int length, int rc) {
   const char* error_str = (error != nullptr) ? error : "unknown_error";
   const char* topic_str = (topic != nullptr) ? topic : "n/a";
   logError(k_log_tag, "Error context: %s (topic=%s rc=%d len=%u)", error_str, topic_str, rc, length);
@@ -195,98 +386,110 @@ void publishMQTTErrorContext(const char* error, const char* topic, const uint8_t
     snapshot.has_payload = true;
   }
 
-  if (!g_mqtt_client.connected()) {
-    queueErrorContextSnapshot(snapshot);
+  if (!ctx.client.connected()) {
+    queueErrorContextSnapshot(ctx, snapshot);
     return;
   }
 
-  if (!publishErrorContextSnapshot(snapshot)) {
-    g_mqtt_publish_failures++;
-    queueErrorContextSnapshot(snapshot);
+  if (!publishErrorContextSnapshot(ctx, snapshot)) {
+    ctx.publish_failures++;
+    queueErrorContextSnapshot(ctx, snapshot);
   }
 #else
+  (void)ctx;
   (void)payload;
   (void)length;
   (void)rc;
 #endif
 }
 
-bool publishErrorContextSnapshot(const ErrorContextSnapshot& snapshot) {
+bool publishErrorContextSnapshot(MQTTContext& ctx, const ErrorContextSnapshot& snapshot) {
   if (!snapshot.has_data) return true;
 
-  g_error_ctx_doc.clear();
+  JsonLease lease(ctx.json_arena, k_json_budget_error);
+  JsonDocument& doc = lease.doc();
 
-  char time_buffer[30];
-  getTimestamp(time_buffer, sizeof(time_buffer));
-  g_error_ctx_doc["ts"] = time_buffer;
-  g_error_ctx_doc["error"] = snapshot.error;
-  g_error_ctx_doc["broker"] = g_mqtt_server;
-  g_error_ctx_doc["port"] = g_mqtt_port;
+  setTimestampField(doc, "ts", getEpochSeconds());
+  doc["error"] = snapshot.error;
+  doc["broker"] = ctx.config.server;
+  doc["port"] = ctx.config.port;
   if (snapshot.topic[0] != '\0' && strcmp(snapshot.topic, "n/a") != 0) {
-    g_error_ctx_doc["topic"] = snapshot.topic;
+    doc["topic"] = snapshot.topic;
   }
-  if (snapshot.rc != 0) g_error_ctx_doc["rc"] = snapshot.rc;
+  if (snapshot.rc != 0) doc["rc"] = snapshot.rc;
 
   if (snapshot.has_payload) {
-    g_error_ctx_doc["payload_len"] = snapshot.payload_len;
-    g_error_ctx_doc["payload"] = snapshot.payload;
+    doc["payload_len"] = snapshot.payload_len;
+    doc["payload"] = snapshot.payload;
   }
 
-  size_t n = serializeJson(g_error_ctx_doc, g_error_ctx_output, sizeof(g_error_ctx_output));
-  bool is_ok = g_mqtt_client.publish(
-    g_mqtt_topic_pub_error,
-    (const uint8_t*)g_error_ctx_output,
+  size_t n = serializeJson(doc, ctx.json_output, sizeof(ctx.json_output));
+  bool is_ok = ctx.client.publish(
+    buildMQTTTopic(ctx, MQTTTopic::Error),
+    (const uint8_t*)ctx.json_output,
     n,
     false
   );
 
-  g_error_ctx_doc.clear();
   return is_ok;
 }
 
-void queueErrorContextSnapshot(const ErrorContextSnapshot& snapshot) {
-  g_last_error_ctx = snapshot;
-  g_has_queued_error_ctx = true;
+void queueErrorContextSnapshot(MQTTContext& ctx, const ErrorContextSnapshot& snapshot) {
+  ctx.last_error_ctx = snapshot;
+  ctx.has_queued_error_ctx = true;
 }
 
-void publishQueuedErrorContextIfAny() {
+void publishQueuedErrorContextIfAny(MQTTContext& ctx) {
 #if LOG_LEVEL >= LOG_MQTT_ERROR_CONTEXT_MIN_LOG_LEVEL
-  if (!g_has_queued_error_ctx) return;
-  if (!g_mqtt_client.connected()) return;
-  if (publishErrorContextSnapshot(g_last_error_ctx)) {
-    g_has_queued_error_ctx = false;
+  if (!ctx.has_queued_error_ctx) return;
+  if (!ctx.client.connected()) return;
+  if (publishErrorContextSnapshot(ctx, ctx.last_error_ctx)) {
+    ctx.has_queued_error_ctx = false;
   } else {
-    g_mqtt_publish_failures++;
+    ctx.publish_failures++;
   }
+#else
+  (void)ctx;
 #endif
 }
 
-void publishOnReconnect() {
-  publishIdentity();
-  publishDeployment();
-  publishDiagnostics();
-  publishMetrics();
-  publishQueuedErrorContextIfAny();
-
-  // Republish last known state if available
-  if (g_last_received_command_json[0] != '\0') {
-    StaticJsonDocument<384> doc;
-    deserializeJson(doc, g_last_received_command_json);
-    publishACUState(doc.as<JsonObject>());
+void publishOnReconnect(MQTTContext& ctx) {
+  publishIdentity(ctx);
+  publishDeployment(ctx);
+  publishDiagnostics(ctx);
+  publishMetrics(ctx);
+  publishQueuedErrorContextIfAny(ctx);
+
+  // Republish last known state of each unit if available
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    const ACUUnit& unit = ctx.units[i];
+    if (!unit.has_state) continue;
+    const ACUState& state = unit.last_state;
+    ctx.acu_remote.setState(state.fan_speed, state.temperature, state.mode, state.louver, state.power);
+    JsonLease lease(ctx.json_arena, k_json_budget_state);
+    ctx.acu_remote.toJSON(lease.doc().to<JsonObject>());
+    publishACUState(ctx, unit, lease.doc().as<JsonObject>());
   }
 }
 
 // Publish heartbeat on connection
-void publishHeartbeat() {
-  if (!g_mqtt_client.connected()) return;
+void publishHeartbeat(MQTTContext& ctx) {
+  if (!ctx.client.connected()) return;
+
+  bool has_retained_pending = ctx.has_identity_pending || ctx.has_deployment_pending;
+  if (has_retained_pending && millis() - ctx.last_retained_retry_ms >= k_retained_retry_interval_ms) {
+    ctx.last_retained_retry_ms = millis();
+    if (ctx.has_identity_pending) publishIdentity(ctx);
+    if (ctx.has_deployment_pending) publishDeployment(ctx);
+  }
 
-  if (millis() - g_last_heartbeat_time >= g_heartbeat_interval_ms) {
-    publishDiagnostics();
-    g_last_heartbeat_time = millis();
+  if (millis() - ctx.last_heartbeat_time >= g_heartbeat_interval_ms) {
+    publishDiagnostics(ctx);
+    ctx.last_heartbeat_time = millis();
   }
 
-  if (millis() - g_last_metrics_time >= g_metrics_interval_ms) {
-    publishMetrics();
-    g_last_metrics_time = millis();
+  if (millis() - ctx.last_metrics_time >= g_metrics_interval_ms) {
+    publishMetrics(ctx);
+    ctx.last_metrics_time = millis();
   }
 }
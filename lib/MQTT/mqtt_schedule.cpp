@@ -0,0 +1,89 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+bool isTopicMatchingSchedule(const MQTTContext& ctx, const char* topic, uint8_t& slot) {
+  const char* suffix = matchMQTTTopicUnit(ctx, topic, MQTTTopic::Schedule, ctx.unit_id);
+  if (suffix == nullptr) return false;
+  const char* filter = getMQTTTopicSuffix(MQTTTopic::Schedule);
+  size_t filter_len = strlen_P(filter) - 1; // Drop the trailing '+'
+  if (strncmp_P(suffix, filter, filter_len) != 0) return false;
+
+  const char* slot_str = suffix + filter_len;
+  if (*slot_str == '\0') return false;
+  unsigned int value = 0;
+  for (const char* p = slot_str; *p != '\0'; ++p) {
+    if (*p < '0' || *p > '9') return false;
+    value = value * 10 + (*p - '0');
+    if (value >= k_schedule_entries_max) return false;
+  }
+  slot = (uint8_t)value;
+  return true;
+}
+
+// Retained per-slot entries; an empty payload deletes the slot.
+// format: {"cron":"0 21 * * 1-5","unit":"ACU2","state":{...}} ("unit" defaults to the primary unit)
+void handleScheduleMessage(MQTTContext& ctx, char* topic, uint8_t slot, byte* payload, unsigned int length) {
+  if (length == 0) {
+    clearScheduleEntry(slot);
+    logInfo(k_log_tag, "Schedule slot %u cleared", slot);
+    return;
+  }
+
+  JsonLease lease(ctx.json_arena, k_json_budget_rx);
+  JsonDocument& doc = lease.doc();
+  DeserializationError err = deserializeJson(doc, payload, length);
+  if (err) {
+    logError(k_log_tag, "Schedule parse failed: %s (topic=%s len=%u)", err.c_str(), topic, length);
+    publishMQTTErrorContext(ctx, "schedule_parse_failed", topic, payload, length, 0);
+    return;
+  }
+
+  ACUUnit* unit = doc["unit"].is<const char*>() ? findUnitById(ctx, doc["unit"]) : &ctx.units[0];
+  if (unit == nullptr) {
+    publishMQTTErrorContext(ctx, "schedule_unknown_unit", topic, payload, length, 0);
+    return;
+  }
+
+  if (!ctx.acu_remote.fromJSON(doc["state"].as<JsonObjectConst>()) ||
+      !setScheduleEntry(slot, doc["cron"].as<const char*>(), getUnitIndex(ctx, *unit), ctx.acu_remote.getState())) {
+    logError(k_log_tag, "Invalid schedule entry (topic=%s len=%u).", topic, length);
+    publishMQTTErrorContext(ctx, "schedule_invalid_entry", topic, payload, length, 0);
+    return;
+  }
+  logInfo(k_log_tag, "Schedule slot %u set (unit=%s)", slot, unit->id);
+}
+
+void setupACUSchedule() {
+  beginSchedule();
+  setScheduleJitter(ESP.getChipId() % (k_schedule_jitter_max_s + 1));
+}
+
+void handleSchedule(MQTTContext& ctx) {
+  ScheduleHit hit;
+  if (!pollSchedule(time(nullptr), hit)) return;
+  if (hit.unit >= ctx.unit_count) return; // Unit removed from DEFINED_UNITS
+
+  ACUUnit& unit = ctx.units[hit.unit];
+  CommandAck ack;
+  snprintf(ack.id, sizeof(ack.id), "schedule/%u", hit.slot);
+  if (ctx.unit_count > 1) ack.unit = unit.id;
+  ack.rx_ts_ms = getEpochMs();
+
+  if (!transmitUnitState(ctx, unit, hit.state, ack)) {
+    logError(k_log_tag, "Scheduled IR send failed (slot=%u unit=%s).", hit.slot, unit.id);
+    ctx.commands_failed_ir++;
+    ack.status = "ir_failed";
+    publishCommandAck(ctx, ack);
+    return;
+  }
+
+  logInfo(k_log_tag, "Schedule slot %u executed (unit=%s)", hit.slot, unit.id);
+  ctx.commands_scheduled++;
+  ack.status = "executed";
+  publishCommandAck(ctx, ack);
+  recordUnitState(ctx, unit, hit.state);
+}
@@ -4,25 +4,34 @@
 #error "ESP8266 only"
 #endif
 
-ErrorContextSnapshot g_last_error_ctx;
-bool g_has_queued_error_ctx = false;
-
 // =================================================================================
 // 1. CONFIGURATION & CONSTANTS
 // =================================================================================
 
-const char* g_mqtt_server = MQTT_SERVER;
-extern const int g_mqtt_port = MQTT_PORT;
-
-const char* g_mqtt_user = MQTT_USER;
-const char* g_mqtt_pass = MQTT_PASS;
-
-// format: "floor_id/room_id/unit_id"
-const char* g_state_root = STATE_PATH;
-const char* g_control_root = CONTROL_PATH;
-const char* g_floor_id = DEFINED_FLOOR;
-const char* g_room_id = DEFINED_ROOM;
-const char* g_unit_id = DEFINED_UNIT;
+namespace {
+const char k_mqtt_tls_fingerprint[] PROGMEM = MQTT_TLS_FINGERPRINT;
+static_assert(sizeof(k_mqtt_tls_fingerprint) <= k_tls_fingerprint_len, "MQTT_TLS_FINGERPRINT must be a SHA-1 fingerprint");
+
+const MQTTConfig k_mqtt_config = {
+  MQTT_SERVER,
+  MQTT_PORT,
+  MQTT_USER,
+  MQTT_PASS,
+  k_mqtt_tls_fingerprint,
+  STATE_PATH,
+  CONTROL_PATH,
+  DEFINED_FLOOR,
+  DEFINED_ROOM,
+  DEFINED_UNIT,
+  DEFINED_UNITS,
+};
+
+// Indexed by MQTTTopic
+const char k_topic_suffixes[static_cast<uint8_t>(MQTTTopic::Count)][k_topic_suffix_max] PROGMEM = {
+  "", "/config", "/schedule/+", "/policy", "/ota", "/ota/chunk",
+  "/state", "/identity", "/deployment", "/diagnostics", "/metrics", "/error", "/ack", "/log", "/ota", "/ota/request",
+};
+} // namespace
 
 extern const char g_lwt_message_json[] PROGMEM = "{\"status\":\"offline\"}";
 
@@ -30,108 +39,58 @@ extern const char g_lwt_message_json[] PROGMEM = "{\"status\":\"offline\"}";
 // 2. GLOBAL OBJECTS & STATE
 // =================================================================================
 
-WiFiClient g_esp_client;
-PubSubClient g_mqtt_client(g_esp_client);
-ACURemote g_acu_remote(ACURemoteSignature::MitsubishiHeavy64);
-#if USE_ACU_ADAPTER
-  // IR adapter selection (switch to MHI152Adapter if needed)
-  MHI88Adapter g_acu_adapter;
-#endif
+MQTTContext g_mqtt_context(k_mqtt_config);
+
+MQTTContext::MQTTContext(const MQTTConfig& mqtt_config)
+    : config(mqtt_config),
+      unit_id(mqtt_config.unit_id),
+      acu_remote(ACURemoteSignature::MitsubishiHeavy64),
+      client(wifi_client) {}
+
+void setWiFiRoamStats(MQTTContext& ctx, const CustomWiFi::WiFiRoamStats* stats) {
+  ctx.wifi_roam_stats = stats;
+}
+
+void setupMQTTTopics(MQTTContext& ctx) {
+  const MQTTConfig& cfg = ctx.config;
+  int state_len = snprintf(ctx.state_prefix, sizeof(ctx.state_prefix), "%s/%s/%s/", cfg.state_root, cfg.floor_id, cfg.room_id);
+  int control_len = snprintf(ctx.control_prefix, sizeof(ctx.control_prefix), "%s/%s/%s/", cfg.control_root, cfg.floor_id, cfg.room_id);
+  if (state_len >= (int)sizeof(ctx.state_prefix) || control_len >= (int)sizeof(ctx.control_prefix)) {
+    logError(k_log_tag, "Topic prefix truncated (max %u chars)", (unsigned int)(k_topic_prefix_max - 1));
+  }
+  ctx.state_prefix_len = (uint8_t)strlen(ctx.state_prefix);
+  ctx.control_prefix_len = (uint8_t)strlen(ctx.control_prefix);
+}
+
+const char* getMQTTTopicSuffix(MQTTTopic topic) {
+  return k_topic_suffixes[static_cast<uint8_t>(topic)];
+}
+
+const char* buildMQTTTopic(MQTTContext& ctx, MQTTTopic topic, const char* unit_id) {
+  bool is_control = topic < MQTTTopic::State;
+  size_t len = is_control ? ctx.control_prefix_len : ctx.state_prefix_len;
+  memcpy(ctx.topic, is_control ? ctx.control_prefix : ctx.state_prefix, len);
+
+  size_t unit_len = strnlen(unit_id, k_unit_id_max - 1);
+  memcpy(ctx.topic + len, unit_id, unit_len);
+  len += unit_len;
+
+  strncpy_P(ctx.topic + len, getMQTTTopicSuffix(topic), k_topic_suffix_max);
+  return ctx.topic;
+}
+
+const char* matchMQTTTopicUnit(const MQTTContext& ctx, const char* topic, MQTTTopic kind, const char* unit_id) {
+  bool is_control = kind < MQTTTopic::State;
+  size_t len = is_control ? ctx.control_prefix_len : ctx.state_prefix_len;
+  if (strncmp(topic, is_control ? ctx.control_prefix : ctx.state_prefix, len) != 0) return nullptr;
+  topic += len;
+
+  size_t unit_len = strlen(unit_id);
+  if (strncmp(topic, unit_id, unit_len) != 0) return nullptr;
+  return topic + unit_len;
+}
 
-// MQTT topic buffers
-char g_mqtt_topic_sub_unit[64];
-char g_mqtt_topic_pub_state[80];
-char g_mqtt_topic_pub_identity[80];
-char g_mqtt_topic_pub_deployment[80];
-char g_mqtt_topic_pub_diagnostics[80];
-char g_mqtt_topic_pub_metrics[80];
-char g_mqtt_topic_pub_error[80];
-
-// MQTT Queue for ISR-safe decoupling
-MQTTQueueItem g_mqtt_queue[g_mqtt_queue_size];
-volatile uint8_t g_mqtt_queue_head = 0;
-volatile uint8_t g_mqtt_queue_tail = 0;
-
-// Heartbeat & Timestamp buffers
-char g_last_received_command_json[256] = {0};
-char g_last_command_timestamp[30] = {0};
-char g_last_change_timestamp[30] = {0};
-unsigned long g_last_heartbeat_time = 0;
-unsigned long g_last_metrics_time = 0;
-
-bool g_is_mqtt_publish_in_progress = false; // lock to prevent overlapping publishes
-
-uint32_t g_last_state_crc = 0;
-bool g_is_state_initialized = false;
-char g_lwt_message[k_lwt_message_len];
-
-ACUState g_last_state = {0};
-
-StaticJsonDocument<256> g_deployment_doc;
-StaticJsonDocument<160> g_diag_doc;
-StaticJsonDocument<384> g_metrics_doc;
-StaticJsonDocument<192> g_state_pub_doc;
-
-// Pre-allocated serialization buffers
-char g_deployment_output[224];
-char g_diag_output[192];
-char g_metrics_output[384];
-char g_state_pub_output[192];
-
-// Static buffers for stack reduction
-StaticJsonDocument<512> g_identity_doc;
-char g_identity_output[384];
-StaticJsonDocument<384> g_error_ctx_doc;
-char g_error_ctx_output[384];
-StaticJsonDocument<256> g_rx_doc;
-StaticJsonDocument<128> g_temp_state_doc;
-
-// Connection Stats
-unsigned long g_wifi_connect_ts = 0;
-unsigned long g_mqtt_connect_ts = 0;
-unsigned int g_wifi_disconnect_counter = 0;
-unsigned int g_mqtt_disconnect_counter = 0;
-unsigned int g_commands_received_counter = 0;
-unsigned int g_commands_executed_counter = 0;
-bool g_is_prev_wifi_status = false;
-bool g_is_prev_mqtt_status = false;
-
-// Cumulative availability counters
-uint32_t g_wifi_connected_total_s = 0;
-uint32_t g_mqtt_connected_total_s = 0;
-unsigned long g_last_wifi_update_ms = 0;
-unsigned long g_last_mqtt_update_ms = 0;
-
-// Command latency metrics
-uint32_t g_last_cmd_latency_ms = 0;
-uint32_t g_avg_cmd_latency_ms = 0;
-
-// Command failure counters
-uint32_t g_commands_failed_parse = 0;
-uint32_t g_commands_failed_struct = 0;
-uint32_t g_commands_failed_ir = 0;
-
-// MQTT publish failures
-uint32_t g_mqtt_publish_failures = 0;
-
-// Uptime wrap tracking (millis() wraps ~49.7 days)
-uint32_t g_uptime_wraps = 0;
-unsigned long g_last_uptime_ms = 0;
-
-// Cached metric snapshots (computed in updateConnectionStats)
-uint64_t g_uptime_s_cached = 0;
-uint32_t g_wifi_uptime_s_cached = 0;
-uint32_t g_mqtt_uptime_s_cached = 0;
-int32_t g_wifi_rssi_cached = -127;
-uint32_t g_free_heap_cached = 0;
-uint32_t g_heap_frag_cached = 0;
-
-void setupMQTTTopics() {
-  snprintf(g_mqtt_topic_sub_unit,        sizeof(g_mqtt_topic_sub_unit),        "%s/%s/%s/%s",            g_control_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_state,       sizeof(g_mqtt_topic_pub_state),       "%s/%s/%s/%s/state",      g_state_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_identity,    sizeof(g_mqtt_topic_pub_identity),    "%s/%s/%s/%s/identity",   g_state_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_deployment,  sizeof(g_mqtt_topic_pub_deployment),  "%s/%s/%s/%s/deployment", g_state_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_diagnostics, sizeof(g_mqtt_topic_pub_diagnostics), "%s/%s/%s/%s/diagnostics", g_state_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_metrics,     sizeof(g_mqtt_topic_pub_metrics),     "%s/%s/%s/%s/metrics",    g_state_root, g_floor_id, g_room_id, g_unit_id);
-  snprintf(g_mqtt_topic_pub_error,       sizeof(g_mqtt_topic_pub_error),       "%s/%s/%s/%s/error",      g_state_root, g_floor_id, g_room_id, g_unit_id);
+bool isMQTTTopic(const MQTTContext& ctx, const char* topic, MQTTTopic kind, const char* unit_id) {
+  const char* suffix = matchMQTTTopicUnit(ctx, topic, kind, unit_id);
+  return suffix != nullptr && strcmp_P(suffix, getMQTTTopicSuffix(kind)) == 0;
 }
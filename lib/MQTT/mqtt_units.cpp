@@ -0,0 +1,160 @@
+#include "mqtt_internal.h"
+#include "MQTT.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+
+constexpr size_t k_units_spec_max = 96;
+
+bool addUnit(MQTTContext& ctx, const char* id, const char* model, uint16_t pin) {
+  if (ctx.unit_count >= k_max_acu_units) {
+    logWarn(k_log_tag, "Unit limit reached (%u), ignoring %s", k_max_acu_units, id);
+    return false;
+  }
+  if (findUnitById(ctx, id) != nullptr) {
+    logWarn(k_log_tag, "Duplicate unit id ignored: %s", id);
+    return false;
+  }
+
+  uint8_t slot = ctx.unit_count;
+  if (selectACUAdapter(slot, model, pin) == nullptr) {
+    // A typo in DEFINED_UNITS must not silently drive the unit with another protocol.
+    // Queued until the first connection, since this runs before MQTT is up.
+    publishMQTTErrorContext(ctx, "unit_unknown_model", nullptr, (const uint8_t*)model, strlen(model), 0);
+    if (selectACUAdapter(slot, ACU_REMOTE_MODEL, pin) == nullptr) {
+      selectACUAdapter(slot, "MHI_64", pin); // ACU_REMOTE_MODEL itself is unknown: raw modulator
+    }
+  }
+
+  ACUUnit& unit = ctx.units[slot];
+  unit = ACUUnit();
+  strncpy(unit.id, id, sizeof(unit.id) - 1);
+  ctx.unit_count++;
+  return true;
+}
+
+// Emitters share the room, so frames are sent back to back with a quiet gap
+// between them. Everything runs on the loop task, which makes this the only
+// point where two transmissions could end up adjacent.
+void waitForIRFrameGap(MQTTContext& ctx) {
+  if (!ctx.has_ir_sent) return;
+  while (millis() - ctx.last_ir_done_ms < k_ir_frame_gap_ms) {
+    watchdogFeed();
+  }
+}
+
+void markIRFrameDone(MQTTContext& ctx) {
+  ctx.last_ir_done_ms = millis();
+  ctx.has_ir_sent = true;
+}
+
+} // namespace
+
+// format: config.units (DEFINED_UNITS) "ACU1:MHI_88:4,ACU2:MHI_152:5"
+void setupACUUnits(MQTTContext& ctx) {
+  ctx.unit_count = 0;
+
+  char spec[k_units_spec_max];
+  strncpy(spec, ctx.config.units, sizeof(spec) - 1);
+  spec[sizeof(spec) - 1] = '\0';
+
+  char* unit_save = nullptr;
+  for (char* token = strtok_r(spec, ",", &unit_save); token != nullptr; token = strtok_r(nullptr, ",", &unit_save)) {
+    char* field_save = nullptr;
+    const char* id = strtok_r(token, ":", &field_save);
+    const char* model = strtok_r(nullptr, ":", &field_save);
+    const char* pin_str = strtok_r(nullptr, ":", &field_save);
+    if (id == nullptr || strlen(id) >= k_unit_id_max) {
+      logWarn(k_log_tag, "Invalid unit spec skipped");
+      continue;
+    }
+    addUnit(ctx, id, model ? model : ACU_REMOTE_MODEL, pin_str ? (uint16_t)atoi(pin_str) : ir_led_pin);
+  }
+
+  if (ctx.unit_count == 0) {
+    addUnit(ctx, ctx.config.unit_id, ACU_REMOTE_MODEL, ir_led_pin);
+  }
+  ctx.unit_id = ctx.units[0].id;
+
+  logInfo(k_log_tag, "Units configured: %u (primary=%s)", ctx.unit_count, ctx.unit_id);
+}
+
+ACUUnit* findUnitByTopic(MQTTContext& ctx, const char* topic) {
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    if (isMQTTTopic(ctx, topic, MQTTTopic::Command, ctx.units[i].id)) return &ctx.units[i];
+  }
+  return nullptr;
+}
+
+ACUUnit* findUnitById(MQTTContext& ctx, const char* id) {
+  if (id == nullptr) return nullptr;
+  for (uint8_t i = 0; i < ctx.unit_count; ++i) {
+    if (strcmp(id, ctx.units[i].id) == 0) return &ctx.units[i];
+  }
+  return nullptr;
+}
+
+uint8_t getUnitIndex(const MQTTContext& ctx, const ACUUnit& unit) {
+  return (uint8_t)(&unit - ctx.units);
+}
+
+bool transmitUnitState(MQTTContext& ctx, ACUUnit& unit, const ACUState& state, CommandAck& ack) {
+  IACUAdapter* adapter = getACUAdapter(getUnitIndex(ctx, unit));
+  if (adapter == nullptr) return false;
+
+  waitForIRFrameGap(ctx);
+
+  bool is_ir_sent = false;
+  ack.ir_start_ts_ms = getEpochMs();
+  {
+    ProfileScope ir_scope(ProfileStage::IRSend);
+    WatchdogScope ir_wdt(WatchdogSection::IRSend, getUnitIndex(ctx, unit));
+    is_ir_sent = adapter->send(state);
+  }
+  ack.ir_done_ts_ms = getEpochMs();
+  markIRFrameDone(ctx);
+  return is_ir_sent;
+}
+
+bool transmitUnitRaw(MQTTContext& ctx, ACUUnit& unit, const uint16_t* durations, uint16_t len, uint16_t khz, CommandAck& ack) {
+  IACUAdapter* adapter = getACUAdapter(getUnitIndex(ctx, unit));
+  if (adapter == nullptr) return false;
+
+  waitForIRFrameGap(ctx);
+
+  bool is_ir_sent = false;
+  ack.ir_start_ts_ms = getEpochMs();
+  {
+    ProfileScope ir_scope(ProfileStage::IRSend);
+    WatchdogScope ir_wdt(WatchdogSection::IRSend, getUnitIndex(ctx, unit));
+    is_ir_sent = adapter->sendRaw(durations, len, khz);
+  }
+  ack.ir_done_ts_ms = getEpochMs();
+  markIRFrameDone(ctx);
+  return is_ir_sent;
+}
+
+// Learning holds the receiver open and a command may still be mid-flight right after a send
+bool isIRIdle(const MQTTContext& ctx) {
+  if (getIRLearnResult().status == IRLearnStatus::Capturing) return false;
+  return !ctx.has_ir_sent || millis() - ctx.last_ir_done_ms >= k_ir_idle_quiet_ms;
+}
+
+// Feed the policy engine and publish the unit's retained state if it differs from the last one sent
+void recordUnitState(MQTTContext& ctx, ACUUnit& unit, const ACUState& state, bool is_command) {
+  notePolicyState(getUnitIndex(ctx, unit), state, millis(), is_command);
+  if (unit.has_state && memcmp(&state, &unit.last_state, sizeof(ACUState)) == 0) return;
+
+  unit.last_change_ts = getEpochSeconds();
+  unit.last_state = state;
+  unit.has_state = true;
+  saveMQTTCheckpoint(ctx);
+
+  ctx.acu_remote.setState(state.fan_speed, state.temperature, state.mode, state.louver, state.power);
+  JsonLease lease(ctx.json_arena, k_json_budget_state);
+  ctx.acu_remote.toJSON(lease.doc().to<JsonObject>());
+  publishACUState(ctx, unit, lease.doc().as<JsonObject>());
+}
@@ -0,0 +1,427 @@
+#include "MQTT_client.h"
+#include "logging.h"
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+
+constexpr const char* k_log_tag = "MQTT";
+
+// Packet types (high nibble of the fixed header)
+constexpr uint8_t k_type_connect = 0x10;
+constexpr uint8_t k_type_connack = 0x20;
+constexpr uint8_t k_type_publish = 0x30;
+constexpr uint8_t k_type_puback = 0x40;
+constexpr uint8_t k_type_subscribe = 0x82; // Reserved flags 0b0010
+constexpr uint8_t k_type_suback = 0x90;
+constexpr uint8_t k_type_pingreq = 0xC0;
+constexpr uint8_t k_type_pingresp = 0xD0;
+constexpr uint8_t k_type_disconnect = 0xE0;
+constexpr uint8_t k_publish_dup = 0x08;
+
+constexpr size_t k_fixed_header_max = 5;  // Type byte + 4-byte remaining length
+constexpr size_t k_control_reserve = 8;   // Kept free by publish/subscribe for PUBACK and PINGREQ
+
+size_t encodeLength(uint8_t* out, uint32_t len) {
+  size_t n = 0;
+  do {
+    uint8_t digit = len % 128;
+    len /= 128;
+    if (len > 0) digit |= 0x80;
+    out[n++] = digit;
+  } while (len > 0);
+  return n;
+}
+
+size_t minSize(size_t a, size_t b) {
+  return (a < b) ? a : b;
+}
+
+} // namespace
+
+void AsyncMQTTClient::setServer(const char* host, uint16_t port) {
+  host_ = host;
+  port_ = port;
+}
+
+bool AsyncMQTTClient::connect(const char* client_id, const char* user, const char* pass,
+                              const char* will_topic, uint8_t will_qos, bool is_will_retained, const char* will_message,
+                              bool is_clean_session) {
+  if (phase_ != Phase::Idle) close(MQTTClientState::Disconnected);
+
+  // The core waits this long for the handshake; sync writes would wait for every ACK
+  client_.setTimeout(connect_timeout_ms_);
+  client_.setNoDelay(true);
+  client_.setSync(false);
+  if (host_ == nullptr || !client_.connect(host_, port_)) {
+    state_ = MQTTClientState::ConnectFailed;
+    return false;
+  }
+
+  bool has_user = (user != nullptr && user[0] != '\0');
+  bool has_pass = has_user && pass != nullptr && pass[0] != '\0';
+  bool has_will = (will_topic != nullptr && will_topic[0] != '\0' && will_message != nullptr);
+
+  uint8_t flags = is_clean_session ? 0x02 : 0x00;
+  uint32_t len = 10 + 2 + strlen(client_id);
+  if (has_will) {
+    flags |= 0x04 | ((will_qos & 0x03) << 3) | (is_will_retained ? 0x20 : 0x00);
+    len += 2 + strlen(will_topic) + 2 + strlen(will_message);
+  }
+  if (has_user) {
+    flags |= 0x80;
+    len += 2 + strlen(user);
+  }
+  if (has_pass) {
+    flags |= 0x40;
+    len += 2 + strlen(pass);
+  }
+
+  uint8_t header[k_fixed_header_max];
+  header[0] = k_type_connect;
+  size_t header_len = 1 + encodeLength(header + 1, len);
+  if (header_len + len > txFree()) {
+    client_.stop();
+    state_ = MQTTClientState::ConnectFailed;
+    return false;
+  }
+
+  const uint8_t variable_header[10] = {0, 4, 'M', 'Q', 'T', 'T', 4, flags,
+                                       (uint8_t)(keepalive_s_ >> 8), (uint8_t)keepalive_s_};
+  txPut(header, header_len);
+  txPut(variable_header, sizeof(variable_header));
+  txPutString(client_id);
+  if (has_will) {
+    txPutString(will_topic);
+    txPutString(will_message);
+  }
+  if (has_user) txPutString(user);
+  if (has_pass) txPutString(pass);
+
+  unsigned long now_ms = millis();
+  phase_ = Phase::WaitConnack;
+  is_clean_session_ = is_clean_session;
+  is_ping_outstanding_ = false;
+  connect_started_ms_ = now_ms;
+  last_rx_ms_ = now_ms;
+  rx_stage_ = RxStage::Header;
+  flushTx();
+  return true;
+}
+
+void AsyncMQTTClient::disconnect() {
+  if (phase_ == Phase::Idle) return;
+  queueControl(k_type_disconnect, nullptr, 0);
+  flushTx();
+  close(MQTTClientState::Disconnected);
+}
+
+bool AsyncMQTTClient::connected() {
+  if (phase_ != Phase::Connected) return false;
+  if (!client_.connected()) {
+    close(MQTTClientState::ConnectionLost);
+    return false;
+  }
+  return true;
+}
+
+bool AsyncMQTTClient::loop() {
+  if (phase_ == Phase::Idle) return false;
+  if (!client_.connected()) {
+    close(MQTTClientState::ConnectionLost);
+    return false;
+  }
+
+  flushTx();
+  readPackets();
+  if (phase_ == Phase::Idle) return false;
+
+  unsigned long now_ms = millis();
+  if (phase_ == Phase::WaitConnack) {
+    if (now_ms - connect_started_ms_ >= k_mqtt_connack_timeout_ms) close(MQTTClientState::ConnectionTimeout);
+    return false;
+  }
+
+  unsigned long keepalive_ms = (unsigned long)keepalive_s_ * 1000UL;
+  if (keepalive_ms > 0) {
+    bool is_tx_stalled = (tx_len_ > 0 && now_ms - last_tx_ms_ >= keepalive_ms);
+    bool is_ping_lost = (is_ping_outstanding_ && now_ms - ping_sent_ms_ >= keepalive_ms);
+    if (is_tx_stalled || is_ping_lost) {
+      close(MQTTClientState::ConnectionTimeout);
+      return false;
+    }
+    bool is_idle = (now_ms - last_tx_ms_ >= keepalive_ms || now_ms - last_rx_ms_ >= keepalive_ms);
+    if (is_idle && !is_ping_outstanding_ && queueControl(k_type_pingreq, nullptr, 0)) {
+      is_ping_outstanding_ = true;
+      ping_sent_ms_ = now_ms;
+      flushTx();
+    }
+  }
+  return true;
+}
+
+bool AsyncMQTTClient::publish(const char* topic, const uint8_t* payload, size_t length, bool is_retained, uint8_t qos) {
+  if (phase_ != Phase::Connected) return false;
+  qos = (qos > 0) ? 1 : 0;
+
+  size_t topic_len = strlen(topic);
+  uint32_t remaining = 2 + topic_len + (qos ? 2 : 0) + length;
+  uint8_t header[k_fixed_header_max + 2];
+  header[0] = k_type_publish | (uint8_t)(qos << 1) | (is_retained ? 0x01 : 0x00);
+  size_t header_len = 1 + encodeLength(header + 1, remaining);
+  header[header_len++] = (uint8_t)(topic_len >> 8);
+  header[header_len++] = (uint8_t)topic_len;
+  size_t total = header_len + topic_len + (qos ? 2 : 0) + length;
+  if (total + k_control_reserve > txFree()) return false;
+
+  if (qos == 0) {
+    txPut(header, header_len);
+    txPut((const uint8_t*)topic, topic_len);
+    txPut(payload, length);
+    flushTx();
+    return true;
+  }
+
+  // QoS 1: encode into the inflight store and queue that copy
+  if (inflight_count_ >= k_mqtt_inflight_max || inflight_used_ + total > sizeof(inflight_buf_)) return false;
+  uint16_t packet_id = nextPacketId();
+  uint8_t* out = inflight_buf_ + inflight_used_;
+  memcpy(out, header, header_len);
+  out += header_len;
+  memcpy(out, topic, topic_len);
+  out += topic_len;
+  *out++ = (uint8_t)(packet_id >> 8);
+  *out++ = (uint8_t)packet_id;
+  memcpy(out, payload, length);
+
+  inflight_[inflight_count_++] = {packet_id, inflight_used_, (uint16_t)total};
+  txPut(inflight_buf_ + inflight_used_, total);
+  inflight_used_ += total;
+  flushTx();
+  return true;
+}
+
+bool AsyncMQTTClient::publish(const char* topic, const char* payload, bool is_retained, uint8_t qos) {
+  return publish(topic, (const uint8_t*)payload, (payload != nullptr) ? strlen(payload) : 0, is_retained, qos);
+}
+
+bool AsyncMQTTClient::subscribe(const char* topic_filter, uint8_t qos) {
+  if (phase_ == Phase::Idle) return false;
+
+  size_t filter_len = strlen(topic_filter);
+  uint32_t remaining = 2 + 2 + filter_len + 1;
+  uint8_t header[k_fixed_header_max];
+  header[0] = k_type_subscribe;
+  size_t header_len = 1 + encodeLength(header + 1, remaining);
+  if (header_len + remaining + k_control_reserve > txFree()) return false;
+
+  uint16_t packet_id = nextPacketId();
+  const uint8_t id_bytes[2] = {(uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+  const uint8_t qos_byte = (qos > 0) ? 1 : 0;
+  txPut(header, header_len);
+  txPut(id_bytes, sizeof(id_bytes));
+  txPutString(topic_filter);
+  txPut(&qos_byte, 1);
+  flushTx();
+  return true;
+}
+
+void AsyncMQTTClient::txPut(const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  if (tx_len_ == 0) last_tx_ms_ = millis(); // The stall timer starts when the buffer stops being empty
+  size_t head = (tx_tail_ + tx_len_) % k_mqtt_tx_buffer_size;
+  size_t first = minSize(len, k_mqtt_tx_buffer_size - head);
+  memcpy(tx_buf_ + head, data, first);
+  memcpy(tx_buf_, data + first, len - first);
+  tx_len_ += len;
+}
+
+void AsyncMQTTClient::txPutString(const char* str) {
+  size_t len = strlen(str);
+  const uint8_t len_bytes[2] = {(uint8_t)(len >> 8), (uint8_t)len};
+  txPut(len_bytes, sizeof(len_bytes));
+  txPut((const uint8_t*)str, len);
+}
+
+// PUBACK, PINGREQ, DISCONNECT: short packets that may use the reserve
+bool AsyncMQTTClient::queueControl(uint8_t header, const uint8_t* body, size_t body_len) {
+  if (2 + body_len > txFree()) return false;
+  const uint8_t fixed[2] = {header, (uint8_t)body_len};
+  txPut(fixed, sizeof(fixed));
+  if (body_len > 0) txPut(body, body_len);
+  return true;
+}
+
+// Hands lwIP what it can take without waiting
+void AsyncMQTTClient::flushTx() {
+  while (tx_len_ > 0) {
+    int room = client_.availableForWrite();
+    if (room <= 0) return;
+    size_t chunk = minSize(minSize(tx_len_, k_mqtt_tx_buffer_size - tx_tail_), (size_t)room);
+    size_t written = client_.write(tx_buf_ + tx_tail_, chunk);
+    if (written == 0) return;
+    tx_tail_ = (tx_tail_ + written) % k_mqtt_tx_buffer_size;
+    tx_len_ -= written;
+    last_tx_ms_ = millis();
+  }
+}
+
+// Consumes what has arrived; stops after one PUBLISH
+void AsyncMQTTClient::readPackets() {
+  int available = client_.available();
+  while (available > 0 && phase_ != Phase::Idle) {
+    if (rx_stage_ == RxStage::Header || rx_stage_ == RxStage::Length) {
+      int value = client_.read();
+      if (value < 0) return;
+      available--;
+      if (rx_stage_ == RxStage::Header) {
+        rx_header_ = (uint8_t)value;
+        rx_length_ = 0;
+        rx_length_shift_ = 0;
+        rx_received_ = 0;
+        rx_stage_ = RxStage::Length;
+        continue;
+      }
+      rx_length_ |= (uint32_t)(value & 0x7F) << rx_length_shift_;
+      rx_length_shift_ += 7;
+      if (value & 0x80) {
+        if (rx_length_shift_ >= 28) close(MQTTClientState::ConnectionLost); // Malformed length
+        continue;
+      }
+      rx_stage_ = RxStage::Body;
+    } else {
+      // Bytes past the buffer are read and dropped (handlePublish reports it)
+      uint8_t discard[32];
+      size_t want = minSize(rx_length_ - rx_received_, (size_t)available);
+      bool is_buffered = rx_received_ < sizeof(rx_buf_);
+      uint8_t* dest = is_buffered ? rx_buf_ + rx_received_ : discard;
+      size_t n = minSize(want, is_buffered ? sizeof(rx_buf_) - rx_received_ : sizeof(discard));
+      int got = client_.read(dest, n);
+      if (got <= 0) return;
+      rx_received_ += (uint32_t)got;
+      available -= got;
+    }
+
+    if (rx_received_ == rx_length_) {
+      rx_stage_ = RxStage::Header;
+      bool is_publish = (rx_header_ & 0xF0) == k_type_publish;
+      handlePacket();
+      if (is_publish) return;
+    }
+  }
+}
+
+void AsyncMQTTClient::handlePacket() {
+  last_rx_ms_ = millis();
+  is_ping_outstanding_ = false; // Anything from the broker shows the connection is alive
+
+  switch (rx_header_ & 0xF0) {
+    case k_type_connack: {
+      if (phase_ != Phase::WaitConnack || rx_length_ < 2) break;
+      uint8_t rc = rx_buf_[1];
+      if (rc != 0) {
+        close((rc <= 5) ? (MQTTClientState)rc : MQTTClientState::Unavailable);
+        break;
+      }
+      phase_ = Phase::Connected;
+      state_ = MQTTClientState::Connected;
+      resendInflight();
+      break;
+    }
+    case k_type_publish:
+      handlePublish();
+      break;
+    case k_type_puback:
+      if (rx_length_ >= 2) releaseInflight((uint16_t)((rx_buf_[0] << 8) | rx_buf_[1]));
+      break;
+    case k_type_suback:
+      if (rx_length_ >= 3 && rx_buf_[2] == 0x80) {
+        logWarn(k_log_tag, "Subscription %u refused by the broker.", (unsigned int)((rx_buf_[0] << 8) | rx_buf_[1]));
+      }
+      break;
+    case k_type_pingresp:
+    default:
+      break;
+  }
+}
+
+void AsyncMQTTClient::handlePublish() {
+  uint8_t qos = (rx_header_ >> 1) & 0x03;
+  size_t buffered = minSize(rx_length_, sizeof(rx_buf_));
+  if (buffered < 2) return;
+  size_t topic_len = (size_t)((rx_buf_[0] << 8) | rx_buf_[1]);
+  size_t payload_offset = 2 + topic_len + (qos > 0 ? 2 : 0);
+  if (payload_offset > buffered) return; // Malformed, or a topic longer than the buffer
+
+  uint16_t packet_id = 0;
+  if (qos > 0) packet_id = (uint16_t)((rx_buf_[2 + topic_len] << 8) | rx_buf_[3 + topic_len]);
+
+  if (rx_length_ > sizeof(rx_buf_)) {
+    logWarn(k_log_tag, "Dropped a %u-byte message (buffer %u).", (unsigned int)rx_length_, (unsigned int)sizeof(rx_buf_));
+  } else if (callback_) {
+    // Shift the topic over its length field to null-terminate it in place
+    memmove(rx_buf_, rx_buf_ + 2, topic_len);
+    rx_buf_[topic_len] = '\0';
+    callback_((char*)rx_buf_, rx_buf_ + payload_offset, (unsigned int)(rx_length_ - payload_offset));
+  }
+
+  // Acknowledged even when dropped, or the broker would redeliver it forever
+  if (qos == 1) {
+    const uint8_t id_bytes[2] = {(uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+    queueControl(k_type_puback, id_bytes, sizeof(id_bytes));
+    flushTx();
+  }
+}
+
+void AsyncMQTTClient::releaseInflight(uint16_t packet_id) {
+  for (uint8_t i = 0; i < inflight_count_; ++i) {
+    if (inflight_[i].packet_id != packet_id) continue;
+    uint16_t offset = inflight_[i].offset;
+    uint16_t length = inflight_[i].length;
+    memmove(inflight_buf_ + offset, inflight_buf_ + offset + length, inflight_used_ - offset - length);
+    inflight_used_ -= length;
+    for (uint8_t j = i; j + 1 < inflight_count_; ++j) {
+      inflight_[j] = inflight_[j + 1];
+      inflight_[j].offset -= length;
+    }
+    inflight_count_--;
+    return;
+  }
+}
+
+// After CONNACK: a persistent session expects the unacknowledged publishes again
+void AsyncMQTTClient::resendInflight() {
+  if (is_clean_session_) {
+    inflight_count_ = 0;
+    inflight_used_ = 0;
+    return;
+  }
+  if (inflight_count_ == 0) return;
+
+  logInfo(k_log_tag, "Resending %u unacknowledged publish(es).", (unsigned int)inflight_count_);
+  for (uint8_t i = 0; i < inflight_count_; ++i) {
+    const InflightPublish& item = inflight_[i];
+    if (item.length > txFree()) break; // The rest goes after the next reconnect
+    inflight_buf_[item.offset] |= k_publish_dup;
+    txPut(inflight_buf_ + item.offset, item.length);
+  }
+  flushTx();
+}
+
+uint16_t AsyncMQTTClient::nextPacketId() {
+  if (++next_packet_id_ == 0) next_packet_id_ = 1; // 0 is not a valid packet identifier
+  return next_packet_id_;
+}
+
+// Queued packets are dropped; unacknowledged QoS 1 publishes are kept
+void AsyncMQTTClient::close(MQTTClientState state) {
+  client_.stop();
+  phase_ = Phase::Idle;
+  state_ = state;
+  is_ping_outstanding_ = false;
+  tx_tail_ = 0;
+  tx_len_ = 0;
+  rx_stage_ = RxStage::Header;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+/*
+ * MQTT_client.h
+ *
+ * Non-blocking MQTT 3.1.1 client on top of the ESP8266 core's WiFiClient.
+ * Nothing in here waits for the broker, so a slow CONNACK/PUBACK or a
+ * half-open socket cannot stall loop() (and the IR path with it):
+ *
+ * - connect() opens the TCP connection and queues CONNECT; the CONNACK is
+ *   picked up by a later loop(). Only the TCP handshake itself still blocks,
+ *   bounded by setConnectTimeout() (k_mqtt_tcp_connect_timeout_ms), because
+ *   the core has no non-blocking connect (a host name also costs a DNS lookup
+ *   there). Over BearSSL::WiFiClientSecure that includes the TLS handshake.
+ * - Outgoing packets are queued whole in a ring buffer, which every publish
+ *   and loop() drain into lwIP without ever writing more than
+ *   availableForWrite(). A packet that does not fit is refused, not waited for.
+ * - Incoming bytes are parsed as they arrive, across loop() calls; at most one
+ *   PUBLISH is delivered per loop().
+ * - QoS 1 publishes are kept until their PUBACK and sent again (DUP) after a
+ *   reconnect, as MQTT 3.1.1 requires for a persistent session.
+ * - A connection whose PINGREQ goes unanswered, or whose send buffer does not
+ *   drain, for one keepalive period is dropped.
+ *
+ * state() uses PubSubClient's return codes, so logged and published rc values
+ * keep their meaning.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <functional>
+
+constexpr size_t k_mqtt_rx_buffer_size = 768;        // Largest incoming packet (OTA chunks)
+constexpr size_t k_mqtt_tx_buffer_size = 1536;       // Packets not yet taken by lwIP
+constexpr size_t k_mqtt_inflight_buffer_size = 1024; // Unacknowledged QoS 1 publishes
+constexpr uint8_t k_mqtt_inflight_max = 4;
+constexpr unsigned long k_mqtt_tcp_connect_timeout_ms = 2000;
+constexpr unsigned long k_mqtt_connack_timeout_ms = 10000;
+
+enum class MQTTClientState : int8_t {
+  ConnectionTimeout = -4, // No CONNACK/PINGRESP in time, or the send buffer stopped draining
+  ConnectionLost = -3,
+  ConnectFailed = -2,     // TCP connect failed
+  Disconnected = -1,
+  Connected = 0,
+  BadProtocol = 1,        // 1-5: CONNACK return codes
+  BadClientId = 2,
+  Unavailable = 3,
+  BadCredentials = 4,
+  Unauthorized = 5
+};
+
+class AsyncMQTTClient {
+public:
+  // topic is null-terminated; both are valid only during the call
+  using MessageCallback = std::function<void(char* topic, uint8_t* payload, unsigned int length)>;
+
+  explicit AsyncMQTTClient(WiFiClient& client) : client_(client) {}
+
+  AsyncMQTTClient(const AsyncMQTTClient&) = delete;
+  AsyncMQTTClient& operator=(const AsyncMQTTClient&) = delete;
+
+  void setServer(const char* host, uint16_t port);
+  void setCallback(MessageCallback callback) { callback_ = callback; }
+  void setKeepAlive(uint16_t keepalive_s) { keepalive_s_ = keepalive_s; }
+  void setConnectTimeout(unsigned long timeout_ms) { connect_timeout_ms_ = timeout_ms; }
+
+  /**
+   * @brief Open the TCP connection and queue CONNECT.
+   *
+   * The session is up once connected() turns true after a later loop();
+   * isConnecting() is true until then. Empty user/pass are left out.
+   *
+   * @return false if the TCP connection could not be opened (see state()).
+   */
+  bool connect(const char* client_id, const char* user, const char* pass,
+               const char* will_topic, uint8_t will_qos, bool is_will_retained, const char* will_message,
+               bool is_clean_session);
+
+  /**
+   * @brief Queue DISCONNECT, hand over what lwIP takes right now, and close.
+   */
+  void disconnect();
+
+  /**
+   * @brief Drain the send buffer, parse what has arrived and keep the session alive.
+   *
+   * Delivers at most one message to the callback.
+   *
+   * @return connected()
+   */
+  bool loop();
+
+  /**
+   * @brief Queue a PUBLISH; its bytes leave from this call and later loop() calls.
+   *
+   * @param qos 0 or 1. QoS 1 publishes are kept until the broker acknowledges them.
+   * @return false if not connected, or if the packet does not fit the send
+   *         buffer (or, for QoS 1, the inflight store) right now.
+   */
+  bool publish(const char* topic, const uint8_t* payload, size_t length, bool is_retained, uint8_t qos = 0);
+  bool publish(const char* topic, const char* payload, bool is_retained, uint8_t qos = 0);
+
+  /**
+   * @brief Queue a SUBSCRIBE. Must follow connect() (it may precede the CONNACK).
+   */
+  bool subscribe(const char* topic_filter, uint8_t qos);
+
+  bool connected();
+  bool isConnecting() const { return phase_ == Phase::WaitConnack; }
+  int state() const { return static_cast<int>(state_); }
+  uint8_t inflightCount() const { return inflight_count_; }
+
+private:
+  enum class Phase : uint8_t {
+    Idle,
+    WaitConnack,
+    Connected
+  };
+
+  enum class RxStage : uint8_t {
+    Header,
+    Length,
+    Body
+  };
+
+  // A QoS 1 PUBLISH, encoded, at offset in inflight_buf_
+  struct InflightPublish {
+    uint16_t packet_id;
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  size_t txFree() const { return k_mqtt_tx_buffer_size - tx_len_; }
+  void txPut(const uint8_t* data, size_t len);
+  void txPutString(const char* str);
+  bool queueControl(uint8_t header, const uint8_t* body, size_t body_len);
+  void flushTx();
+  void readPackets();
+  void handlePacket();
+  void handlePublish();
+  void releaseInflight(uint16_t packet_id);
+  void resendInflight();
+  uint16_t nextPacketId();
+  void close(MQTTClientState state);
+
+  WiFiClient& client_;
+  MessageCallback callback_;
+  const char* host_ = nullptr;
+  uint16_t port_ = 1883;
+  uint16_t keepalive_s_ = 15;
+  uint16_t next_packet_id_ = 0;
+  unsigned long connect_timeout_ms_ = k_mqtt_tcp_connect_timeout_ms;
+
+  Phase phase_ = Phase::Idle;
+  MQTTClientState state_ = MQTTClientState::Disconnected;
+  bool is_clean_session_ = false;
+  bool is_ping_outstanding_ = false;
+  unsigned long connect_started_ms_ = 0;
+  unsigned long last_rx_ms_ = 0;        // Last complete packet from the broker
+  unsigned long last_tx_ms_ = 0;        // Last bytes handed to lwIP, or the buffer filling up from empty
+  unsigned long ping_sent_ms_ = 0;
+
+  // Send ring: tx_len_ bytes starting at tx_tail_
+  uint16_t tx_tail_ = 0;
+  uint16_t tx_len_ = 0;
+
+  // Receive parser
+  RxStage rx_stage_ = RxStage::Header;
+  uint8_t rx_header_ = 0;
+  uint8_t rx_length_shift_ = 0;
+  uint32_t rx_length_ = 0;              // Remaining length of the packet being received
+  uint32_t rx_received_ = 0;
+
+  uint8_t inflight_count_ = 0;
+  uint16_t inflight_used_ = 0;
+  InflightPublish inflight_[k_mqtt_inflight_max];
+
+  uint8_t tx_buf_[k_mqtt_tx_buffer_size];
+  uint8_t rx_buf_[k_mqtt_rx_buffer_size];
+  uint8_t inflight_buf_[k_mqtt_inflight_buffer_size];
+};
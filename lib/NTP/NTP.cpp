@@ -1,28 +1,214 @@
 #include "NTP.h"
 #include "logging.h"
-#include "secrets.h" // Include secrets for NTP server addresses
+
+#include <coredecls.h>
+#include <sys/time.h>
 
 namespace {
 constexpr const char* k_log_tag = "NTP";
-constexpr long utc_offset_seconds = 8 * 3600;
+constexpr long utc_offset_seconds = NTP_UTC_OFFSET_S;
+constexpr time_t epoch_valid_after_s = 1672531200; // 2023-01-01, anything earlier is unsynced
+constexpr uint32_t k_first_sync_timeout_ms = 60000;
+constexpr uint8_t k_missed_syncs_stale = 3;
+constexpr uint32_t k_drift_min_interval_ms = 600000; // Too short an interval makes the ppm estimate noise
+constexpr int32_t k_drift_max_ppm = 500;
+constexpr uint32_t k_seconds_per_day = 86400;
 const char* g_ntp_addr1 = NTP_SERVER_1;
 const char* g_ntp_addr2 = NTP_SERVER_2;
+
+NTPStats g_stats;
+
+// Clock model: epoch = base_epoch_ms + (millis() - base_millis) corrected by drift_ppm
+uint64_t g_base_epoch_ms = 0;
+uint32_t g_base_millis = 0;
+bool g_has_base = false;
+uint64_t g_last_epoch_ms = 0;
+
+// Written by the SNTP callback, consumed by handleTime()
+volatile bool g_is_sync_pending = false;
+uint64_t g_sync_epoch_ms = 0;
+uint32_t g_sync_millis = 0;
+
+uint32_t g_restart_ms = 0;
+
+// Per-second cache for getTimestamp()
+uint32_t g_cached_epoch_s = 0;
+char g_cached_timestamp[k_timestamp_len] = {0};
+
+uint64_t readSystemEpochMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < epoch_valid_after_s) return 0;
+  return (uint64_t)tv.tv_sec * 1000ULL + (uint64_t)(tv.tv_usec / 1000);
+}
+
+uint64_t modelEpochMs(uint32_t now_ms) {
+  int64_t elapsed = (int64_t)(uint32_t)(now_ms - g_base_millis);
+  elapsed += elapsed * g_stats.drift_ppm / 1000000;
+  return g_base_epoch_ms + (uint64_t)elapsed;
+}
+
+void onTimeSet(bool is_from_sntp) {
+  if (!is_from_sntp) return;
+  // SDK context: sample only, the rest happens in handleTime()
+  g_sync_millis = millis();
+  g_sync_epoch_ms = readSystemEpochMs();
+  g_is_sync_pending = true;
+}
+
+void applySync() {
+  g_is_sync_pending = false;
+  uint64_t sync_epoch_ms = g_sync_epoch_ms;
+  uint32_t sync_millis = g_sync_millis;
+  if (sync_epoch_ms == 0) return;
+
+  if (g_has_base) {
+    int64_t offset_ms = (int64_t)sync_epoch_ms - (int64_t)modelEpochMs(sync_millis);
+    uint32_t interval_ms = sync_millis - g_stats.last_sync_ms;
+    g_stats.last_offset_ms = (int32_t)offset_ms;
+
+    // Residual error over the interval refines the drift estimate (EWMA 1/4)
+    if (interval_ms >= k_drift_min_interval_ms && offset_ms > -60000 && offset_ms < 60000) {
+      int32_t residual_ppm = (int32_t)(offset_ms * 1000000 / (int64_t)interval_ms);
+      int32_t drift_ppm = g_stats.drift_ppm + residual_ppm / 4;
+      if (drift_ppm > k_drift_max_ppm) drift_ppm = k_drift_max_ppm;
+      if (drift_ppm < -k_drift_max_ppm) drift_ppm = -k_drift_max_ppm;
+      g_stats.drift_ppm = drift_ppm;
+    }
+  }
+
+  g_base_epoch_ms = sync_epoch_ms;
+  g_base_millis = sync_millis;
+  g_has_base = true;
+  g_stats.last_sync_ms = sync_millis;
+  g_stats.sync_count++;
+
+  if (g_stats.state != NTPState::Synced) {
+    logInfo(k_log_tag, "Time synchronized.");
+  } else {
+    logDebug(k_log_tag, "Sync: offset %d ms, drift %d ppm", (int)g_stats.last_offset_ms, (int)g_stats.drift_ppm);
+  }
+  g_stats.state = NTPState::Synced;
+}
+
+void startSNTP() {
+  configTime(utc_offset_seconds, 0, g_ntp_addr1, g_ntp_addr2);
+  g_restart_ms = millis();
+}
+
+char* writeDigits(char* out, uint32_t value, uint8_t digits) {
+  for (int8_t i = digits - 1; i >= 0; --i) {
+    out[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+  return out + digits;
+}
+
 } // namespace
 
+// lwIP SNTP poll interval hook
+extern "C" uint32_t sntp_update_delay_MS_rfc_not_less_than_15000() {
+  return NTP_SYNC_INTERVAL_MS;
+}
+
 void setupTime() {
-  configTime(utc_offset_seconds, 0, g_ntp_addr1, g_ntp_addr2); // UTC+8
+  settimeofday_cb(onTimeSet);
+  startSNTP();
+  logInfo(k_log_tag, "SNTP started (UTC%+ld s)", utc_offset_seconds);
+}
+
+void handleTime() {
+  if (g_is_sync_pending) applySync();
 
-  logInfo(k_log_tag, "Waiting for NTP time sync");
-  time_t now = time(nullptr);
-  while (now < utc_offset_seconds * 2) {
-    delay(500);
-    now = time(nullptr);
+  uint32_t now_ms = millis();
+  if (g_stats.state == NTPState::Waiting) {
+    if (now_ms - g_restart_ms < k_first_sync_timeout_ms) return;
+    logWarn(k_log_tag, "No NTP sync yet, restarting SNTP.");
+  } else {
+    if (now_ms - g_stats.last_sync_ms < k_missed_syncs_stale * NTP_SYNC_INTERVAL_MS) return;
+    if (now_ms - g_restart_ms < NTP_SYNC_INTERVAL_MS) return;
+    if (g_stats.state != NTPState::Stale) logWarn(k_log_tag, "NTP sync is stale, restarting SNTP.");
+    g_stats.state = NTPState::Stale; // Keep serving time from the drift-corrected model
   }
-  logInfo(k_log_tag, "Time synchronized.");
+  g_stats.restart_count++;
+  startSNTP();
+}
+
+bool isTimeSynced() {
+  return g_has_base;
+}
+
+const NTPStats& getNTPStats() {
+  return g_stats;
 }
 
 void getTimestamp(char* buffer, size_t len) {
-  time_t now = time(nullptr);
-  struct tm* timeinfo = localtime(&now);
-  strftime(buffer, len, "%Y-%m-%d %H:%M:%S", timeinfo);
+  if (buffer == nullptr || len == 0) return;
+  uint32_t epoch_s = (uint32_t)(getEpochMs() / 1000);
+
+#if NTP_TIMESTAMP_EPOCH
+  snprintf(buffer, len, "%lu", (unsigned long)epoch_s);
+#else
+  if (len < k_timestamp_len) {
+    buffer[0] = '\0';
+    return;
+  }
+  if (epoch_s != g_cached_epoch_s || g_cached_timestamp[0] == '\0') {
+    formatTimestamp(g_cached_timestamp, sizeof(g_cached_timestamp), epoch_s);
+    g_cached_epoch_s = epoch_s;
+  }
+  memcpy(buffer, g_cached_timestamp, k_timestamp_len);
+#endif
+}
+
+uint64_t getEpochMs() {
+  if (g_is_sync_pending) applySync();
+  if (!g_has_base) return readSystemEpochMs();
+
+  uint64_t epoch_ms = modelEpochMs(millis());
+  // Hold small backward corrections so consecutive timestamps never decrease
+  if (epoch_ms < g_last_epoch_ms && g_last_epoch_ms - epoch_ms < k_ntp_monotonic_hold_ms) {
+    return g_last_epoch_ms;
+  }
+  g_last_epoch_ms = epoch_ms;
+  return epoch_ms;
+}
+
+uint32_t getEpochSeconds() {
+  return (uint32_t)(getEpochMs() / 1000);
+}
+
+// Days-to-civil conversion (proleptic Gregorian), integer only
+size_t formatTimestamp(char* buffer, size_t len, uint32_t epoch_s) {
+  if (buffer == nullptr || len < k_timestamp_len) return 0;
+
+  int64_t local_s = (int64_t)epoch_s + utc_offset_seconds;
+  if (local_s < 0) local_s = 0;
+  uint32_t days = (uint32_t)(local_s / k_seconds_per_day);
+  uint32_t secs = (uint32_t)(local_s % k_seconds_per_day);
+
+  uint32_t z = days + 719468;
+  uint32_t era = z / 146097;
+  uint32_t doe = z - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+  uint32_t month = (mp < 10) ? mp + 3 : mp - 9;
+  uint32_t year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+  char* out = buffer;
+  out = writeDigits(out, year, 4);
+  *out++ = '-';
+  out = writeDigits(out, month, 2);
+  *out++ = '-';
+  out = writeDigits(out, day, 2);
+  *out++ = ' ';
+  out = writeDigits(out, secs / 3600, 2);
+  *out++ = ':';
+  out = writeDigits(out, (secs / 60) % 60, 2);
+  *out++ = ':';
+  out = writeDigits(out, secs % 60, 2);
+  *out = '\0';
+  return (size_t)(out - buffer);
 }
@@ -4,20 +4,95 @@
  * NTP.h
  *
  * NTP time synchronization helpers for ESP8266.
+ *
+ * - SNTP runs in the background; setupTime() returns immediately and
+ *   handleTime() tracks sync health from loop().
+ * - Timestamps are derived from a cached epoch + millis() offset, corrected
+ *   for the measured crystal drift, and never step backwards by less than
+ *   k_ntp_monotonic_hold_ms (small corrections are absorbed instead).
  */
 
 #include <Arduino.h>
 #include <time.h>
 
+#include "secrets.h" // May override the NTP_* options below
+
+#ifndef NTP_UTC_OFFSET_S
+  #define NTP_UTC_OFFSET_S (8 * 3600) // Local time offset for timestamps and schedules
+#endif
+
+#ifndef NTP_TIMESTAMP_EPOCH
+  #define NTP_TIMESTAMP_EPOCH 0 // 1 = timestamps are UTC epoch seconds instead of local date strings
+#endif
+
+#ifndef NTP_SYNC_INTERVAL_MS
+  #define NTP_SYNC_INTERVAL_MS 3600000UL // SNTP poll interval (RFC minimum 15 s)
+#endif
+
+constexpr size_t k_timestamp_len = 20; // "YYYY-MM-DD HH:MM:SS" + null terminator
+constexpr uint32_t k_ntp_monotonic_hold_ms = 2000;
+
+enum class NTPState : uint8_t {
+  Waiting,  // No sync yet
+  Synced,
+  Stale     // Several poll intervals without a sync
+};
+
+struct NTPStats {
+  NTPState state = NTPState::Waiting;
+  uint32_t sync_count = 0;
+  uint32_t restart_count = 0;  // SNTP restarts after missing syncs
+  int32_t last_offset_ms = 0;  // Local clock error corrected by the last sync
+  int32_t drift_ppm = 0;       // Smoothed local clock drift (+ = running slow)
+  uint32_t last_sync_ms = 0;   // millis() of the last sync
+};
+
 /**
- * @brief Initialize NTP time synchronization (UTC+8).
+ * @brief Start SNTP (non-blocking). The UTC offset comes from NTP_UTC_OFFSET_S.
  */
 void setupTime();
 
+/**
+ * @brief Process sync events and restart SNTP when syncs stop (call from loop()).
+ */
+void handleTime();
+
+/**
+ * @brief true once the clock has been synchronized at least once.
+ */
+bool isTimeSynced();
+
+/**
+ * @brief Sync state and drift statistics.
+ */
+const NTPStats& getNTPStats();
+
 /**
  * @brief Get the current local time as a formatted string.
  *
+ * Writes "YYYY-MM-DD HH:MM:SS", or the UTC epoch in seconds when
+ * NTP_TIMESTAMP_EPOCH is set. Writes "" if len is too small.
+ *
  * @param buffer Destination buffer.
- * @param len Buffer size.
+ * @param len Buffer size (k_timestamp_len is enough).
  */
 void getTimestamp(char* buffer, size_t len);
+
+/**
+ * @brief Get the current UTC epoch time in milliseconds.
+ *
+ * @return Epoch milliseconds, or 0 if the clock has not been synchronized yet.
+ */
+uint64_t getEpochMs();
+
+/**
+ * @brief getEpochMs() in seconds; 0 if the clock has not been synchronized yet.
+ */
+uint32_t getEpochSeconds();
+
+/**
+ * @brief Format a UTC epoch (seconds) as local "YYYY-MM-DD HH:MM:SS".
+ *
+ * @return Characters written (19), or 0 if len < k_timestamp_len.
+ */
+size_t formatTimestamp(char* buffer, size_t len, uint32_t epoch_s);
@@ -0,0 +1,179 @@
+#include "OTA_patch.h"
+
+#include <string.h>
+
+namespace {
+
+constexpr uint8_t k_op_end = 0x00;
+constexpr uint8_t k_op_copy = 0x01;
+constexpr uint8_t k_op_kind_mask = 0xC0;
+constexpr uint8_t k_op_insert_short = 0x40;
+constexpr uint8_t k_op_copy_short = 0x80;
+constexpr uint8_t k_op_length_mask = 0x3F;
+constexpr uint8_t k_varint_shift_max = 28; // 5 bytes cover uint32
+
+uint32_t readLE32(const uint8_t* data) {
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+} // namespace
+
+void OTAPatchApplier::begin(ReadBase read_base, WriteOut write_out, void* ctx, uint32_t base_size) {
+  *this = OTAPatchApplier();
+  read_base_ = read_base;
+  write_out_ = write_out;
+  ctx_ = ctx;
+  base_limit_ = base_size;
+}
+
+bool OTAPatchApplier::fail(OTAPatchError error) {
+  error_ = error;
+  state_ = State::Failed;
+  copy_left_ = 0;
+  return false;
+}
+
+bool OTAPatchApplier::emit(const uint8_t* data, size_t len) {
+  if (len > out_size_ - written_) return fail(OTAPatchError::Range);
+  if (!write_out_(data, len, ctx_)) return fail(OTAPatchError::Write);
+  written_ += len;
+  return true;
+}
+
+// LEB128; returns true once the last byte of the value has been read
+bool OTAPatchApplier::readVarint(uint8_t byte) {
+  if (varint_shift_ > k_varint_shift_max) return fail(OTAPatchError::Opcode);
+  varint_ |= (uint32_t)(byte & 0x7F) << varint_shift_;
+  varint_shift_ += 7;
+  return (byte & 0x80) == 0;
+}
+
+bool OTAPatchApplier::startCopy() {
+  int64_t from = (int64_t)cursor_ + copy_delta_;
+  if (from < 0 || from + varint_ > base_size_) return fail(OTAPatchError::Range);
+  if (varint_ > out_size_ - written_) return fail(OTAPatchError::Range);
+  copy_from_ = (uint32_t)from;
+  copy_left_ = varint_;
+  cursor_ = copy_from_ + copy_left_;
+  return true;
+}
+
+// The cursor moves past the base bytes the literal stands in for
+void OTAPatchApplier::startInsert() {
+  cursor_ += insert_left_;
+  state_ = (insert_left_ > 0) ? State::InsertData : State::Opcode;
+}
+
+size_t OTAPatchApplier::runCopy(size_t budget) {
+  uint8_t block[k_ota_patch_copy_block];
+  size_t produced = 0;
+  while (copy_left_ > 0 && produced < budget) {
+    size_t len = (copy_left_ < sizeof(block)) ? copy_left_ : sizeof(block);
+    if (!read_base_(copy_from_, block, len, ctx_)) {
+      fail(OTAPatchError::Read);
+      break;
+    }
+    if (!emit(block, len)) break;
+    copy_from_ += len;
+    copy_left_ -= len;
+    produced += len;
+  }
+  return produced;
+}
+
+size_t OTAPatchApplier::feed(const uint8_t* data, size_t len, size_t budget) {
+  size_t produced = runCopy(budget);
+  size_t pos = 0;
+
+  while (pos < len && !hasPendingCopy() && produced < budget) {
+    uint8_t byte = data[pos];
+
+    switch (state_) {
+      case State::Header:
+        header_[header_len_++] = byte;
+        pos++;
+        if (header_len_ < k_ota_patch_header_len) break;
+        base_size_ = readLE32(header_ + 4);
+        out_size_ = readLE32(header_ + 8);
+        if (memcmp(header_, "OTP1", 4) != 0 || base_size_ > base_limit_) {
+          fail(OTAPatchError::Header);
+          return pos;
+        }
+        state_ = State::Opcode;
+        break;
+
+      case State::Opcode:
+        pos++;
+        varint_ = 0;
+        varint_shift_ = 0;
+        copy_delta_ = 0;
+        if (byte == k_op_end) {
+          if (written_ != out_size_) fail(OTAPatchError::Truncated);
+          else state_ = State::Done;
+          return pos;
+        }
+        if (byte == k_op_copy) {
+          state_ = State::CopyDelta;
+        } else if ((byte & k_op_kind_mask) == k_op_copy_short) {
+          varint_ = byte & k_op_length_mask;
+          if (varint_ == 0) {
+            state_ = State::CopyLength;
+            break;
+          }
+          if (!startCopy()) return pos;
+          produced += runCopy(budget - produced);
+        } else if ((byte & k_op_kind_mask) == k_op_insert_short) {
+          insert_left_ = byte & k_op_length_mask;
+          if (insert_left_ == 0) state_ = State::InsertLength;
+          else startInsert();
+        } else {
+          fail(OTAPatchError::Opcode);
+          return pos;
+        }
+        break;
+
+      case State::CopyDelta:
+        pos++;
+        if (!readVarint(byte)) break;
+        copy_delta_ = (int64_t)(varint_ >> 1) ^ -(int64_t)(varint_ & 1);
+        varint_ = 0;
+        varint_shift_ = 0;
+        state_ = State::CopyLength;
+        break;
+
+      case State::CopyLength:
+        pos++;
+        if (!readVarint(byte)) break;
+        state_ = State::Opcode;
+        if (!startCopy()) return pos;
+        produced += runCopy(budget - produced);
+        break;
+
+      case State::InsertLength:
+        pos++;
+        if (!readVarint(byte)) break;
+        insert_left_ = varint_;
+        startInsert();
+        break;
+
+      case State::InsertData: {
+        size_t take = len - pos;
+        if (take > insert_left_) take = insert_left_;
+        if (!emit(data + pos, take)) return pos;
+        pos += take;
+        produced += take;
+        insert_left_ -= take;
+        if (insert_left_ == 0) state_ = State::Opcode;
+        break;
+      }
+
+      case State::Done:
+      case State::Failed:
+        return pos;
+    }
+
+    if (state_ == State::Failed) return pos;
+  }
+
+  return pos;
+}
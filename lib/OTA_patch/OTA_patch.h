@@ -0,0 +1,112 @@
+/*
+ * OTA_patch.h
+ *
+ * Streaming applier for firmware delta patches (see scripts/ota_server.py).
+ *
+ * A patch rebuilds the new image from the running one (the base) with two
+ * operations: COPY a run of bytes from the base, or INSERT literal bytes that
+ * follow in the patch. Both move a base cursor, so the common case of a few
+ * changed bytes (a moved pointer) inside otherwise identical code costs an
+ * INSERT plus a one-byte COPY that carries on where the base left off.
+ *
+ * The patch is consumed in arbitrary pieces as chunks arrive and never buffers
+ * more than one small copy block, so the output can go straight into the
+ * updater. No Arduino dependencies; test/test_ota_patch runs it natively.
+ *
+ * Patch layout (little endian):
+ *   "OTP1", uint32 base size, uint32 output size, then ops:
+ *   0x80|n  COPY n bytes at the cursor (n = 0: varint length follows)
+ *   0x01    COPY zigzag varint delta from the cursor, varint length
+ *   0x40|n  INSERT n literal bytes (n = 0: varint length follows);
+ *           the cursor skips as many base bytes
+ *   0x00    END
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr size_t k_ota_patch_header_len = 12;
+constexpr size_t k_ota_patch_copy_block = 64; // Base bytes read per step
+
+enum class OTAPatchError : uint8_t {
+  None,
+  Header,     // Bad magic or base larger than the running image
+  Opcode,
+  Range,      // COPY outside the base, or output beyond the declared size
+  Read,
+  Write,
+  Truncated   // END before the declared output size
+};
+
+class OTAPatchApplier {
+public:
+  using ReadBase = bool (*)(uint32_t offset, uint8_t* data, size_t len, void* ctx);
+  using WriteOut = bool (*)(const uint8_t* data, size_t len, void* ctx);
+
+  /**
+   * @brief Start a new patch.
+   *
+   * @param base_size Bytes of the running image that may be read.
+   */
+  void begin(ReadBase read_base, WriteOut write_out, void* ctx, uint32_t base_size);
+
+  /**
+   * @brief Consume patch bytes.
+   *
+   * Output is limited to roughly 'budget' bytes per call; a COPY that does not
+   * fit is continued by the next call (with or without new input).
+   *
+   * @return Bytes of 'data' consumed.
+   */
+  size_t feed(const uint8_t* data, size_t len, size_t budget);
+
+  bool hasPendingCopy() const { return copy_left_ > 0; }
+  bool isDone() const { return state_ == State::Done; }
+  bool hasFailed() const { return error_ != OTAPatchError::None; }
+  OTAPatchError error() const { return error_; }
+
+  uint32_t outputSize() const { return out_size_; } // 0 until the header is read
+  uint32_t written() const { return written_; }
+
+private:
+  enum class State : uint8_t {
+    Header,
+    Opcode,
+    CopyDelta,
+    CopyLength,
+    InsertLength,
+    InsertData,
+    Done,
+    Failed
+  };
+
+  bool fail(OTAPatchError error);
+  bool emit(const uint8_t* data, size_t len);
+  bool readVarint(uint8_t byte);
+  bool startCopy();
+  void startInsert();
+  size_t runCopy(size_t budget);
+
+  ReadBase read_base_ = nullptr;
+  WriteOut write_out_ = nullptr;
+  void* ctx_ = nullptr;
+  uint32_t base_limit_ = 0;
+
+  State state_ = State::Header;
+  OTAPatchError error_ = OTAPatchError::None;
+  uint8_t header_[k_ota_patch_header_len] = {0};
+  uint8_t header_len_ = 0;
+  uint32_t base_size_ = 0;
+  uint32_t out_size_ = 0;
+  uint32_t written_ = 0;
+
+  uint32_t varint_ = 0;
+  uint8_t varint_shift_ = 0;
+  int64_t copy_delta_ = 0;
+  uint32_t cursor_ = 0;     // Base position COPY deltas are relative to
+  uint32_t copy_from_ = 0;
+  uint32_t copy_left_ = 0;
+  uint32_t insert_left_ = 0;
+};
@@ -0,0 +1,244 @@
+#include "OTA_update.h"
+#include "OTA_patch.h"
+#include "logging.h"
+
+#include <Updater.h>
+
+namespace {
+
+constexpr const char* k_log_tag = "OTA";
+constexpr uint16_t k_frame_magic = 0x544F; // "OT"
+constexpr uint8_t k_frame_version = 1;
+constexpr uint16_t k_chunk_min = 64;
+constexpr size_t k_service_budget = 2048;  // Output bytes per serviceOTA() call
+constexpr uint8_t k_chunk_slots = 2;       // One being applied, one received meanwhile
+
+struct ChunkSlot {
+  uint8_t data[k_ota_chunk_max];
+  uint16_t len;
+};
+
+OTAProgress g_progress;
+OTAOffer g_offer;
+OTAPatchApplier g_patch;
+
+ChunkSlot g_slots[k_chunk_slots];
+uint8_t g_slot_head = 0;   // Chunk being applied (index next_index)
+uint8_t g_slot_count = 0;
+size_t g_chunk_used = 0;   // Bytes of the head chunk already applied
+
+uint16_t readLE16(const uint8_t* data) {
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+uint32_t readLE32(const uint8_t* data) {
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// zlib CRC32 (matches the server's zlib.crc32), nibble table
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  static const uint32_t k_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i) {
+    crc = k_table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+    crc = k_table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+uint32_t expectedChunkLen(uint32_t index) {
+  uint32_t offset = index * g_offer.chunk_size;
+  uint32_t left = g_progress.stream_size - offset;
+  return (left < g_offer.chunk_size) ? left : g_offer.chunk_size;
+}
+
+// flashRead needs word-aligned addresses and buffers
+bool readRunningImage(uint32_t offset, uint8_t* data, size_t len, void*) {
+  uint32_t words[k_ota_patch_copy_block / 4 + 2];
+  uint32_t start = offset & ~3u;
+  size_t span = ((offset + len + 3) & ~3u) - start;
+  if (span > sizeof(words)) return false;
+  if (!ESP.flashRead(start, words, span)) return false;
+  memcpy(data, (uint8_t*)words + (offset - start), len);
+  return true;
+}
+
+bool writeUpdate(const uint8_t* data, size_t len, void*) {
+  return Update.write(const_cast<uint8_t*>(data), len) == len;
+}
+
+void failSession(OTAError error) {
+  g_progress.status = OTAStatus::Failed;
+  g_progress.error = error;
+  g_progress.update_error = Update.getError();
+  g_slot_count = 0;
+  if (Update.isRunning()) Update.end(false); // Unfinished: discards the partial image
+  logError(k_log_tag, "Update failed: %s (stream=%s chunk=%u update_err=%u)",
+           otaErrorName(error), otaStreamName(g_progress.stream), g_progress.next_index, g_progress.update_error);
+}
+
+void commitSession() {
+  if (g_progress.stream == OTAStream::Patch && !g_patch.isDone()) {
+    failSession(OTAError::Patch);
+    return;
+  }
+  if (!Update.end()) {
+    failSession(OTAError::Verify);
+    return;
+  }
+  g_progress.status = OTAStatus::Ready;
+  logInfo(k_log_tag, "Image %s verified (%u bytes via %s).", g_offer.version, g_offer.size, otaStreamName(g_progress.stream));
+}
+
+} // namespace
+
+uint32_t otaSessionId(const char* md5) {
+  if (md5 == nullptr || strlen(md5) != k_ota_md5_len - 1) return 0;
+  char head[9];
+  memcpy(head, md5, 8);
+  head[8] = '\0';
+  return (uint32_t)strtoul(head, nullptr, 16);
+}
+
+bool startOTA(const OTAOffer& offer, OTAStream stream) {
+  abortOTA();
+  g_progress = OTAProgress();
+  g_slot_count = 0;
+  g_progress.stream = stream;
+
+  uint32_t stream_size = (stream == OTAStream::Patch) ? offer.patch_size : offer.size;
+  if (offer.size == 0 || stream_size == 0 || offer.chunk_size < k_chunk_min || offer.chunk_size > k_ota_chunk_max ||
+      otaSessionId(offer.md5) == 0 || (stream == OTAStream::Patch && !offer.has_patch)) {
+    failSession(OTAError::Offer);
+    return false;
+  }
+
+  g_offer = offer;
+  g_progress.session = otaSessionId(offer.md5);
+  g_progress.stream_size = stream_size;
+  g_progress.chunk_count = (stream_size + offer.chunk_size - 1) / offer.chunk_size;
+
+  if (!Update.begin(offer.size, U_FLASH) || !Update.setMD5(offer.md5)) {
+    failSession(OTAError::Begin);
+    return false;
+  }
+  if (stream == OTAStream::Patch) {
+    g_patch.begin(readRunningImage, writeUpdate, nullptr, ESP.getSketchSize());
+  }
+
+  g_progress.status = OTAStatus::Downloading;
+  logInfo(k_log_tag, "Downloading %s: %u bytes in %u chunks (%s).",
+          offer.version, stream_size, g_progress.chunk_count, otaStreamName(stream));
+  return true;
+}
+
+void abortOTA() {
+  if (g_progress.status != OTAStatus::Downloading) return;
+  g_slot_count = 0;
+  if (Update.isRunning()) Update.end(false);
+  g_progress.status = OTAStatus::Idle;
+  logInfo(k_log_tag, "Update of %s abandoned at chunk %u/%u.", g_offer.version, g_progress.next_index, g_progress.chunk_count);
+}
+
+OTAChunkResult submitOTAChunk(const uint8_t* frame, size_t len) {
+  if (g_progress.status != OTAStatus::Downloading) return OTAChunkResult::Stale;
+  if (frame == nullptr || len <= k_ota_frame_header_len) return OTAChunkResult::Corrupt;
+  if (readLE16(frame) != k_frame_magic || frame[2] != k_frame_version) return OTAChunkResult::Corrupt;
+
+  uint32_t index = g_progress.next_index + g_slot_count;
+  if (frame[3] != (uint8_t)g_progress.stream || readLE32(frame + 4) != g_progress.session) return OTAChunkResult::Stale;
+  if (readLE32(frame + 8) < index) return OTAChunkResult::Stale; // Duplicate
+  if (g_slot_count == k_chunk_slots) return OTAChunkResult::Busy;
+  if (readLE32(frame + 8) != index) return OTAChunkResult::Stale;
+
+  const uint8_t* data = frame + k_ota_frame_header_len;
+  size_t data_len = len - k_ota_frame_header_len;
+  if (data_len != expectedChunkLen(index) || crc32Update(0, data, data_len) != readLE32(frame + 12)) {
+    g_progress.crc_failures++;
+    return OTAChunkResult::Corrupt;
+  }
+
+  ChunkSlot& slot = g_slots[(g_slot_head + g_slot_count) % k_chunk_slots];
+  memcpy(slot.data, data, data_len);
+  slot.len = (uint16_t)data_len;
+  if (g_slot_count++ == 0) g_chunk_used = 0;
+  return OTAChunkResult::Accepted;
+}
+
+bool serviceOTA() {
+  if (g_progress.status != OTAStatus::Downloading || g_slot_count == 0) return false;
+  ChunkSlot& slot = g_slots[g_slot_head];
+
+  if (g_progress.stream == OTAStream::Image) {
+    if (!writeUpdate(slot.data, slot.len, nullptr)) {
+      failSession(OTAError::Write);
+      return true;
+    }
+  } else {
+    g_chunk_used += g_patch.feed(slot.data + g_chunk_used, slot.len - g_chunk_used, k_service_budget);
+    if (g_patch.hasFailed()) {
+      failSession(OTAError::Patch);
+      return true;
+    }
+    if (g_patch.outputSize() != 0 && g_patch.outputSize() != g_offer.size) {
+      failSession(OTAError::Patch);
+      return true;
+    }
+    // Bytes after END are never consumed: without this the chunk would stay pending forever
+    bool is_last_chunk = (g_progress.next_index + 1 == g_progress.chunk_count);
+    if (g_patch.isDone() && (g_chunk_used < slot.len || !is_last_chunk)) {
+      failSession(OTAError::Patch);
+      return true;
+    }
+    if (g_chunk_used < slot.len || g_patch.hasPendingCopy()) return false; // Continue next loop
+  }
+
+  g_progress.received += slot.len;
+  g_progress.next_index++;
+  g_slot_head = (g_slot_head + 1) % k_chunk_slots;
+  g_slot_count--;
+  g_chunk_used = 0;
+  if (g_progress.next_index == g_progress.chunk_count) commitSession();
+  return true;
+}
+
+const OTAProgress& getOTAProgress() {
+  return g_progress;
+}
+
+bool isOTAActive() {
+  return g_progress.status == OTAStatus::Downloading;
+}
+
+bool isOTAChunkPending() {
+  return g_slot_count > 0;
+}
+
+const char* otaStatusName(OTAStatus status) {
+  switch (status) {
+    case OTAStatus::Idle:        return "idle";
+    case OTAStatus::Downloading: return "downloading";
+    case OTAStatus::Ready:       return "ready";
+    case OTAStatus::Failed:      return "failed";
+    default:                     return "unknown";
+  }
+}
+
+const char* otaErrorName(OTAError error) {
+  switch (error) {
+    case OTAError::None:   return "none";
+    case OTAError::Offer:  return "offer";
+    case OTAError::Begin:  return "begin";
+    case OTAError::Write:  return "write";
+    case OTAError::Patch:  return "patch";
+    case OTAError::Verify: return "verify";
+    default:               return "unknown";
+  }
+}
+
+const char* otaStreamName(OTAStream stream) {
+  return (stream == OTAStream::Patch) ? "patch" : "image";
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+ * OTA_update.h
+ *
+ * Pull-based firmware update session, independent of the transport.
+ *
+ * - A session is started from an offer (target version, image size and MD5,
+ *   chunk size, optionally a delta patch against the running build).
+ * - The update is streamed as numbered chunks, each framed with a CRC32 of its
+ *   data. Chunks must arrive in order; anything else is rejected so the caller
+ *   can re-request from getOTAProgress().next_index.
+ * - Image chunks go straight to the updater; patch chunks are expanded against
+ *   the running image first (OTA_patch.h). The image MD5 is checked by the
+ *   updater before the new build is committed.
+ * - A session survives broker/Wi-Fi outages (the caller simply resumes
+ *   requesting), but not a reboot: the updater cannot reopen a partial image.
+ *
+ * Chunk frame layout (little endian):
+ *   uint16 magic 0x544F ("OT"), uint8 version (1), uint8 stream (OTAStream),
+ *   uint32 session (first 4 bytes of the image MD5), uint32 chunk index,
+ *   uint32 CRC32 (zlib) of the data, data[chunk size] (the last one may be short)
+ */
+
+#include <Arduino.h>
+
+constexpr size_t k_ota_version_max = 48;      // "git describe --always --dirty" output
+constexpr size_t k_ota_md5_len = 33;          // 32 hex digits
+constexpr uint16_t k_ota_chunk_max = 512;     // Frame + topic must fit the MQTT buffer
+constexpr size_t k_ota_frame_header_len = 16;
+
+enum class OTAStream : uint8_t {
+  Image = 0,
+  Patch = 1
+};
+
+enum class OTAStatus : uint8_t {
+  Idle,
+  Downloading,
+  Ready,   // Image verified and committed, reboot pending
+  Failed
+};
+
+enum class OTAError : uint8_t {
+  None,
+  Offer,   // Offer fields out of range
+  Begin,   // Not enough free flash, or the updater refused to start
+  Write,
+  Patch,
+  Verify   // Image MD5 mismatch or updater error at commit
+};
+
+enum class OTAChunkResult : uint8_t {
+  Accepted,
+  Busy,     // Both chunk buffers still waiting to be applied
+  Stale,    // Other session/stream, or not the next index
+  Corrupt   // Bad frame or CRC mismatch
+};
+
+struct OTAOffer {
+  char version[k_ota_version_max] = {0};
+  char md5[k_ota_md5_len] = {0};
+  uint32_t size = 0;            // Image bytes
+  uint16_t chunk_size = 0;
+  bool has_patch = false;
+  char patch_base[k_ota_version_max] = {0};
+  uint32_t patch_size = 0;
+};
+
+struct OTAProgress {
+  OTAStatus status = OTAStatus::Idle;
+  OTAStream stream = OTAStream::Image;
+  OTAError error = OTAError::None;
+  uint8_t update_error = 0;     // Update.getError() after a failure
+  uint32_t session = 0;
+  uint32_t next_index = 0;
+  uint32_t chunk_count = 0;
+  uint32_t received = 0;        // Stream bytes applied
+  uint32_t stream_size = 0;
+  uint32_t crc_failures = 0;
+};
+
+/**
+ * @brief Start a session for an offer, aborting any session in progress.
+ *
+ * @param stream Patch only if the offer's patch base is the running build.
+ * @return false if the offer is invalid or the updater cannot start.
+ */
+bool startOTA(const OTAOffer& offer, OTAStream stream);
+
+/**
+ * @brief Abandon the session in progress (the running image is untouched).
+ */
+void abortOTA();
+
+/**
+ * @brief Validate a chunk frame and buffer its data for serviceOTA().
+ *
+ * Cheap enough to call from the MQTT callback.
+ */
+OTAChunkResult submitOTAChunk(const uint8_t* frame, size_t len);
+
+/**
+ * @brief Apply the pending chunk, a bounded amount of work per call (call from loop()).
+ *
+ * Commits the image after the last chunk.
+ *
+ * @return true if a chunk was completed (or the session ended) during this call.
+ */
+bool serviceOTA();
+
+/**
+ * @brief Session state and counters.
+ */
+const OTAProgress& getOTAProgress();
+
+/**
+ * @brief true while a session is downloading.
+ */
+bool isOTAActive();
+
+/**
+ * @brief true while accepted chunks are waiting to be applied.
+ */
+bool isOTAChunkPending();
+
+/**
+ * @brief Session id for an MD5 hex string (its first 4 bytes, 0 if malformed).
+ */
+uint32_t otaSessionId(const char* md5);
+
+/**
+ * @brief Short names for status reporting.
+ */
+const char* otaStatusName(OTAStatus status);
+const char* otaErrorName(OTAError error);
+const char* otaStreamName(OTAStream stream);
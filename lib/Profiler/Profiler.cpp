@@ -0,0 +1,91 @@
+#include "Profiler.h"
+
+namespace {
+
+constexpr uint8_t k_bucket_count = 24; // Last bucket is open-ended (>= ~4.2 s)
+constexpr uint8_t k_stage_count = static_cast<uint8_t>(ProfileStage::Count);
+
+struct StageHistogram {
+  uint32_t buckets[k_bucket_count]; // As wide as count, so the cumulative sum always reaches it
+  uint32_t count;
+  uint32_t max_us;
+};
+
+StageHistogram g_histograms[k_stage_count] = {};
+
+uint8_t bucketIndex(uint32_t duration_us) {
+  if (duration_us == 0) return 0;
+  uint8_t index = 32 - __builtin_clz(duration_us); // Bit width of the duration
+  return (index < k_bucket_count) ? index : k_bucket_count - 1;
+}
+
+uint32_t bucketUpperBound(uint8_t index) {
+  if (index == 0) return 0;
+  return ((uint32_t)1 << index) - 1;
+}
+
+uint32_t percentile(const StageHistogram& hist, uint8_t pct) {
+  uint32_t target = (hist.count * pct + 99) / 100; // ceil(count * pct / 100)
+  if (target == 0) target = 1;
+
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < k_bucket_count; ++i) {
+    cumulative += hist.buckets[i];
+    if (cumulative >= target) {
+      uint32_t bound = bucketUpperBound(i);
+      return (bound < hist.max_us) ? bound : hist.max_us;
+    }
+  }
+  return hist.max_us;
+}
+
+} // namespace
+
+void profilerRecord(ProfileStage stage, uint32_t duration_us) {
+  uint8_t s = static_cast<uint8_t>(stage);
+  if (s >= k_stage_count) return;
+
+  StageHistogram& hist = g_histograms[s];
+  uint8_t b = bucketIndex(duration_us);
+  hist.buckets[b]++;
+  hist.count++;
+  if (duration_us > hist.max_us) hist.max_us = duration_us;
+}
+
+bool profilerSummarize(ProfileStage stage, ProfileSummary& out) {
+  out = ProfileSummary();
+  uint8_t s = static_cast<uint8_t>(stage);
+  if (s >= k_stage_count) return false;
+
+  const StageHistogram& hist = g_histograms[s];
+  if (hist.count == 0) return false;
+
+  out.p50_us = percentile(hist, 50);
+  out.p95_us = percentile(hist, 95);
+  out.p99_us = percentile(hist, 99);
+  out.max_us = hist.max_us;
+  out.count = hist.count;
+  return true;
+}
+
+void profilerReset() {
+  memset(g_histograms, 0, sizeof(g_histograms));
+}
+
+const char* profileStageName(ProfileStage stage) {
+  switch (stage) {
+    case ProfileStage::Loop:       return "loop";
+    case ProfileStage::MQTTHandle: return "mqtt";
+    case ProfileStage::IRSend:     return "ir";
+    case ProfileStage::Serialize:  return "ser";
+    case ProfileStage::Publish:    return "pub";
+    default:                       return "unknown";
+  }
+}
+
+ProfileScope::ProfileScope(ProfileStage stage)
+  : stage_(stage), start_us_(micros()) {}
+
+ProfileScope::~ProfileScope() {
+  profilerRecord(stage_, micros() - start_us_);
+}
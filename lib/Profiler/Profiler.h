@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * Profiler.h
+ *
+ * Lightweight loop/stage latency profiler backed by fixed-bucket log2
+ * histograms. Bucket i (i >= 1) holds durations in [2^(i-1), 2^i) microseconds,
+ * so percentiles are approximate (upper bucket bound, clipped to the observed max).
+ */
+
+#include <Arduino.h>
+#include <cstdint>
+
+enum class ProfileStage : uint8_t {
+  Loop = 0,     // Full loop() iteration
+  MQTTHandle,   // handleMQTT()
+  IRSend,       // IR transmission
+  Serialize,    // JSON serialization for publishes
+  Publish,      // MQTT client publish call
+  Count
+};
+
+struct ProfileSummary {
+  uint32_t p50_us = 0;
+  uint32_t p95_us = 0;
+  uint32_t p99_us = 0;
+  uint32_t max_us = 0;
+  uint32_t count = 0;
+};
+
+/**
+ * @brief Record one duration sample for a stage.
+ *
+ * @param stage Stage being measured.
+ * @param duration_us Duration in microseconds.
+ */
+void profilerRecord(ProfileStage stage, uint32_t duration_us);
+
+/**
+ * @brief Compute p50/p95/p99/max for a stage since the last reset.
+ *
+ * @param stage Stage to summarize.
+ * @param out Destination summary.
+ * @return true if the stage has at least one sample.
+ */
+bool profilerSummarize(ProfileStage stage, ProfileSummary& out);
+
+/**
+ * @brief Clear all stage histograms (start a new reporting interval).
+ */
+void profilerReset();
+
+/**
+ * @brief Short stage name used as the telemetry key.
+ */
+const char* profileStageName(ProfileStage stage);
+
+/**
+ * @brief Scoped timer that records its lifetime into a stage histogram.
+ */
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileStage stage);
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  ProfileStage stage_;
+  uint32_t start_us_;
+};
@@ -0,0 +1,167 @@
+#include "Watchdog.h"
+#include "logging.h"
+#include "ESP_system.h"
+
+#include <stddef.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266)
+#error "ESP8266 only"
+#endif
+
+namespace {
+
+constexpr const char* k_log_tag = "WDT";
+constexpr uint32_t k_breadcrumb_magic = 0x42544457; // "WDTB"
+constexpr uint32_t k_loop_budget_us = (uint32_t)WATCHDOG_LOOP_BUDGET_MS * 1000UL;
+constexpr uint8_t k_section_count = static_cast<uint8_t>(WatchdogSection::Count);
+
+// Mirrored into RTC user memory on every section change; a feed rewrites fed_ms alone
+struct Breadcrumb {
+  uint32_t magic;
+  uint32_t section;
+  uint32_t detail;
+  uint32_t entered_ms;
+  uint32_t fed_ms;
+  uint32_t loops;
+};
+static_assert(sizeof(Breadcrumb) % 4 == 0, "RTC memory is written in 4-byte blocks");
+static_assert(k_watchdog_rtc_block + sizeof(Breadcrumb) / 4 <= 40, "Breadcrumb must stay within RTC blocks 32-39");
+constexpr uint32_t k_fed_block = offsetof(Breadcrumb, fed_ms) / 4;
+
+Breadcrumb g_breadcrumb = {};
+WatchdogStats g_stats;
+WatchdogCrash g_crash = {};
+bool g_has_crash = false;
+
+uint32_t g_loop_start_us = 0;
+uint32_t g_last_feed_us = 0;     // Last feed of any kind (what the WDT sees)
+uint32_t g_stretch_start_us = 0; // Last feed or section change (per-section stretches)
+bool g_is_deferring = false;     // This loop already deferred its work
+bool g_has_deferred = false;     // The previous loop did
+
+void writeBreadcrumb() {
+  ESP.rtcUserMemoryWrite(k_watchdog_rtc_block, reinterpret_cast<uint32_t*>(&g_breadcrumb), sizeof(g_breadcrumb));
+}
+
+void noteMax(uint32_t& max_ms, uint32_t span_us) {
+  uint32_t span_ms = (span_us + 999) / 1000;
+  if (span_ms > max_ms) max_ms = span_ms;
+}
+
+// Charges the time since the last feed or section change to the current section
+void closeStretch(uint32_t now_us) {
+  uint8_t section = (uint8_t)g_breadcrumb.section;
+  if (section != static_cast<uint8_t>(WatchdogSection::Loop)) noteMax(g_stats.max_unfed_ms[section], now_us - g_stretch_start_us);
+  g_stretch_start_us = now_us;
+}
+
+void noteFeed(uint32_t now_us) {
+  closeStretch(now_us);
+  noteMax(g_stats.max_unfed_ms[static_cast<uint8_t>(WatchdogSection::Loop)], now_us - g_last_feed_us);
+  g_last_feed_us = now_us;
+  g_breadcrumb.fed_ms = millis();
+}
+
+} // namespace
+
+void beginWatchdog() {
+  Breadcrumb previous;
+  if (isCrashReset() &&
+      ESP.rtcUserMemoryRead(k_watchdog_rtc_block, reinterpret_cast<uint32_t*>(&previous), sizeof(previous)) &&
+      previous.magic == k_breadcrumb_magic && previous.section < k_section_count) {
+    g_crash.section = static_cast<WatchdogSection>(previous.section);
+    g_crash.detail = previous.detail;
+    g_crash.entered_ms = previous.entered_ms;
+    g_crash.fed_ms = previous.fed_ms;
+    g_crash.loops = previous.loops;
+    g_has_crash = true;
+    logWarn(k_log_tag, "Previous boot ended (%s) in %s (detail=%u entered=%u ms fed=%u ms loops=%u)",
+            getResetReasonName(), watchdogSectionName(g_crash.section), (unsigned int)g_crash.detail,
+            (unsigned int)g_crash.entered_ms, (unsigned int)g_crash.fed_ms, (unsigned int)g_crash.loops);
+  }
+
+  uint32_t now_ms = millis();
+  g_breadcrumb = {k_breadcrumb_magic, static_cast<uint32_t>(WatchdogSection::Loop), 0, now_ms, now_ms, 0};
+  writeBreadcrumb();
+  g_loop_start_us = g_last_feed_us = g_stretch_start_us = micros();
+}
+
+void watchdogLoopBegin() {
+  // The previous loop() returned, which fed the WDT
+  g_loop_start_us = g_last_feed_us = g_stretch_start_us = micros();
+  g_is_deferring = false;
+}
+
+void watchdogLoopEnd() {
+  uint32_t now_us = micros();
+  noteFeed(now_us);
+  if (now_us - g_loop_start_us > k_loop_budget_us) g_stats.loop_overruns++;
+  g_has_deferred = g_is_deferring;
+
+  g_breadcrumb.loops++;
+  writeBreadcrumb();
+}
+
+void watchdogFeed() {
+  noteFeed(micros());
+  ESP.rtcUserMemoryWrite(k_watchdog_rtc_block + k_fed_block, &g_breadcrumb.fed_ms, sizeof(g_breadcrumb.fed_ms));
+
+  // Yielding mid-frame would hand the CPU to the Wi-Fi stack and stretch the IR timing
+  if (g_breadcrumb.section == static_cast<uint32_t>(WatchdogSection::IRSend)) {
+    ESP.wdtFeed();
+  } else {
+    yield();
+  }
+  g_last_feed_us = g_stretch_start_us = micros();
+}
+
+bool shouldDeferLoopWork() {
+  if (g_is_deferring) return true;
+  if (g_has_deferred || micros() - g_loop_start_us <= k_loop_budget_us) return false;
+  g_is_deferring = true;
+  g_stats.loops_deferred++;
+  return true;
+}
+
+const WatchdogStats& getWatchdogStats() {
+  return g_stats;
+}
+
+void resetWatchdogStats() {
+  g_stats = WatchdogStats();
+}
+
+const WatchdogCrash* getWatchdogCrash() {
+  return g_has_crash ? &g_crash : nullptr;
+}
+
+const char* watchdogSectionName(WatchdogSection section) {
+  switch (section) {
+    case WatchdogSection::Loop:    return "loop";
+    case WatchdogSection::WiFi:    return "wifi";
+    case WatchdogSection::MQTT:    return "mqtt";
+    case WatchdogSection::IRSend:  return "ir";
+    case WatchdogSection::Storage: return "fs";
+    case WatchdogSection::OTA:     return "ota";
+    default:                       return "unknown";
+  }
+}
+
+WatchdogScope::WatchdogScope(WatchdogSection section, uint32_t detail)
+  : outer_section_(static_cast<WatchdogSection>(g_breadcrumb.section)),
+    outer_detail_(g_breadcrumb.detail),
+    outer_entered_ms_(g_breadcrumb.entered_ms) {
+  closeStretch(micros());
+  g_breadcrumb.section = static_cast<uint32_t>(section);
+  g_breadcrumb.detail = detail;
+  g_breadcrumb.entered_ms = millis();
+  writeBreadcrumb();
+}
+
+WatchdogScope::~WatchdogScope() {
+  closeStretch(micros());
+  g_breadcrumb.section = static_cast<uint32_t>(outer_section_);
+  g_breadcrumb.detail = outer_detail_;
+  g_breadcrumb.entered_ms = outer_entered_ms_;
+  writeBreadcrumb();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+ * Watchdog.h
+ *
+ * Instrumented layer over the ESP8266 watchdogs. The soft WDT resets the chip
+ * when loop() neither returns nor yields for about 3.2 s, the hardware WDT
+ * after about 8 s.
+ *
+ * - Potentially long work runs inside a WatchdogScope naming its subsystem.
+ *   The longest stretch each subsystem ran without a feed is tracked, as is
+ *   the longest stretch overall (the "loop" row, what the WDT itself sees).
+ * - watchdogFeed() replaces yield() in long operations. It yields, except
+ *   during an IR send, where it only feeds the WDT so the frame timing holds.
+ * - loop() has a time budget (WATCHDOG_LOOP_BUDGET_MS). Deferrable work asks
+ *   shouldDeferLoopWork() and waits for the next loop once the budget is spent.
+ * - A breadcrumb (subsystem, when it was entered, last feed) is kept in RTC
+ *   user memory, which survives a WDT reset or exception. After one, the
+ *   previous boot's breadcrumb is available from getWatchdogCrash().
+ *
+ * RTC user memory blocks 0-31 hold the OTA boot loader command; the
+ * breadcrumb uses blocks 32-37.
+ */
+
+#include <Arduino.h>
+
+#ifndef WATCHDOG_LOOP_BUDGET_MS
+  #define WATCHDOG_LOOP_BUDGET_MS 50
+#endif
+
+constexpr uint32_t k_watchdog_rtc_block = 32;
+
+enum class WatchdogSection : uint8_t {
+  Loop = 0,  // Outside any section; its stats row is the longest stretch overall
+  WiFi,      // Connection manager (association, scans)
+  MQTT,      // handleMQTT(): connect, commands, publishes
+  IRSend,    // IR transmission (detail: unit slot)
+  Storage,   // LittleFS writes
+  OTA,       // Update chunks: patching and flash writes (detail: chunk index)
+  Count
+};
+
+struct WatchdogStats {
+  uint32_t max_unfed_ms[static_cast<uint8_t>(WatchdogSection::Count)] = {0};
+  uint32_t loop_overruns = 0;  // loop() iterations over the budget
+  uint32_t loops_deferred = 0; // Iterations that left deferrable work to the next one
+};
+
+// Breadcrumb of the boot that ended in a WDT reset or exception
+struct WatchdogCrash {
+  WatchdogSection section;
+  uint32_t detail;
+  uint32_t entered_ms;  // millis() when the section was entered
+  uint32_t fed_ms;      // millis() at the last feed
+  uint32_t loops;       // loop() iterations completed
+};
+
+/**
+ * @brief Read the previous boot's breadcrumb and start this boot's. Call first in setup().
+ */
+void beginWatchdog();
+
+/**
+ * @brief Mark the start and end of a loop() iteration (returning from loop() feeds the WDT).
+ */
+void watchdogLoopBegin();
+void watchdogLoopEnd();
+
+/**
+ * @brief Feed the WDT from inside a long operation (yields outside IR sends).
+ */
+void watchdogFeed();
+
+/**
+ * @brief True once this loop() is over budget, unless the previous one already deferred.
+ *
+ * Work that can wait a loop checks this; since two loops in a row never defer,
+ * deferred work is delayed by one iteration at most.
+ */
+bool shouldDeferLoopWork();
+
+/**
+ * @brief Stats since the last reset (see resetWatchdogStats).
+ */
+const WatchdogStats& getWatchdogStats();
+void resetWatchdogStats();
+
+/**
+ * @brief Breadcrumb left by the previous boot, or nullptr unless it ended in a WDT reset or exception.
+ */
+const WatchdogCrash* getWatchdogCrash();
+
+/**
+ * @brief Short section name used as the telemetry key.
+ */
+const char* watchdogSectionName(WatchdogSection section);
+
+/**
+ * @brief Scoped subsystem section; nests (the innermost one is current).
+ */
+class WatchdogScope {
+public:
+  explicit WatchdogScope(WatchdogSection section, uint32_t detail = 0);
+  ~WatchdogScope();
+
+  WatchdogScope(const WatchdogScope&) = delete;
+  WatchdogScope& operator=(const WatchdogScope&) = delete;
+
+private:
+  WatchdogSection outer_section_;
+  uint32_t outer_detail_;
+  uint32_t outer_entered_ms_;
+};
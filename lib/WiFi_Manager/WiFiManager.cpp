@@ -2,14 +2,16 @@
 
 #include "WiFiManager.h"
 #include "logging.h"
+#include "Watchdog.h"
+#include "Device_info.h"
 
 namespace {
 constexpr const char* k_log_tag = "WIFI";
 
-void formatIpAddress(char* buf, size_t len, const IPAddress& ip) {
-  if (buf == nullptr || len == 0) return;
-  snprintf(buf, len, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
-}
+constexpr int32_t k_bssid_failures_counted = 3;
+constexpr int32_t k_channel_load_counted = 5;
+constexpr uint8_t k_channel_max = 14;
+
 } // namespace
 
 CustomWiFi::WiFiManager::WiFiManager()
@@ -51,7 +53,15 @@ bool CustomWiFi::WiFiManager::readWiFiFromEEPROM(char* ssid, char* password) {
   return false;
 }
 
+void CustomWiFi::WiFiManager::buildKnownNetworkIndex() {
+  size_t indexed = known_networks.build(k_wifi_table, k_wifi_count);
+  if (indexed < (size_t)k_wifi_count) {
+    logWarn(k_log_tag, "Indexed %u of %d known networks.", (unsigned int)indexed, k_wifi_count);
+  }
+}
+
 void CustomWiFi::WiFiManager::begin() {
+  buildKnownNetworkIndex();
   WiFi.mode(WIFI_STA);
   WiFi.setAutoReconnect(false);
   if (WiFi.status() != WL_CONNECTED) {
@@ -65,6 +75,7 @@ void CustomWiFi::WiFiManager::begin(const char* ssid, const char* pass) {
   strncpy(hidden_pass, pass ? pass : "", sizeof(hidden_pass) - 1);
   hidden_pass[sizeof(hidden_pass) - 1] = '\0';
 
+  buildKnownNetworkIndex();
   WiFi.mode(WIFI_STA);
   WiFi.setAutoReconnect(false);
   current_state = CustomWiFi::WiFiState::DISCONNECTED;
@@ -85,12 +96,16 @@ void CustomWiFi::WiFiManager::handleConnection() {
           retry_count = 0;
         }
       }
+      if (current_state == CustomWiFi::WiFiState::CONNECTED) {
+        handleRoaming();
+      }
       break;
 
     case CustomWiFi::WiFiState::DISCONNECTED:
       logInfo(k_log_tag, "Starting connection process...");
       if (strlen(hidden_ssid) > 0) {
-        startConnection(hidden_ssid, hidden_pass, CustomWiFi::WiFiState::CONNECTING_HIDDEN, true);
+        startConnection(hidden_ssid, hidden_pass, CustomWiFi::WiFiState::CONNECTING_HIDDEN, true, &resume_target);
+        resume_target.is_valid = false;
       } else {
         trySavedCredentials();
       }
@@ -98,6 +113,7 @@ void CustomWiFi::WiFiManager::handleConnection() {
 
     case CustomWiFi::WiFiState::CONNECTING_SAVED:
     case CustomWiFi::WiFiState::CONNECTING_SCANNED:
+    case CustomWiFi::WiFiState::CONNECTING_ROAM:
     case CustomWiFi::WiFiState::CONNECTING_HIDDEN:
       checkConnectionProgress();
       break;
@@ -120,18 +136,31 @@ void CustomWiFi::WiFiManager::trySavedCredentials() {
   char saved_ssid[ssid_max_len], saved_pass[pass_max_len];
   if (readWiFiFromEEPROM(saved_ssid, saved_pass)) {
     logInfo(k_log_tag, "Trying saved WiFi: %s", saved_ssid);
-    startConnection(saved_ssid, saved_pass, CustomWiFi::WiFiState::CONNECTING_SAVED);
+    startConnection(saved_ssid, saved_pass, CustomWiFi::WiFiState::CONNECTING_SAVED, false, &resume_target);
+    resume_target.is_valid = false;
   } else {
     logInfo(k_log_tag, "No saved credentials. Queuing scan...");
     current_state = CustomWiFi::WiFiState::START_SCAN;
   }
 }
 
-void CustomWiFi::WiFiManager::startConnection(const char* ssid, const char* password, WiFiState next_state, bool mask_ssid) {
+void CustomWiFi::WiFiManager::startConnection(const char* ssid, const char* password, WiFiState next_state, bool mask_ssid,
+                                               const BssCandidate* target) {
   WiFi.disconnect(); 
-  yield(); // Feed WDT before intensive radio work
-  WiFi.begin(ssid, password);
-  if (mask_ssid) {
+  watchdogFeed(); // Before intensive radio work
+  if (target != nullptr && target->is_valid) {
+    connect_target = *target;
+    WiFi.begin(ssid, password, target->channel, target->bssid);
+  } else {
+    connect_target = BssCandidate();
+    WiFi.begin(ssid, password);
+  }
+  if (connect_target.is_valid) {
+    char bssid_str[18];
+    formatMacAddress(bssid_str, sizeof(bssid_str), connect_target.bssid);
+    logInfo(k_log_tag, "Trying to connect to WiFi: %s (bssid=%s ch=%d)", mask_ssid ? "<hidden>" : ssid, bssid_str,
+            (int)connect_target.channel);
+  } else if (mask_ssid) {
     logInfo(k_log_tag, "Trying to connect to hidden WiFi.");
   } else {
     logInfo(k_log_tag, "Trying to connect to WiFi: %s", ssid);
@@ -144,14 +173,22 @@ void CustomWiFi::WiFiManager::checkConnectionProgress() {
   if (WiFi.status() == WL_CONNECTED) {
     logInfo(k_log_tag, "WiFi connected.");
     char ip_buffer[16];
-    formatIpAddress(ip_buffer, sizeof(ip_buffer), WiFi.localIP());
+    formatIpAddress(ip_buffer, sizeof(ip_buffer), (uint32_t)WiFi.localIP());
     logInfo(k_log_tag, "IP Address: %s", ip_buffer);
 
+    bool is_from_scan = (current_state == CustomWiFi::WiFiState::CONNECTING_SCANNED ||
+                         current_state == CustomWiFi::WiFiState::CONNECTING_ROAM);
+
     // Only save if we connected via scan and no hidden credentials were provided in flash.
-    if (current_state == CustomWiFi::WiFiState::CONNECTING_SCANNED &&
-        strlen(hidden_ssid) == 0) {
+    if (is_from_scan && strlen(hidden_ssid) == 0 && scanned_index >= 0) {
       logInfo(k_log_tag, "Saving successful credentials to EEPROM...");
-      saveWiFiToEEPROM(WiFi.SSID().c_str(), WiFi.psk().c_str());
+      saveWiFiToEEPROM(k_wifi_table[scanned_index].ssid, k_wifi_table[scanned_index].password);
+    }
+
+    if (current_state == CustomWiFi::WiFiState::CONNECTING_ROAM) {
+      roam_stats.roams++;
+      is_post_rssi_pending = true;
+      roam_connected_ms = millis();
     }
 
     current_state = CustomWiFi::WiFiState::CONNECTED;
@@ -162,7 +199,10 @@ void CustomWiFi::WiFiManager::checkConnectionProgress() {
   if (millis() - last_attempt_time > wifi_connect_timeout_ms) {
     logWarn(k_log_tag, "Connection attempt timed out.");
     WiFi.disconnect();
-    yield();
+    watchdogFeed();
+
+    if (connect_target.is_valid) recordBssidFailure(connect_target.bssid);
+    if (current_state == CustomWiFi::WiFiState::CONNECTING_ROAM) roam_stats.roam_failures++;
 
     if (current_state == CustomWiFi::WiFiState::CONNECTING_SAVED) {
       // If saved creds failed, try scanning
@@ -188,7 +228,7 @@ void CustomWiFi::WiFiManager::startScan() {
   logInfo(k_log_tag, "Starting async WiFi scan...");
   WiFi.mode(WIFI_STA);
   WiFi.disconnect();
-  yield();
+  watchdogFeed();
   WiFi.scanNetworks(true); // 'true' = ASYNC MODE. Returns immediately.
   current_state = CustomWiFi::WiFiState::SCANNING;
 }
@@ -206,29 +246,16 @@ void CustomWiFi::WiFiManager::handleScanResult() {
 
   logInfo(k_log_tag, "Found %d networks.", n);
   
-  int best_index = -1;
-  int best_rssi = -1000;
-
-  // Search for known networks in the scan results
-  for (int i = 0; i < n; ++i) {
-    for (int j = 0; j < k_wifi_count; j++) {
-      if (strcmp(WiFi.SSID(i).c_str(), k_wifi_table[j].ssid) == 0) {
-        if (WiFi.RSSI(i) > best_rssi) {
-          best_rssi = WiFi.RSSI(i);
-          best_index = j;
-        }
-      }
-    }
-    yield();
-  }
-
+  BssCandidate best;
+  selectBestBss(n, best, nullptr);
   WiFi.scanDelete(); // Clean up RAM
 
-  if (best_index != -1) {
-    const char* ssid = k_wifi_table[best_index].ssid;
-    const char* password = k_wifi_table[best_index].password;
-    logInfo(k_log_tag, "Found strongest known SSID: %s (%d dBm)", ssid, best_rssi);
-    startConnection(ssid, password, CustomWiFi::WiFiState::CONNECTING_SCANNED);
+  scanned_index = best.table_index;
+  if (best.is_valid) {
+    const char* ssid = k_wifi_table[best.table_index].ssid;
+    const char* password = k_wifi_table[best.table_index].password;
+    logInfo(k_log_tag, "Found best known SSID: %s (%d dBm, score %d)", ssid, (int)best.rssi, (int)best.score);
+    startConnection(ssid, password, CustomWiFi::WiFiState::CONNECTING_SCANNED, false, &best);
   } else {
     logWarn(k_log_tag, "No known networks found.");
     current_state = CustomWiFi::WiFiState::CONNECTION_FAILED;
@@ -250,3 +277,157 @@ void CustomWiFi::WiFiManager::handleRetry() {
     last_attempt_time = millis();
   }
 }
+
+void CustomWiFi::WiFiManager::setRoamGate(RoamGate gate) {
+  roam_gate = gate;
+}
+
+void CustomWiFi::WiFiManager::setResumeLink(const WiFiLink& link) {
+  if (link.channel == 0) return;
+  resume_target = BssCandidate();
+  resume_target.is_valid = true;
+  memcpy(resume_target.bssid, link.bssid, sizeof(resume_target.bssid));
+  resume_target.channel = link.channel;
+}
+
+// Score every BSSID of a known SSID: RSSI, minus recent association failures,
+// minus co-channel congestion (the SDK does not report per-AP station load).
+// Two passes over the scan results; each SSID is one indexed lookup (raw bss_info, no String copies).
+bool CustomWiFi::WiFiManager::selectBestBss(int scan_count, BssCandidate& best, const uint8_t* exclude_bssid) {
+  uint8_t channel_bss[k_channel_max + 1] = {0};
+  for (int i = 0; i < scan_count; ++i) {
+    const bss_info* info = WiFi.getScanInfoByIndex(i);
+    if (info != nullptr && info->channel <= k_channel_max) channel_bss[info->channel]++;
+  }
+
+  best = BssCandidate();
+  for (int i = 0; i < scan_count; ++i) {
+    const bss_info* info = WiFi.getScanInfoByIndex(i);
+    if (info == nullptr) continue;
+    if (exclude_bssid != nullptr && memcmp(info->bssid, exclude_bssid, sizeof(info->bssid)) == 0) continue;
+    size_t ssid_len = (info->ssid_len < sizeof(info->ssid)) ? info->ssid_len : sizeof(info->ssid);
+
+    int known = known_networks.find(info->ssid, ssid_len);
+    if (known < 0) continue;
+
+    int32_t co_channel = (info->channel <= k_channel_max) ? channel_bss[info->channel] - 1 : 0;
+    if (co_channel > k_channel_load_counted) co_channel = k_channel_load_counted;
+    int32_t score = info->rssi - bssidFailurePenalty(info->bssid) - co_channel * channel_load_penalty_db;
+
+    if (!best.is_valid || score > best.score) {
+      best.is_valid = true;
+      best.table_index = known;
+      memcpy(best.bssid, info->bssid, sizeof(best.bssid));
+      best.channel = info->channel;
+      best.rssi = info->rssi;
+      best.score = score;
+    }
+  }
+  return best.is_valid;
+}
+
+int32_t CustomWiFi::WiFiManager::bssidFailurePenalty(const uint8_t* bssid) {
+  for (const BssidFailure& slot : bssid_failures) {
+    if (slot.count == 0 || memcmp(slot.bssid, bssid, sizeof(slot.bssid)) != 0) continue;
+    if (millis() - slot.last_ms > bssid_failure_forget_ms) return 0;
+    int32_t count = (slot.count < k_bssid_failures_counted) ? slot.count : k_bssid_failures_counted;
+    return count * bssid_failure_penalty_db;
+  }
+  return 0;
+}
+
+void CustomWiFi::WiFiManager::recordBssidFailure(const uint8_t* bssid) {
+  unsigned long now_ms = millis();
+  BssidFailure* target = &bssid_failures[0];
+  for (BssidFailure& slot : bssid_failures) {
+    if (slot.count != 0 && memcmp(slot.bssid, bssid, sizeof(slot.bssid)) == 0) {
+      target = &slot;
+      if (now_ms - slot.last_ms > bssid_failure_forget_ms) slot.count = 0;
+      break;
+    }
+    // Otherwise reuse an empty slot or the least recently failed one
+    if (target->count != 0 && (slot.count == 0 || slot.last_ms < target->last_ms)) target = &slot;
+  }
+
+  if (target->count == 0 || memcmp(target->bssid, bssid, sizeof(target->bssid)) != 0) {
+    memcpy(target->bssid, bssid, sizeof(target->bssid));
+    target->count = 0;
+  }
+  if (target->count < 0xFF) target->count++;
+  target->last_ms = now_ms;
+}
+
+void CustomWiFi::WiFiManager::handleRoaming() {
+  if (is_roam_scanning) {
+    handleRoamScanResult();
+    return;
+  }
+  if (roam_target.is_valid) {
+    tryRoam();
+    return;
+  }
+
+  unsigned long now_ms = millis();
+  if (is_post_rssi_pending && now_ms - roam_connected_ms > roam_settle_ms) {
+    is_post_rssi_pending = false;
+    roam_stats.last_post_rssi = (int8_t)WiFi.RSSI();
+    logInfo(k_log_tag, "Roam complete: %d dBm -> %d dBm", roam_stats.last_pre_rssi, roam_stats.last_post_rssi);
+  }
+
+  if (now_ms - last_roam_check < roam_check_interval_ms) return;
+  last_roam_check = now_ms;
+
+  if (known_networks.size() == 0 || WiFi.status() != WL_CONNECTED) return;
+  int32_t rssi = WiFi.RSSI();
+  if (rssi >= roam_rssi_threshold) return;
+  if (roam_stats.roam_scans > 0 && now_ms - last_roam_scan < roam_scan_cooldown_ms) return;
+
+  // Async scan while staying associated
+  logInfo(k_log_tag, "Weak signal (%d dBm), scanning for a better AP...", (int)rssi);
+  WiFi.scanNetworks(true);
+  is_roam_scanning = true;
+  last_roam_scan = now_ms;
+  roam_stats.roam_scans++;
+}
+
+void CustomWiFi::WiFiManager::handleRoamScanResult() {
+  int n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING) return;
+  is_roam_scanning = false;
+  if (n < 0) return;
+
+  const uint8_t* current_bssid = WiFi.BSSID();
+  int32_t current_rssi = WiFi.RSSI();
+
+  BssCandidate best;
+  selectBestBss(n, best, current_bssid);
+  WiFi.scanDelete();
+
+  if (!best.is_valid || best.score < current_rssi + roam_min_gain_db) {
+    logDebug(k_log_tag, "No better AP (current %d dBm).", (int)current_rssi);
+    return;
+  }
+
+  roam_target = best;
+  roam_target_ms = millis();
+  char bssid_str[18];
+  formatMacAddress(bssid_str, sizeof(bssid_str), best.bssid);
+  logInfo(k_log_tag, "Roam candidate %s (%d dBm, score %d), current %d dBm", bssid_str, (int)best.rssi, (int)best.score, (int)current_rssi);
+}
+
+void CustomWiFi::WiFiManager::tryRoam() {
+  if (millis() - roam_target_ms > roam_target_ttl_ms) {
+    logDebug(k_log_tag, "Roam candidate expired.");
+    roam_target.is_valid = false;
+    return;
+  }
+  if (roam_gate != nullptr && !roam_gate()) return; // Wait for an idle moment
+
+  BssCandidate target = roam_target;
+  roam_target.is_valid = false;
+
+  roam_stats.last_pre_rssi = (int8_t)WiFi.RSSI();
+  scanned_index = target.table_index;
+  const WiFiCredential& credential = k_wifi_table[target.table_index];
+  startConnection(credential.ssid, credential.password, CustomWiFi::WiFiState::CONNECTING_ROAM, false, &target);
+}
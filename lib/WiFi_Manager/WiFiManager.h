@@ -14,6 +14,7 @@
 #include <EEPROM.h>
 
 #include "WiFiData.h" 
+#include "WiFiIndex.h"
 
 namespace CustomWiFi {
 
@@ -25,10 +26,14 @@ namespace CustomWiFi {
     START_SCAN,      
     SCANNING,         
     CONNECTING_SCANNED,
+    CONNECTING_ROAM,
     CONNECTED,
     CONNECTION_FAILED
   };
 
+  // Returns true when a roam (a short disconnect) would not interrupt anything
+  using RoamGate = bool (*)();
+
   class WiFiManager {
   public:
     /**
@@ -63,6 +68,29 @@ namespace CustomWiFi {
      */
     bool connectToHidden(const char* ssid, const char* pass);
 
+    /**
+     * @brief Only roam while the gate allows it (e.g. no IR activity).
+     *
+     * @param gate Callback, or nullptr to roam as soon as a better AP is found.
+     */
+    void setRoamGate(RoamGate gate);
+
+    /**
+     * @brief Make the next connection attempt go straight to this access point.
+     *
+     * Pinning BSSID and channel skips the SDK's sweep over all channels. Used
+     * after a warm boot with the link the previous boot was on; if that
+     * attempt fails, the usual sequence takes over.
+     *
+     * @param link Ignored if its channel is 0.
+     */
+    void setResumeLink(const WiFiLink& link);
+
+    /**
+     * @brief Roaming counters for telemetry.
+     */
+    const WiFiRoamStats& getRoamStats() const { return roam_stats; }
+
   private:
     // --- Configuration ---
     static constexpr size_t ssid_max_len = 32;
@@ -72,6 +100,20 @@ namespace CustomWiFi {
     static constexpr unsigned long wifi_retry_delay_ms = 2000;
     static constexpr unsigned long wifi_check_interval_ms = 30000; // Keep-alive check only
 
+    // Roaming: background scan when the signal is weak, move only for a clear gain
+    static constexpr unsigned long roam_check_interval_ms = 5000;
+    static constexpr int32_t roam_rssi_threshold = -75;          // dBm
+    static constexpr unsigned long roam_scan_cooldown_ms = 60000;
+    static constexpr int32_t roam_min_gain_db = 8;               // Score margin over the current AP
+    static constexpr unsigned long roam_target_ttl_ms = 30000;   // Drop a candidate the gate kept waiting
+    static constexpr unsigned long roam_settle_ms = 3000;        // Delay before sampling post-roam RSSI
+
+    // BSSID scoring
+    static constexpr size_t bssid_failure_slots = 4;
+    static constexpr int32_t bssid_failure_penalty_db = 10;      // Per recent failure (max 3)
+    static constexpr unsigned long bssid_failure_forget_ms = 600000;
+    static constexpr int32_t channel_load_penalty_db = 2;        // Per co-channel BSS (max 5)
+
     struct StoredCredential {
       uint32_t magic;
       char ssid[ssid_max_len];
@@ -79,18 +121,51 @@ namespace CustomWiFi {
     };
     static constexpr uint32_t eeprom_magic = 0xC0FFEE27;
 
+    struct BssCandidate {
+      bool is_valid = false;
+      int table_index = -1;
+      uint8_t bssid[6] = {0};
+      int32_t channel = 0;
+      int32_t rssi = 0;
+      int32_t score = 0;
+    };
+
+    struct BssidFailure {
+      uint8_t bssid[6] = {0};
+      uint8_t count = 0;
+      unsigned long last_ms = 0;
+    };
+
     // --- State ---
     WiFiState current_state;
     unsigned long last_wifi_check = 0;
     unsigned long last_attempt_time = 0;
     int retry_count = 0;
+    int scanned_index = -1; // k_wifi_table entry picked by the last scan
     
+    WiFiIndex known_networks; // Built from k_wifi_table in begin()
+
+    BssCandidate connect_target;  // BSSID pinned by the current attempt, if any
+    BssCandidate roam_target;     // Better AP waiting for the roam gate
+    BssCandidate resume_target;   // AP of the previous boot, for the first attempt
+    BssidFailure bssid_failures[bssid_failure_slots];
+    RoamGate roam_gate = nullptr;
+    WiFiRoamStats roam_stats;
+    bool is_roam_scanning = false;
+    bool is_post_rssi_pending = false;
+    unsigned long last_roam_check = 0;
+    unsigned long last_roam_scan = 0;
+    unsigned long roam_target_ms = 0;
+    unsigned long roam_connected_ms = 0;
+
     char hidden_ssid[ssid_max_len] = {0};
     char hidden_pass[pass_max_len] = {0};
 
     // --- Core Logic ---
+    void buildKnownNetworkIndex();
     void trySavedCredentials();
-    void startConnection(const char* ssid, const char* password, WiFiState next_state, bool mask_ssid = false);
+    void startConnection(const char* ssid, const char* password, WiFiState next_state, bool mask_ssid = false,
+                         const BssCandidate* target = nullptr);
     void checkConnectionProgress();
     
     // Split scan into two phases for non-blocking operation
@@ -98,6 +173,14 @@ namespace CustomWiFi {
     void handleScanResult();
     
     void handleRetry();
+
+    // Roaming
+    bool selectBestBss(int scan_count, BssCandidate& best, const uint8_t* exclude_bssid);
+    int32_t bssidFailurePenalty(const uint8_t* bssid);
+    void recordBssidFailure(const uint8_t* bssid);
+    void handleRoaming();
+    void handleRoamScanResult();
+    void tryRoam();
     void saveWiFiToEEPROM(const char* ssid, const char* password);
     bool readWiFiFromEEPROM(char* ssid, char* password);
   };
@@ -0,0 +1,40 @@
+/*
+ * WiFiData.h
+ *
+ * This file defines the data structures and enumerations used by the
+ * CustomWiFi::WiFiManager library. By separating these definitions, we avoid
+ * circular dependencies between header files.
+ */
+
+#pragma once
+
+#include <stdint.h> // For uint32_t
+
+namespace CustomWiFi {
+  struct WiFiCredential {
+    const char* ssid;
+    const char* password;
+  };
+
+  // Declare the array of credentials as extern
+  extern const WiFiCredential k_wifi_table[];
+
+  // Declare the number of credentials
+  extern const int k_wifi_count;
+
+  // Roaming counters, exported to telemetry
+  struct WiFiRoamStats {
+    uint32_t roam_scans = 0;    // Background scans triggered by a weak signal
+    uint32_t roams = 0;         // Successful moves to another BSSID
+    uint32_t roam_failures = 0; // Roam attempts that did not associate
+    int8_t last_pre_rssi = 0;   // RSSI before the last roam (dBm)
+    int8_t last_post_rssi = 0;  // RSSI shortly after the last roam (dBm)
+  };
+
+  // Access point a connection was on; a warm boot reconnects to it directly
+  struct WiFiLink {
+    uint8_t bssid[6] = {0};
+    uint8_t channel = 0;        // 0 = none
+  };
+
+} // namespace CustomWiFi
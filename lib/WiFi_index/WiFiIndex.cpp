@@ -0,0 +1,71 @@
+// WiFiIndex.cpp
+
+#include "WiFiIndex.h"
+
+#include <string.h>
+
+namespace {
+constexpr uint32_t k_fnv_offset_basis = 2166136261u;
+constexpr uint32_t k_fnv_prime = 16777619u;
+constexpr size_t k_ssid_max_len = 32;
+} // namespace
+
+uint32_t CustomWiFi::hashSSID(const uint8_t* ssid, size_t len) {
+  uint32_t hash = k_fnv_offset_basis;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= ssid[i];
+    hash *= k_fnv_prime;
+  }
+  return hash;
+}
+
+size_t CustomWiFi::WiFiIndex::build(const WiFiCredential* table, int count) {
+  table_ = table;
+  count_ = 0;
+
+  for (int i = 0; i < count && count_ < k_wifi_index_max; ++i) {
+    const char* ssid = table[i].ssid;
+    size_t len = (ssid != nullptr) ? strlen(ssid) : 0;
+    if (len == 0 || len > k_ssid_max_len) continue;
+
+    Entry entry;
+    entry.hash = hashSSID(reinterpret_cast<const uint8_t*>(ssid), len);
+    entry.len = (uint8_t)len;
+    entry.table_index = (uint8_t)i;
+
+    // Insertion sort; strict '>' keeps equal hashes in table order
+    size_t pos = count_;
+    while (pos > 0 && entries_[pos - 1].hash > entry.hash) {
+      entries_[pos] = entries_[pos - 1];
+      --pos;
+    }
+    entries_[pos] = entry;
+    count_++;
+  }
+  return count_;
+}
+
+int CustomWiFi::WiFiIndex::find(const uint8_t* ssid, size_t len) const {
+  if (count_ == 0 || len == 0 || len > k_ssid_max_len) return -1;
+  uint32_t hash = hashSSID(ssid, len);
+
+  // Lower bound on the hash
+  size_t lo = 0;
+  size_t hi = count_;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (entries_[mid].hash < hash) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (size_t i = lo; i < count_ && entries_[i].hash == hash; ++i) {
+    const Entry& entry = entries_[i];
+    if (entry.len == len && memcmp(table_[entry.table_index].ssid, ssid, len) == 0) {
+      return entry.table_index;
+    }
+  }
+  return -1;
+}
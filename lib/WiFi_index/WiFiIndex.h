@@ -0,0 +1,58 @@
+/*
+ * WiFiIndex.h
+ *
+ * Lookup index over the known-network table (k_wifi_table).
+ *
+ * SSIDs are hashed with 32-bit FNV-1a and kept sorted by hash, so each scan
+ * result costs one hash plus a binary search instead of a compare against
+ * every table entry. A hash hit is confirmed with a length + memcmp check.
+ * No Arduino dependencies, so it can be exercised natively.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "WiFiData.h"
+
+namespace CustomWiFi {
+
+  constexpr size_t k_wifi_index_max = 64; // Table entries beyond this are ignored
+
+  /**
+   * @brief 32-bit FNV-1a over raw SSID bytes (SSIDs are not NUL-terminated in bss_info).
+   */
+  uint32_t hashSSID(const uint8_t* ssid, size_t len);
+
+  class WiFiIndex {
+  public:
+    /**
+     * @brief Index a credential table. Duplicate SSIDs resolve to the first entry.
+     *
+     * @return Number of indexed entries.
+     */
+    size_t build(const WiFiCredential* table, int count);
+
+    /**
+     * @brief Look up an SSID.
+     *
+     * @return Index into the credential table, or -1 if the SSID is unknown.
+     */
+    int find(const uint8_t* ssid, size_t len) const;
+
+    size_t size() const { return count_; }
+
+  private:
+    struct Entry {
+      uint32_t hash;
+      uint8_t len;
+      uint8_t table_index;
+    };
+
+    const WiFiCredential* table_ = nullptr;
+    Entry entries_[k_wifi_index_max];
+    size_t count_ = 0;
+  };
+
+} // namespace CustomWiFi
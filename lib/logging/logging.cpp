@@ -1,13 +1,76 @@
 #include "logging.h"
 
-#include <cstdarg>
 #include <cstdio>
+#include <cstring>
 
 namespace {
 
-constexpr size_t k_max_log_length = 512;
+constexpr size_t k_max_message_length = 160;
+constexpr size_t k_max_log_length = 192;   // Serial line, including prefix
+constexpr size_t k_ring_size = LOG_RING_SIZE;
+constexpr uint8_t k_drain_records_max = 4; // Per handleLogging() call
+constexpr const char* k_log_tag = "LOG";
+
+enum class ArgType : uint8_t {
+  Int32,
+  Int64,
+  Double,
+  String,
+  Pointer
+};
+
+struct RecordHeader {
+  uint8_t level;
+  uint8_t arg_len;
+  uint16_t reserved;
+  uint32_t ms;
+  const char* tag;
+  const char* format;
+};
+
 bool g_is_logging_ready = false;
-static char g_log_message[k_max_log_length];
+LogLevel g_log_level = static_cast<LogLevel>((LOG_LEVEL < LOG_LEVEL_MAX) ? LOG_LEVEL : LOG_LEVEL_MAX);
+LogSink g_log_sink = nullptr;
+
+uint8_t g_ring[k_ring_size];
+size_t g_ring_head = 0; // Next write
+size_t g_ring_tail = 0; // Next read
+size_t g_ring_used = 0;
+uint32_t g_dropped = 0;
+uint32_t g_dropped_reported = 0;
+
+// Line being written to Serial
+char g_log_message[k_max_message_length];
+char g_log_line[k_max_log_length];
+size_t g_line_len = 0;
+size_t g_line_sent = 0;
+
+void ringWrite(const void* src, size_t len) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(src);
+  size_t first = k_ring_size - g_ring_head;
+  if (first > len) first = len;
+  memcpy(g_ring + g_ring_head, bytes, first);
+  memcpy(g_ring, bytes + first, len - first);
+  g_ring_head = (g_ring_head + len) % k_ring_size;
+  g_ring_used += len;
+}
+
+void ringRead(void* dst, size_t len) {
+  uint8_t* bytes = static_cast<uint8_t*>(dst);
+  size_t first = k_ring_size - g_ring_tail;
+  if (first > len) first = len;
+  memcpy(bytes, g_ring + g_ring_tail, first);
+  memcpy(bytes + first, g_ring, len - first);
+  g_ring_tail = (g_ring_tail + len) % k_ring_size;
+  g_ring_used -= len;
+}
+
+void putArg(LogArgWriter& writer, ArgType type, const void* value, size_t len) {
+  if (writer.len + 1 + len > sizeof(writer.data)) return; // Missing args print as '?'
+  writer.data[writer.len++] = static_cast<uint8_t>(type);
+  memcpy(writer.data + writer.len, value, len);
+  writer.len += len;
+}
 
 const char* levelToString(LogLevel level) {
   switch (level) {
@@ -19,20 +82,163 @@ const char* levelToString(LogLevel level) {
   return "INFO";
 }
 
-bool isLogEnabled(LogLevel level) {
-  return static_cast<uint8_t>(level) <= LOG_LEVEL;
+// Walks the encoded arguments of one record
+class ArgReader {
+public:
+  ArgReader(const uint8_t* data, size_t len) : data_(data), len_(len) {}
+
+  bool next(ArgType& type, const uint8_t*& value, size_t& value_len) {
+    if (pos_ >= len_) return false;
+    type = static_cast<ArgType>(data_[pos_++]);
+    switch (type) {
+      case ArgType::Int32:   value_len = 4; break;
+      case ArgType::Int64:   value_len = 8; break;
+      case ArgType::Double:  value_len = sizeof(double); break;
+      case ArgType::Pointer: value_len = sizeof(const void*); break;
+      case ArgType::String:  value_len = 1 + data_[pos_]; break;
+      default: return false;
+    }
+    if (pos_ + value_len > len_) return false;
+    value = data_ + pos_;
+    pos_ += value_len;
+    return true;
+  }
+
+private:
+  const uint8_t* data_;
+  size_t len_;
+  size_t pos_ = 0;
+};
+
+int64_t readInteger(ArgType type, const uint8_t* value) {
+  if (type == ArgType::Int64) {
+    int64_t v;
+    memcpy(&v, value, sizeof(v));
+    return v;
+  }
+  if (type == ArgType::Int32) {
+    int32_t v;
+    memcpy(&v, value, sizeof(v));
+    return v;
+  }
+  return 0;
 }
 
-void logMessage(LogLevel level, const char* tag, const char* format, va_list args) {
-  if (!isLogEnabled(level)) return;
-  if (!g_is_logging_ready) return;
+// Formats one conversion spec (e.g. "%02X") with a stored argument
+int formatArg(char* out, size_t len, const char* spec, size_t spec_len, ArgType type, const uint8_t* value) {
+  char fmt[16];
+  if (spec_len >= sizeof(fmt)) return snprintf(out, len, "?");
+  memcpy(fmt, spec, spec_len);
+  fmt[spec_len] = '\0';
 
-  vsnprintf(g_log_message, sizeof(g_log_message), format, args);
+  char conv = spec[spec_len - 1];
+  bool is_long_long = (spec_len >= 3 && spec[spec_len - 2] == 'l' && spec[spec_len - 3] == 'l');
+  bool is_long = !is_long_long && spec[spec_len - 2] == 'l';
 
-  const char* level_str = levelToString(level);
+  switch (conv) {
+    case 'd': case 'i': {
+      int64_t v = readInteger(type, value);
+      if (is_long_long) return snprintf(out, len, fmt, (long long)v);
+      if (is_long) return snprintf(out, len, fmt, (long)v);
+      return snprintf(out, len, fmt, (int)v);
+    }
+    case 'u': case 'x': case 'X': case 'o': case 'c': {
+      uint64_t v = (uint64_t)readInteger(type, value);
+      if (type == ArgType::Int32) v &= 0xFFFFFFFFULL; // Stored sign-extended
+      if (is_long_long) return snprintf(out, len, fmt, (unsigned long long)v);
+      if (is_long) return snprintf(out, len, fmt, (unsigned long)v);
+      return snprintf(out, len, fmt, (unsigned int)v);
+    }
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+      double v = 0;
+      if (type == ArgType::Double) memcpy(&v, value, sizeof(v));
+      else v = (double)readInteger(type, value);
+      return snprintf(out, len, fmt, v);
+    }
+    case 's':
+      if (type != ArgType::String) return snprintf(out, len, "?");
+      {
+        char text[k_log_string_max + 1];
+        memcpy(text, value + 1, value[0]);
+        text[value[0]] = '\0';
+        return snprintf(out, len, fmt, text);
+      }
+    case 'p': {
+      const void* v = nullptr;
+      if (type == ArgType::Pointer) memcpy(&v, value, sizeof(v));
+      return snprintf(out, len, fmt, v);
+    }
+    default:
+      return snprintf(out, len, "%s", fmt);
+  }
+}
+
+// Message text only (no prefix, no newline)
+void formatMessage(const RecordHeader& header, const uint8_t* args, char* out, size_t len) {
+  size_t pos = 0;
+  ArgReader reader(args, header.arg_len);
+  const char* p = header.format;
+  while (*p != '\0' && pos < len - 1) {
+    if (*p != '%') {
+      out[pos++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[pos++] = '%';
+      p += 2;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion
+    const char* spec = p++;
+    while (*p != '\0' && strchr("-+ #0123456789.hljzt", *p) != nullptr) p++;
+    if (*p == '\0') break;
+    size_t spec_len = (size_t)(++p - spec);
+
+    ArgType type;
+    const uint8_t* value;
+    size_t value_len;
+    int n = reader.next(type, value, value_len)
+      ? formatArg(out + pos, len - pos, spec, spec_len, type, value)
+      : snprintf(out + pos, len - pos, "?");
+    if (n > 0) pos += (size_t)n;
+    if (pos > len - 1) pos = len - 1;
+  }
+  out[pos] = '\0';
+}
+
+void emitLine(LogLevel level, uint32_t ms, const char* tag, const char* message) {
   const char* tag_str = (tag != nullptr) ? tag : "GEN";
+  if (g_log_sink != nullptr) g_log_sink(level, ms, tag_str, message);
 
-  Serial.printf("[%s] [%s] %s\n", level_str, tag_str, g_log_message);
+#if LOG_SERIAL_ENABLE
+  int n = snprintf(g_log_line, sizeof(g_log_line), "[%s] [%s] %s\n", levelToString(level), tag_str, message);
+  g_line_len = (n < 0) ? 0 : ((size_t)n < sizeof(g_log_line) ? (size_t)n : sizeof(g_log_line) - 1);
+#else
+  g_line_len = 0;
+#endif
+  g_line_sent = 0;
+}
+
+// Pops the next record into g_log_line; false if there is nothing to write.
+// Drops are reported once the records queued before them are out.
+bool loadNextLine() {
+  if (g_ring_used == 0 && g_dropped != g_dropped_reported) {
+    snprintf(g_log_message, sizeof(g_log_message), "%u log records dropped", (unsigned int)(g_dropped - g_dropped_reported));
+    g_dropped_reported = g_dropped;
+    emitLine(LogLevel::Warn, millis(), k_log_tag, g_log_message);
+    return true;
+  }
+  if (g_ring_used == 0) return false;
+
+  RecordHeader header;
+  uint8_t args[k_log_args_max];
+  ringRead(&header, sizeof(header));
+  ringRead(args, header.arg_len);
+
+  formatMessage(header, args, g_log_message, sizeof(g_log_message));
+  emitLine(static_cast<LogLevel>(header.level), header.ms, header.tag, g_log_message);
+  return true;
 }
 
 } // namespace
@@ -41,30 +247,147 @@ void initLogging() {
   g_is_logging_ready = true;
 }
 
-void logError(const char* tag, const char* format, ...) {
-  va_list args;
-  va_start(args, format);
-  logMessage(LogLevel::Error, tag, format, args);
-  va_end(args);
+bool isLogEnabled(LogLevel level) {
+  if (!g_is_logging_ready || level > g_log_level) return false;
+  return LOG_SERIAL_ENABLE || g_log_sink != nullptr;
+}
+
+void setLogSink(LogSink sink) {
+  g_log_sink = sink;
 }
 
-void logWarn(const char* tag, const char* format, ...) {
-  va_list args;
-  va_start(args, format);
-  logMessage(LogLevel::Warn, tag, format, args);
-  va_end(args);
+void setLogLevel(LogLevel level) {
+  if (static_cast<uint8_t>(level) > LOG_LEVEL_MAX) level = static_cast<LogLevel>(LOG_LEVEL_MAX);
+  g_log_level = level;
 }
 
-void logInfo(const char* tag, const char* format, ...) {
-  va_list args;
-  va_start(args, format);
-  logMessage(LogLevel::Info, tag, format, args);
-  va_end(args);
+LogLevel getLogLevel() {
+  return g_log_level;
+}
+
+const char* logLevelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::Error: return "error";
+    case LogLevel::Warn:  return "warn";
+    case LogLevel::Info:  return "info";
+    case LogLevel::Debug: return "debug";
+  }
+  return "info";
+}
+
+bool parseLogLevel(const char* name, LogLevel& level) {
+  if (name == nullptr) return false;
+  for (uint8_t i = 0; i <= static_cast<uint8_t>(LogLevel::Debug); ++i) {
+    if (strcmp(name, logLevelName(static_cast<LogLevel>(i))) == 0) {
+      level = static_cast<LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void writeLogArg(LogArgWriter& writer, int value) {
+  int32_t v = value;
+  putArg(writer, ArgType::Int32, &v, sizeof(v));
+}
+
+void writeLogArg(LogArgWriter& writer, unsigned int value) {
+  uint32_t v = value;
+  putArg(writer, ArgType::Int32, &v, sizeof(v));
+}
+
+// long is 32-bit on the ESP8266, 64-bit on native builds
+void writeLogArg(LogArgWriter& writer, long value) {
+  if (sizeof(long) == sizeof(int32_t)) {
+    writeLogArg(writer, (int)value);
+  } else {
+    writeLogArg(writer, (long long)value);
+  }
+}
+
+void writeLogArg(LogArgWriter& writer, unsigned long value) {
+  if (sizeof(unsigned long) == sizeof(uint32_t)) {
+    writeLogArg(writer, (unsigned int)value);
+  } else {
+    writeLogArg(writer, (unsigned long long)value);
+  }
+}
+
+void writeLogArg(LogArgWriter& writer, long long value) {
+  int64_t v = value;
+  putArg(writer, ArgType::Int64, &v, sizeof(v));
+}
+
+void writeLogArg(LogArgWriter& writer, unsigned long long value) {
+  uint64_t v = value;
+  putArg(writer, ArgType::Int64, &v, sizeof(v));
+}
+
+void writeLogArg(LogArgWriter& writer, double value) {
+  putArg(writer, ArgType::Double, &value, sizeof(value));
+}
+
+void writeLogArg(LogArgWriter& writer, const char* value) {
+  if (value == nullptr) value = "(null)";
+  size_t len = strnlen(value, k_log_string_max);
+  if (writer.len + 2 + len > sizeof(writer.data)) return;
+  writer.data[writer.len++] = static_cast<uint8_t>(ArgType::String);
+  writer.data[writer.len++] = (uint8_t)len;
+  memcpy(writer.data + writer.len, value, len);
+  writer.len += len;
+}
+
+void writeLogArg(LogArgWriter& writer, const void* value) {
+  putArg(writer, ArgType::Pointer, &value, sizeof(value));
+}
+
+void pushLogRecord(LogLevel level, const char* tag, const char* format, const LogArgWriter& writer) {
+  size_t record_len = sizeof(RecordHeader) + writer.len;
+  if (k_ring_size - g_ring_used < record_len) {
+    g_dropped++;
+    return;
+  }
+
+  RecordHeader header;
+  header.level = static_cast<uint8_t>(level);
+  header.arg_len = (uint8_t)writer.len;
+  header.reserved = 0;
+  header.ms = millis();
+  header.tag = tag;
+  header.format = format;
+  ringWrite(&header, sizeof(header));
+  ringWrite(writer.data, writer.len);
+}
+
+void handleLogging() {
+  if (!g_is_logging_ready) return;
+
+  for (uint8_t i = 0; i < k_drain_records_max; ++i) {
+    if (g_line_sent >= g_line_len && !loadNextLine()) return;
+    if (g_line_len == 0) continue; // Sink only
+
+    size_t room = (size_t)Serial.availableForWrite();
+    size_t remaining = g_line_len - g_line_sent;
+    size_t chunk = (room < remaining) ? room : remaining;
+    if (chunk > 0) {
+      Serial.write(reinterpret_cast<const uint8_t*>(g_log_line + g_line_sent), chunk);
+      g_line_sent += chunk;
+    }
+    if (g_line_sent < g_line_len) return; // UART FIFO full, continue next loop
+  }
+}
+
+void flushLogs() {
+  if (!g_is_logging_ready) return;
+
+  while (g_line_sent < g_line_len || loadNextLine()) {
+    if (g_line_len > g_line_sent) {
+      Serial.write(reinterpret_cast<const uint8_t*>(g_log_line + g_line_sent), g_line_len - g_line_sent);
+    }
+    g_line_sent = g_line_len;
+  }
 }
 
-void logDebug(const char* tag, const char* format, ...) {
-  va_list args;
-  va_start(args, format);
-  logMessage(LogLevel::Debug, tag, format, args);
-  va_end(args);
+uint32_t getLogDropCount() {
+  return g_dropped;
 }
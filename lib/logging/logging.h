@@ -1,13 +1,36 @@
 #pragma once
 
+/*
+ * logging.h
+ *
+ * Deferred, ring-buffered logger.
+ *
+ * - A log call stores a binary record (level, tag pointer, format pointer and
+ *   the raw arguments) in a RAM ring; no formatting or UART I/O happens on the
+ *   caller's path.
+ * - handleLogging() formats queued records and writes them to Serial only as
+ *   far as the UART FIFO has room, so it never blocks. An optional sink (e.g.
+ *   the MQTT log stream) receives every formatted record as well.
+ * - LOG_LEVEL is the initial runtime level (setLogLevel() changes it); levels
+ *   above LOG_LEVEL_MAX compile out entirely (arguments are not evaluated).
+ * - Tags and formats must be string literals (only the pointer is kept);
+ *   %s arguments are copied, truncated to k_log_string_max characters.
+ */
+
 #include <Arduino.h>
 #include <cstdint>
+#include <initializer_list>
 
 #ifndef LOG_LEVEL
   // Default to Info to keep production logs useful without Debug noise.
   #define LOG_LEVEL 2
 #endif
 
+#ifndef LOG_LEVEL_MAX
+  // Highest level compiled in; Debug stays available for runtime debugging.
+  #define LOG_LEVEL_MAX 3
+#endif
+
 // Controls whether Serial logging output is enabled (0/1).
 // Default is enabled to keep Error/Warn/Info visible in production.
 // Logging verbosity is still gated by LOG_LEVEL.
@@ -15,6 +38,10 @@
   #define LOG_SERIAL_ENABLE 1
 #endif
 
+#ifndef LOG_RING_SIZE
+  #define LOG_RING_SIZE 1024 // Bytes of queued records
+#endif
+
 #ifndef LOG_MQTT_ERROR_CONTEXT_MIN_LOG_LEVEL
   // MQTT /error publishing is enabled when:
   // LOG_LEVEL >= LOG_MQTT_ERROR_CONTEXT_MIN_LOG_LEVEL
@@ -33,16 +60,110 @@ enum class LogLevel : uint8_t {
   Debug = 3,
 };
 
+constexpr size_t k_log_args_max = 96;   // Encoded argument bytes per record
+constexpr size_t k_log_string_max = 48; // Characters kept per %s argument
+
 /**
  * @brief Initialize logging after Serial.begin().
  *
- * LOG_SERIAL_ENABLE controls Serial initialization.
- * LOG_LEVEL controls local log verbosity.
+ * LOG_SERIAL_ENABLE controls Serial output.
+ * LOG_LEVEL sets the initial runtime verbosity.
  * LOG_MQTT_ERROR_CONTEXT_MIN_LOG_LEVEL controls MQTT /error publishing threshold.
  */
 void initLogging();
 
-void logError(const char* tag, const char* format, ...);
-void logWarn(const char* tag, const char* format, ...);
-void logInfo(const char* tag, const char* format, ...);
-void logDebug(const char* tag, const char* format, ...);
+/**
+ * @brief Receives each formatted record (message without prefix or newline).
+ */
+using LogSink = void (*)(LogLevel level, uint32_t ms, const char* tag, const char* message);
+
+/**
+ * @brief Install or remove (nullptr) the secondary log sink.
+ */
+void setLogSink(LogSink sink);
+
+/**
+ * @brief Change the runtime log level (capped at LOG_LEVEL_MAX).
+ */
+void setLogLevel(LogLevel level);
+
+LogLevel getLogLevel();
+
+/**
+ * @brief Level name ("error", "warn", "info", "debug").
+ */
+const char* logLevelName(LogLevel level);
+
+/**
+ * @brief Parse a level name as returned by logLevelName().
+ *
+ * @return false if the name is unknown.
+ */
+bool parseLogLevel(const char* name, LogLevel& level);
+
+/**
+ * @brief Write queued records to Serial and the sink without blocking (call from loop()).
+ */
+void handleLogging();
+
+/**
+ * @brief Write all queued records to Serial, blocking until done.
+ */
+void flushLogs();
+
+/**
+ * @brief Records lost because the ring was full.
+ */
+uint32_t getLogDropCount();
+
+// --- Record encoding (used by the log macros) ---
+
+struct LogArgWriter {
+  uint8_t data[k_log_args_max];
+  size_t len = 0;
+};
+
+bool isLogEnabled(LogLevel level);
+
+void writeLogArg(LogArgWriter& writer, int value);
+void writeLogArg(LogArgWriter& writer, unsigned int value);
+void writeLogArg(LogArgWriter& writer, long value);
+void writeLogArg(LogArgWriter& writer, unsigned long value);
+void writeLogArg(LogArgWriter& writer, long long value);
+void writeLogArg(LogArgWriter& writer, unsigned long long value);
+void writeLogArg(LogArgWriter& writer, double value);
+void writeLogArg(LogArgWriter& writer, const char* value);
+void writeLogArg(LogArgWriter& writer, const void* value);
+
+void pushLogRecord(LogLevel level, const char* tag, const char* format, const LogArgWriter& writer);
+
+template <typename... Args>
+void logDeferred(LogLevel level, const char* tag, const char* format, const Args&... args) {
+  if (!isLogEnabled(level)) return;
+  LogArgWriter writer;
+  (void)std::initializer_list<int>{(writeLogArg(writer, args), 0)...};
+  pushLogRecord(level, tag, format, writer);
+}
+
+// Disabled levels keep type checking but generate no code
+#define LOG_DISABLED_CALL(...) do { if (false) logDeferred(LogLevel::Debug, __VA_ARGS__); } while (0)
+
+#define logError(tag, ...) logDeferred(LogLevel::Error, tag, __VA_ARGS__)
+
+#if LOG_LEVEL_MAX >= 1
+  #define logWarn(tag, ...) logDeferred(LogLevel::Warn, tag, __VA_ARGS__)
+#else
+  #define logWarn(tag, ...) LOG_DISABLED_CALL(tag, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_MAX >= 2
+  #define logInfo(tag, ...) logDeferred(LogLevel::Info, tag, __VA_ARGS__)
+#else
+  #define logInfo(tag, ...) LOG_DISABLED_CALL(tag, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_MAX >= 3
+  #define logDebug(tag, ...) logDeferred(LogLevel::Debug, tag, __VA_ARGS__)
+#else
+  #define logDebug(tag, ...) LOG_DISABLED_CALL(tag, __VA_ARGS__)
+#endif
@@ -0,0 +1,446 @@
+#!/usr/bin/env python3
+"""
+Staged OTA rollout with health gating for the IR transceiver fleet.
+
+  fleet_rollout.py --image NEW.bin --version V [--base V0=OLD.bin ...]
+                   [--canary 3 | --canary-device F/R/U ...] [--waves 10,50,100]
+                   [--soak 600] [--report rollout.json]
+
+The fleet is discovered from the retained deployment topics. A few canary
+devices are updated first, then the rest of the fleet in waves (cumulative
+percentages of the devices left after the canaries). Each wave is offered the
+release (same offers, patches and chunk answers as ota_server.py serve, at most
+--concurrency downloads at a time) and every updated device soaks for --soak
+seconds on the new firmware. A device is unhealthy if, after its update, it
+
+  - reboots with a crash reset reason (Hardware/Software Watchdog, Exception)
+    or comes back on another version,
+  - reports more than --max-ir-fail new cmd_fail_ir or --max-mqtt-disc new
+    mqtt_disc in its metrics, counted from its first metrics on the new image,
+  - fails the download or does not finish it within --update-timeout,
+  - is not sending heartbeats when its soak ends.
+
+The canaries tolerate no unhealthy device, later waves --max-unhealthy-pct. As
+soon as a wave goes over, the rollout halts: open offers are withdrawn (the
+devices abandon the download and keep running their current image), a report
+is written and the exit status is 1.
+
+All MQTT traffic goes through one connection. Messages are handed from the
+network thread to an asyncio loop and handled in batches; chunk frames are
+built once per release and shared, so one process keeps up with thousands of
+devices.
+
+Requires paho-mqtt (pip install paho-mqtt).
+"""
+
+import argparse
+import asyncio
+import collections
+import json
+import math
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ota_server import CHUNK_SIZE, Release  # noqa: E402
+
+CRASH_RESETS = {"Hardware Watchdog", "Exception", "Software Watchdog"}
+BATCH = 500         # Messages handled before yielding to the scheduler
+TICK_S = 0.5        # Wave scheduler period
+PROGRESS_S = 10     # Wave status line period
+
+
+def log(message):
+    sys.stdout.write("%s %s\n" % (time.strftime("%H:%M:%S"), message))  # One write: also called from the network thread
+    sys.stdout.flush()
+
+
+class Device:
+    __slots__ = ("path", "version", "reset_reason", "online", "last_seen", "wave", "state", "reason",
+                 "from_version", "offered_at", "updated_at", "crashes", "counters", "deltas")
+
+    def __init__(self, path):
+        self.path = path
+        self.version = ""
+        self.reset_reason = ""
+        self.online = None      # None until a heartbeat or LWT is seen
+        self.last_seen = 0.0
+        self.wave = None
+        self.state = "idle"     # idle, pending, offered, soaking, healthy, unhealthy
+        self.reason = ""
+        self.from_version = ""
+        self.offered_at = 0.0
+        self.updated_at = 0.0
+        self.crashes = 0
+        self.counters = {}      # Last reported value of each watched counter
+        self.deltas = {}        # Increase since the first metrics on the new image
+
+    def summary(self):
+        return {
+            "wave": self.wave, "state": self.state, "reason": self.reason, "from": self.from_version,
+            "version": self.version, "reset_reason": self.reset_reason, "crashes": self.crashes,
+            "cmd_fail_ir": self.deltas.get("cmd_fail_ir", 0), "mqtt_disc": self.deltas.get("mqtt_disc", 0),
+        }
+
+
+class Wave:
+    def __init__(self, name, devices, tolerance):
+        self.name = name
+        self.devices = devices
+        self.tolerance = tolerance
+
+    def unhealthy(self):
+        return sum(1 for dev in self.devices if dev.state == "unhealthy")
+
+    def is_finished(self):
+        return all(dev.state in ("healthy", "unhealthy") for dev in self.devices)
+
+
+class Rollout:
+    def __init__(self, args, release):
+        self.args = args
+        self.release = release
+        self.devices = {}
+        self.waves = []
+        self.targets = tuple(args.target)
+        self.root_len = len(args.state_root.split("/"))
+        self.watched = {"cmd_fail_ir": args.max_ir_fail, "mqtt_disc": args.max_mqtt_disc}
+        self.inbox = collections.deque()
+        self.is_wake_pending = False
+        self.stats = collections.Counter()
+        self.client = None
+        self.loop = None
+        self.wakeup = None
+
+    # ─────────────────────────────────────────
+    # MQTT (network thread)
+    # ─────────────────────────────────────────
+    def connect(self):
+        import paho.mqtt.client as mqtt
+
+        if hasattr(mqtt, "CallbackAPIVersion"):  # paho-mqtt 2.x
+            client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        else:
+            client = mqtt.Client()
+        if self.args.user:
+            client.username_pw_set(self.args.user, self.args.password)
+        client.max_inflight_messages_set(200)
+        client.max_queued_messages_set(0)
+        client.on_connect = self.on_connect
+        client.on_message = self.on_message
+        client.connect(self.args.broker, self.args.port, 45)
+        client.loop_start()
+        self.client = client
+
+    def on_connect(self, client, userdata, flags, rc, *extra):
+        root = self.args.state_root
+        client.subscribe([("%s/+/+/+/deployment" % root, 1), ("%s/+/+/+/diagnostics" % root, 0),
+                          ("%s/+/+/+/metrics" % root, 0), ("%s/+/+/+/ota" % root, 0),
+                          ("%s/+/+/+/ota/request" % root, 0)])
+        log("connected to %s:%d" % (self.args.broker, self.args.port))
+
+    def on_message(self, client, userdata, msg):
+        self.inbox.append((msg.topic, msg.payload, msg.retain))
+        if not self.is_wake_pending:
+            self.is_wake_pending = True
+            self.loop.call_soon_threadsafe(self.wakeup.set)
+
+    def publish_offer(self, dev, payload):
+        self.client.publish("%s/%s/ota" % (self.args.control_root, dev.path), payload, qos=1, retain=True)
+
+    # ─────────────────────────────────────────
+    # Message handling (event loop)
+    # ─────────────────────────────────────────
+    async def pump(self):
+        while True:
+            await self.wakeup.wait()
+            self.wakeup.clear()
+            self.is_wake_pending = False
+            while self.inbox:
+                for _ in range(min(BATCH, len(self.inbox))):
+                    self.dispatch(*self.inbox.popleft())
+                await asyncio.sleep(0)
+
+    def dispatch(self, topic, payload, is_retained):
+        parts = topic.split("/")
+        path = "/".join(parts[self.root_len:self.root_len + 3])
+        kind = "/".join(parts[self.root_len + 3:])
+        if self.targets and not path.startswith(self.targets):
+            return
+        self.stats[kind] += 1
+        try:
+            doc = json.loads(payload) if payload else {}
+            if not isinstance(doc, dict):
+                return
+            if kind == "ota/request":
+                self.on_request(path, doc)
+                return
+            dev = self.devices.get(path)
+            if dev is None:
+                if kind != "deployment":
+                    return  # Unknown until its deployment record is seen
+                dev = self.devices[path] = Device(path)
+            if kind == "deployment":
+                self.on_deployment(dev, doc, is_retained)
+            elif kind == "diagnostics":
+                self.on_diagnostics(dev, doc)
+            elif kind == "metrics":
+                self.on_metrics(dev, doc)
+            elif kind == "ota":
+                self.on_ota_status(dev, doc, is_retained)
+        except (ValueError, TypeError) as err:
+            self.stats["invalid"] += 1
+            if self.args.verbose:
+                log("ignored %s: %s" % (topic, err))
+
+    def on_request(self, path, req):
+        dev = self.devices.get(path)
+        if dev is None or dev.state != "offered":
+            return
+        chunk_topic = "%s/%s/ota/chunk" % (self.args.control_root, path)
+        for frame in self.release.answer(req):
+            self.client.publish(chunk_topic, frame, qos=0)
+            self.stats["chunks_sent"] += 1
+
+    def on_deployment(self, dev, doc, is_retained):
+        dev.version = doc.get("version_hash", "")
+        dev.reset_reason = doc.get("reset_reason", "")
+        if not is_retained:
+            dev.online = True
+            dev.last_seen = time.monotonic()
+
+        if dev.state == "offered" and dev.version == self.release.version:
+            dev.state = "soaking"
+            dev.updated_at = time.monotonic()
+            dev.counters = {}  # The first metrics on the new image are the baseline
+            self.publish_offer(dev, b"")  # Done: withdraw
+            if self.args.verbose:
+                log("%s: running %s, soaking" % (dev.path, dev.version))
+            if dev.reset_reason in CRASH_RESETS:
+                self.mark_unhealthy(dev, "crash (%s)" % dev.reset_reason)
+            return
+        if dev.updated_at == 0.0 or is_retained:
+            return
+        # Any later boot of an updated device
+        if dev.reset_reason in CRASH_RESETS:
+            dev.crashes += 1
+            self.mark_unhealthy(dev, "crash (%s)" % dev.reset_reason)
+        elif dev.version != self.release.version:
+            self.mark_unhealthy(dev, "came back on %s" % dev.version)
+
+    def on_diagnostics(self, dev, doc):
+        dev.online = doc.get("status") != "offline"
+        if dev.online:
+            dev.last_seen = time.monotonic()
+
+    def on_metrics(self, dev, doc):
+        dev.online = True
+        dev.last_seen = time.monotonic()
+        if dev.updated_at == 0.0:
+            return
+        for key, limit in self.watched.items():
+            value = int(doc.get(key, 0))
+            previous = dev.counters.get(key)
+            dev.counters[key] = value
+            # Counters carry over warm boots, so only a cold boot lowers them;
+            # what it lost cannot be told apart, so it only sets a new baseline
+            if previous is None or value < previous:
+                continue
+            dev.deltas[key] = dev.deltas.get(key, 0) + value - previous
+            if dev.deltas[key] > limit:
+                self.mark_unhealthy(dev, "%s +%d" % (key, dev.deltas[key]))
+
+    def on_ota_status(self, dev, doc, is_retained):
+        if is_retained or dev.state != "offered" or doc.get("version") != self.release.version:
+            return
+        if doc.get("status") == "failed":
+            self.mark_unhealthy(dev, "download failed (%s)" % doc.get("error", "?"))
+
+    def mark_unhealthy(self, dev, reason):
+        if dev.state == "unhealthy" or dev.wave is None:
+            return
+        if dev.state == "offered":
+            self.publish_offer(dev, b"")
+        dev.state = "unhealthy"
+        dev.reason = reason
+        log("%s: UNHEALTHY, %s" % (dev.path, reason))
+
+    # ─────────────────────────────────────────
+    # Waves
+    # ─────────────────────────────────────────
+    def plan(self):
+        eligible, skipped = [], []
+        for dev in sorted(self.devices.values(), key=lambda d: d.path):
+            if dev.version == self.release.version:
+                continue
+            (skipped if dev.online is False else eligible).append(dev)
+        for dev in skipped:
+            log("%s: offline, left out" % dev.path)
+
+        if self.args.canary_device:
+            canaries = [dev for dev in eligible if dev.path in self.args.canary_device]
+        else:
+            # Evenly spaced over the sorted paths, so the canaries span floors
+            count = min(self.args.canary, len(eligible))
+            canaries = [eligible[i * len(eligible) // count] for i in range(count)] if count else []
+        rest = [dev for dev in eligible if dev not in canaries]
+
+        if canaries:
+            self.waves.append(Wave("canary", canaries, 0))
+        done = 0
+        for number, percent in enumerate(self.args.waves, 1):
+            upto = min(len(rest), int(math.ceil(len(rest) * percent / 100.0)))
+            if upto > done:
+                devices = rest[done:upto]
+                tolerance = int(len(devices) * self.args.max_unhealthy_pct / 100.0)
+                self.waves.append(Wave("wave %d" % number, devices, tolerance))
+                done = upto
+        for wave in self.waves:
+            for dev in wave.devices:
+                dev.wave = wave.name
+                dev.state = "pending"
+        log("%d devices, %d to update, %d offline: %s" % (
+            len(self.devices), len(eligible), len(skipped),
+            ", ".join("%s %d" % (wave.name, len(wave.devices)) for wave in self.waves) or "nothing to do"))
+
+    def offer(self, dev):
+        dev.state = "offered"
+        dev.from_version = dev.version
+        dev.offered_at = time.monotonic()
+        payload = json.dumps(self.release.offer(dev.version), separators=(",", ":"))
+        self.publish_offer(dev, payload)
+
+    def step(self, wave):
+        """Advance one wave; returns the name of a wave over its tolerance, if any."""
+        now = time.monotonic()
+        active = 0
+        for dev in wave.devices:
+            if dev.state == "offered":
+                if now - dev.offered_at > self.args.update_timeout:
+                    self.mark_unhealthy(dev, "no update after %ds" % self.args.update_timeout)
+                else:
+                    active += 1
+            elif dev.state == "soaking" and now - dev.updated_at >= self.args.soak:
+                if not dev.online or now - dev.last_seen > self.args.stale:
+                    self.mark_unhealthy(dev, "silent at the end of the soak")
+                else:
+                    dev.state = "healthy"
+        for dev in wave.devices:
+            if active >= self.args.concurrency:
+                break
+            if dev.state == "pending":
+                self.offer(dev)
+                active += 1
+        # Earlier waves stay watched: a late crash still counts against them
+        for done in self.waves:
+            if done.unhealthy() > done.tolerance:
+                return done.name
+            if done is wave:
+                break
+        return None
+
+    def halt(self, wave_name):
+        for dev in self.devices.values():
+            if dev.state == "offered":
+                self.publish_offer(dev, b"")
+                dev.state = "pending"
+        log("HALTED: %s over its limit, open offers withdrawn" % wave_name)
+
+    async def run(self):
+        self.loop = asyncio.get_running_loop()
+        self.wakeup = asyncio.Event()
+        pump = asyncio.create_task(self.pump())
+        self.connect()
+
+        log("discovering devices for %ds" % self.args.discover)
+        await asyncio.sleep(self.args.discover)
+        self.plan()
+        if self.args.dry_run:
+            return self.finish("planned", pump)
+
+        for wave in self.waves:
+            started = last_progress = time.monotonic()
+            log("%s: %d devices, %d unhealthy allowed" % (wave.name, len(wave.devices), wave.tolerance))
+            while True:
+                failed = self.step(wave)
+                if failed:
+                    self.halt(failed)
+                    return self.finish("halted", pump, failed)
+                if wave.is_finished():
+                    break
+                if time.monotonic() - last_progress >= PROGRESS_S:
+                    last_progress = time.monotonic()
+                    states = collections.Counter(dev.state for dev in wave.devices)
+                    log("%s: %s" % (wave.name, ", ".join("%d %s" % (n, state) for state, n in sorted(states.items()))))
+                await asyncio.sleep(TICK_S)
+            log("%s: passed in %ds (%d unhealthy)" % (wave.name, time.monotonic() - started, wave.unhealthy()))
+        return self.finish("complete", pump)
+
+    def finish(self, result, pump, failed_wave=None):
+        pump.cancel()
+        self.client.loop_stop()
+        self.client.disconnect()
+        report = {
+            "version": self.release.version,
+            "result": result,
+            "failed_wave": failed_wave,
+            "waves": [{"name": wave.name, "devices": len(wave.devices), "tolerance": wave.tolerance,
+                       "unhealthy": wave.unhealthy()} for wave in self.waves],
+            "messages": dict(self.stats),
+            "devices": {path: dev.summary() for path, dev in sorted(self.devices.items())},
+        }
+        if self.args.report:
+            with open(self.args.report, "w") as out:
+                json.dump(report, out, indent=2)
+        log("rollout %s: %d messages in, %d chunks out" % (
+            result, sum(v for k, v in self.stats.items() if k != "chunks_sent"), self.stats["chunks_sent"]))
+        return result != "halted"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--image", required=True, help="firmware.bin to roll out")
+    parser.add_argument("--version", required=True, help="its GIT_HASH")
+    parser.add_argument("--base", action="append", default=[], metavar="VERSION=PATH",
+                        help="previous firmware.bin to build patches from (repeatable)")
+    parser.add_argument("--target", action="append", default=[], metavar="PATH_PREFIX",
+                        help="limit the rollout to devices under these paths, e.g. 3/ (repeatable)")
+    parser.add_argument("--canary", type=int, default=3, help="number of canary devices")
+    parser.add_argument("--canary-device", action="append", default=[], metavar="FLOOR/ROOM/UNIT",
+                        help="use these devices as canaries instead (repeatable)")
+    parser.add_argument("--waves", type=lambda s: [float(v) for v in s.split(",")], default=[10.0, 50.0, 100.0],
+                        help="cumulative percentages of the remaining devices (default 10,50,100)")
+    parser.add_argument("--soak", type=int, default=600, help="seconds each updated device is watched")
+    parser.add_argument("--update-timeout", type=int, default=900, help="seconds allowed per download")
+    parser.add_argument("--concurrency", type=int, default=50, help="downloads at a time")
+    parser.add_argument("--max-ir-fail", type=int, default=0, help="new cmd_fail_ir allowed per device")
+    parser.add_argument("--max-mqtt-disc", type=int, default=2, help="new mqtt_disc allowed per device")
+    parser.add_argument("--max-unhealthy-pct", type=float, default=2.0, help="per wave, after the canaries")
+    parser.add_argument("--stale", type=int, default=60, help="seconds without a heartbeat before silent")
+    parser.add_argument("--discover", type=int, default=20, help="seconds to collect retained state")
+    parser.add_argument("--dry-run", action="store_true", help="discover and print the waves only")
+    parser.add_argument("--report", default="", help="write a JSON report here")
+    parser.add_argument("--chunk", type=int, default=CHUNK_SIZE)
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    parser.add_argument("--state-root", default="state")
+    parser.add_argument("--control-root", default="control")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    bases = {}
+    for spec in args.base:
+        version, _, path = spec.partition("=")
+        bases[version] = open(path, "rb").read()
+    release = Release(args.version, open(args.image, "rb").read(), bases, args.chunk)
+    for version in bases:
+        release.patch_for(version)  # Built up front, not while devices wait
+
+    sys.exit(0 if asyncio.run(Rollout(args, release).run()) else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""
+Rollout rehearsal: fleet_rollout.py against a simulated fleet.
+
+  fleet_rollout_sim.py [--devices 2000] [--scenario clean|crash|irfail|silent]
+                       [--image-size 20000] [--port 18883] [-- ROLLOUT ARGS ...]
+
+Starts mqtt_test_broker.py in-process and a fleet of simulated devices behind
+one MQTT connection, then runs fleet_rollout.py against them with short
+discover/soak/stale times. The devices speak the device side of the OTA
+protocol in OTA_update.h: retained deployment record at boot, windowed chunk
+requests with CRC checks, re-requests after a stall, the patch or image
+verified against the offer's MD5, then a reboot onto the new version. They
+send heartbeats on diagnostics and cmd_fail_ir/mqtt_disc on metrics; the
+counters start with some history from the old image, carry over a crash
+(warm boot) and start from zero on the new image.
+
+Scenarios inject a fault into some devices once they run the new version:
+  clean   none; every device must end on the new version
+  crash   20% of the fleet, from the middle of the sorted paths, reboots with
+          Exception shortly after the update; a later wave must halt
+  irfail  the first device (a canary) reports new cmd_fail_ir; the canary
+          wave must halt
+  silent  three devices stop their heartbeats and go offline
+
+Prints the rollout output, its exit status and result, the versions the fleet
+ends on and whether any offer is still retained. Anything after -- is passed
+to fleet_rollout.py (e.g. -- --waves 5,100 --concurrency 200).
+
+Requires paho-mqtt (pip install paho-mqtt).
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import zlib
+
+import paho.mqtt.client as mqtt
+
+SCRIPTS_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, SCRIPTS_DIR)
+from mqtt_test_broker import Broker  # noqa: E402
+from ota_server import apply_patch  # noqa: E402
+
+BASE_VERSION = "aaaaaaa"
+NEW_VERSION = "bbbbbbb"
+WINDOW = 4              # Chunks requested at a time, as OTA_update.cpp
+STALL_S = 2.0           # Re-request a window after this long without a chunk
+REBOOT_S = 0.3          # From a verified image to the new deployment record
+HEARTBEAT_S = 1.0
+METRICS_S = 2.0
+FRAME_HEADER = struct.Struct("<HBBIII")  # magic, version, stream, session, index, crc
+
+
+def device_paths(count):
+    return ["%d/%d/%d" % (i // 100 + 1, (i // 10) % 10 + 1, i % 10 + 1) for i in range(count)]
+
+
+class SimDevice:
+    def __init__(self, path, image, fault):
+        self.path = path
+        self.version = BASE_VERSION
+        self.image = image
+        self.fault = fault
+        self.has_faulted = False
+        self.is_online = True
+        self.updated_at = 0.0
+        self.counters = {"cmd_fail_ir": 0, "mqtt_disc": 0}  # Kept over warm boots, as the RTC checkpoint does
+        self.offer = None
+        self.stream = ""
+        self.data = bytearray()
+        self.chunks = 0
+        self.next_index = 0
+        self.window_end = 0
+        self.last_chunk_at = 0.0
+
+
+class SimFleet:
+    """Every device behind one client; callbacks and the ticker share a lock."""
+
+    def __init__(self, port, paths, image, faults):
+        self.devices = {path: SimDevice(path, image, faults.get(path)) for path in paths}
+        self.lock = threading.Lock()
+        self.updates = 0
+
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        self.client.max_inflight_messages_set(1000)
+        self.client.max_queued_messages_set(0)
+        self.client.on_message = self.on_message
+        self.client.connect("127.0.0.1", port)
+        self.client.subscribe([("control/+/+/+/ota", 1), ("control/+/+/+/ota/chunk", 0)])
+        self.client.loop_start()
+
+        for number, dev in enumerate(self.devices.values()):
+            self.boot(dev, "Power On")
+            dev.counters = {"cmd_fail_ir": number % 3, "mqtt_disc": number % 5}  # History from the old image
+        threading.Thread(target=self.ticker, daemon=True).start()
+
+    def boot(self, dev, reset_reason, is_cold=True):
+        if is_cold:
+            dev.counters = {"cmd_fail_ir": 0, "mqtt_disc": 0}
+        record = {"version_hash": dev.version, "reset_reason": reset_reason}
+        self.client.publish("state/%s/deployment" % dev.path, json.dumps(record), qos=1, retain=True)
+
+    def request_window(self, dev):
+        count = min(WINDOW, dev.chunks - dev.next_index)
+        dev.window_end = dev.next_index + count
+        dev.last_chunk_at = time.monotonic()
+        request = {"version": dev.offer["version"], "base": dev.version, "stream": dev.stream,
+                   "index": dev.next_index, "count": count}
+        self.client.publish("state/%s/ota/request" % dev.path, json.dumps(request))
+
+    def on_message(self, client, userdata, message):
+        dev = self.devices.get("/".join(message.topic.split("/")[1:4]))
+        if dev is None:
+            return
+        with self.lock:
+            if message.topic.endswith("/ota"):
+                self.on_offer(dev, message.payload)
+            else:
+                self.on_chunk(dev, message.payload)
+
+    def on_offer(self, dev, payload):
+        if not payload:
+            dev.offer = None  # Withdrawn
+            return
+        offer = json.loads(payload)
+        if offer["version"] == dev.version:
+            return
+        if dev.offer is not None and dev.offer["md5"] == offer["md5"]:
+            self.request_window(dev)  # Redelivered: resume
+            return
+        patch = offer.get("patch")
+        dev.offer = offer
+        dev.stream = "patch" if patch and patch["base"] == dev.version else "image"
+        size = patch["size"] if dev.stream == "patch" else offer["size"]
+        dev.chunks = (size + offer["chunk"] - 1) // offer["chunk"]
+        dev.data = bytearray()
+        dev.next_index = 0
+        self.request_window(dev)
+
+    def on_chunk(self, dev, payload):
+        if dev.offer is None or len(payload) < FRAME_HEADER.size:
+            return
+        _, _, _, _, index, crc = FRAME_HEADER.unpack_from(payload)
+        data = payload[FRAME_HEADER.size:]
+        if index != dev.next_index or zlib.crc32(data) & 0xFFFFFFFF != crc:
+            return  # Re-requested after the stall timeout
+        dev.data += data
+        dev.next_index += 1
+        dev.last_chunk_at = time.monotonic()
+        if dev.next_index < dev.chunks:
+            if dev.next_index == dev.window_end:
+                self.request_window(dev)
+            return
+
+        image = apply_patch(dev.image, bytes(dev.data)) if dev.stream == "patch" else bytes(dev.data)
+        if hashlib.md5(image).hexdigest() != dev.offer["md5"]:
+            raise AssertionError("%s: image MD5 mismatch" % dev.path)
+        dev.version = dev.offer["version"]
+        dev.image = image
+        dev.offer = None
+        dev.updated_at = time.monotonic()
+        self.updates += 1
+        # The reboot into the update clears the checkpoint: counters start from zero
+        threading.Timer(REBOOT_S, self.boot, (dev, "Software/System restart")).start()
+
+    def inject_fault(self, dev, now):
+        if dev.has_faulted or dev.updated_at == 0.0:
+            return
+        if dev.fault == "crash" and now - dev.updated_at > 1.5:
+            dev.has_faulted = True
+            self.boot(dev, "Exception", False)
+        elif dev.fault == "silent" and now - dev.updated_at > 1.0:
+            dev.has_faulted = True
+            dev.is_online = False
+            self.client.publish("state/%s/diagnostics" % dev.path, b'{"status":"offline"}', retain=True)
+
+    def ticker(self):
+        last_heartbeat = last_metrics = 0.0
+        while True:
+            time.sleep(0.1)
+            now = time.monotonic()
+            with self.lock:
+                for dev in self.devices.values():
+                    if dev.offer is not None and now - dev.last_chunk_at > STALL_S:
+                        self.request_window(dev)
+                    self.inject_fault(dev, now)
+                if now - last_heartbeat >= HEARTBEAT_S:
+                    last_heartbeat = now
+                    for dev in self.devices.values():
+                        if dev.is_online:
+                            self.client.publish("state/%s/diagnostics" % dev.path, b'{"status":"online"}')
+                if now - last_metrics >= METRICS_S:
+                    last_metrics = now
+                    for dev in self.devices.values():
+                        if not dev.is_online:
+                            continue
+                        if dev.fault == "irfail" and dev.updated_at:
+                            dev.counters["cmd_fail_ir"] += 2
+                        self.client.publish("state/%s/metrics" % dev.path, json.dumps(dev.counters))
+
+    def versions(self):
+        with self.lock:
+            counts = {}
+            for dev in self.devices.values():
+                counts[dev.version] = counts.get(dev.version, 0) + 1
+            return counts
+
+
+def build_images(size):
+    rnd = random.Random(1)
+    base = bytes(rnd.getrandbits(8) for _ in range(size))
+    new = bytearray(base)
+    for i in range(0, size, 97):
+        new[i] ^= 0x5A  # Scattered small changes, like moved pointers
+    return base, bytes(new) + bytes(rnd.getrandbits(8) for _ in range(300))
+
+
+def scenario_faults(scenario, paths):
+    count = len(paths)
+    if scenario == "crash":
+        return {path: "crash" for path in paths[count // 2:count // 2 + count // 5]}
+    if scenario == "irfail":
+        return {paths[0]: "irfail"}
+    if scenario == "silent":
+        return {path: "silent" for path in paths[count // 3:count // 3 + 3]}
+    return {}
+
+
+def main():
+    argv = sys.argv[1:]
+    rollout_args = []
+    if "--" in argv:
+        split = argv.index("--")
+        argv, rollout_args = argv[:split], argv[split + 1:]
+
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--devices", type=int, default=2000)
+    parser.add_argument("--scenario", choices=["clean", "crash", "irfail", "silent"], default="clean")
+    parser.add_argument("--image-size", type=int, default=20000, help="bytes of the simulated base image")
+    parser.add_argument("--port", type=int, default=18883)
+    args = parser.parse_args(argv)
+
+    base, new = build_images(args.image_size)
+    paths = device_paths(args.devices)
+    broker = Broker(args.port).start()
+    time.sleep(0.2)
+    fleet = SimFleet(args.port, paths, base, scenario_faults(args.scenario, paths))
+
+    with tempfile.TemporaryDirectory() as work:
+        base_path = os.path.join(work, "base.bin")
+        new_path = os.path.join(work, "new.bin")
+        report_path = os.path.join(work, "report.json")
+        with open(base_path, "wb") as f:
+            f.write(base)
+        with open(new_path, "wb") as f:
+            f.write(new)
+
+        started = time.monotonic()
+        command = [sys.executable, os.path.join(SCRIPTS_DIR, "fleet_rollout.py"),
+                   "--image", new_path, "--version", NEW_VERSION, "--base", "%s=%s" % (BASE_VERSION, base_path),
+                   "--port", str(args.port), "--discover", "3", "--soak", "4", "--stale", "3",
+                   "--update-timeout", "30", "--report", report_path] + rollout_args
+        result = subprocess.run(command, capture_output=True, text=True)
+        elapsed = time.monotonic() - started
+
+        lines = result.stdout.splitlines()
+        print("\n".join(lines if len(lines) < 40 else lines[:12] + ["..."] + lines[-15:]))
+        if result.stderr:
+            print(result.stderr[-2000:])
+        with open(report_path) as f:
+            report = json.load(f)
+
+    time.sleep(0.5)  # Let the last withdrawals reach the broker
+    open_offers = sum(1 for topic, payload in broker.retained.items()
+                      if topic.startswith("control/") and topic.endswith("/ota") and payload)
+    print("exit %d, result %s, %.1f s, %d updates, fleet versions %s, open offers %d, broker publishes %d" % (
+        result.returncode, report["result"], elapsed, fleet.updates, fleet.versions(), open_offers,
+        broker.published))
+    return result.returncode
+
+
+if __name__ == "__main__":
+    sys.exit(main())
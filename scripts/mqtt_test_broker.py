@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""
+Minimal MQTT 3.1.1 broker for local test runs without Mosquitto.
+
+  mqtt_test_broker.py [--host 127.0.0.1] [--port 1883]
+                      [--drop-topic SUFFIX --drop-every N]
+
+Supports what the firmware, tools/fleet_sim, ota_server.py and
+fleet_rollout.py use: CONNECT, PUBLISH at QoS 0/1 (delivered at most at
+QoS 1, PUBACK at once), retained messages, SUBSCRIBE with + and # filters,
+PINGREQ and DISCONNECT. No authentication, sessions, wills or QoS 2.
+
+--drop-topic/--drop-every silently discard every Nth message on topics that
+end with SUFFIX (e.g. /ota/chunk), to exercise the OTA stall and resume path.
+
+The Broker class can also be started in-process from a test script:
+Broker(port).start() serves from a daemon thread.
+"""
+
+import argparse
+import socket
+import struct
+import threading
+
+PACKET_CONNECT = 1
+PACKET_PUBLISH = 3
+PACKET_SUBSCRIBE = 8
+PACKET_PINGREQ = 12
+PACKET_DISCONNECT = 14
+
+CONNACK_ACCEPTED = b"\x20\x02\x00\x00"
+PINGRESP = b"\xd0\x00"
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        out.append(byte | 0x80 if n else byte)
+        if not n:
+            return bytes(out)
+
+
+def recv_exact(conn, n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            raise ConnectionError("closed")
+        data += chunk
+    return data
+
+
+def read_packet(conn):
+    header = recv_exact(conn, 1)[0]
+    length, multiplier = 0, 1
+    while True:
+        byte = recv_exact(conn, 1)[0]
+        length += (byte & 0x7F) * multiplier
+        multiplier *= 128
+        if not byte & 0x80:
+            break
+    return header, recv_exact(conn, length) if length else b""
+
+
+def topic_matches(topic_filter, topic):
+    filter_parts = topic_filter.split("/")
+    topic_parts = topic.split("/")
+    for i, part in enumerate(filter_parts):
+        if part == "#":
+            return True
+        if i >= len(topic_parts) or (part != "+" and part != topic_parts[i]):
+            return False
+    return len(filter_parts) == len(topic_parts)
+
+
+class Broker:
+    def __init__(self, port, host="127.0.0.1", drop_topic=None, drop_every=0):
+        self.host = host
+        self.port = port
+        self.drop_topic = drop_topic
+        self.drop_every = drop_every
+        self.clients = {}       # Connection -> {filter: qos}
+        self.send_locks = {}    # Connection -> lock, so packets from several threads never interleave
+        self.retained = {}
+        self.lock = threading.Lock()
+        self.published = 0
+        self.dropped = 0
+        self._drop_count = 0
+
+    def _write(self, conn, data):
+        with self.lock:
+            send_lock = self.send_locks.setdefault(conn, threading.Lock())
+        try:
+            with send_lock:
+                conn.sendall(data)
+        except OSError:
+            pass  # The reader thread of that client cleans up
+
+    def _deliver(self, conn, topic, payload, qos, retain=False):
+        encoded = topic.encode()
+        body = struct.pack(">H", len(encoded)) + encoded
+        if qos:
+            body += struct.pack(">H", 1)  # Clients ack, nobody resends: one id is enough
+        body += payload
+        header = 0x30 | (qos << 1) | (1 if retain else 0)
+        self._write(conn, bytes([header]) + encode_length(len(body)) + body)
+
+    def _route(self, topic, payload, retain):
+        with self.lock:
+            self.published += 1
+            if retain:
+                if payload:
+                    self.retained[topic] = payload
+                else:
+                    self.retained.pop(topic, None)
+            if self.drop_every and self.drop_topic and topic.endswith(self.drop_topic):
+                self._drop_count += 1
+                if self._drop_count % self.drop_every == 0:
+                    self.dropped += 1
+                    return
+            targets = {}
+            for conn, subscriptions in self.clients.items():
+                for topic_filter, qos in subscriptions.items():
+                    if topic_matches(topic_filter, topic):
+                        targets[conn] = max(targets.get(conn, 0), min(qos, 1))
+        for conn, qos in targets.items():
+            self._deliver(conn, topic, payload, qos)
+
+    def _subscribe(self, conn, subscriptions, body):
+        packet_id, pos = body[:2], 2
+        codes = bytearray()
+        added = []
+        while pos < len(body):
+            length = struct.unpack(">H", body[pos:pos + 2])[0]
+            topic_filter = body[pos + 2:pos + 2 + length].decode()
+            qos = min(body[pos + 2 + length], 1)
+            pos += 3 + length
+            with self.lock:
+                subscriptions[topic_filter] = qos
+            codes.append(qos)
+            added.append((topic_filter, qos))
+        self._write(conn, b"\x90" + encode_length(2 + len(codes)) + packet_id + bytes(codes))
+
+        with self.lock:
+            retained = list(self.retained.items())
+        for topic_filter, qos in added:
+            for topic, payload in retained:
+                if topic_matches(topic_filter, topic):
+                    self._deliver(conn, topic, payload, qos, True)
+
+    def _handle(self, conn):
+        subscriptions = {}
+        try:
+            header, _ = read_packet(conn)
+            if header >> 4 != PACKET_CONNECT:
+                return
+            self._write(conn, CONNACK_ACCEPTED)
+            with self.lock:
+                self.clients[conn] = subscriptions
+            while True:
+                header, body = read_packet(conn)
+                kind = header >> 4
+                if kind == PACKET_PUBLISH:
+                    qos = (header >> 1) & 3
+                    length = struct.unpack(">H", body[:2])[0]
+                    topic = body[2:2 + length].decode()
+                    pos = 2 + length
+                    if qos:
+                        self._write(conn, b"\x40\x02" + body[pos:pos + 2])
+                        pos += 2
+                    self._route(topic, body[pos:], bool(header & 1))
+                elif kind == PACKET_SUBSCRIBE:
+                    self._subscribe(conn, subscriptions, body)
+                elif kind == PACKET_PINGREQ:
+                    self._write(conn, PINGRESP)
+                elif kind == PACKET_DISCONNECT:
+                    return
+        except (ConnectionError, OSError, IndexError, struct.error, UnicodeDecodeError):
+            pass
+        finally:
+            with self.lock:
+                self.clients.pop(conn, None)
+                self.send_locks.pop(conn, None)
+            conn.close()
+
+    def serve(self):
+        server = socket.socket()
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((self.host, self.port))
+        server.listen(128)
+        while True:
+            try:
+                conn, _ = server.accept()
+            except OSError:
+                return
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            threading.Thread(target=self._handle, args=(conn,), daemon=True).start()
+
+    def start(self):
+        threading.Thread(target=self.serve, daemon=True).start()
+        return self
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--drop-topic", help="topic suffix whose messages are dropped")
+    parser.add_argument("--drop-every", type=int, default=0, help="drop every Nth matching message")
+    args = parser.parse_args()
+
+    print("MQTT test broker on %s:%d" % (args.host, args.port), flush=True)
+    try:
+        Broker(args.port, args.host, args.drop_topic, args.drop_every).serve()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
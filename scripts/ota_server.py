@@ -0,0 +1,380 @@
+#!/usr/bin/env python3
+"""
+Pull-based OTA server and delta patch tool for the IR transceiver firmware.
+
+  ota_server.py patch OLD.bin NEW.bin OUT.patch   build a delta patch
+  ota_server.py apply OLD.bin IN.patch OUT.bin    apply one (reference applier)
+  ota_server.py serve --image NEW.bin --version V [--base V0=OLD.bin ...]
+
+'serve' watches the retained deployment topic of every device, publishes a
+retained offer to each device that runs something other than V (with a patch
+when one of the --base images matches its version_hash), and answers chunk
+requests. Chunk/offer formats are documented in lib/OTA_update/OTA_update.h,
+the patch format in lib/OTA_patch/OTA_patch.h.
+
+Requires paho-mqtt for 'serve' (pip install paho-mqtt).
+"""
+
+import argparse
+import hashlib
+import json
+import struct
+import sys
+import zlib
+
+PATCH_MAGIC = b"OTP1"
+OP_END, OP_COPY = 0x00, 0x01
+OP_INSERT_SHORT, OP_COPY_SHORT = 0x40, 0x80  # Low 6 bits: length (0 = varint follows)
+FRAME_MAGIC = 0x544F
+FRAME_VERSION = 1
+STREAM_IMAGE, STREAM_PATCH = 0, 1
+STREAM_IDS = {"image": STREAM_IMAGE, "patch": STREAM_PATCH}
+
+BLOCK = 16          # Index key length
+MIN_MATCH = 12      # Shorter matches cost more as COPY than as INSERT
+DIAG_MIN_MATCH = 6  # Matches that continue the previous COPY are cheaper
+MAX_CANDIDATES = 8
+CHUNK_SIZE = 512    # k_ota_chunk_max
+MAX_REQUEST = 8     # Chunks answered per request
+
+
+# ─────────────────────────────────────────────
+# Patch format
+# ─────────────────────────────────────────────
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def match_len(old, a, new, b):
+    limit = min(len(old) - a, len(new) - b)
+    n = 0
+    step = 256
+    while n + step <= limit and old[a + n:a + n + step] == new[b + n:b + n + step]:
+        n += step
+    while n < limit and old[a + n] == new[b + n]:
+        n += 1
+    return n
+
+
+def make_patch(old, new):
+    index = {}
+    for i in range(len(old) - BLOCK + 1):
+        key = old[i:i + BLOCK]
+        slot = index.get(key)
+        if slot is None:
+            index[key] = [i]
+        elif len(slot) < MAX_CANDIDATES:
+            slot.append(i)
+
+    out = bytearray(PATCH_MAGIC + struct.pack("<II", len(old), len(new)))
+    literal = bytearray()
+    cursor = 0  # Base position the next COPY is relative to
+    i = 0
+
+    def emit_short(op, length):
+        if length < 64:
+            out.append(op | length)
+        else:
+            out.append(op)
+            out.extend(varint(length))
+
+    def flush_literal():
+        nonlocal cursor
+        if literal:
+            emit_short(OP_INSERT_SHORT, len(literal))
+            out.extend(literal)
+            cursor += len(literal)  # Inserted bytes usually replace as many base bytes
+            literal.clear()
+
+    while i < len(new):
+        best_len, best_src = 0, 0
+
+        # Continue along the base (e.g. after a changed pointer)
+        diag = cursor + len(literal)
+        if 0 <= diag < len(old):
+            n = match_len(old, diag, new, i)
+            if n >= DIAG_MIN_MATCH:
+                best_len, best_src = n, diag
+
+        for src in index.get(new[i:i + BLOCK], ()) if i + BLOCK <= len(new) else ():
+            n = match_len(old, src, new, i)
+            if n >= MIN_MATCH and n > best_len:
+                best_len, best_src = n, src
+
+        if best_len == 0:
+            literal.append(new[i])
+            i += 1
+            continue
+
+        back = 0  # Pull literal bytes that also match into the COPY
+        while back < len(literal) and best_src - back > 0 and old[best_src - back - 1] == literal[-back - 1]:
+            back += 1
+        if back:
+            del literal[-back:]
+            best_src -= back
+            best_len += back
+            i -= back
+
+        flush_literal()
+        if best_src == cursor:
+            emit_short(OP_COPY_SHORT, best_len)
+        else:
+            out.append(OP_COPY)
+            out.extend(varint(zigzag(best_src - cursor)))
+            out.extend(varint(best_len))
+        cursor = best_src + best_len
+        i += best_len
+
+    flush_literal()
+    out.append(OP_END)
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    if patch[:4] != PATCH_MAGIC:
+        raise ValueError("bad patch magic")
+    base_size, out_size = struct.unpack_from("<II", patch, 4)
+    if base_size > len(old):
+        raise ValueError("base is smaller than the patch expects")
+    pos = 12
+    out = bytearray()
+    cursor = 0
+
+    def read_varint():
+        nonlocal pos
+        value, shift = 0, 0
+        while True:
+            byte = patch[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY or op & 0xC0 == OP_COPY_SHORT:
+            start = cursor
+            if op == OP_COPY:
+                raw = read_varint()
+                start += (raw >> 1) ^ -(raw & 1)
+                length = read_varint()
+            else:
+                length = (op & 0x3F) or read_varint()
+            if start < 0 or start + length > base_size:
+                raise ValueError("COPY outside the base")
+            out += old[start:start + length]
+            cursor = start + length
+        elif op & 0xC0 == OP_INSERT_SHORT:
+            length = (op & 0x3F) or read_varint()
+            out += patch[pos:pos + length]
+            pos += length
+            cursor += length
+        else:
+            raise ValueError("bad opcode 0x%02x" % op)
+    if len(out) != out_size:
+        raise ValueError("output size mismatch")
+    return bytes(out)
+
+
+# ─────────────────────────────────────────────
+# Chunk frames
+# ─────────────────────────────────────────────
+def session_id(md5_hex):
+    return int(md5_hex[:8], 16)
+
+
+def chunk_frame(stream, session, index, data):
+    header = struct.pack("<HBBIII", FRAME_MAGIC, FRAME_VERSION, stream, session, index, zlib.crc32(data) & 0xFFFFFFFF)
+    return header + data
+
+
+class Release:
+    def __init__(self, version, image, bases, chunk_size=CHUNK_SIZE):
+        self.version = version
+        self.image = image
+        self.md5 = hashlib.md5(image).hexdigest()
+        self.session = session_id(self.md5)
+        self.chunk_size = chunk_size
+        self.bases = bases      # version -> base image bytes
+        self.patches = {}       # version -> patch bytes, built on first use
+        self.frames = {}        # (stream, base, index) -> chunk frame, shared by all devices
+
+    def patch_for(self, base_version):
+        if base_version not in self.bases:
+            return None
+        if base_version not in self.patches:
+            patch = make_patch(self.bases[base_version], self.image)
+            if apply_patch(self.bases[base_version], patch) != self.image:
+                raise RuntimeError("patch self-check failed for base %s" % base_version)
+            # A patch that saves little is not worth the slower apply
+            self.patches[base_version] = patch if len(patch) < len(self.image) * 0.8 else None
+            print("patch %s -> %s: %s" % (base_version, self.version,
+                  "%d bytes (%.0f%% of image)" % (len(patch), 100.0 * len(patch) / len(self.image))
+                  if self.patches[base_version] else "not smaller, image only"))
+        return self.patches[base_version]
+
+    def offer(self, base_version):
+        offer = {"version": self.version, "size": len(self.image), "md5": self.md5, "chunk": self.chunk_size}
+        patch = self.patch_for(base_version)
+        if patch is not None:
+            offer["patch"] = {"base": base_version, "size": len(patch)}
+        return offer
+
+    def stream(self, name, base_version):
+        if name == "patch":
+            return self.patch_for(base_version)
+        return self.image
+
+    def answer(self, req):
+        """Frames for a chunk request from a device, [] if it is not for this release."""
+        if req.get("version") != self.version or req.get("stream") not in STREAM_IDS:
+            return []
+        data = self.stream(req["stream"], req.get("base", ""))
+        if data is None:
+            return []
+        chunks = (len(data) + self.chunk_size - 1) // self.chunk_size
+        first = int(req.get("index", 0))
+        count = min(int(req.get("count", 1)), MAX_REQUEST, chunks - first)
+        frames = []
+        for index in range(first, first + max(count, 0)):
+            key = (req["stream"], req.get("base", "") if req["stream"] == "patch" else "", index)
+            if key not in self.frames:
+                piece = data[index * self.chunk_size:(index + 1) * self.chunk_size]
+                self.frames[key] = chunk_frame(STREAM_IDS[req["stream"]], self.session, index, piece)
+            frames.append(self.frames[key])
+        return frames
+
+
+# ─────────────────────────────────────────────
+# MQTT server
+# ─────────────────────────────────────────────
+def serve(args):
+    import paho.mqtt.client as mqtt
+
+    bases = {}
+    for spec in args.base:
+        version, _, path = spec.partition("=")
+        bases[version] = open(path, "rb").read()
+    release = Release(args.version, open(args.image, "rb").read(), bases, args.chunk)
+    targets = set(args.target)
+    offered = {}  # device path -> version the offer was built for
+
+    def device_path(topic, suffix):
+        parts = topic.split("/")
+        return "/".join(parts[1:-len(suffix.split("/"))])
+
+    def on_connect(client, userdata, flags, rc, *extra):
+        client.subscribe("%s/+/+/+/deployment" % args.state_root, 1)
+        client.subscribe("%s/+/+/+/ota/request" % args.state_root, 0)
+        print("connected, serving %s (%d bytes, md5 %s)" % (release.version, len(release.image), release.md5))
+
+    def on_deployment(client, topic, payload):
+        path = device_path(topic, "deployment")
+        if targets and path not in targets:
+            return
+        running = json.loads(payload).get("version_hash", "")
+        offer_topic = "%s/%s/ota" % (args.control_root, path)
+        if running == release.version:
+            if path in offered:
+                client.publish(offer_topic, b"", qos=1, retain=True)  # Done: withdraw
+                offered.pop(path)
+                print("%s: running %s" % (path, running))
+            return
+        if offered.get(path) == running:
+            return
+        client.publish(offer_topic, json.dumps(release.offer(running), separators=(",", ":")), qos=1, retain=True)
+        offered[path] = running
+        print("%s: offered %s (running %s)" % (path, release.version, running))
+
+    def on_request(client, topic, payload):
+        path = device_path(topic, "ota/request")
+        req = json.loads(payload)
+        frames = release.answer(req)
+        chunk_topic = "%s/%s/ota/chunk" % (args.control_root, path)
+        for frame in frames:
+            client.publish(chunk_topic, frame, qos=0)
+        if args.verbose and frames:
+            print("%s: %s chunks from %d (%d)" % (path, req["stream"], int(req.get("index", 0)), len(frames)))
+
+    def on_message(client, userdata, msg):
+        try:
+            if msg.topic.endswith("/deployment"):
+                on_deployment(client, msg.topic, msg.payload)
+            elif msg.topic.endswith("/ota/request"):
+                on_request(client, msg.topic, msg.payload)
+        except (ValueError, KeyError) as err:
+            print("ignored %s: %s" % (msg.topic, err), file=sys.stderr)
+
+    if hasattr(mqtt, "CallbackAPIVersion"):  # paho-mqtt 2.x
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    else:
+        client = mqtt.Client()
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.broker, args.port, 45)
+    client.loop_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("patch", help="build a delta patch")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("out")
+
+    p = sub.add_parser("apply", help="apply a delta patch")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("out")
+
+    p = sub.add_parser("serve", help="offer an image and answer chunk requests")
+    p.add_argument("--image", required=True, help="firmware.bin to roll out")
+    p.add_argument("--version", required=True, help="its GIT_HASH")
+    p.add_argument("--base", action="append", default=[], metavar="VERSION=PATH",
+                   help="previous firmware.bin to build patches from (repeatable)")
+    p.add_argument("--target", action="append", default=[], metavar="FLOOR/ROOM/UNIT",
+                   help="limit the rollout to these devices (repeatable, default all)")
+    p.add_argument("--chunk", type=int, default=CHUNK_SIZE)
+    p.add_argument("--broker", default="127.0.0.1")
+    p.add_argument("--port", type=int, default=1883)
+    p.add_argument("--user", default="")
+    p.add_argument("--password", default="")
+    p.add_argument("--state-root", default="state")
+    p.add_argument("--control-root", default="control")
+    p.add_argument("--verbose", action="store_true")
+
+    args = parser.parse_args()
+    if args.command == "patch":
+        old, new = open(args.old, "rb").read(), open(args.new, "rb").read()
+        patch = make_patch(old, new)
+        assert apply_patch(old, patch) == new
+        open(args.out, "wb").write(patch)
+        print("%d -> %d bytes (%.1f%% of the image)" % (len(new), len(patch), 100.0 * len(patch) / len(new)))
+    elif args.command == "apply":
+        open(args.out, "wb").write(apply_patch(open(args.old, "rb").read(), open(args.patch, "rb").read()))
+    else:
+        serve(args)
+
+
+if __name__ == "__main__":
+    main()
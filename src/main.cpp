@@ -17,21 +17,16 @@
 #define HIDDEN_PASS ""
 #endif
 
-// IR send default pipeline selection
-// 1 = use protocol adapters (IRremoteESP8266)
-// 0 = use legacy raw IR modulator (64-bit custom)
-#ifndef USE_ACU_ADAPTER
-  #define USE_ACU_ADAPTER 0
-#endif
-
 // Custom Libraries
 #include "WiFiManager.h"           // WiFi connection manager class
-// #include "OTA_config.h"            // OTA setup and event handlers
 #include "ACU_remote_encoder.h"    // IR command generator (ACU signature)
-#if !USE_ACU_ADAPTER
-  #include "ACU_IR_modulator.h"      // Converts command to IR waveform
-#endif
-#include "MQTT.h"                  // MQTT messaging (PubSubClient wrapper)
+#include "ACU_IR_modulator.h"      // Converts command to IR waveform
+#include "ACU_ir_adapters.h"       // Runtime IR adapter registry
+#include "IR_learning.h"           // IR learning mode + flash code library
+#include "MQTT.h"                  // MQTT messaging (non-blocking client)
+#include "Profiler.h"              // Loop/stage latency histograms
+#include "Watchdog.h"              // WDT feeds, loop budget, crash breadcrumb
+#include "ESP_system.h"            // Reset cause, warm boot detection
 
 // ─────────────────────────────────────────────
 // 📡 Configuration
@@ -48,11 +43,6 @@ constexpr unsigned long wifi_loop_delay_ms = 10;
 // 🔧 Global Objects
 // ─────────────────────────────────────────────
 CustomWiFi::WiFiManager g_wifi_manager;           // WiFi manager instance
-#if !USE_ACU_ADAPTER
-  IRsend g_ir_send(ir_led_pin);                      // IR transmitter
-  uint16_t g_durations[raw_data_length];             // Pulse duration buffer
-  const IRProtocolConfig* g_selected_protocol = &k_mitsubishi_heavy_64;
-#endif
 
 #if ENABLE_TIMER_ROUTINE
   uint32_t g_last_timer_event_ms = 0;
@@ -64,42 +54,62 @@ CustomWiFi::WiFiManager g_wifi_manager;           // WiFi manager instance
 void setup() {
   #if LOG_SERIAL_ENABLE
     Serial.begin(115200);
-    delay(startup_delay_ms); // Startup delay for serial debugging. This is skipped in release builds.
-    initLogging();
-    logInfo(k_log_tag, "MCU Status: ON");
-    String reset_reason = ESP.getResetReason();
-    logInfo(k_log_tag, "Reset reason: %s", reset_reason.c_str());
+    if (!isWarmBoot()) delay(startup_delay_ms); // Startup delay for serial debugging. Skipped in release builds and after a soft reset.
   #endif
+  initLogging(); // Also feeds the MQTT log stream when Serial is disabled
+  logInfo(k_log_tag, "MCU Status: ON");
+  logInfo(k_log_tag, "Reset reason: %s", getResetReasonName());
+  beginWatchdog();             // Picks up the breadcrumb of a WDT reset
   
-#if !USE_ACU_ADAPTER
-  g_ir_send.begin();
-#endif
+  setupACUUnits();             // One IR adapter per logical unit
+  beginIRCodeLibrary();
+  setupACUSchedule();          // Load on-device schedule (LittleFS)
+  setupACUPolicy();            // Load local policy rules (LittleFS)
+  CustomWiFi::WiFiLink resume_link;
+  restoreMQTTCheckpoint(resume_link); // Warm boot: unit states, counters, last access point
 
   g_wifi_manager.begin(HIDDEN_SSID, HIDDEN_PASS);
+  g_wifi_manager.setRoamGate(isIRIdle);                 // Roam only between IR commands
+  g_wifi_manager.setResumeLink(resume_link);            // Straight back to the previous access point
+  setWiFiRoamStats(&g_wifi_manager.getRoamStats());
+
+  flushLogs(); // Boot messages, before the ring starts filling with connection attempts
 
   while (WiFi.status() != WL_CONNECTED) {
     g_wifi_manager.handleConnection(); // Let the state machine run
+    handleLogging();
     delay(wifi_loop_delay_ms); // Small delay to prevent busy-waiting
   }
 
-  // setupOTA();                  // Start OTA service
-  setupMQTTTopics();          // Build MQTT topic strings
+  setupMQTTTopics();          // Build MQTT topic strings (device + units)
   setupMQTT();                // Start MQTT client
-  setupTime();                // Configure NTP
+  setupTime();                // Start SNTP (non-blocking)
 }
 
 // ─────────────────────────────────────────────
 // 🔁 Main Loop
 // ─────────────────────────────────────────────
 void loop() {
-  g_wifi_manager.handleConnection(); 
+  ProfileScope loop_scope(ProfileStage::Loop);
+  watchdogLoopBegin();
+
+  {
+    WatchdogScope wifi_wdt(WatchdogSection::WiFi);
+    g_wifi_manager.handleConnection();
+  }
 
   updateConnectionStats();
+  handleTime();     // SNTP sync tracking
 
   if (WiFi.status() == WL_CONNECTED) {
+    ProfileScope mqtt_scope(ProfileStage::MQTTHandle);
+    WatchdogScope mqtt_wdt(WatchdogSection::MQTT);
     handleMQTT();
   }
 
+  handleSchedule(); // Runs on local time, with or without the broker
+  handlePolicy();   // One rule per loop
+
   #if ENABLE_TIMER_ROUTINE
   uint32_t now_ms = millis();
     if ((uint32_t)(now_ms - g_last_timer_event_ms) >= timer_interval_ms) {
@@ -111,11 +121,18 @@ void loop() {
     }    
   #endif
 
-  #if !USE_ACU_ADAPTER
-    #if LOG_SERIAL_ENABLE
-      #ifdef ENABLE_IR_DEBUG_INPUT
-      debugIRInput();           // Optional IR test via Serial input
-      #endif
+  #if LOG_SERIAL_ENABLE
+    #ifdef ENABLE_IR_DEBUG_INPUT
+    size_t debug_len = 0;
+    if (debugIRInput(g_durations, debug_len)) { // Optional IR test via Serial input
+      IACUAdapter* adapter = getACUAdapter();
+      if (adapter != nullptr && adapter->sendRaw(g_durations, debug_len, 38)) {
+        logInfo(k_log_tag, "IR sent.");
+      }
+    }
     #endif
   #endif
+
+  handleLogging(); // Lowest priority: write queued log lines as the UART has room
+  watchdogLoopEnd();
 }
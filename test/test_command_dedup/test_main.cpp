@@ -0,0 +1,98 @@
+#include <unity.h>
+
+#include "CommandDedup.h"
+
+namespace {
+
+DedupSender g_slots[k_dedup_sender_slots];
+
+void markAll(const char* sender, uint32_t first, uint32_t last, unsigned long now_ms) {
+  for (uint32_t seq = first; seq <= last; ++seq) markSeqSeen(g_slots, sender, seq, now_ms);
+}
+
+} // namespace
+
+void setUp() {
+  for (DedupSender& slot : g_slots) slot = DedupSender();
+}
+
+void tearDown() {}
+
+void test_unknown_sender_is_not_duplicate() {
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 1));
+}
+
+void test_redelivery_is_duplicate() {
+  markSeqSeen(g_slots, "dash", 7, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 7));
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 8));
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "other", 7));
+}
+
+void test_out_of_order_within_window() {
+  markSeqSeen(g_slots, "dash", 10, 0);
+  markSeqSeen(g_slots, "dash", 12, 0);
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 11));
+  markSeqSeen(g_slots, "dash", 11, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 10));
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 11));
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 12));
+}
+
+void test_window_edge() {
+  markAll("dash", 1, k_dedup_window_bits, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 1)); // Oldest tracked bit
+  markSeqSeen(g_slots, "dash", k_dedup_window_bits + 1, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 2));
+}
+
+void test_seq_reset_starts_new_window() {
+  markAll("dash", 1, 500, 0);
+
+  // The sender restarted and counts from 1 again
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 1));
+  markSeqSeen(g_slots, "dash", 1, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 1));
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 2));
+  markSeqSeen(g_slots, "dash", 2, 0);
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "dash", 2));
+
+  // The new window is the one tracked; the old numbers are far ahead of it
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "dash", 500));
+}
+
+void test_seq_reset_keeps_one_slot() {
+  markAll("dash", 100, 200, 0);
+  markSeqSeen(g_slots, "dash", 1, 0);
+
+  uint8_t used = 0;
+  for (const DedupSender& slot : g_slots) {
+    if (slot.sender[0] != '\0') used++;
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, used);
+}
+
+void test_least_recently_used_sender_evicted() {
+  markSeqSeen(g_slots, "a", 1, 100);
+  markSeqSeen(g_slots, "b", 1, 200);
+  markSeqSeen(g_slots, "c", 1, 300);
+  markSeqSeen(g_slots, "d", 1, 400);
+  markSeqSeen(g_slots, "a", 2, 500); // "b" is now the oldest
+
+  markSeqSeen(g_slots, "e", 1, 600);
+  TEST_ASSERT_FALSE(isDuplicateSeq(g_slots, "b", 1));
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "a", 1));
+  TEST_ASSERT_TRUE(isDuplicateSeq(g_slots, "e", 1));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unknown_sender_is_not_duplicate);
+  RUN_TEST(test_redelivery_is_duplicate);
+  RUN_TEST(test_out_of_order_within_window);
+  RUN_TEST(test_window_edge);
+  RUN_TEST(test_seq_reset_starts_new_window);
+  RUN_TEST(test_seq_reset_keeps_one_slot);
+  RUN_TEST(test_least_recently_used_sender_evicted);
+  return UNITY_END();
+}
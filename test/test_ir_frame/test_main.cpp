@@ -0,0 +1,129 @@
+#include <unity.h>
+
+#include "IR_frame.h"
+
+namespace {
+
+constexpr size_t k_mhi64_frame_len = 133;
+
+// MHI64 command 0x50243108 + complement, as the pre-table parseBinaryToDurations
+// produced it; every MHI64 transmission so far matches this layout.
+constexpr uint8_t k_mhi64_payload[] = {0x50, 0x24, 0x31, 0x08, 0xAF, 0xDB, 0xCE, 0xF7};
+constexpr uint16_t k_mhi64_golden[k_mhi64_frame_len] = {
+  6000, 7300, // Header
+  500, 1400, 500, 3300, 500, 1400, 500, 3300, 500, 1400, 500, 1400, 500, 1400, 500, 1400, // 0x50
+  500, 1400, 500, 1400, 500, 3300, 500, 1400, 500, 1400, 500, 3300, 500, 1400, 500, 1400, // 0x24
+  500, 1400, 500, 1400, 500, 3300, 500, 3300, 500, 1400, 500, 1400, 500, 1400, 500, 3300, // 0x31
+  500, 1400, 500, 1400, 500, 1400, 500, 1400, 500, 3300, 500, 1400, 500, 1400, 500, 1400, // 0x08
+  500, 3300, 500, 1400, 500, 3300, 500, 1400, 500, 3300, 500, 3300, 500, 3300, 500, 3300, // 0xAF
+  500, 3300, 500, 3300, 500, 1400, 500, 3300, 500, 3300, 500, 1400, 500, 3300, 500, 3300, // 0xDB
+  500, 3300, 500, 3300, 500, 1400, 500, 1400, 500, 3300, 500, 3300, 500, 3300, 500, 1400, // 0xCE
+  500, 3300, 500, 3300, 500, 3300, 500, 3300, 500, 1400, 500, 3300, 500, 3300, 500, 3300, // 0xF7
+  500, 7300, 500  // Footer
+};
+
+// Four-bit protocol so repeats stay readable
+constexpr uint16_t k_mark_footer[] = {300};            // Ends on a mark
+constexpr uint16_t k_space_footer[] = {300, 900};      // Ends on a space
+constexpr IRProtocolConfig k_repeat_mark_end = {
+  1000, 2000, 100, 700, 200, 4, IRBitOrder::MSBFirst, k_mark_footer, 1, 2, 5000, 38, 50
+};
+constexpr IRProtocolConfig k_repeat_space_end = {
+  1000, 2000, 100, 700, 200, 4, IRBitOrder::MSBFirst, k_space_footer, 2, 1, 5000, 38, 50
+};
+constexpr IRProtocolConfig k_lsb_first = {
+  1000, 2000, 100, 700, 200, 4, IRBitOrder::LSBFirst, k_mark_footer, 1, 0, 0, 38, 50
+};
+
+uint16_t g_durations[k_mhi64_frame_len + 8];
+
+} // namespace
+
+void setUp() {
+  for (uint16_t& d : g_durations) d = 0xBEEF;
+}
+
+void tearDown() {}
+
+void test_mhi64_length() {
+  TEST_ASSERT_EQUAL_size_t(k_mhi64_frame_len, irFrameLength(k_mitsubishi_heavy_64));
+}
+
+void test_mhi64_matches_golden() {
+  size_t len = 0;
+  TEST_ASSERT_TRUE(buildIRFrame(k_mitsubishi_heavy_64, k_mhi64_payload, g_durations, k_mhi64_frame_len, len));
+  TEST_ASSERT_EQUAL_size_t(k_mhi64_frame_len, len);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(k_mhi64_golden, g_durations, k_mhi64_frame_len);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, g_durations[k_mhi64_frame_len]); // Nothing past the frame
+}
+
+void test_mhi64_footer() {
+  size_t len = 0;
+  TEST_ASSERT_TRUE(buildIRFrame(k_mitsubishi_heavy_64, k_mhi64_payload, g_durations, k_mhi64_frame_len, len));
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(k_mitsubishi_heavy_64_footer, &g_durations[len - 3], 3);
+  TEST_ASSERT_EQUAL(1, len % 2); // Ends on a mark, so the LED is off afterwards
+}
+
+void test_capacity_too_small() {
+  size_t len = 99;
+  TEST_ASSERT_FALSE(buildIRFrame(k_mitsubishi_heavy_64, k_mhi64_payload, g_durations, k_mhi64_frame_len - 1, len));
+  TEST_ASSERT_EQUAL_size_t(0, len);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, g_durations[0]);
+}
+
+void test_null_buffers() {
+  size_t len = 0;
+  TEST_ASSERT_FALSE(buildIRFrame(k_mitsubishi_heavy_64, nullptr, g_durations, k_mhi64_frame_len, len));
+  TEST_ASSERT_FALSE(buildIRFrame(k_mitsubishi_heavy_64, k_mhi64_payload, nullptr, k_mhi64_frame_len, len));
+}
+
+void test_repeat_gap_after_mark() {
+  const uint8_t data[] = {0xA0}; // 1010
+  const uint16_t expected[] = {
+    1000, 2000, 100, 700, 100, 200, 100, 700, 100, 200, 300,
+    5000,
+    1000, 2000, 100, 700, 100, 200, 100, 700, 100, 200, 300,
+    5000,
+    1000, 2000, 100, 700, 100, 200, 100, 700, 100, 200, 300
+  };
+  size_t len = 0;
+  TEST_ASSERT_TRUE(buildIRFrame(k_repeat_mark_end, data, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len));
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected) / sizeof(expected[0]), len);
+  TEST_ASSERT_EQUAL_size_t(irFrameLength(k_repeat_mark_end), len);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, g_durations, len);
+}
+
+void test_repeat_gap_merged_into_space() {
+  const uint8_t data[] = {0x30}; // 0011
+  const uint16_t expected[] = {
+    1000, 2000, 100, 200, 100, 200, 100, 700, 100, 700, 300, 900 + 5000,
+    1000, 2000, 100, 200, 100, 200, 100, 700, 100, 700, 300, 900
+  };
+  size_t len = 0;
+  TEST_ASSERT_TRUE(buildIRFrame(k_repeat_space_end, data, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len));
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected) / sizeof(expected[0]), len);
+  TEST_ASSERT_LESS_OR_EQUAL(irFrameLength(k_repeat_space_end), len);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, g_durations, len);
+}
+
+void test_lsb_first() {
+  const uint8_t data[] = {0x01}; // Bit 0 goes first
+  const uint16_t expected[] = {1000, 2000, 100, 700, 100, 200, 100, 200, 100, 200, 300};
+  size_t len = 0;
+  TEST_ASSERT_TRUE(buildIRFrame(k_lsb_first, data, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len));
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected) / sizeof(expected[0]), len);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, g_durations, len);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_mhi64_length);
+  RUN_TEST(test_mhi64_matches_golden);
+  RUN_TEST(test_mhi64_footer);
+  RUN_TEST(test_capacity_too_small);
+  RUN_TEST(test_null_buffers);
+  RUN_TEST(test_repeat_gap_after_mark);
+  RUN_TEST(test_repeat_gap_merged_into_space);
+  RUN_TEST(test_lsb_first);
+  return UNITY_END();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Native stand-in for the parts of the ESP8266 core that MQTT_client uses.
+// Time only moves when the test or the WiFiClient stand-in advances it, so a
+// call's duration is exactly what it spent waiting on the network.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+extern uint64_t g_now_us;
+
+inline unsigned long millis() {
+  return (unsigned long)(g_now_us / 1000);
+}
+
+inline void advanceClock(uint64_t us) {
+  g_now_us += us;
+}
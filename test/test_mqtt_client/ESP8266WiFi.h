@@ -0,0 +1,112 @@
+#pragma once
+
+// Native stand-in for the core's WiFiClient, with its blocking behaviour:
+// - connect() waits for the DNS lookup and TCP handshake, up to setTimeout();
+// - write() of more than availableForWrite() waits for the peer's ACKs, up to
+//   setTimeout(), even with setSync(false).
+// The test plays the network: ack() moves written bytes to the broker,
+// dropSent() discards what the broker has parsed, receive() queues bytes
+// from it.
+
+#include "Arduino.h"
+
+constexpr size_t k_sim_tcp_send_buffer = 2920; // lwIP TCP_SND_BUF (2 * MSS)
+constexpr size_t k_sim_sent_max = 16384;
+constexpr size_t k_sim_rx_max = 4096;
+
+class WiFiClient {
+public:
+  // Network behaviour, set by the test
+  uint32_t connect_us = 30000;   // DNS + handshake
+  bool is_reachable = true;
+  uint32_t write_call_us = 50;   // Copying into lwIP pbufs
+
+  // Everything written, in order; the first sent_len - unacked bytes reached the broker
+  uint8_t sent[k_sim_sent_max];
+  size_t sent_len = 0;
+  size_t unacked = 0;
+  bool is_open = false;
+  uint32_t blocked_writes = 0;   // write() calls that had to wait for ACKs
+
+  void setTimeout(unsigned long timeout_ms) { timeout_ms_ = timeout_ms; }
+  void setNoDelay(bool) {}
+  void setSync(bool) {}
+
+  int connect(const char*, uint16_t) {
+    if (!is_reachable || connect_us >= timeout_ms_ * 1000) {
+      advanceClock((uint64_t)timeout_ms_ * 1000);
+      return 0;
+    }
+    advanceClock(connect_us);
+    is_open = true;
+    sent_len = 0;
+    unacked = 0;
+    rx_head_ = 0;
+    rx_len_ = 0;
+    return 1;
+  }
+
+  uint8_t connected() { return is_open ? 1 : 0; }
+  void stop() { is_open = false; }
+
+  int availableForWrite() { return is_open ? (int)(k_sim_tcp_send_buffer - unacked) : 0; }
+
+  size_t write(const uint8_t* data, size_t len) {
+    if (!is_open) return 0;
+    advanceClock(write_call_us);
+    size_t room = k_sim_tcp_send_buffer - unacked;
+    if (len > room) {
+      blocked_writes++;
+      advanceClock((uint64_t)timeout_ms_ * 1000); // No ACK comes back in time
+      len = room;
+    }
+    if (len > k_sim_sent_max - sent_len) len = k_sim_sent_max - sent_len;
+    memcpy(sent + sent_len, data, len);
+    sent_len += len;
+    unacked += len;
+    return len;
+  }
+
+  int available() { return is_open ? (int)rx_len_ : 0; }
+
+  int read() {
+    uint8_t value;
+    return (read(&value, 1) == 1) ? value : -1;
+  }
+
+  int read(uint8_t* data, size_t len) {
+    if (!is_open || rx_len_ == 0) return -1;
+    if (len > rx_len_) len = rx_len_;
+    for (size_t i = 0; i < len; ++i) data[i] = rx_[(rx_head_ + i) % k_sim_rx_max];
+    rx_head_ = (rx_head_ + len) % k_sim_rx_max;
+    rx_len_ -= len;
+    return (int)len;
+  }
+
+  // The peer acknowledges up to n bytes; returns how many
+  size_t ack(size_t n) {
+    if (n > unacked) n = unacked;
+    unacked -= n;
+    return n;
+  }
+
+  // The broker has parsed the first n bytes of sent
+  void dropSent(size_t n) {
+    memmove(sent, sent + n, sent_len - n);
+    sent_len -= n;
+  }
+
+  // Bytes from the broker; false if they do not fit
+  bool receive(const uint8_t* data, size_t len) {
+    if (len > k_sim_rx_max - rx_len_) return false;
+    for (size_t i = 0; i < len; ++i) rx_[(rx_head_ + rx_len_ + i) % k_sim_rx_max] = data[i];
+    rx_len_ += len;
+    return true;
+  }
+
+private:
+  unsigned long timeout_ms_ = 1000;
+  uint8_t rx_[k_sim_rx_max];
+  size_t rx_head_ = 0;
+  size_t rx_len_ = 0;
+};
@@ -0,0 +1,285 @@
+#include <unity.h>
+
+#include <string.h>
+
+// MQTT_client is limited to espressif8266 (WiFiClient), so the native env does
+// not build it as a library: its source is compiled here against the
+// Arduino.h, ESP8266WiFi.h and logging.h stand-ins in this directory, which
+// emulate the core's blocking connect() and write().
+#define ARDUINO_ARCH_ESP8266
+#include "../../lib/MQTT_client/MQTT_client.cpp"
+
+// Every loop(), publish() and subscribe() call must return within this much
+// time spent waiting on the network, whatever the broker or the link does.
+// connect() is the exception: the core has no non-blocking TCP connect, so it
+// is bounded by setConnectTimeout() (k_mqtt_tcp_connect_timeout_ms) instead.
+constexpr uint64_t k_call_budget_us = 5000;
+
+uint64_t g_now_us = 0;
+
+namespace {
+
+constexpr uint64_t k_loop_period_us = 1000; // Rest of the firmware's loop()
+constexpr uint16_t k_keepalive_s = 15;
+
+WiFiClient g_wifi;
+
+// Broker side
+bool g_is_broker_answering = true;
+size_t g_broker_pos = 0;         // Parse position in g_wifi.sent
+uint32_t g_broker_publishes = 0;
+uint32_t g_delivered = 0;        // Messages the callback got
+
+uint64_t g_worst_us = 0;         // Longest loop()/publish()/subscribe() call
+
+void queueToClient(uint8_t header, const uint8_t* body, size_t body_len) {
+  uint8_t fixed[5] = {header};
+  size_t n = 1 + encodeLength(fixed + 1, (uint32_t)body_len);
+  TEST_ASSERT_TRUE(g_wifi.receive(fixed, n));
+  if (body_len > 0) TEST_ASSERT_TRUE(g_wifi.receive(body, body_len));
+}
+
+void sendPublishToClient(const char* topic, size_t payload_len, uint8_t qos) {
+  static uint16_t packet_id = 0;
+  uint8_t body[700];
+  size_t topic_len = strlen(topic);
+  size_t n = 0;
+  body[n++] = (uint8_t)(topic_len >> 8);
+  body[n++] = (uint8_t)topic_len;
+  memcpy(body + n, topic, topic_len);
+  n += topic_len;
+  if (qos > 0) {
+    packet_id++;
+    body[n++] = (uint8_t)(packet_id >> 8);
+    body[n++] = (uint8_t)packet_id;
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(sizeof(body) - n, payload_len);
+  memset(body + n, 'x', payload_len);
+  queueToClient((uint8_t)(0x30 | (qos << 1)), body, n + payload_len);
+}
+
+// Answers what the client's acknowledged bytes contain, like mqtt_test_broker.py
+void serveBroker() {
+  size_t delivered = g_wifi.sent_len - g_wifi.unacked;
+  while (g_broker_pos < delivered) {
+    size_t pos = g_broker_pos + 1;
+    uint32_t len = 0;
+    uint8_t shift = 0;
+    while (pos < delivered && (g_wifi.sent[pos] & 0x80)) len |= (uint32_t)(g_wifi.sent[pos++] & 0x7F) << (7 * shift++);
+    if (pos >= delivered) break;
+    len |= (uint32_t)g_wifi.sent[pos++] << (7 * shift);
+    if (pos + len > delivered) break; // Rest still in flight
+
+    uint8_t header = g_wifi.sent[g_broker_pos];
+    const uint8_t* body = g_wifi.sent + pos;
+    g_broker_pos = pos + len;
+    if (!g_is_broker_answering) continue;
+
+    switch (header & 0xF0) {
+      case 0x10: {
+        const uint8_t connack[2] = {0, 0};
+        queueToClient(0x20, connack, sizeof(connack));
+        break;
+      }
+      case 0x30: {
+        g_broker_publishes++;
+        if (((header >> 1) & 3) == 0) break;
+        size_t id_pos = 2 + (size_t)((body[0] << 8) | body[1]);
+        queueToClient(0x40, body + id_pos, 2);
+        break;
+      }
+      case 0x80: {
+        const uint8_t suback[3] = {body[0], body[1], 1};
+        queueToClient(0x90, suback, sizeof(suback));
+        break;
+      }
+      case 0xC0:
+        queueToClient(0xD0, nullptr, 0);
+        break;
+      default:
+        break;
+    }
+  }
+  g_wifi.dropSent(g_broker_pos);
+  g_broker_pos = 0;
+}
+
+void track(uint64_t start_us) {
+  uint64_t elapsed = g_now_us - start_us;
+  if (elapsed > g_worst_us) g_worst_us = elapsed;
+}
+
+bool timedLoop(AsyncMQTTClient& mqtt) {
+  uint64_t start = g_now_us;
+  bool is_connected = mqtt.loop();
+  track(start);
+  return is_connected;
+}
+
+bool timedPublish(AsyncMQTTClient& mqtt, size_t payload_len, uint8_t qos) {
+  static uint8_t payload[600];
+  uint64_t start = g_now_us;
+  bool is_queued = mqtt.publish("state/1/2/3/acu", payload, payload_len, false, qos);
+  track(start);
+  return is_queued;
+}
+
+uint64_t timedConnect(AsyncMQTTClient& mqtt, bool& is_ok) {
+  uint64_t start = g_now_us;
+  is_ok = mqtt.connect("ESP8266Client-0AB12E", "user", "pass", "state/1/2/3/diagnostics", 1, true,
+                       "{\"status\":\"offline\"}", true);
+  return g_now_us - start;
+}
+
+// One pass of the firmware loop; the peer acknowledges ack_bytes meanwhile
+void step(AsyncMQTTClient& mqtt, size_t ack_bytes) {
+  advanceClock(k_loop_period_us);
+  g_wifi.ack(ack_bytes);
+  serveBroker();
+  timedLoop(mqtt);
+}
+
+void setUpClient(AsyncMQTTClient& mqtt) {
+  mqtt.setServer("broker.local", 1883);
+  mqtt.setKeepAlive(k_keepalive_s);
+  mqtt.setCallback([](char*, uint8_t*, unsigned int) { g_delivered++; });
+}
+
+// Connects and waits for the CONNACK over a healthy link
+void establish(AsyncMQTTClient& mqtt) {
+  setUpClient(mqtt);
+  bool is_ok = false;
+  timedConnect(mqtt, is_ok);
+  TEST_ASSERT_TRUE(is_ok);
+  for (int i = 0; i < 100 && !mqtt.connected(); ++i) step(mqtt, k_sim_tcp_send_buffer);
+  TEST_ASSERT_TRUE(mqtt.connected());
+  uint64_t start = g_now_us;
+  TEST_ASSERT_TRUE(mqtt.subscribe("control/1/2/3/+", 1));
+  track(start);
+}
+
+} // namespace
+
+void setUp() {
+  g_wifi.stop();
+  g_wifi.connect_us = 30000;
+  g_wifi.is_reachable = true;
+  g_wifi.write_call_us = 50;
+  g_wifi.blocked_writes = 0;
+  g_is_broker_answering = true;
+  g_broker_pos = 0;
+  g_broker_publishes = 0;
+  g_delivered = 0;
+  g_worst_us = 0;
+}
+
+void tearDown() {}
+
+void test_healthy_session_within_budget() {
+  AsyncMQTTClient mqtt(g_wifi);
+  establish(mqtt);
+
+  // A minute of traffic both ways, keepalive pings included
+  for (uint32_t i = 0; i < 60000; ++i) {
+    if (i % 50 == 0) timedPublish(mqtt, 120, 1);
+    if (i % 20 == 0) timedPublish(mqtt, 60, 0);
+    if (i % 500 == 0) sendPublishToClient("control/1/2/3/command", 200, 1);
+    step(mqtt, 1460);
+  }
+
+  TEST_ASSERT_TRUE(mqtt.connected());
+  TEST_ASSERT_EQUAL_UINT32(0, g_wifi.blocked_writes);
+  TEST_ASSERT_EQUAL_UINT32(120, g_delivered);
+  TEST_ASSERT_GREATER_THAN_UINT32(4000, g_broker_publishes);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(k_call_budget_us, g_worst_us);
+}
+
+// A slow link: every write costs 1.5 ms and the peer takes 100 bytes per loop
+void test_slow_writes_within_budget() {
+  AsyncMQTTClient mqtt(g_wifi);
+  establish(mqtt);
+  g_wifi.write_call_us = 1500;
+
+  uint32_t refused = 0;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    for (int burst = 0; burst < 4; ++burst) {
+      if (!timedPublish(mqtt, 500, (uint8_t)(burst & 1))) refused++;
+    }
+    step(mqtt, 100);
+  }
+
+  TEST_ASSERT_TRUE(mqtt.connected());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, refused); // Refused when the ring is full, never waited for
+  TEST_ASSERT_EQUAL_UINT32(0, g_wifi.blocked_writes);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(k_call_budget_us, g_worst_us);
+}
+
+// Half-open socket: the connection looks up but nothing is acknowledged any more
+void test_stalled_socket_within_budget_then_dropped() {
+  AsyncMQTTClient mqtt(g_wifi);
+  establish(mqtt);
+
+  uint64_t stalled_at_us = g_now_us;
+  uint32_t steps = 0;
+  while (mqtt.connected()) {
+    timedPublish(mqtt, 500, 1);
+    timedPublish(mqtt, 80, 0);
+    step(mqtt, 0);
+    TEST_ASSERT_LESS_THAN(4 * k_keepalive_s * 1000, ++steps);
+  }
+
+  TEST_ASSERT_EQUAL(MQTTClientState::ConnectionTimeout, (MQTTClientState)mqtt.state());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(2 * k_keepalive_s * 1000000ULL, g_now_us - stalled_at_us);
+  TEST_ASSERT_EQUAL_UINT32(0, g_wifi.blocked_writes);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(k_call_budget_us, g_worst_us);
+}
+
+void test_missing_connack_within_budget() {
+  AsyncMQTTClient mqtt(g_wifi);
+  setUpClient(mqtt);
+  g_is_broker_answering = false;
+  bool is_ok = false;
+  timedConnect(mqtt, is_ok);
+  TEST_ASSERT_TRUE(is_ok);
+
+  uint64_t connected_at_us = g_now_us;
+  while (mqtt.isConnecting()) {
+    TEST_ASSERT_FALSE(timedPublish(mqtt, 50, 0)); // Not before the CONNACK
+    step(mqtt, k_sim_tcp_send_buffer);
+  }
+
+  TEST_ASSERT_EQUAL(MQTTClientState::ConnectionTimeout, (MQTTClientState)mqtt.state());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64((k_mqtt_connack_timeout_ms + 2) * 1000, g_now_us - connected_at_us);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(k_call_budget_us, g_worst_us);
+}
+
+// The exception: connect() blocks for the handshake, never longer than the connect timeout
+void test_connect_bounded_by_connect_timeout() {
+  AsyncMQTTClient mqtt(g_wifi);
+  setUpClient(mqtt);
+  bool is_ok = false;
+
+  g_wifi.connect_us = 400000; // Slow but successful handshake
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(400000 + k_call_budget_us, timedConnect(mqtt, is_ok));
+  TEST_ASSERT_TRUE(is_ok);
+
+  g_wifi.is_reachable = false; // Broker host down: the SYNs go unanswered
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(k_mqtt_tcp_connect_timeout_ms * 1000 + k_call_budget_us, timedConnect(mqtt, is_ok));
+  TEST_ASSERT_FALSE(is_ok);
+  TEST_ASSERT_EQUAL(MQTTClientState::ConnectFailed, (MQTTClientState)mqtt.state());
+
+  // A shorter timeout (e.g. while IR traffic is due) shortens the wait with it
+  mqtt.setConnectTimeout(250);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT64(250000 + k_call_budget_us, timedConnect(mqtt, is_ok));
+  TEST_ASSERT_FALSE(is_ok);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_healthy_session_within_budget);
+  RUN_TEST(test_slow_writes_within_budget);
+  RUN_TEST(test_stalled_socket_within_budget_then_dropped);
+  RUN_TEST(test_missing_connack_within_budget);
+  RUN_TEST(test_connect_bounded_by_connect_timeout);
+  return UNITY_END();
+}
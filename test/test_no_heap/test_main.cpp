@@ -0,0 +1,231 @@
+#include <unity.h>
+
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CommandDedup.h"
+#include "Cron.h"
+#include "Device_info.h"
+#include "IR_frame.h"
+#include "WiFiIndex.h"
+
+// Every heap allocation in the process is counted. The paths below run on
+// every command, IR frame or loop() once the device is up, and must not
+// allocate: on the ESP8266 each one fragments the heap further over weeks of
+// uptime. Each path is run once before counting, so one-off setup
+// (e.g. libc loading the time zone) is not charged to it.
+
+namespace {
+size_t g_allocations = 0;
+} // namespace
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#if defined(__GLIBC__)
+// C allocations too (String and ArduinoJson use malloc/realloc on the device)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size) {
+  g_allocations++;
+  return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+  g_allocations++;
+  return __libc_calloc(count, size);
+}
+void* realloc(void* p, size_t size) {
+  g_allocations++;
+  return __libc_realloc(p, size);
+}
+}
+#endif
+
+namespace {
+
+constexpr time_t k_monday_2058 = 1772485080; // 2026-03-02 20:58:00 UTC
+
+DedupSender g_senders[k_dedup_sender_slots];
+uint16_t g_durations[140];
+CronSpec g_specs[4];
+
+const CustomWiFi::WiFiCredential k_networks[] = {
+  {"office-2g", "a"}, {"office-5g", "b"}, {"lab", "c"}, {"guest", "d"}, {"office-2g", "dup"}, {"ops-floor-3", "e"},
+};
+CustomWiFi::WiFiIndex g_wifi_index;
+char g_text[128];
+
+void runCommandDedup(uint32_t seq) {
+  const char* senders[] = {"dash-1", "dash-2", "sched", "ops", "dash-3"}; // One more than the slots
+  for (const char* sender : senders) {
+    if (!isDuplicateSeq(g_senders, sender, seq)) markSeqSeen(g_senders, sender, seq, seq);
+  }
+  markSeqSeen(g_senders, "dash-1", 1, seq); // Sender restart
+}
+
+void runIRFrame() {
+  const uint8_t payload[] = {0x50, 0x24, 0x31, 0x08, 0xAF, 0xDB, 0xCE, 0xF7};
+  size_t len = 0;
+  buildIRFrame(k_mitsubishi_heavy_64, payload, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len);
+  buildIRFrame(k_default_protocol, payload, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len);
+}
+
+uint32_t runSchedulerTicks(CronClock& clock, time_t from, time_t to) {
+  uint32_t matches = 0;
+  for (time_t now = from; now <= to; ++now) {
+    time_t first = 0;
+    time_t last = 0;
+    if (!advanceCronClock(clock, now, 17, first, last)) continue;
+    for (time_t m = first; m <= last; ++m) {
+      time_t minute_start = m * 60;
+      struct tm local_time;
+      localtime_r(&minute_start, &local_time);
+      for (const CronSpec& spec : g_specs) {
+        if (isCronMatch(spec, local_time)) matches++;
+      }
+    }
+  }
+  return matches;
+}
+
+// One scan: every result hashed and looked up, the index rebuilt as after a table reload
+int runWiFiScan() {
+  const char* scanned[] = {"lab", "neighbour", "office-5g", "guest", "printer-direct", "office-2g"};
+  int hits = 0;
+  g_wifi_index.build(k_networks, sizeof(k_networks) / sizeof(k_networks[0]));
+  for (const char* ssid : scanned) {
+    if (g_wifi_index.find((const uint8_t*)ssid, strlen(ssid)) >= 0) hits++;
+  }
+  return hits;
+}
+
+// The text fields publishIdentity and publishDeployment format on every (re)connect
+size_t runDeviceRecords(uint32_t reason) {
+  const uint8_t mac[6] = {0x5C, 0xCF, 0x7F, 0x0A, 0xB1, 0x2E};
+  char device_id[32];
+  char mac_str[18];
+  char ip_str[16];
+  formatDeviceId(device_id, sizeof(device_id), 0x0AB12E);
+  formatMacAddress(mac_str, sizeof(mac_str), mac);
+  formatIpAddress(ip_str, sizeof(ip_str), 0x0B01A8C0); // 192.168.1.11
+  const char* section = isCrashResetReason(reason) ? "mqtt_loop" : "none";
+  return (size_t)snprintf(g_text, sizeof(g_text), "%s %s %s %s %s", device_id, mac_str, ip_str,
+                          resetReasonName(reason), section);
+}
+
+} // namespace
+
+void setUp() {
+  for (DedupSender& slot : g_senders) slot = DedupSender();
+  parseCronExpression("0 21 * * 1-5", g_specs[0]);
+  parseCronExpression("*/5 * * * *", g_specs[1]);
+  parseCronExpression("30 6 1 * 1", g_specs[2]);
+  parseCronExpression("* 22-23 * * *", g_specs[3]);
+}
+
+void tearDown() {}
+
+void test_counter_sees_allocations() {
+  size_t before = g_allocations;
+  int* volatile p = new int(1); // volatile: the pair may not be optimized out
+  delete p;
+  TEST_ASSERT_GREATER_THAN(before, g_allocations);
+}
+
+void test_command_dedup_no_heap() {
+  runCommandDedup(1);
+  size_t before = g_allocations;
+  for (uint32_t seq = 2; seq < 200; ++seq) runCommandDedup(seq);
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+}
+
+void test_ir_frame_no_heap() {
+  runIRFrame();
+  size_t before = g_allocations;
+  for (int i = 0; i < 100; ++i) runIRFrame();
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+}
+
+void test_scheduler_tick_no_heap() {
+  CronClock clock;
+  runSchedulerTicks(clock, k_monday_2058, k_monday_2058 + 60);
+
+  size_t before = g_allocations;
+  uint32_t matches = runSchedulerTicks(clock, k_monday_2058 + 61, k_monday_2058 + 3 * 3600);
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, matches); // The path was exercised
+}
+
+void test_cron_parse_no_heap() {
+  CronSpec spec;
+  parseCronExpression("0 21 * * 1-5", spec);
+  size_t before = g_allocations;
+  TEST_ASSERT_TRUE(parseCronExpression("*/15 8-10,20 1,15 * 0-6/2", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("61 * * * *", spec));
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+}
+
+void test_ir_frame_from_bits_no_heap() {
+  const char* bits = "01010000 00100100 00110001 00001000 10101111 11011011 11001110 11110111";
+  size_t len = 0;
+  buildIRFrameFromBits(k_mitsubishi_heavy_64, bits, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len);
+  size_t before = g_allocations;
+  for (int i = 0; i < 100; ++i) {
+    TEST_ASSERT_TRUE(buildIRFrameFromBits(k_mitsubishi_heavy_64, bits, g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len));
+  }
+  TEST_ASSERT_FALSE(buildIRFrameFromBits(k_mitsubishi_heavy_64, "0101", g_durations, sizeof(g_durations) / sizeof(g_durations[0]), len));
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+}
+
+void test_wifi_scan_match_no_heap() {
+  runWiFiScan();
+  size_t before = g_allocations;
+  int hits = 0;
+  for (int i = 0; i < 100; ++i) hits = runWiFiScan();
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+  TEST_ASSERT_EQUAL_INT(4, hits);
+  TEST_ASSERT_EQUAL_INT(0, g_wifi_index.find((const uint8_t*)"office-2g", 9)); // First of the duplicates
+}
+
+void test_device_records_no_heap() {
+  runDeviceRecords(0);
+  size_t before = g_allocations;
+  for (uint32_t reason = 0; reason < 100; ++reason) {
+    TEST_ASSERT_LESS_THAN(sizeof(g_text), runDeviceRecords(reason % 8)); // 7 is out of range
+  }
+  TEST_ASSERT_EQUAL_size_t(before, g_allocations);
+
+  runDeviceRecords(k_reset_reason_exception);
+  TEST_ASSERT_EQUAL_STRING("ESP8266Client-0AB12E 5C:CF:7F:0A:B1:2E 192.168.1.11 Exception mqtt_loop", g_text);
+  runDeviceRecords(7);
+  TEST_ASSERT_EQUAL_STRING("ESP8266Client-0AB12E 5C:CF:7F:0A:B1:2E 192.168.1.11 Unknown none", g_text);
+}
+
+int main(int, char**) {
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_counter_sees_allocations);
+  RUN_TEST(test_command_dedup_no_heap);
+  RUN_TEST(test_ir_frame_no_heap);
+  RUN_TEST(test_scheduler_tick_no_heap);
+  RUN_TEST(test_cron_parse_no_heap);
+  RUN_TEST(test_ir_frame_from_bits_no_heap);
+  RUN_TEST(test_wifi_scan_match_no_heap);
+  RUN_TEST(test_device_records_no_heap);
+  return UNITY_END();
+}
@@ -0,0 +1,308 @@
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "OTA_patch.h"
+
+namespace {
+
+constexpr size_t k_base_len = 3000;
+constexpr size_t k_out_max = 4096;
+constexpr size_t k_patch_max = 512;
+constexpr size_t k_budget = 256; // Output per feed() call, as serviceOTA() uses it
+
+uint8_t g_base[k_base_len];
+uint8_t g_expected[k_out_max];
+size_t g_expected_len = 0;
+
+uint8_t g_out[k_out_max];
+size_t g_out_len = 0;
+bool g_is_write_ok = true;
+
+uint8_t g_patch[k_patch_max];
+size_t g_patch_len = 0;
+uint32_t g_cursor = 0; // Encoder copy of the applier's base cursor
+
+bool readBase(uint32_t offset, uint8_t* data, size_t len, void*) {
+  if (offset > k_base_len || len > k_base_len - offset) return false;
+  memcpy(data, g_base + offset, len);
+  return true;
+}
+
+bool writeOut(const uint8_t* data, size_t len, void*) {
+  if (!g_is_write_ok || len > k_out_max - g_out_len) return false;
+  memcpy(g_out + g_out_len, data, len);
+  g_out_len += len;
+  return true;
+}
+
+// --- Patch encoder (same format as scripts/ota_server.py make_patch) ---
+
+void putByte(uint8_t value) {
+  TEST_ASSERT_LESS_THAN(k_patch_max, g_patch_len);
+  g_patch[g_patch_len++] = value;
+}
+
+void putVarint(uint32_t value) {
+  while (value >= 0x80) {
+    putByte((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  putByte((uint8_t)value);
+}
+
+void putLE32(uint32_t value) {
+  for (int i = 0; i < 4; ++i) putByte((uint8_t)(value >> (8 * i)));
+}
+
+void putHeader(uint32_t base_size, uint32_t out_size) {
+  g_patch_len = 0;
+  g_cursor = 0;
+  g_expected_len = 0;
+  for (const char* p = "OTP1"; *p != '\0'; ++p) putByte((uint8_t)*p);
+  putLE32(base_size);
+  putLE32(out_size);
+}
+
+void putCopy(uint32_t from, uint32_t len) {
+  if (from == g_cursor && len < 0x40) {
+    putByte((uint8_t)(0x80 | len));
+  } else if (from == g_cursor) {
+    putByte(0x80);
+    putVarint(len);
+  } else {
+    int64_t delta = (int64_t)from - g_cursor;
+    putByte(0x01);
+    putVarint((delta < 0) ? (uint32_t)(-delta * 2 - 1) : (uint32_t)(delta * 2)); // Zigzag
+    putVarint(len);
+  }
+  if (from + len <= k_base_len) {
+    memcpy(g_expected + g_expected_len, g_base + from, len);
+    g_expected_len += len;
+  }
+  g_cursor = from + len;
+}
+
+void putInsert(const uint8_t* data, uint32_t len) {
+  if (len < 0x40) {
+    putByte((uint8_t)(0x40 | len));
+  } else {
+    putByte(0x40);
+    putVarint(len);
+  }
+  for (uint32_t i = 0; i < len; ++i) putByte(data[i]);
+  memcpy(g_expected + g_expected_len, data, len);
+  g_expected_len += len;
+  g_cursor += len;
+}
+
+// A small code change: patched bytes in place, a block moved back, a tail appended
+void buildTypicalPatch() {
+  static const uint8_t k_moved_pointer[] = {0x3c, 0x41, 0x20, 0x40};
+  uint8_t tail[100];
+  for (size_t i = 0; i < sizeof(tail); ++i) tail[i] = (uint8_t)(0xA0 + i);
+
+  putHeader(k_base_len, 0); // Output size patched in below
+  putCopy(0, 40);
+  putInsert(k_moved_pointer, sizeof(k_moved_pointer));
+  putCopy(44, 1);
+  putCopy(45, 1200);
+  putCopy(100, 300); // Backward delta
+  putCopy(1600, 1400);
+  putInsert(tail, sizeof(tail));
+  putByte(0x00);
+
+  for (int i = 0; i < 4; ++i) g_patch[8 + i] = (uint8_t)(g_expected_len >> (8 * i));
+}
+
+// Feeds the patch in pieces of 1..max_chunk bytes the way serviceOTA() does
+void applyPatch(OTAPatchApplier& applier, size_t len, size_t max_chunk, unsigned int seed) {
+  srand(seed);
+  g_out_len = 0;
+  applier.begin(readBase, writeOut, nullptr, k_base_len);
+
+  size_t pos = 0;
+  uint32_t guard = 0;
+  while ((pos < len || applier.hasPendingCopy()) && !applier.hasFailed() && !applier.isDone()) {
+    size_t chunk = 1 + (size_t)rand() % max_chunk;
+    if (chunk > len - pos) chunk = len - pos;
+    pos += applier.feed(g_patch + pos, chunk, k_budget);
+    TEST_ASSERT_LESS_THAN(100000, ++guard);
+  }
+}
+
+} // namespace
+
+void setUp() {
+  for (size_t i = 0; i < k_base_len; ++i) g_base[i] = (uint8_t)((i * 131u) ^ (i >> 5));
+  g_out_len = 0;
+  g_is_write_ok = true;
+}
+
+void tearDown() {}
+
+void test_round_trip() {
+  buildTypicalPatch();
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+
+  TEST_ASSERT_FALSE(applier.hasFailed());
+  TEST_ASSERT_TRUE(applier.isDone());
+  TEST_ASSERT_EQUAL_UINT32(g_expected_len, applier.outputSize());
+  TEST_ASSERT_EQUAL_UINT32(g_expected_len, g_out_len);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(g_expected, g_out, g_expected_len);
+}
+
+void test_round_trip_any_chunking() {
+  buildTypicalPatch();
+  for (unsigned int seed = 0; seed < 50; ++seed) {
+    OTAPatchApplier applier;
+    applyPatch(applier, g_patch_len, 1 + seed % 7, seed);
+    TEST_ASSERT_TRUE(applier.isDone());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(g_expected, g_out, g_expected_len);
+  }
+}
+
+void test_budget_limits_output_per_call() {
+  buildTypicalPatch();
+  OTAPatchApplier applier;
+  applier.begin(readBase, writeOut, nullptr, k_base_len);
+
+  size_t pos = 0;
+  while (!applier.isDone() && !applier.hasFailed()) {
+    size_t before = g_out_len;
+    pos += applier.feed(g_patch + pos, g_patch_len - pos, k_budget);
+    // At most one copy block or one insert run past the budget
+    TEST_ASSERT_LESS_OR_EQUAL(k_budget + k_ota_patch_copy_block + 100, g_out_len - before);
+  }
+  TEST_ASSERT_TRUE(applier.isDone());
+}
+
+void test_bad_magic() {
+  buildTypicalPatch();
+  g_patch[0] = 'X';
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Header, applier.error());
+  TEST_ASSERT_EQUAL_UINT32(0, g_out_len);
+}
+
+void test_base_larger_than_running_image() {
+  putHeader(k_base_len + 1, 1);
+  putCopy(0, 1);
+  putByte(0x00);
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Header, applier.error());
+}
+
+void test_unknown_opcode() {
+  putHeader(k_base_len, 1);
+  putByte(0xC0);
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Opcode, applier.error());
+}
+
+void test_copy_outside_base() {
+  putHeader(k_base_len, 200);
+  putCopy(k_base_len - 100, 200);
+  putByte(0x00);
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Range, applier.error());
+  TEST_ASSERT_EQUAL_UINT32(0, g_out_len);
+}
+
+void test_output_beyond_declared_size() {
+  buildTypicalPatch();
+  g_patch[8] = (uint8_t)(g_patch[8] - 1); // One byte less than the ops produce
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Range, applier.error());
+  TEST_ASSERT_LESS_OR_EQUAL(applier.outputSize(), g_out_len);
+}
+
+void test_end_before_declared_size() {
+  putHeader(k_base_len, 100);
+  putCopy(0, 50);
+  putByte(0x00);
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Truncated, applier.error());
+  TEST_ASSERT_FALSE(applier.isDone());
+}
+
+void test_truncated_stream_is_never_done() {
+  buildTypicalPatch();
+  for (size_t len = 0; len < g_patch_len; len += 7) {
+    OTAPatchApplier applier;
+    applyPatch(applier, len, 64, (unsigned int)len);
+    TEST_ASSERT_FALSE(applier.isDone());
+    TEST_ASSERT_LESS_OR_EQUAL(g_expected_len, g_out_len);
+    if (g_out_len > 0) TEST_ASSERT_EQUAL_UINT8_ARRAY(g_expected, g_out, g_out_len);
+  }
+}
+
+void test_base_read_failure() {
+  putHeader(k_base_len, 10);
+  putCopy(0, 10);
+  putByte(0x00);
+  OTAPatchApplier applier;
+  applier.begin(readBase, writeOut, nullptr, k_base_len);
+  applier.feed(g_patch, g_patch_len, k_budget);
+  TEST_ASSERT_TRUE(applier.isDone());
+
+  // Same patch, but the running image is shorter than the base it names
+  applier.begin([](uint32_t, uint8_t*, size_t, void*) { return false; }, writeOut, nullptr, k_base_len);
+  applier.feed(g_patch, g_patch_len, k_budget);
+  TEST_ASSERT_EQUAL(OTAPatchError::Read, applier.error());
+}
+
+void test_write_failure() {
+  buildTypicalPatch();
+  g_is_write_ok = false;
+  OTAPatchApplier applier;
+  applyPatch(applier, g_patch_len, 600, 1);
+  TEST_ASSERT_EQUAL(OTAPatchError::Write, applier.error());
+}
+
+void test_corrupted_patch_stays_in_bounds() {
+  buildTypicalPatch();
+  uint8_t original[k_patch_max];
+  memcpy(original, g_patch, g_patch_len);
+  size_t original_len = g_patch_len;
+
+  for (unsigned int trial = 0; trial < 300; ++trial) {
+    memcpy(g_patch, original, original_len);
+    srand(trial);
+    int flips = 1 + rand() % 4;
+    for (int i = 0; i < flips; ++i) g_patch[k_ota_patch_header_len + (size_t)rand() % (original_len - k_ota_patch_header_len)] ^= (uint8_t)(1 << (rand() % 8));
+
+    OTAPatchApplier applier;
+    applyPatch(applier, original_len, 600, trial);
+    // readBase() rejects out-of-range reads, so Read would mean the applier asked for one
+    TEST_ASSERT_NOT_EQUAL(OTAPatchError::Read, applier.error());
+    TEST_ASSERT_LESS_OR_EQUAL(applier.outputSize(), g_out_len);
+    if (applier.isDone()) TEST_ASSERT_EQUAL_UINT32(applier.outputSize(), g_out_len);
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_round_trip_any_chunking);
+  RUN_TEST(test_budget_limits_output_per_call);
+  RUN_TEST(test_bad_magic);
+  RUN_TEST(test_base_larger_than_running_image);
+  RUN_TEST(test_unknown_opcode);
+  RUN_TEST(test_copy_outside_base);
+  RUN_TEST(test_output_beyond_declared_size);
+  RUN_TEST(test_end_before_declared_size);
+  RUN_TEST(test_truncated_stream_is_never_done);
+  RUN_TEST(test_base_read_failure);
+  RUN_TEST(test_write_failure);
+  RUN_TEST(test_corrupted_patch_stays_in_bounds);
+  return UNITY_END();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Native stand-in for the parts of the ESP8266 core that OTA_update.cpp uses.
+// The running image is a buffer the test fills (see test_main.cpp).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class EspClass {
+public:
+  const uint8_t* image = nullptr;
+  uint32_t image_len = 0;
+
+  uint32_t getSketchSize() { return image_len; }
+  bool flashRead(uint32_t address, uint32_t* data, size_t size) {
+    if (address % 4 != 0 || size % 4 != 0 || address > image_len) return false;
+    size_t n = (size < image_len - address) ? size : image_len - address; // Erased flash past the image
+    memset(data, 0xFF, size);
+    memcpy(data, image + address, n);
+    return true;
+  }
+};
+
+extern EspClass ESP;
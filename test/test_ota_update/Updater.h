@@ -0,0 +1,61 @@
+#pragma once
+
+// Native stand-in for the ESP8266 Updater. It stages the image in RAM; end()
+// checks it against the test's expected image, where the core checks the MD5.
+
+#include "Arduino.h"
+
+#define U_FLASH 0
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_SPACE 4
+#define UPDATE_ERROR_MD5 9
+
+constexpr size_t k_update_stage_max = 8192;
+
+class UpdaterClass {
+public:
+  const uint8_t* expected = nullptr;  // Image the offer's MD5 stands for
+  uint8_t staged[k_update_stage_max];
+  size_t size = 0;
+  size_t written = 0;
+  uint32_t commits = 0;
+
+  bool begin(size_t image_size, int = U_FLASH) {
+    if (image_size > sizeof(staged)) {
+      error_ = UPDATE_ERROR_SPACE;
+      return false;
+    }
+    size = image_size;
+    written = 0;
+    error_ = UPDATE_ERROR_OK;
+    is_running_ = true;
+    return true;
+  }
+  bool setMD5(const char*) { return true; }
+  size_t write(uint8_t* data, size_t len) {
+    if (!is_running_ || len > size - written) return 0;
+    memcpy(staged + written, data, len);
+    written += len;
+    return len;
+  }
+  // Unfinished images are discarded, as the core does without evenIfRemaining
+  bool end(bool = false) {
+    if (!is_running_) return false;
+    is_running_ = false;
+    if (written != size) return false;
+    if (expected == nullptr || memcmp(staged, expected, size) != 0) {
+      error_ = UPDATE_ERROR_MD5;
+      return false;
+    }
+    commits++;
+    return true;
+  }
+  bool isRunning() { return is_running_; }
+  uint8_t getError() { return error_; }
+
+private:
+  bool is_running_ = false;
+  uint8_t error_ = UPDATE_ERROR_OK;
+};
+
+extern UpdaterClass Update;
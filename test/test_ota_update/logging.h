@@ -0,0 +1,8 @@
+#pragma once
+
+// Native stand-in: the session engine's log calls are dropped.
+
+inline void logError(const char*, const char*, ...) {}
+inline void logWarn(const char*, const char*, ...) {}
+inline void logInfo(const char*, const char*, ...) {}
+inline void logDebug(const char*, const char*, ...) {}
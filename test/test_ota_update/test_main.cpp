@@ -0,0 +1,326 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OTA_patch.h"
+
+// OTA_update is limited to espressif8266 (Updater, flash reads), so the native
+// env does not build it as a library: its source is compiled here against the
+// Arduino.h, Updater.h and logging.h stand-ins in this directory.
+#include "../../lib/OTA_update/OTA_update.cpp"
+
+EspClass ESP;
+UpdaterClass Update;
+
+namespace {
+
+constexpr uint16_t k_chunk = 64; // The smallest offers allow: the patch spans several chunks
+constexpr size_t k_running_len = 3000;
+constexpr size_t k_new_len = 3100;
+constexpr size_t k_patch_max = 1024;
+constexpr const char* k_md5 = "0badc0de0123456789abcdef01234567";
+
+uint8_t g_running[k_running_len];  // Image the device is running (patch base)
+uint8_t g_new[k_new_len];          // Image being offered
+uint8_t g_patch_stream[k_patch_max];
+size_t g_patch_stream_len = 0;
+uint8_t g_frame[k_ota_frame_header_len + k_ota_chunk_max];
+
+uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+void putLE(uint8_t* out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+const uint8_t* streamData(OTAStream stream) {
+  return (stream == OTAStream::Patch) ? g_patch_stream : g_new;
+}
+
+size_t streamSize(OTAStream stream) {
+  return (stream == OTAStream::Patch) ? g_patch_stream_len : k_new_len;
+}
+
+// Frame for chunk index of a stream, as scripts/ota_server.py sends it
+size_t buildFrame(OTAStream stream, uint32_t index) {
+  size_t offset = (size_t)index * k_chunk;
+  size_t len = streamSize(stream) - offset;
+  if (len > k_chunk) len = k_chunk;
+  putLE(g_frame, 0x544F, 2);
+  g_frame[2] = 1;
+  g_frame[3] = (uint8_t)stream;
+  putLE(g_frame + 4, otaSessionId(k_md5), 4);
+  putLE(g_frame + 8, index, 4);
+  memcpy(g_frame + k_ota_frame_header_len, streamData(stream) + offset, len);
+  putLE(g_frame + 12, crc32(streamData(stream) + offset, len), 4);
+  return k_ota_frame_header_len + len;
+}
+
+OTAChunkResult submit(OTAStream stream, uint32_t index) {
+  return submitOTAChunk(g_frame, buildFrame(stream, index));
+}
+
+// serviceOTA() until the pending chunks are applied; counts the calls
+uint32_t serviceAll() {
+  uint32_t calls = 0;
+  while (isOTAChunkPending()) {
+    serviceOTA();
+    TEST_ASSERT_LESS_THAN(10000, ++calls);
+  }
+  return calls;
+}
+
+OTAOffer makeOffer(bool has_patch) {
+  OTAOffer offer;
+  strcpy(offer.version, "v2");
+  strcpy(offer.md5, k_md5);
+  offer.size = k_new_len;
+  offer.chunk_size = k_chunk;
+  offer.has_patch = has_patch;
+  strcpy(offer.patch_base, "v1");
+  offer.patch_size = (uint32_t)g_patch_stream_len;
+  return offer;
+}
+
+// Requests every chunk in order, the way mqtt_ota.cpp does after each window
+void download(OTAStream stream) {
+  while (isOTAActive()) {
+    uint32_t index = getOTAProgress().next_index;
+    TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(stream, index));
+    serviceAll();
+  }
+}
+
+// --- Patch encoder (same format as scripts/ota_server.py make_patch) ---
+
+void putByte(uint8_t value) {
+  TEST_ASSERT_LESS_THAN(k_patch_max, g_patch_stream_len);
+  g_patch_stream[g_patch_stream_len++] = value;
+}
+
+void putVarint(uint32_t value) {
+  while (value >= 0x80) {
+    putByte((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  putByte((uint8_t)value);
+}
+
+// New image = running image with a changed middle and an appended tail
+void buildPatch() {
+  g_patch_stream_len = 0;
+  for (const char* p = "OTP1"; *p != '\0'; ++p) putByte((uint8_t)*p);
+  putLE(g_patch_stream + g_patch_stream_len, k_running_len, 4);
+  g_patch_stream_len += 4;
+  putLE(g_patch_stream + g_patch_stream_len, k_new_len, 4);
+  g_patch_stream_len += 4;
+
+  putByte(0x01); // Copy with a delta (zigzag), from the start
+  putVarint(0);
+  putVarint(1000);
+  putByte(0x40 | 16); // Insert
+  for (size_t i = 1000; i < 1016; ++i) putByte(g_new[i]);
+  putByte(0x80); // The insert moved the cursor past the replaced bytes
+  putVarint(k_running_len - 1016);
+  putByte(0x40); // Insert, length as varint
+  putVarint(k_new_len - k_running_len);
+  for (size_t i = k_running_len; i < k_new_len; ++i) putByte(g_new[i]);
+  putByte(0x00); // END
+}
+
+} // namespace
+
+void setUp() {
+  for (size_t i = 0; i < k_running_len; ++i) g_running[i] = (uint8_t)((i * 131u) ^ (i >> 5));
+  memcpy(g_new, g_running, k_running_len);
+  for (size_t i = 1000; i < 1016; ++i) g_new[i] = (uint8_t)~g_new[i];
+  for (size_t i = k_running_len; i < k_new_len; ++i) g_new[i] = (uint8_t)(i * 7);
+  buildPatch();
+
+  ESP.image = g_running;
+  ESP.image_len = k_running_len;
+  Update.expected = g_new;
+  Update.commits = 0;
+  abortOTA();
+}
+
+void tearDown() {}
+
+void test_image_stream() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+  download(OTAStream::Image);
+
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+  TEST_ASSERT_EQUAL_UINT32((k_new_len + k_chunk - 1) / k_chunk, getOTAProgress().chunk_count);
+  TEST_ASSERT_EQUAL_UINT32(k_new_len, getOTAProgress().received);
+  TEST_ASSERT_EQUAL_UINT32(1, Update.commits);
+}
+
+void test_patch_stream() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Patch));
+  download(OTAStream::Patch);
+
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+  TEST_ASSERT_EQUAL_UINT32(g_patch_stream_len, getOTAProgress().received);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(g_new, Update.staged, k_new_len);
+}
+
+void test_dropped_chunk_is_requested_again() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(OTAStream::Image, 0));
+  serviceAll();
+
+  // Chunk 1 is lost: 2 and 3 of the same window arrive out of order
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submit(OTAStream::Image, 2));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submit(OTAStream::Image, 3));
+  TEST_ASSERT_FALSE(isOTAChunkPending());
+  TEST_ASSERT_EQUAL_UINT32(1, getOTAProgress().next_index);
+
+  download(OTAStream::Image); // The re-request starts at next_index
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+}
+
+void test_corrupt_chunk_is_rejected() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+
+  size_t len = buildFrame(OTAStream::Image, 0);
+  g_frame[k_ota_frame_header_len + 10] ^= 0x04;
+  TEST_ASSERT_EQUAL(OTAChunkResult::Corrupt, submitOTAChunk(g_frame, len));
+  TEST_ASSERT_EQUAL_UINT32(1, getOTAProgress().crc_failures);
+
+  len = buildFrame(OTAStream::Image, 0);
+  TEST_ASSERT_EQUAL(OTAChunkResult::Corrupt, submitOTAChunk(g_frame, len - 1)); // Short
+  g_frame[0] = 'X';
+  TEST_ASSERT_EQUAL(OTAChunkResult::Corrupt, submitOTAChunk(g_frame, len)); // Magic
+  TEST_ASSERT_FALSE(isOTAChunkPending());
+
+  download(OTAStream::Image);
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+}
+
+void test_duplicate_chunk_is_applied_once() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(OTAStream::Image, 0));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submit(OTAStream::Image, 0)); // Redelivered while pending
+  serviceAll();
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submit(OTAStream::Image, 0)); // And after it was applied
+  TEST_ASSERT_EQUAL_size_t(k_chunk, Update.written);
+
+  download(OTAStream::Image);
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+}
+
+void test_two_chunks_buffered_then_busy() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(OTAStream::Image, 0));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(OTAStream::Image, 1));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Busy, submit(OTAStream::Image, 2));
+  serviceAll();
+  TEST_ASSERT_EQUAL_UINT32(2, getOTAProgress().next_index);
+}
+
+void test_outage_then_resume() {
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Patch));
+  for (uint32_t i = 0; i < 2; ++i) {
+    TEST_ASSERT_EQUAL(OTAChunkResult::Accepted, submit(OTAStream::Patch, i));
+    serviceAll();
+  }
+
+  // Broker gone: nothing arrives, servicing an empty session does nothing
+  for (int i = 0; i < 100; ++i) TEST_ASSERT_FALSE(serviceOTA());
+  TEST_ASSERT_TRUE(isOTAActive());
+  TEST_ASSERT_EQUAL_UINT32(2, getOTAProgress().next_index);
+
+  // Chunks of another offer that were still in flight are ignored
+  size_t len = buildFrame(OTAStream::Patch, 2);
+  putLE(g_frame + 4, otaSessionId(k_md5) + 1, 4);
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submitOTAChunk(g_frame, len));
+  TEST_ASSERT_EQUAL(OTAChunkResult::Stale, submit(OTAStream::Image, 2));
+
+  download(OTAStream::Patch); // Resumed from next_index
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(g_new, Update.staged, k_new_len);
+}
+
+// mqtt_ota.cpp restarts the offer as an image after a patch failure
+void test_patch_failure_falls_back_to_image() {
+  g_patch_stream[k_ota_patch_header_len + 1] = 0x7F; // First copy starts before the base
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Patch));
+  download(OTAStream::Patch);
+  TEST_ASSERT_EQUAL(OTAStatus::Failed, getOTAProgress().status);
+  TEST_ASSERT_EQUAL(OTAError::Patch, getOTAProgress().error);
+  TEST_ASSERT_FALSE(Update.isRunning()); // Partial image discarded
+
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Image));
+  download(OTAStream::Image);
+  TEST_ASSERT_EQUAL(OTAStatus::Ready, getOTAProgress().status);
+  TEST_ASSERT_EQUAL_UINT32(1, Update.commits);
+}
+
+void test_wrong_image_fails_verify() {
+  static uint8_t other[k_new_len];
+  memcpy(other, g_new, k_new_len);
+  other[2000] ^= 0x01;
+  Update.expected = other; // The MD5 stands for another image
+  TEST_ASSERT_TRUE(startOTA(makeOffer(false), OTAStream::Image));
+  download(OTAStream::Image);
+  TEST_ASSERT_EQUAL(OTAStatus::Failed, getOTAProgress().status);
+  TEST_ASSERT_EQUAL(OTAError::Verify, getOTAProgress().error);
+  TEST_ASSERT_EQUAL_UINT8(UPDATE_ERROR_MD5, getOTAProgress().update_error);
+}
+
+// END in the middle of the last chunk: the bytes after it are never consumed
+void test_bytes_after_end_fail_the_session() {
+  for (int i = 0; i < 5; ++i) putByte(0xAA);
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Patch));
+  download(OTAStream::Patch);
+  TEST_ASSERT_EQUAL(OTAStatus::Failed, getOTAProgress().status);
+  TEST_ASSERT_EQUAL(OTAError::Patch, getOTAProgress().error);
+  TEST_ASSERT_FALSE(isOTAChunkPending());
+}
+
+// END before the last chunk: the remaining chunks can never be applied
+void test_end_before_last_chunk_fails_the_session() {
+  size_t padded_len = (g_patch_stream_len + k_chunk - 1) / k_chunk * k_chunk + 10; // One more chunk
+  while (g_patch_stream_len < padded_len) putByte(0x00);
+  TEST_ASSERT_TRUE(startOTA(makeOffer(true), OTAStream::Patch));
+  download(OTAStream::Patch);
+  TEST_ASSERT_EQUAL(OTAStatus::Failed, getOTAProgress().status);
+  TEST_ASSERT_EQUAL(OTAError::Patch, getOTAProgress().error);
+  TEST_ASSERT_LESS_THAN_UINT32(getOTAProgress().chunk_count - 1, getOTAProgress().next_index);
+  TEST_ASSERT_FALSE(isOTAChunkPending());
+}
+
+void test_invalid_offer() {
+  OTAOffer offer = makeOffer(false);
+  offer.chunk_size = 16;
+  TEST_ASSERT_FALSE(startOTA(offer, OTAStream::Image));
+  TEST_ASSERT_EQUAL(OTAError::Offer, getOTAProgress().error);
+
+  TEST_ASSERT_FALSE(startOTA(makeOffer(false), OTAStream::Patch)); // No patch in the offer
+  TEST_ASSERT_EQUAL(OTAError::Offer, getOTAProgress().error);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_image_stream);
+  RUN_TEST(test_patch_stream);
+  RUN_TEST(test_dropped_chunk_is_requested_again);
+  RUN_TEST(test_corrupt_chunk_is_rejected);
+  RUN_TEST(test_duplicate_chunk_is_applied_once);
+  RUN_TEST(test_two_chunks_buffered_then_busy);
+  RUN_TEST(test_outage_then_resume);
+  RUN_TEST(test_patch_failure_falls_back_to_image);
+  RUN_TEST(test_wrong_image_fails_verify);
+  RUN_TEST(test_bytes_after_end_fail_the_session);
+  RUN_TEST(test_end_before_last_chunk_fails_the_session);
+  RUN_TEST(test_invalid_offer);
+  return UNITY_END();
+}
@@ -0,0 +1,172 @@
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "Cron.h"
+
+namespace {
+
+constexpr time_t k_monday_2058 = 1772485080;   // 2026-03-02 20:58:00 UTC, a Monday
+constexpr time_t k_saturday_2058 = 1772917080; // 2026-03-07 20:58:00 UTC
+constexpr uint8_t k_entries_max = 4;
+
+// Same evaluation pollSchedule() does, recording when each entry fired
+struct FakeScheduler {
+  CronClock clock;
+  CronSpec entries[k_entries_max];
+  uint8_t entry_count = 0;
+  uint16_t jitter_s = 0;
+  uint16_t fires[k_entries_max] = {};
+  time_t last_fire_s[k_entries_max] = {};
+
+  void add(const char* expr) {
+    TEST_ASSERT_TRUE(parseCronExpression(expr, entries[entry_count]));
+    entry_count++;
+  }
+
+  void tick(time_t now) {
+    time_t first = 0;
+    time_t last = 0;
+    if (!advanceCronClock(clock, now, jitter_s, first, last)) return;
+    for (time_t m = first; m <= last; ++m) {
+      time_t minute_start = m * 60;
+      struct tm local_time;
+      localtime_r(&minute_start, &local_time);
+      for (uint8_t i = 0; i < entry_count; ++i) {
+        if (!isCronMatch(entries[i], local_time)) continue;
+        fires[i]++;
+        last_fire_s[i] = now;
+      }
+    }
+  }
+
+  void run(time_t from, time_t to) {
+    for (time_t now = from; now <= to; ++now) tick(now);
+  }
+};
+
+FakeScheduler g_sched;
+
+struct tm makeTime(int mday, int hour, int min, int wday) {
+  struct tm t = {};
+  t.tm_year = 126;
+  t.tm_mon = 2;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_wday = wday;
+  return t;
+}
+
+} // namespace
+
+void setUp() {
+  g_sched = FakeScheduler();
+}
+
+void tearDown() {}
+
+void test_parse_rejects_invalid() {
+  CronSpec spec;
+  TEST_ASSERT_FALSE(parseCronExpression("0 21 * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("0 21 * * * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("60 21 * * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("0 24 * * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("0 21 0 * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("*/0 * * * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression("5-2 * * * *", spec));
+  TEST_ASSERT_FALSE(parseCronExpression(nullptr, spec));
+}
+
+void test_parse_fields() {
+  CronSpec spec;
+  TEST_ASSERT_TRUE(parseCronExpression("*/15 8-10,20 * * 7", spec));
+  TEST_ASSERT_TRUE(spec.minutes == ((1ULL << 0) | (1ULL << 15) | (1ULL << 30) | (1ULL << 45)));
+  TEST_ASSERT_EQUAL_UINT32((1UL << 8) | (1UL << 9) | (1UL << 10) | (1UL << 20), spec.hours);
+  TEST_ASSERT_EQUAL_UINT8(1, spec.weekdays); // 7 is Sunday
+  TEST_ASSERT_TRUE(spec.is_day_any);
+  TEST_ASSERT_FALSE(spec.is_weekday_any);
+}
+
+void test_day_fields_either_match() {
+  CronSpec spec;
+  TEST_ASSERT_TRUE(parseCronExpression("0 21 1 * 1", spec)); // The 1st, or any Monday
+  TEST_ASSERT_TRUE(isCronMatch(spec, makeTime(2, 21, 0, 1)));
+  TEST_ASSERT_TRUE(isCronMatch(spec, makeTime(1, 21, 0, 0)));
+  TEST_ASSERT_FALSE(isCronMatch(spec, makeTime(3, 21, 0, 2)));
+}
+
+void test_fires_once_per_minute() {
+  g_sched.add("0 21 * * 1-5");
+  g_sched.run(k_monday_2058, k_monday_2058 + 7 * 60);
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+  TEST_ASSERT_EQUAL(k_monday_2058 + 120, g_sched.last_fire_s[0]);
+}
+
+void test_jitter_delays_inside_minute() {
+  g_sched.jitter_s = 17;
+  g_sched.add("0 21 * * *");
+  g_sched.run(k_monday_2058, k_monday_2058 + 5 * 60);
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+  TEST_ASSERT_EQUAL(k_monday_2058 + 120 + 17, g_sched.last_fire_s[0]);
+}
+
+void test_weekday_filter() {
+  g_sched.add("0 21 * * 1-5");
+  g_sched.run(k_saturday_2058, k_saturday_2058 + 5 * 60);
+  TEST_ASSERT_EQUAL_UINT16(0, g_sched.fires[0]);
+}
+
+void test_short_stall_caught_up() {
+  g_sched.add("0 21 * * *");
+  g_sched.tick(k_monday_2058 + 90);       // 20:59:30
+  g_sched.tick(k_monday_2058 + 4 * 60);   // 21:02:00, three minutes later
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+}
+
+void test_large_jump_only_current_minute() {
+  g_sched.add("0 21 * * *");
+  g_sched.add("30 21 * * *");
+  g_sched.tick(k_monday_2058 - 8 * 60);   // 20:50
+  g_sched.tick(k_monday_2058 + 32 * 60);  // 21:30
+  TEST_ASSERT_EQUAL_UINT16(0, g_sched.fires[0]);
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[1]);
+}
+
+void test_backward_step_does_not_refire() {
+  g_sched.add("0 21 * * *");
+  g_sched.add("* * * * *");
+  g_sched.run(k_monday_2058, k_monday_2058 + 3 * 60);           // Up to 21:01:00
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+  TEST_ASSERT_EQUAL_UINT16(4, g_sched.fires[1]);                // 20:58 - 21:01
+
+  g_sched.run(k_monday_2058 + 30, k_monday_2058 + 6 * 60);      // NTP steps back to 20:58:30
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+  TEST_ASSERT_EQUAL_UINT16(7, g_sched.fires[1]);                // Each minute still once: 21:02 - 21:04
+}
+
+void test_unsynced_clock_ignored() {
+  g_sched.add("* * * * *");
+  g_sched.run(600, 1200);
+  TEST_ASSERT_EQUAL_UINT16(0, g_sched.fires[0]);
+  g_sched.tick(k_monday_2058);
+  TEST_ASSERT_EQUAL_UINT16(1, g_sched.fires[0]);
+}
+
+int main(int, char**) {
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_rejects_invalid);
+  RUN_TEST(test_parse_fields);
+  RUN_TEST(test_day_fields_either_match);
+  RUN_TEST(test_fires_once_per_minute);
+  RUN_TEST(test_jitter_delays_inside_minute);
+  RUN_TEST(test_weekday_filter);
+  RUN_TEST(test_short_stall_caught_up);
+  RUN_TEST(test_large_jump_only_current_minute);
+  RUN_TEST(test_backward_step_does_not_refire);
+  RUN_TEST(test_unsynced_clock_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,84 @@
+/*
+ * bench_logging.cpp
+ *
+ * Caller-side cost of a log call: the deferred logger in lib/logging (record
+ * enqueue only, and enqueue plus the formatting handleLogging() does later)
+ * against the previous logger, which ran vsnprintf and Serial.printf inside
+ * the call. Serial output is discarded, so neither side includes UART time;
+ * on the module the previous logger also blocked once the 128-byte FIFO was
+ * full.
+ */
+
+#include <stdarg.h>
+
+#include <chrono>
+
+#include "logging.h"
+
+HardwareSerial Serial;
+
+extern "C" {
+uint32_t sim_millis(void) { return 1234; }
+size_t sim_serial_write(const uint8_t*, size_t len) { return len; }
+}
+
+namespace {
+
+constexpr int k_calls = 200000;
+constexpr int k_batch = 16; // Records per flush, well inside LOG_RING_SIZE
+constexpr const char* k_log_tag = "MQTT";
+
+char g_old_message[512];
+char g_old_line[sizeof(g_old_message) + 32]; // Message plus "[LEVEL] [TAG] " prefix
+
+// Previous logInfo(): format in the caller, then Serial.printf
+void oldLogInfo(const char* tag, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vsnprintf(g_old_message, sizeof(g_old_message), format, args);
+  va_end(args);
+  int n = snprintf(g_old_line, sizeof(g_old_line), "[%s] [%s] %s\n", "INFO", tag, g_old_message);
+  Serial.write((const uint8_t*)g_old_line, (size_t)n);
+}
+
+using Clock = std::chrono::steady_clock;
+
+double nsPerCall(Clock::duration elapsed) {
+  return std::chrono::duration<double, std::nano>(elapsed).count() / k_calls;
+}
+
+} // namespace
+
+int main() {
+  initLogging();
+  const char* topic = "acu/f1/r101/ACU1";
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < k_calls; ++i) {
+    oldLogInfo(k_log_tag, "Processing topic: %s len=%u rssi=%d", topic, 42u, -71);
+  }
+  Clock::duration old_path = Clock::now() - start;
+
+  Clock::duration enqueue{};
+  Clock::duration flush{};
+  for (int i = 0; i < k_calls / k_batch; ++i) {
+    Clock::time_point batch = Clock::now();
+    for (int j = 0; j < k_batch; ++j) {
+      logInfo(k_log_tag, "Processing topic: %s len=%u rssi=%d", topic, 42u, -71);
+    }
+    Clock::time_point formatted = Clock::now();
+    flushLogs();
+    enqueue += formatted - batch;
+    flush += Clock::now() - formatted;
+  }
+
+  if (getLogDropCount() != 0) {
+    fprintf(stderr, "%u records dropped\n", (unsigned int)getLogDropCount());
+    return 1;
+  }
+
+  printf("previous logger (vsnprintf + printf): %5.0f ns/call\n", nsPerCall(old_path));
+  printf("deferred logger, enqueue only:        %5.0f ns/call\n", nsPerCall(enqueue));
+  printf("deferred logger, enqueue + format:    %5.0f ns/call\n", nsPerCall(enqueue + flush));
+  return 0;
+}
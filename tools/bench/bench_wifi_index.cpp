@@ -0,0 +1,82 @@
+/*
+ * bench_wifi_index.cpp
+ *
+ * Scan result matching: WiFiIndex (hash + binary search) against the linear
+ * walk over k_wifi_table that handleScanResult did before. A scan is 48 BSS
+ * entries, a quarter of them known networks.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+
+#include "WiFiIndex.h"
+
+using CustomWiFi::WiFiCredential;
+using CustomWiFi::WiFiIndex;
+
+namespace {
+
+constexpr int k_scan_len = 48;
+constexpr int k_rounds = 200000;
+constexpr size_t k_ssid_buf = 33;
+
+char g_known[CustomWiFi::k_wifi_index_max][k_ssid_buf];
+WiFiCredential g_table[CustomWiFi::k_wifi_index_max];
+char g_scan[k_scan_len][k_ssid_buf];
+
+// Previous handleScanResult: compare every result against every table entry
+int findLinear(const WiFiCredential* table, int count, const uint8_t* ssid, size_t len) {
+  for (int j = 0; j < count; ++j) {
+    const char* known = table[j].ssid;
+    if (strlen(known) == len && memcmp(ssid, known, len) == 0) return j;
+  }
+  return -1;
+}
+
+template <typename Find>
+double nsPerScan(Find find) {
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < k_rounds; ++r) {
+    for (const char* ssid : g_scan) sink = sink + find((const uint8_t*)ssid, strlen(ssid));
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / k_rounds;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(1);
+  for (int count : {4, 16, 64}) {
+    for (int i = 0; i < count; ++i) {
+      snprintf(g_known[i], sizeof(g_known[i]), "Campus-%d-%u", i, (unsigned int)(rng() % 1000));
+      g_table[i] = {g_known[i], "password"};
+    }
+    for (int i = 0; i < k_scan_len; ++i) {
+      if (i % 4 == 0) {
+        strcpy(g_scan[i], g_known[rng() % count]);
+      } else {
+        snprintf(g_scan[i], sizeof(g_scan[i]), "Other-%u", (unsigned int)rng());
+      }
+    }
+
+    WiFiIndex index;
+    index.build(g_table, count);
+    for (const char* ssid : g_scan) {
+      size_t len = strlen(ssid);
+      if (index.find((const uint8_t*)ssid, len) != findLinear(g_table, count, (const uint8_t*)ssid, len)) {
+        fprintf(stderr, "Mismatch for %s\n", ssid);
+        return 1;
+      }
+    }
+
+    double linear_ns = nsPerScan([&](const uint8_t* ssid, size_t len) { return findLinear(g_table, count, ssid, len); });
+    double index_ns = nsPerScan([&](const uint8_t* ssid, size_t len) { return index.find(ssid, len); });
+    printf("table %2d: linear %6.0f ns/scan, index %6.0f ns/scan\n", count, linear_ns, index_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Arduino.h (fleet simulator)
+ *
+ * The part of the ESP8266 Arduino core the firmware uses, backed by the
+ * simulator host (sim_env.h). Only the device image includes this directory.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+
+#include "sim_env.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define LOW 0x0
+#define HIGH 0x1
+
+using std::min;
+using std::max;
+
+inline char* strcpy_P(char* dst, const char* src) { return strcpy(dst, src); }
+inline char* strncpy_P(char* dst, const char* src, size_t len) { return strncpy(dst, src, len); }
+inline size_t strlen_P(const char* s) { return strlen(s); }
+inline int strcmp_P(const char* a, const char* b) { return strcmp(a, b); }
+inline int strncmp_P(const char* a, const char* b, size_t len) { return strncmp(a, b, len); }
+inline void* memcpy_P(void* dst, const void* src, size_t len) { return memcpy(dst, src, len); }
+inline uint8_t pgm_read_byte(const void* p) { return *(const uint8_t*)p; }
+inline uint16_t pgm_read_word(const void* p) { return *(const uint16_t*)p; }
+inline uint32_t pgm_read_dword(const void* p) { return *(const uint32_t*)p; }
+
+inline unsigned long millis() { return sim_millis(); }
+inline unsigned long micros() { return sim_micros(); }
+inline void delay(unsigned long ms) { sim_delay((uint32_t)ms); }
+inline void delayMicroseconds(unsigned int) {}
+inline void yield() { sim_yield(); }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+
+#include "Print.h"
+#include "Stream.h"
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  int availableForWrite() { return 128; } // UART FIFO
+  size_t write(uint8_t c) override { return sim_serial_write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override { return sim_serial_write(data, len); }
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// ─────────────────────────────────────────────
+// ESP (non-OS SDK)
+// ─────────────────────────────────────────────
+enum rst_reason {
+  REASON_DEFAULT_RST = 0,
+  REASON_WDT_RST = 1,
+  REASON_EXCEPTION_RST = 2,
+  REASON_SOFT_WDT_RST = 3,
+  REASON_SOFT_RESTART = 4,
+  REASON_DEEP_SLEEP_AWAKE = 5,
+  REASON_EXT_SYS_RST = 6
+};
+
+struct rst_info {
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t epc2;
+  uint32_t epc3;
+  uint32_t excvaddr;
+  uint32_t depc;
+};
+
+class EspClass {
+public:
+  uint32_t getChipId() { return sim_chip_id(); }
+  uint32_t getFreeHeap();
+  uint8_t getHeapFragmentation() { return 0; }
+  uint16_t getMaxFreeBlockSize() { return (uint16_t)getFreeHeap(); }
+  rst_info* getResetInfoPtr();
+  uint32_t getSketchSize() { return 0; }
+  uint32_t getFreeSketchSpace() { return 0; }
+  bool flashRead(uint32_t, uint32_t*, size_t) { return false; } // No running image to read
+  void wdtFeed() { sim_wdt_feed(); }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+  void restart() { sim_restart(); }
+};
+
+extern EspClass ESP;
+
+void configTime(long gmt_offset_s, int daylight_offset_s, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Arduino.h"
+
+// RAM copy of the emulated sector; commit() writes it back to the host store
+class EEPROMClass {
+public:
+  void begin(size_t size);
+  bool commit();
+  bool end();
+
+  template <typename T>
+  T& get(int address, T& value) {
+    if (data_ != nullptr && address >= 0 && address + sizeof(T) <= size_) memcpy(&value, data_ + address, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  const T& put(int address, const T& value) {
+    if (data_ != nullptr && address >= 0 && address + sizeof(T) <= size_) memcpy(data_ + address, &value, sizeof(T));
+    return value;
+  }
+
+private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ * ESP8266WiFi.h (fleet simulator)
+ *
+ * Station interface and TCP client backed by the simulator host. The host
+ * decides when an association completes or drops; while the link is down the
+ * MQTT socket stays open but carries nothing, as an lwIP PCB would.
+ */
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "Client.h"
+
+enum wl_status_t {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_WRONG_PASSWORD = 6,
+  WL_DISCONNECTED = 7
+};
+
+enum WiFiMode_t { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 };
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+struct bss_info {
+  uint8_t bssid[6];
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t channel;
+  int8_t rssi;
+};
+
+class ESP8266WiFiClass {
+public:
+  bool mode(WiFiMode_t) { return true; }
+  void setAutoReconnect(bool) {}
+  wl_status_t status() { return (wl_status_t)sim_wifi_status(); }
+  wl_status_t begin(const char* ssid, const char* pass = nullptr, int32_t channel = 0,
+                    const uint8_t* bssid = nullptr, bool connect = true);
+  bool disconnect(bool wifi_off = false);
+  int32_t RSSI() { return sim_wifi_rssi(); }
+  uint8_t* BSSID() { return const_cast<uint8_t*>(sim_wifi_bssid()); }
+  int32_t channel() { return sim_wifi_channel(); }
+  IPAddress localIP() { return IPAddress(sim_wifi_ip()); }
+  uint8_t* macAddress(uint8_t* mac);
+
+  int8_t scanNetworks(bool async = false, bool show_hidden = false, uint8_t channel = 0, uint8_t* ssid = nullptr);
+  int8_t scanComplete() { return (int8_t)sim_wifi_scan_complete(); }
+  void scanDelete() {}
+  const bss_info* getScanInfoByIndex(int index);
+};
+
+extern ESP8266WiFiClass WiFi;
+
+class WiFiClient : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t c) override { return sim_tcp_write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override { return sim_tcp_write(data, len); }
+  int availableForWrite() override { return sim_tcp_available_for_write(); }
+  int available() override { return sim_tcp_available(); }
+  int read() override;
+  int read(uint8_t* data, size_t len) override { return sim_tcp_read(data, len); }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override { sim_tcp_stop(); }
+  uint8_t connected() override { return (uint8_t)sim_tcp_connected(); }
+  operator bool() override { return connected() != 0; }
+  void setNoDelay(bool) {}
+  void setSync(bool) {}
+};
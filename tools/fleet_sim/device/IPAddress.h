@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// IPv4 only, stored in network byte order like the ESP8266 core
+class IPAddress {
+public:
+  IPAddress() : address_(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    uint8_t bytes[4] = {a, b, c, d};
+    memcpy(&address_, bytes, sizeof(address_));
+  }
+  IPAddress(uint32_t address) : address_(address) {}
+
+  operator uint32_t() const { return address_; }
+  uint8_t operator[](int index) const { return ((const uint8_t*)&address_)[index & 3]; }
+  bool operator==(const IPAddress& other) const { return address_ == other.address_; }
+  bool operator!=(const IPAddress& other) const { return address_ != other.address_; }
+
+  bool fromString(const char* str) {
+    unsigned int a, b, c, d;
+    char tail;
+    if (str == nullptr || sscanf(str, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4) return false;
+    if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+  }
+
+private:
+  uint32_t address_;
+};
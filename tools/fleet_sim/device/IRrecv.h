@@ -0,0 +1,21 @@
+#pragma once
+
+#include "IRremoteESP8266.h"
+
+const uint16_t kRawTick = 2;
+
+struct decode_results {
+  volatile uint16_t* rawbuf = nullptr;
+  uint16_t rawlen = 0;
+  bool overflow = false;
+};
+
+// No receiver in the simulator: learning always times out
+class IRrecv {
+public:
+  IRrecv(uint16_t pin, uint16_t buffer_len = 100, uint8_t timeout_ms = 15, bool save_buffer = false) {}
+  void enableIRIn(bool = false) {}
+  void disableIRIn() {}
+  void resume() {}
+  bool decode(decode_results*, void* = nullptr, uint8_t = 0, uint16_t = 0) { return false; }
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "IRremoteESP8266.h"
+
+const uint8_t kDutyDefault = 50;
+
+// Declarations only: the simulator's IR adapters account airtime themselves
+class IRsend {
+public:
+  explicit IRsend(uint16_t pin, bool inverted = false, bool use_modulation = true) : pin_(pin) {}
+  void begin() {}
+  void enableIROut(uint32_t, uint8_t = kDutyDefault) {}
+  uint16_t mark(uint16_t) { return 0; }
+  void space(uint32_t) {}
+  void sendRaw(const uint16_t*, uint16_t, uint16_t) {}
+
+private:
+  uint16_t pin_;
+};
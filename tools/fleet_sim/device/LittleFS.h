@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * LittleFS.h (fleet simulator)
+ *
+ * Flat file store kept by the host per virtual device, so schedules, policy
+ * and learned codes survive a simulated reboot. A file opened for writing is
+ * buffered and replaces the stored file when the last handle closes.
+ */
+
+#include <memory>
+#include <vector>
+
+#include "Arduino.h"
+
+class File : public Stream {
+public:
+  File() = default;
+  File(const char* path, const char* mode);
+
+  explicit operator bool() const { return state_ != nullptr; }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override;
+  size_t read(uint8_t* data, size_t len);
+  int read() override;
+  int peek() override;
+  int available() override { return (int)(size() - position()); }
+  bool seek(uint32_t pos);
+  size_t position() const { return state_ ? state_->pos : 0; }
+  size_t size() const;
+  void close();
+
+private:
+  struct State {
+    char path[32] = {0};
+    bool is_write = false;
+    size_t pos = 0;
+    std::vector<uint8_t> data; // Write mode only
+    ~State();
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+class FS {
+public:
+  bool begin() { return true; }
+  void end() {}
+  File open(const char* path, const char* mode);
+  bool exists(const char* path) { return sim_fs_exists(path) != 0; }
+  bool remove(const char* path) { return sim_fs_remove(path) != 0; }
+  bool rename(const char* from, const char* to) { return sim_fs_rename(from, to) != 0; }
+};
+
+extern FS LittleFS;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class Print {
+public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t len) {
+    size_t n = 0;
+    while (n < len && write(data[n]) == 1) n++;
+    return n;
+  }
+  size_t write(const char* str) { return (str != nullptr) ? write((const uint8_t*)str, strlen(str)) : 0; }
+  virtual int availableForWrite() { return 0; }
+  size_t print(const char* str) { return write(str); }
+};
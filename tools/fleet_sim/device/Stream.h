@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  void setTimeout(unsigned long timeout_ms) { timeout_ms_ = timeout_ms; }
+
+protected:
+  unsigned long timeout_ms_ = 1000;
+};
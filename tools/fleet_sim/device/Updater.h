@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define U_FLASH 0
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_SPACE 4
+
+// A virtual device has no flash to stage an image in: every update is refused
+// with a space error, and the firmware reports the OTA offer as failed.
+class UpdaterClass {
+public:
+  bool begin(size_t, int = U_FLASH) { error_ = UPDATE_ERROR_SPACE; return false; }
+  bool setMD5(const char*) { return true; }
+  size_t write(uint8_t*, size_t) { return 0; }
+  bool end(bool = false) { return false; }
+  bool isRunning() { return false; }
+  bool hasError() { return error_ != UPDATE_ERROR_OK; }
+  uint8_t getError() { return error_; }
+
+private:
+  uint8_t error_ = UPDATE_ERROR_OK;
+};
+
+extern UpdaterClass Update;
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+// Called from the SDK context (here: before loop()) after SNTP set the clock
+void settimeofday_cb(const std::function<void(bool)>& cb);
+void settimeofday_cb(const std::function<void()>& cb);
+
+// The core's CRC-32 (MSB first, polynomial 0x04C11DB7)
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0xffffffff);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "IRsend.h"
+
+const uint8_t kMitsubishiHeavyAuto = 0;
+const uint8_t kMitsubishiHeavyCool = 1;
+const uint8_t kMitsubishiHeavyDry = 2;
+const uint8_t kMitsubishiHeavyFan = 3;
+const uint8_t kMitsubishiHeavyHeat = 4;
+
+const uint8_t kMitsubishiHeavy88FanAuto = 0;
+const uint8_t kMitsubishiHeavy88FanLow = 2;
+const uint8_t kMitsubishiHeavy88FanMed = 3;
+const uint8_t kMitsubishiHeavy88FanHigh = 4;
+const uint8_t kMitsubishiHeavy88FanTurbo = 6;
+const uint8_t kMitsubishiHeavy88FanEcono = 7;
+const uint8_t kMitsubishiHeavy88SwingVAuto = 0;
+const uint8_t kMitsubishiHeavy88SwingVHighest = 1;
+const uint8_t kMitsubishiHeavy88SwingVHigh = 2;
+const uint8_t kMitsubishiHeavy88SwingVMiddle = 3;
+const uint8_t kMitsubishiHeavy88SwingVLow = 4;
+const uint8_t kMitsubishiHeavy88SwingHOff = 0;
+
+const uint8_t kMitsubishiHeavy152FanAuto = 0;
+const uint8_t kMitsubishiHeavy152FanLow = 1;
+const uint8_t kMitsubishiHeavy152FanMed = 2;
+const uint8_t kMitsubishiHeavy152FanHigh = 3;
+const uint8_t kMitsubishiHeavy152FanMax = 4;
+const uint8_t kMitsubishiHeavy152FanTurbo = 8;
+const uint8_t kMitsubishiHeavy152SwingVAuto = 0;
+const uint8_t kMitsubishiHeavy152SwingVHighest = 1;
+const uint8_t kMitsubishiHeavy152SwingVHigh = 2;
+const uint8_t kMitsubishiHeavy152SwingVMiddle = 3;
+const uint8_t kMitsubishiHeavy152SwingVLow = 4;
+const uint8_t kMitsubishiHeavy152SwingHOff = 0;
+
+// Declarations only (see sim_ir_adapters.cpp)
+class IRMitsubishiHeavy88Ac {
+public:
+  explicit IRMitsubishiHeavy88Ac(uint16_t pin, bool inverted = false, bool use_modulation = true) : irsend_(pin) {}
+  void begin() {}
+  void stateReset() {}
+  void setPower(bool) {}
+  void setMode(uint8_t) {}
+  void setTemp(uint8_t) {}
+  void setFan(uint8_t) {}
+  void setSwingVertical(uint8_t) {}
+  void setSwingHorizontal(uint8_t) {}
+  void send(uint16_t = 0) {}
+
+private:
+  IRsend irsend_;
+};
+
+class IRMitsubishiHeavy152Ac {
+public:
+  explicit IRMitsubishiHeavy152Ac(uint16_t pin, bool inverted = false, bool use_modulation = true) : irsend_(pin) {}
+  void begin() {}
+  void stateReset() {}
+  void setPower(bool) {}
+  void setMode(uint8_t) {}
+  void setTemp(uint8_t) {}
+  void setFan(uint8_t) {}
+  void setSwingVertical(uint8_t) {}
+  void setSwingHorizontal(uint8_t) {}
+  void send(uint16_t = 0) {}
+
+private:
+  IRsend irsend_;
+};
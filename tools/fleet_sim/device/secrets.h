@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * secrets.h (fleet simulator)
+ *
+ * Same options as include/secrets_template.h, but the per-module identity and
+ * the broker are read from the simulator host when the image is loaded, so
+ * one build serves every virtual device.
+ */
+
+#include "sim_env.h"
+
+#define ACU_REMOTE_MODEL "MHI_88"
+
+#define HIDDEN_SSID "fleet-sim"
+#define HIDDEN_PASS "fleet-sim"
+
+#define MQTT_SERVER sim_broker_host()
+#define MQTT_PORT sim_broker_port()
+#define MQTT_USER sim_broker_user()
+#define MQTT_PASS sim_broker_pass()
+
+#define DEFINED_FLOOR sim_device_floor()
+#define DEFINED_ROOM  sim_device_room()
+#define DEFINED_UNIT  sim_device_unit()
+
+#define DEFINED_ROOM_TYPE_ID 1
+#define DEFINED_DEPARTMENT "Fleet Simulator"
+
+#define NTP_SERVER_1 "pool.ntp.org"
+#define NTP_SERVER_2 "time.nist.gov"
+#define NTP_UTC_OFFSET_S (8 * 3600)
+
+#define DEFINED_VERSION_HASH "fleet-sim"
+#define DEFINED_DEPLOYMENT_DATE "January 1, 2026"
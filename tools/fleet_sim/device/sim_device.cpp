@@ -0,0 +1,261 @@
+/*
+ * sim_device.cpp
+ *
+ * Core objects of the device image (Serial, ESP, WiFi, LittleFS, EEPROM,
+ * Update), the SDK's SNTP callback, the core's crc32(), and the sim_image_*
+ * entry points the host calls to run setup() and loop().
+ */
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "LittleFS.h"
+#include "EEPROM.h"
+#include "Updater.h"
+#include "coredecls.h"
+
+void setup();
+void loop();
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+FS LittleFS;
+EEPROMClass EEPROM;
+UpdaterClass Update;
+
+// Default lwIP hook; lib/NTP provides the firmware's interval
+extern "C" __attribute__((weak)) uint32_t sntp_update_delay_MS_rfc_not_less_than_15000() {
+  return 3600000;
+}
+
+namespace {
+constexpr uint32_t k_free_heap_nominal = 28000; // Typical free heap of the module once connected
+constexpr uint32_t k_sntp_first_sync_ms = 1500; // Association to first SNTP reply
+constexpr const char* k_sim_ssid = "fleet-sim";
+
+rst_info g_reset_info;
+bss_info g_scan_info;
+
+std::function<void(bool)> g_time_set_cb;
+bool g_is_sntp_running = false;
+uint32_t g_sntp_due_ms = 0;
+
+void pollSNTP() {
+  if (!g_is_sntp_running || !g_time_set_cb || sim_wifi_status() != WL_CONNECTED) return;
+  uint32_t now_ms = sim_millis();
+  if ((int32_t)(now_ms - g_sntp_due_ms) < 0) return;
+  g_sntp_due_ms = now_ms + sntp_update_delay_MS_rfc_not_less_than_15000();
+  g_time_set_cb(true); // The host clock is the synchronized time
+}
+
+} // namespace
+
+// ─────────────────────────────────────────────
+// ESP / SDK
+// ─────────────────────────────────────────────
+uint32_t EspClass::getFreeHeap() {
+  return k_free_heap_nominal;
+}
+
+rst_info* EspClass::getResetInfoPtr() {
+  g_reset_info.reason = sim_reset_reason();
+  return &g_reset_info;
+}
+
+// Same bounds as the core: 128 blocks of 4 bytes, offset in blocks
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+  if (offset * 4 + size > 512 || size == 0) return false;
+  memcpy(data, sim_rtc_memory() + offset, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+  if (offset * 4 + size > 512 || size == 0) return false;
+  memcpy(sim_rtc_memory() + offset, data, size);
+  return true;
+}
+
+void configTime(long, int, const char*, const char*, const char*) {
+  g_is_sntp_running = true;
+  g_sntp_due_ms = sim_millis() + k_sntp_first_sync_ms;
+}
+
+void settimeofday_cb(const std::function<void(bool)>& cb) {
+  g_time_set_cb = cb;
+}
+
+void settimeofday_cb(const std::function<void()>& cb) {
+  g_time_set_cb = [cb](bool) { cb(); };
+}
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (length--) {
+    uint8_t c = *bytes++;
+    for (uint32_t i = 0x80; i > 0; i >>= 1) {
+      bool bit = crc & 0x80000000;
+      if (c & i) bit = !bit;
+      crc <<= 1;
+      if (bit) crc ^= 0x04c11db7;
+    }
+  }
+  return crc;
+}
+
+// ─────────────────────────────────────────────
+// WiFi
+// ─────────────────────────────────────────────
+wl_status_t ESP8266WiFiClass::begin(const char*, const char*, int32_t, const uint8_t* bssid, bool connect) {
+  if (connect) sim_wifi_begin(bssid);
+  return status();
+}
+
+bool ESP8266WiFiClass::disconnect(bool) {
+  sim_wifi_disconnect();
+  return true;
+}
+
+uint8_t* ESP8266WiFiClass::macAddress(uint8_t* mac) {
+  uint32_t chip_id = sim_chip_id(); // Low three bytes of the station MAC
+  const uint8_t prefix[3] = {0x5C, 0xCF, 0x7F};
+  memcpy(mac, prefix, sizeof(prefix));
+  mac[3] = (uint8_t)(chip_id >> 16);
+  mac[4] = (uint8_t)(chip_id >> 8);
+  mac[5] = (uint8_t)chip_id;
+  return mac;
+}
+
+int8_t ESP8266WiFiClass::scanNetworks(bool async, bool, uint8_t, uint8_t*) {
+  sim_wifi_scan_start();
+  if (async) return WIFI_SCAN_RUNNING;
+  int n;
+  while ((n = sim_wifi_scan_complete()) == WIFI_SCAN_RUNNING) delay(10);
+  return (int8_t)n;
+}
+
+const bss_info* ESP8266WiFiClass::getScanInfoByIndex(int index) {
+  int32_t channel = 0;
+  int32_t rssi = 0;
+  if (!sim_wifi_scan_result(index, g_scan_info.bssid, &channel, &rssi)) return nullptr;
+  g_scan_info.ssid_len = (uint8_t)strlen(k_sim_ssid);
+  memcpy(g_scan_info.ssid, k_sim_ssid, g_scan_info.ssid_len);
+  g_scan_info.channel = (uint8_t)channel;
+  g_scan_info.rssi = (int8_t)rssi;
+  return &g_scan_info;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  char host[16];
+  snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return sim_tcp_connect(host, port);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  return sim_tcp_connect(host, port);
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return (sim_tcp_read(&c, 1) == 1) ? c : -1;
+}
+
+// ─────────────────────────────────────────────
+// LittleFS
+// ─────────────────────────────────────────────
+File::State::~State() {
+  if (is_write) sim_fs_write(path, data.data(), data.size());
+}
+
+File::File(const char* path, const char* mode) {
+  bool is_write = (mode[0] == 'w' || mode[0] == 'a');
+  if (!is_write && !sim_fs_exists(path)) return;
+
+  state_ = std::make_shared<State>();
+  strncpy(state_->path, path, sizeof(state_->path) - 1);
+  state_->is_write = is_write;
+  if (mode[0] == 'a') {
+    state_->data.resize(sim_fs_size(path));
+    sim_fs_read(path, state_->data.data(), 0, state_->data.size());
+    state_->pos = state_->data.size();
+  }
+}
+
+size_t File::write(const uint8_t* data, size_t len) {
+  if (!state_ || !state_->is_write) return 0;
+  state_->data.insert(state_->data.end(), data, data + len);
+  state_->pos = state_->data.size();
+  return len;
+}
+
+size_t File::read(uint8_t* data, size_t len) {
+  if (!state_ || state_->is_write) return 0;
+  size_t n = sim_fs_read(state_->path, data, state_->pos, len);
+  state_->pos += n;
+  return n;
+}
+
+int File::read() {
+  uint8_t c;
+  return (read(&c, 1) == 1) ? c : -1;
+}
+
+int File::peek() {
+  if (!state_ || state_->is_write) return -1;
+  uint8_t c;
+  return (sim_fs_read(state_->path, &c, state_->pos, 1) == 1) ? c : -1;
+}
+
+bool File::seek(uint32_t pos) {
+  if (!state_ || pos > size()) return false;
+  state_->pos = pos;
+  return true;
+}
+
+size_t File::size() const {
+  if (!state_) return 0;
+  return state_->is_write ? state_->data.size() : sim_fs_size(state_->path);
+}
+
+void File::close() {
+  state_.reset(); // The last handle commits a written file
+}
+
+File FS::open(const char* path, const char* mode) {
+  return File(path, mode);
+}
+
+// ─────────────────────────────────────────────
+// EEPROM
+// ─────────────────────────────────────────────
+void EEPROMClass::begin(size_t size) {
+  end();
+  data_ = static_cast<uint8_t*>(malloc(size));
+  if (data_ == nullptr) return;
+  size_ = size;
+  memcpy(data_, sim_eeprom(size), size);
+}
+
+bool EEPROMClass::commit() {
+  if (data_ == nullptr) return false;
+  memcpy(sim_eeprom(size_), data_, size_);
+  return true;
+}
+
+bool EEPROMClass::end() {
+  free(data_);
+  data_ = nullptr;
+  size_ = 0;
+  return true;
+}
+
+// ─────────────────────────────────────────────
+// Host entry points
+// ─────────────────────────────────────────────
+extern "C" void sim_image_setup(void) {
+  setup();
+}
+
+extern "C" void sim_image_loop(void) {
+  pollSNTP();
+  loop();
+}
@@ -0,0 +1,130 @@
+/*
+ * sim_ir_adapters.cpp
+ *
+ * Stand-in for lib/ACU_ir_adapters/ACU_ir_adapters.cpp in the device image.
+ * Same registry API and model keys, but every adapter is a SimACUAdapter: it
+ * builds the frame the real adapter would send (MHI_64 through the real
+ * encoder and modulator), hands its airtime to the host, and reports the
+ * failures the host injects.
+ */
+
+#include "ACU_ir_adapters.h"
+#include "ACU_IR_modulator.h"
+#include "logging.h"
+
+#include <new>
+
+namespace {
+constexpr const char* k_log_tag = "IR";
+
+// Nominal MHI88/MHI152 bit timing (header 3140+1630 us, bit mark 370 us, average space 820 us)
+constexpr uint32_t k_mhi_header_us = 3140 + 1630;
+constexpr uint32_t k_mhi_bit_us = 370 + 820;
+constexpr uint16_t k_mhi88_bits = 88;
+constexpr uint16_t k_mhi152_bits = 152;
+
+uint32_t sumDurations(const uint16_t* durations, size_t len) {
+  uint32_t total_us = 0;
+  for (size_t i = 0; i < len; ++i) total_us += durations[i];
+  return total_us;
+}
+
+class SimACUAdapter : public IACUAdapter {
+public:
+  SimACUAdapter(const char* name, uint16_t frame_bits)
+    : name_(name), frame_bits_(frame_bits), encoder_(ACURemoteSignature::MitsubishiHeavy64) {}
+
+  void begin() override {}
+
+  bool send(const ACUState& state) override {
+    if (frame_bits_ != 0) return sim_ir_transmit(k_mhi_header_us + frame_bits_ * k_mhi_bit_us) != 0;
+
+    encoder_.setState(state.fan_speed, state.temperature, state.mode, state.louver, state.power);
+    size_t len = 0;
+    if (!parseBinaryToDurations(encoder_.encodeCommand(), g_durations, len)) return false;
+    return sim_ir_transmit(sumDurations(g_durations, len)) != 0;
+  }
+
+  bool sendRaw(const uint16_t* durations, uint16_t len, uint16_t) override {
+    if (durations == nullptr || len == 0) return false;
+    return sim_ir_transmit(sumDurations(durations, len)) != 0;
+  }
+
+  const char* name() const override { return name_; }
+
+private:
+  const char* name_;
+  uint16_t frame_bits_; // 0 = raw 64-bit modulator
+  ACURemote encoder_;
+};
+
+struct ACUAdapterEntry {
+  const char* model;
+  const char* name;
+  uint16_t frame_bits;
+};
+
+constexpr ACUAdapterEntry k_adapter_registry[] = {
+  {"MHI_64",  "MHI-64",  0},
+  {"MHI_88",  "MHI-88",  k_mhi88_bits},
+  {"MHI_152", "MHI-152", k_mhi152_bits},
+};
+
+struct AdapterSlot {
+  alignas(SimACUAdapter) uint8_t storage[sizeof(SimACUAdapter)];
+  IACUAdapter* adapter = nullptr;
+  const char* model = "none";
+  uint16_t pin = 4;
+};
+
+AdapterSlot g_adapter_slots[k_acu_adapter_slots];
+
+const ACUAdapterEntry* findAdapterEntry(const char* model) {
+  if (model == nullptr) return nullptr;
+  for (const ACUAdapterEntry& entry : k_adapter_registry) {
+    if (strcmp(entry.model, model) == 0) return &entry;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+IACUAdapter* selectACUAdapter(uint8_t slot, const char* model, uint16_t pin) {
+  if (slot >= k_acu_adapter_slots) return nullptr;
+
+  const ACUAdapterEntry* entry = findAdapterEntry(model);
+  if (entry == nullptr) {
+    logWarn(k_log_tag, "Unknown ACU adapter: %s", model ? model : "null");
+    return nullptr;
+  }
+
+  AdapterSlot& target = g_adapter_slots[slot];
+  if (target.adapter != nullptr) {
+    target.adapter->~IACUAdapter();
+    target.adapter = nullptr;
+  }
+
+  target.adapter = new (target.storage) SimACUAdapter(entry->name, entry->frame_bits);
+  target.adapter->begin();
+  target.model = entry->model;
+  target.pin = pin;
+  logInfo(k_log_tag, "ACU adapter selected: slot=%u %s (%s) pin=%u",
+          slot, target.model, target.adapter->name(), pin);
+  return target.adapter;
+}
+
+IACUAdapter* getACUAdapter(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].adapter : nullptr;
+}
+
+const char* getACUAdapterModel(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].model : "none";
+}
+
+uint16_t getACUAdapterPin(uint8_t slot) {
+  return (slot < k_acu_adapter_slots) ? g_adapter_slots[slot].pin : 0;
+}
+
+bool isACUAdapterModelKnown(const char* model) {
+  return findAdapterEntry(model) != nullptr;
+}
@@ -0,0 +1,18 @@
+/*
+ * sim_wifi_credentials.cpp
+ *
+ * Known-network table for the device image: the simulated access points all
+ * broadcast HIDDEN_SSID (see secrets.h), so roaming scans find them.
+ */
+
+#include "WiFiData.h"
+
+namespace CustomWiFi {
+
+const WiFiCredential k_wifi_table[] = {
+    {"fleet-sim", "fleet-sim"},
+};
+
+const int k_wifi_count = sizeof(k_wifi_table) / sizeof(k_wifi_table[0]);
+
+} // namespace CustomWiFi
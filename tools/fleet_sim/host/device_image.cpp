@@ -0,0 +1,84 @@
+#include "device_image.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace fleet {
+
+namespace {
+std::vector<uint8_t> g_image_bytes;
+} // namespace
+
+bool DeviceImage::readFile(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  g_image_bytes.clear();
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    g_image_bytes.insert(g_image_bytes.end(), chunk, chunk + n);
+  }
+  fclose(file);
+  return !g_image_bytes.empty();
+}
+
+bool DeviceImage::load() {
+  // The old copy stays loaded until the new one is open, so the new /proc
+  // path can never reuse the name of a copy the loader still knows about
+  int fd = memfd_create("fleet_image", MFD_CLOEXEC);
+  if (fd < 0) {
+    perror("memfd_create");
+    return false;
+  }
+  size_t written = 0;
+  while (written < g_image_bytes.size()) {
+    ssize_t n = write(fd, g_image_bytes.data() + written, g_image_bytes.size() - written);
+    if (n <= 0) {
+      perror("write image");
+      close(fd);
+      return false;
+    }
+    written += (size_t)n;
+  }
+
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    fprintf(stderr, "dlopen: %s\n", dlerror());
+    close(fd);
+    return false;
+  }
+
+  SimImageFn setup = reinterpret_cast<SimImageFn>(dlsym(handle, "sim_image_setup"));
+  SimImageFn loop = reinterpret_cast<SimImageFn>(dlsym(handle, "sim_image_loop"));
+  if (setup == nullptr || loop == nullptr) {
+    fprintf(stderr, "image lacks sim_image_setup/sim_image_loop\n");
+    dlclose(handle);
+    close(fd);
+    return false;
+  }
+  unload();
+  handle_ = handle;
+  fd_ = fd;
+  setup_ = setup;
+  loop_ = loop;
+  return true;
+}
+
+void DeviceImage::unload() {
+  if (handle_ != nullptr) dlclose(handle_);
+  if (fd_ >= 0) close(fd_);
+  handle_ = nullptr;
+  fd_ = -1;
+  setup_ = nullptr;
+  loop_ = nullptr;
+}
+
+} // namespace fleet
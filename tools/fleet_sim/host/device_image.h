@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * device_image.h
+ *
+ * Loads private copies of the firmware image. Each copy is written to its own
+ * memfd and dlopen()ed from /proc/self/fd, so the dynamic loader treats it as
+ * a distinct object with its own .data/.bss: every virtual device gets fresh
+ * firmware globals, and a reboot is an unload plus a reload.
+ */
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim_env.h"
+
+namespace fleet {
+
+class DeviceImage {
+public:
+  DeviceImage() = default;
+  ~DeviceImage() { unload(); }
+  DeviceImage(const DeviceImage&) = delete;
+  DeviceImage& operator=(const DeviceImage&) = delete;
+
+  // Reads the image file once; every load() copies these bytes
+  static bool readFile(const char* path);
+
+  // Static initialisers run inside load(), so the host must already report
+  // the identity of the device being loaded
+  bool load();
+  void unload();
+
+  bool isLoaded() const { return handle_ != nullptr; }
+  void setup() const { setup_(); }
+  void loop() const { loop_(); }
+
+private:
+  void* handle_ = nullptr;
+  int fd_ = -1; // Kept open while loaded: its /proc path is the loader's name for this copy
+  SimImageFn setup_ = nullptr;
+  SimImageFn loop_ = nullptr;
+};
+
+} // namespace fleet
@@ -0,0 +1,615 @@
+/*
+ * fleet_sim.cpp
+ *
+ * Fleet simulator: runs N virtual modules, each on its own copy of the
+ * firmware image, against a real MQTT broker from one event loop. A probe
+ * client subscribed to the state tree measures what the broker delivers; Wi-Fi
+ * drops, IR failures, broker stalls and dashboard commands are injected at
+ * configurable rates. Prints a report line per interval and a summary at the
+ * end; with --step-budget, exits with status 3 if any loop() step overran it.
+ */
+
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "device_image.h"
+#include "fleet_stats.h"
+#include "mqtt_probe.h"
+#include "virtual_device.h"
+
+using namespace fleet;
+
+namespace {
+constexpr uint32_t k_reason_power_on = 0;     // REASON_DEFAULT_RST
+constexpr int k_max_steps_per_poll = 64;      // Steps between two looks at the sockets
+constexpr uint64_t k_command_window_us = 30ULL * 1000000ULL;
+
+struct Options {
+  FleetConfig config;
+  int devices = 10;
+  int rooms_per_floor = 20;
+  int units_per_room = 1;
+  double boot_ramp_s = 10.0;
+  double duration_s = 60.0;    // 0 = until interrupted
+  double report_s = 10.0;
+  double wifi_drop_rate = 0.0; // Drops per device-hour
+  uint32_t wifi_drop_min_ms = 2000;
+  uint32_t wifi_drop_max_ms = 20000;
+  double power_cycle_rate = 0.0; // Power cycles per device-hour
+  double broker_stall_rate = 0.0; // Broker stalls per device-hour
+  uint32_t broker_stall_min_ms = 5000;
+  uint32_t broker_stall_max_ms = 20000;
+  double cmd_rate = 0.0;       // Commands per second, fleet-wide
+  std::string state_root = "state";
+  std::string control_root = "control";
+  std::string image_path;
+  std::string json_path;
+};
+
+struct StepEntry {
+  uint64_t due_us;
+  int index;
+  bool operator>(const StepEntry& other) const { return due_us > other.due_us; }
+};
+
+struct PendingCommand {
+  uint64_t sent_us;
+};
+
+struct Totals {
+  LatencyHistogram delivery_latency;
+  LatencyHistogram command_rtt;
+  LatencyHistogram step_time;
+  std::map<std::string, uint64_t> delivered_by_kind; // Last topic level(s) below <state>/<f>/<r>/<u>
+};
+
+volatile sig_atomic_t g_is_stop_requested = 0;
+
+void onSignal(int) {
+  g_is_stop_requested = 1;
+}
+
+void usage(const char* argv0) {
+  printf(
+    "Usage: %s [options]\n"
+    "  --host HOST            Broker host (127.0.0.1)\n"
+    "  --port PORT            Broker port (1883)\n"
+    "  --user USER --pass PASS  Broker credentials for devices and probe\n"
+    "  --devices N            Virtual modules (10)\n"
+    "  --rooms-per-floor N    Layout: rooms per floor (20)\n"
+    "  --units-per-room N     Layout: modules per room (1)\n"
+    "  --boot-ramp S          Spread power-on over S seconds (10)\n"
+    "  --duration S           Run time, 0 = until Ctrl-C (60)\n"
+    "  --report S             Report interval (10)\n"
+    "  --step-ms MS           loop() cadence of an idle device (50)\n"
+    "  --wifi-drop-rate R     Injected Wi-Fi drops per device-hour (0)\n"
+    "  --wifi-drop-ms A-B     Drop duration range in ms (2000-20000)\n"
+    "  --ir-fail P            Probability that an IR transmission fails (0)\n"
+    "  --power-cycle-rate R   Injected power cycles per device-hour (0)\n"
+    "  --broker-latency MS    Delay everything the broker sends a device (0)\n"
+    "  --broker-stall-rate R  Half-open stalls of a device's connection per device-hour (0)\n"
+    "  --broker-stall-ms A-B  Stall duration range in ms (5000-20000)\n"
+    "  --step-budget MS       Count loop() steps longer than MS; exit 3 if any (0 = off)\n"
+    "  --cmd-rate R           Dashboard commands per second, fleet-wide (0)\n"
+    "  --state-root T         STATE_PATH of the firmware (state)\n"
+    "  --control-root T       CONTROL_PATH of the firmware (control)\n"
+    "  --trace N              Print the serial log of device N\n"
+    "  --image PATH           Firmware image (fleet_image.so next to this binary)\n"
+    "  --json FILE            Write the final summary as JSON\n"
+    "  --seed N               Random seed (1)\n",
+    argv0);
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+  enum {
+    k_opt_host = 1000, k_opt_port, k_opt_user, k_opt_pass, k_opt_devices, k_opt_rooms, k_opt_units,
+    k_opt_ramp, k_opt_duration, k_opt_report, k_opt_step, k_opt_drop_rate, k_opt_drop_ms,
+    k_opt_ir_fail, k_opt_power_cycle_rate, k_opt_broker_latency, k_opt_stall_rate, k_opt_stall_ms, k_opt_step_budget,
+    k_opt_cmd_rate, k_opt_state_root, k_opt_control_root, k_opt_trace,
+    k_opt_image, k_opt_json, k_opt_seed, k_opt_help
+  };
+  static const option long_options[] = {
+    {"host", required_argument, nullptr, k_opt_host},
+    {"port", required_argument, nullptr, k_opt_port},
+    {"user", required_argument, nullptr, k_opt_user},
+    {"pass", required_argument, nullptr, k_opt_pass},
+    {"devices", required_argument, nullptr, k_opt_devices},
+    {"rooms-per-floor", required_argument, nullptr, k_opt_rooms},
+    {"units-per-room", required_argument, nullptr, k_opt_units},
+    {"boot-ramp", required_argument, nullptr, k_opt_ramp},
+    {"duration", required_argument, nullptr, k_opt_duration},
+    {"report", required_argument, nullptr, k_opt_report},
+    {"step-ms", required_argument, nullptr, k_opt_step},
+    {"wifi-drop-rate", required_argument, nullptr, k_opt_drop_rate},
+    {"wifi-drop-ms", required_argument, nullptr, k_opt_drop_ms},
+    {"ir-fail", required_argument, nullptr, k_opt_ir_fail},
+    {"power-cycle-rate", required_argument, nullptr, k_opt_power_cycle_rate},
+    {"broker-latency", required_argument, nullptr, k_opt_broker_latency},
+    {"broker-stall-rate", required_argument, nullptr, k_opt_stall_rate},
+    {"broker-stall-ms", required_argument, nullptr, k_opt_stall_ms},
+    {"step-budget", required_argument, nullptr, k_opt_step_budget},
+    {"cmd-rate", required_argument, nullptr, k_opt_cmd_rate},
+    {"state-root", required_argument, nullptr, k_opt_state_root},
+    {"control-root", required_argument, nullptr, k_opt_control_root},
+    {"trace", required_argument, nullptr, k_opt_trace},
+    {"image", required_argument, nullptr, k_opt_image},
+    {"json", required_argument, nullptr, k_opt_json},
+    {"seed", required_argument, nullptr, k_opt_seed},
+    {"help", no_argument, nullptr, k_opt_help},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+    switch (opt) {
+      case k_opt_host: options.config.broker_host = optarg; break;
+      case k_opt_port: options.config.broker_port = atoi(optarg); break;
+      case k_opt_user: options.config.broker_user = optarg; break;
+      case k_opt_pass: options.config.broker_pass = optarg; break;
+      case k_opt_devices: options.devices = atoi(optarg); break;
+      case k_opt_rooms: options.rooms_per_floor = atoi(optarg); break;
+      case k_opt_units: options.units_per_room = atoi(optarg); break;
+      case k_opt_ramp: options.boot_ramp_s = atof(optarg); break;
+      case k_opt_duration: options.duration_s = atof(optarg); break;
+      case k_opt_report: options.report_s = atof(optarg); break;
+      case k_opt_step: options.config.step_ms = (uint32_t)atoi(optarg); break;
+      case k_opt_drop_rate: options.wifi_drop_rate = atof(optarg); break;
+      case k_opt_drop_ms:
+        if (sscanf(optarg, "%u-%u", &options.wifi_drop_min_ms, &options.wifi_drop_max_ms) != 2) {
+          options.wifi_drop_max_ms = options.wifi_drop_min_ms = (uint32_t)atoi(optarg);
+        }
+        break;
+      case k_opt_ir_fail: options.config.ir_fail_rate = atof(optarg); break;
+      case k_opt_power_cycle_rate: options.power_cycle_rate = atof(optarg); break;
+      case k_opt_broker_latency: options.config.broker_latency_ms = (uint32_t)atoi(optarg); break;
+      case k_opt_stall_rate: options.broker_stall_rate = atof(optarg); break;
+      case k_opt_stall_ms:
+        if (sscanf(optarg, "%u-%u", &options.broker_stall_min_ms, &options.broker_stall_max_ms) != 2) {
+          options.broker_stall_max_ms = options.broker_stall_min_ms = (uint32_t)atoi(optarg);
+        }
+        break;
+      case k_opt_step_budget: options.config.step_budget_ms = (uint32_t)atoi(optarg); break;
+      case k_opt_cmd_rate: options.cmd_rate = atof(optarg); break;
+      case k_opt_state_root: options.state_root = optarg; break;
+      case k_opt_control_root: options.control_root = optarg; break;
+      case k_opt_trace: options.config.trace_device = atoi(optarg); break;
+      case k_opt_image: options.image_path = optarg; break;
+      case k_opt_json: options.json_path = optarg; break;
+      case k_opt_seed: options.config.seed = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case k_opt_help: usage(argv[0]); exit(0);
+      default: usage(argv[0]); return false;
+    }
+  }
+
+  if (options.devices <= 0 || options.rooms_per_floor <= 0 || options.units_per_room <= 0 ||
+      options.config.step_ms == 0 || options.report_s <= 0 || options.wifi_drop_min_ms > options.wifi_drop_max_ms ||
+      options.broker_stall_min_ms > options.broker_stall_max_ms) {
+    fprintf(stderr, "invalid options\n");
+    return false;
+  }
+  if (options.image_path.empty()) {
+    char exe[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n <= 0) return false;
+    exe[n] = '\0';
+    options.image_path = std::string(dirname(exe)) + "/fleet_image.so";
+  }
+  return true;
+}
+
+void raiseFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+  limit.rlim_cur = limit.rlim_max; // Each device holds an image fd and a socket
+  setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+// Value of "key":"..." in a flat JSON payload (acks are produced by the firmware, so no escapes)
+bool findJsonString(const uint8_t* payload, size_t len, const char* key, std::string& out) {
+  std::string needle = std::string("\"") + key + "\":\"";
+  const char* begin = reinterpret_cast<const char*>(payload);
+  const char* end = begin + len;
+  const char* hit = std::search(begin, end, needle.begin(), needle.end());
+  if (hit == end) return false;
+  const char* value = hit + needle.size();
+  const char* close = std::find(value, end, '"');
+  if (close == end) return false;
+  out.assign(value, close);
+  return true;
+}
+
+double ratePerS(uint64_t delta, double seconds) {
+  return (seconds > 0) ? (double)delta / seconds : 0.0;
+}
+
+double ms(uint64_t us) {
+  return (double)us / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) return 2;
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+  raiseFileLimit();
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  if (!DeviceImage::readFile(options.image_path.c_str())) return 1;
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1");
+    return 1;
+  }
+  options.config.epoll_fd = epoll_fd;
+
+  FleetStats& stats = fleetStats();
+  FleetCounters& counters = stats.counters;
+  Totals totals;
+  std::unordered_map<std::string, PendingCommand> pending_commands;
+  std::deque<std::pair<uint64_t, std::string>> command_order;
+
+  // The probe subscribes before any device boots, so the first publishes are seen
+  MqttProbe probe;
+  std::string state_filter = options.state_root + "/#";
+  probe.setPublishHandler([&](const MqttPublish& publish, uint64_t received_us) {
+    if (publish.is_retained) { // Replayed on subscribe, not a live delivery
+      counters.probe_retained++;
+      return;
+    }
+    counters.probe_publishes++;
+    counters.probe_bytes += publish.topic_len + publish.payload_len;
+    publishTracker().onProbeDelivery(hashMqttPublish(publish), received_us);
+
+    // <state>/<floor>/<room>/<unit>/<kind...>
+    std::string topic(publish.topic, publish.topic_len);
+    size_t pos = 0;
+    for (int level = 0; level < 4 && pos != std::string::npos; ++level) {
+      pos = topic.find('/', pos);
+      if (pos != std::string::npos) pos++;
+    }
+    std::string kind = (pos == std::string::npos) ? std::string("?") : topic.substr(pos);
+    totals.delivered_by_kind[kind]++;
+    if (kind != "ack") return;
+
+    counters.acks_received++;
+    std::string status;
+    findJsonString(publish.payload, publish.payload_len, "status", status);
+    if (status == "executed") counters.acks_executed++;
+    else if (status == "ir_failed") counters.acks_ir_failed++;
+    else counters.acks_other++;
+
+    std::string id;
+    if (!findJsonString(publish.payload, publish.payload_len, "id", id)) return;
+    auto it = pending_commands.find(id);
+    if (it == pending_commands.end()) return;
+    stats.command_rtt.record(received_us - it->second.sent_us);
+    pending_commands.erase(it);
+  });
+  char probe_id[32];
+  snprintf(probe_id, sizeof(probe_id), "fleet-sim-probe-%d", (int)getpid());
+  if (!probe.connect(options.config.broker_host, options.config.broker_port, options.config.broker_user,
+                     options.config.broker_pass, probe_id, state_filter.c_str())) {
+    return 1;
+  }
+  {
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = epollData(k_epoll_probe, 0);
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, probe.fd(), &ev);
+  }
+
+  // Layout: floors of rooms_per_floor rooms, units_per_room modules per room
+  std::vector<std::unique_ptr<VirtualDevice>> devices;
+  devices.reserve(options.devices);
+  for (int i = 0; i < options.devices; ++i) {
+    int room_index = i / options.units_per_room;
+    int floor_number = room_index / options.rooms_per_floor + 1;
+    int room_number = room_index % options.rooms_per_floor + 1;
+    char floor[24], room[24], unit[24];
+    snprintf(floor, sizeof(floor), "%02d", floor_number);
+    snprintf(room, sizeof(room), "%02d%02d", floor_number, room_number);
+    snprintf(unit, sizeof(unit), "ACU%d", i % options.units_per_room + 1);
+    devices.emplace_back(new VirtualDevice(i, floor, room, unit, options.config));
+  }
+
+  uint64_t start_us = monotonicUs();
+  std::priority_queue<StepEntry, std::vector<StepEntry>, std::greater<StepEntry>> schedule;
+  for (int i = 0; i < options.devices; ++i) {
+    uint64_t boot_us = start_us + (uint64_t)(options.boot_ramp_s * 1e6 * i / options.devices);
+    devices[i]->setDueUs(boot_us);
+    schedule.push({boot_us, i});
+  }
+
+  std::mt19937 rng(options.config.seed);
+  std::uniform_real_distribution<double> unit_interval(0.0, 1.0);
+  auto exponentialUs = [&](double rate_per_s) {
+    return (uint64_t)(-log(1.0 - unit_interval(rng)) / rate_per_s * 1e6);
+  };
+
+  double drop_rate_per_s = options.wifi_drop_rate * options.devices / 3600.0;
+  uint64_t next_drop_us = (drop_rate_per_s > 0) ? start_us + exponentialUs(drop_rate_per_s) : UINT64_MAX;
+  double power_cycle_rate_per_s = options.power_cycle_rate * options.devices / 3600.0;
+  uint64_t next_power_cycle_us = (power_cycle_rate_per_s > 0) ? start_us + exponentialUs(power_cycle_rate_per_s) : UINT64_MAX;
+  double stall_rate_per_s = options.broker_stall_rate * options.devices / 3600.0;
+  uint64_t next_stall_us = (stall_rate_per_s > 0) ? start_us + exponentialUs(stall_rate_per_s) : UINT64_MAX;
+  uint64_t next_command_us = (options.cmd_rate > 0) ? start_us + exponentialUs(options.cmd_rate) : UINT64_MAX;
+  uint64_t report_interval_us = (uint64_t)(options.report_s * 1e6);
+  uint64_t next_report_us = start_us + report_interval_us;
+  uint64_t end_us = (options.duration_s > 0) ? start_us + (uint64_t)(options.duration_s * 1e6) : UINT64_MAX;
+  uint64_t command_seq = 0;
+
+  FleetCounters last_counters;
+  uint64_t last_report_us = start_us;
+
+  printf("fleet_sim: %d devices, broker %s:%d, image %s\n", options.devices, options.config.broker_host,
+         options.config.broker_port, options.image_path.c_str());
+
+  auto report = [&](uint64_t now_us, bool is_final) {
+    publishTracker().expire(now_us);
+    while (!command_order.empty() && command_order.front().first + k_command_window_us < now_us) {
+      if (pending_commands.erase(command_order.front().second)) counters.commands_unacked++;
+      command_order.pop_front();
+    }
+
+    int booted = 0, wifi_up = 0, mqtt_up = 0;
+    for (const auto& device : devices) {
+      booted += device->isBooted();
+      wifi_up += device->isWifiUp();
+      mqtt_up += device->isMqttConnected();
+    }
+    double interval_s = (double)(now_us - last_report_us) / 1e6;
+    const FleetCounters& c = counters;
+    const FleetCounters& p = last_counters;
+    if (interval_s >= 1.0 || !is_final) printf("[%7.1fs] up %d/%d wifi %d mqtt %d | dev tx %.1f msg/s %.1f kB/s rx %.1f msg/s | "
+           "delivered %.1f msg/s p50 %.2f p99 %.2f max %.2f ms lost %llu | "
+           "cmd %.2f/s rtt p50 %.1f p99 %.1f ms | reconnects %llu drops %llu ir_fail %llu reboots %llu | "
+           "steps %.0f/s p99 %.2f max %.2f ms waits %llu\n",
+           (double)(now_us - start_us) / 1e6, booted, options.devices, wifi_up, mqtt_up,
+           ratePerS(c.tx_publishes - p.tx_publishes, interval_s),
+           ratePerS(c.tx_bytes - p.tx_bytes, interval_s) / 1000.0,
+           ratePerS(c.rx_publishes - p.rx_publishes, interval_s),
+           ratePerS(c.probe_publishes - p.probe_publishes, interval_s),
+           ms(stats.delivery_latency.percentile(50)), ms(stats.delivery_latency.percentile(99)),
+           ms(stats.delivery_latency.max()), (unsigned long long)(c.publishes_lost - p.publishes_lost),
+           ratePerS(c.commands_sent - p.commands_sent, interval_s),
+           ms(stats.command_rtt.percentile(50)), ms(stats.command_rtt.percentile(99)),
+           (unsigned long long)(c.mqtt_reconnects - p.mqtt_reconnects),
+           (unsigned long long)(c.wifi_drops_injected - p.wifi_drops_injected),
+           (unsigned long long)(c.ir_failures_injected - p.ir_failures_injected),
+           (unsigned long long)(c.reboots + c.power_cycles + c.wdt_resets - p.reboots - p.power_cycles - p.wdt_resets),
+           ratePerS(c.steps - p.steps, interval_s),
+           ms(stats.step_time.percentile(99)), ms(stats.step_time.max()),
+           (unsigned long long)(c.socket_waits - p.socket_waits));
+
+    totals.delivery_latency.merge(stats.delivery_latency);
+    totals.command_rtt.merge(stats.command_rtt);
+    totals.step_time.merge(stats.step_time);
+    stats.delivery_latency.clear();
+    stats.command_rtt.clear();
+    stats.step_time.clear();
+    last_counters = counters;
+    last_report_us = now_us;
+    if (!is_final) return;
+
+    double run_s = (double)(now_us - start_us) / 1e6;
+    printf("\nSummary over %.1f s\n", run_s);
+    printf("  devices            %d (wifi up %d, mqtt connected %d)\n", options.devices, wifi_up, mqtt_up);
+    printf("  device publishes   %llu (%.1f msg/s, %.1f kB/s)\n", (unsigned long long)c.tx_publishes,
+           ratePerS(c.tx_publishes, run_s), ratePerS(c.tx_bytes, run_s) / 1000.0);
+    printf("  device receives    %llu (%.1f msg/s)\n", (unsigned long long)c.rx_publishes, ratePerS(c.rx_publishes, run_s));
+    printf("  probe deliveries   %llu (%.1f msg/s), unmatched %llu, lost %llu, in flight %zu, retained replays %llu\n",
+           (unsigned long long)c.probe_publishes, ratePerS(c.probe_publishes, run_s),
+           (unsigned long long)c.probe_unmatched, (unsigned long long)c.publishes_lost, publishTracker().pending(),
+           (unsigned long long)c.probe_retained);
+    printf("  delivery latency   p50 %.2f p95 %.2f p99 %.2f max %.2f ms\n",
+           ms(totals.delivery_latency.percentile(50)), ms(totals.delivery_latency.percentile(95)),
+           ms(totals.delivery_latency.percentile(99)), ms(totals.delivery_latency.max()));
+    printf("  commands           %llu sent, %llu acks (executed %llu, ir_failed %llu, other %llu), unacked %llu\n",
+           (unsigned long long)c.commands_sent, (unsigned long long)c.acks_received,
+           (unsigned long long)c.acks_executed, (unsigned long long)c.acks_ir_failed,
+           (unsigned long long)c.acks_other, (unsigned long long)c.commands_unacked);
+    printf("  command rtt        p50 %.1f p95 %.1f p99 %.1f max %.1f ms\n",
+           ms(totals.command_rtt.percentile(50)), ms(totals.command_rtt.percentile(95)),
+           ms(totals.command_rtt.percentile(99)), ms(totals.command_rtt.max()));
+    printf("  mqtt               %llu connects, %llu reconnects, %llu closed by broker\n",
+           (unsigned long long)c.mqtt_connects, (unsigned long long)c.mqtt_reconnects,
+           (unsigned long long)c.tcp_closed_by_peer);
+    printf("  faults             %llu Wi-Fi drops (%llu links lost), %llu/%llu IR sends failed, %llu power cycles, "
+           "%llu broker stalls\n",
+           (unsigned long long)c.wifi_drops_injected, (unsigned long long)c.wifi_links_lost,
+           (unsigned long long)c.ir_failures_injected, (unsigned long long)c.ir_sends, (unsigned long long)c.power_cycles,
+           (unsigned long long)c.broker_stalls_injected);
+    printf("  firmware restarts  %llu, %llu soft WDT resets\n", (unsigned long long)c.reboots,
+           (unsigned long long)c.wdt_resets);
+    printf("  event loop         %llu steps, step p99 %.2f max %.2f ms, %llu socket waits\n",
+           (unsigned long long)c.steps, ms(totals.step_time.percentile(99)), ms(totals.step_time.max()),
+           (unsigned long long)c.socket_waits);
+    if (options.config.step_budget_ms > 0) {
+      printf("  step budget        %u ms, %llu steps over\n", options.config.step_budget_ms,
+             (unsigned long long)c.steps_over_budget);
+    }
+    printf("  delivered by kind ");
+    for (const auto& kind : totals.delivered_by_kind) printf(" %s=%llu", kind.first.c_str(), (unsigned long long)kind.second);
+    printf("\n");
+
+    if (options.json_path.empty()) return;
+    FILE* json = fopen(options.json_path.c_str(), "w");
+    if (json == nullptr) {
+      perror(options.json_path.c_str());
+      return;
+    }
+    fprintf(json, "{\"devices\":%d,\"duration_s\":%.1f,\"wifi_up\":%d,\"mqtt_connected\":%d,", options.devices, run_s, wifi_up, mqtt_up);
+    fprintf(json, "\"device_publishes\":%llu,\"device_publish_rate\":%.2f,\"device_tx_bytes\":%llu,\"device_receives\":%llu,",
+            (unsigned long long)c.tx_publishes, ratePerS(c.tx_publishes, run_s), (unsigned long long)c.tx_bytes,
+            (unsigned long long)c.rx_publishes);
+    fprintf(json, "\"delivered\":%llu,\"delivered_rate\":%.2f,\"unmatched\":%llu,\"lost\":%llu,",
+            (unsigned long long)c.probe_publishes, ratePerS(c.probe_publishes, run_s),
+            (unsigned long long)c.probe_unmatched, (unsigned long long)c.publishes_lost);
+    fprintf(json, "\"delivery_ms\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f},",
+            ms(totals.delivery_latency.percentile(50)), ms(totals.delivery_latency.percentile(95)),
+            ms(totals.delivery_latency.percentile(99)), ms(totals.delivery_latency.max()));
+    fprintf(json, "\"commands\":{\"sent\":%llu,\"acks\":%llu,\"executed\":%llu,\"ir_failed\":%llu,\"other\":%llu,\"unacked\":%llu},",
+            (unsigned long long)c.commands_sent, (unsigned long long)c.acks_received,
+            (unsigned long long)c.acks_executed, (unsigned long long)c.acks_ir_failed,
+            (unsigned long long)c.acks_other, (unsigned long long)c.commands_unacked);
+    fprintf(json, "\"command_rtt_ms\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f},",
+            ms(totals.command_rtt.percentile(50)), ms(totals.command_rtt.percentile(95)),
+            ms(totals.command_rtt.percentile(99)), ms(totals.command_rtt.max()));
+    fprintf(json, "\"mqtt_connects\":%llu,\"mqtt_reconnects\":%llu,\"closed_by_broker\":%llu,",
+            (unsigned long long)c.mqtt_connects, (unsigned long long)c.mqtt_reconnects,
+            (unsigned long long)c.tcp_closed_by_peer);
+    fprintf(json, "\"wifi_drops\":%llu,\"ir_sends\":%llu,\"ir_failures\":%llu,\"power_cycles\":%llu,\"broker_stalls\":%llu,\"restarts\":%llu,\"wdt_resets\":%llu,",
+            (unsigned long long)c.wifi_drops_injected, (unsigned long long)c.ir_sends,
+            (unsigned long long)c.ir_failures_injected, (unsigned long long)c.power_cycles,
+            (unsigned long long)c.broker_stalls_injected, (unsigned long long)c.reboots,
+            (unsigned long long)c.wdt_resets);
+    fprintf(json, "\"steps\":%llu,\"step_ms\":{\"p99\":%.3f,\"max\":%.3f},\"steps_over_budget\":%llu,\"socket_waits\":%llu,\"delivered_by_kind\":{",
+            (unsigned long long)c.steps, ms(totals.step_time.percentile(99)), ms(totals.step_time.max()),
+            (unsigned long long)c.steps_over_budget, (unsigned long long)c.socket_waits);
+    bool is_first = true;
+    for (const auto& kind : totals.delivered_by_kind) {
+      fprintf(json, "%s\"%s\":%llu", is_first ? "" : ",", kind.first.c_str(), (unsigned long long)kind.second);
+      is_first = false;
+    }
+    fprintf(json, "}}\n");
+    fclose(json);
+  };
+
+  epoll_event events[256];
+  while (!g_is_stop_requested) {
+    uint64_t now_us = monotonicUs();
+    if (now_us >= end_us) break;
+
+    // Drop entries superseded by an earlier wake-up
+    while (!schedule.empty() && schedule.top().due_us != devices[schedule.top().index]->dueUs()) schedule.pop();
+
+    uint64_t wake_us = std::min({end_us, next_report_us, next_drop_us, next_power_cycle_us, next_stall_us, next_command_us,
+                                 schedule.empty() ? UINT64_MAX : schedule.top().due_us});
+    int timeout_ms = (wake_us <= now_us) ? 0 : (int)std::min<uint64_t>((wake_us - now_us + 999) / 1000, 1000);
+    int n = epoll_wait(epoll_fd, events, 256, timeout_ms);
+    now_us = monotonicUs();
+
+    for (int i = 0; i < n; ++i) {
+      uint32_t tag = (uint32_t)(events[i].data.u64 >> 32);
+      uint32_t id = (uint32_t)events[i].data.u64;
+      if (tag == k_epoll_probe) {
+        probe.onReadable();
+      } else if (tag == k_epoll_abandoned) {
+        drainAbandonedSocket(epoll_fd, (int)id);
+      } else if (id < devices.size()) {
+        VirtualDevice& device = *devices[id];
+        device.onSocketReadable();
+        // Data for a device that is not sleeping off a delay: run its loop now
+        if (device.isBooted() && device.dueUs() > now_us) {
+          device.setDueUs(now_us);
+          schedule.push({now_us, (int)id});
+        }
+      }
+    }
+
+    for (int steps = 0; steps < k_max_steps_per_poll && !schedule.empty(); ++steps) {
+      StepEntry entry = schedule.top();
+      VirtualDevice& device = *devices[entry.index];
+      if (entry.due_us != device.dueUs()) {
+        schedule.pop();
+        continue;
+      }
+      if (entry.due_us > now_us) break;
+      schedule.pop();
+      if (!device.isBooted()) {
+        if (!device.boot(k_reason_power_on)) return 1;
+      }
+      device.step();
+      schedule.push({device.dueUs(), entry.index});
+    }
+
+    now_us = monotonicUs();
+    if (now_us >= next_drop_us) {
+      VirtualDevice& device = *devices[rng() % devices.size()];
+      if (device.isBooted()) {
+        uint32_t span = options.wifi_drop_max_ms - options.wifi_drop_min_ms;
+        device.injectWifiDrop(options.wifi_drop_min_ms + (span ? (uint32_t)(rng() % (span + 1)) : 0));
+      }
+      next_drop_us = now_us + exponentialUs(drop_rate_per_s);
+    }
+
+    if (now_us >= next_power_cycle_us) {
+      int index = (int)(rng() % devices.size());
+      VirtualDevice& device = *devices[index];
+      if (device.isBooted()) {
+        counters.power_cycles++;
+        if (!device.boot(k_reason_power_on)) return 1;
+        schedule.push({device.dueUs(), index});
+      }
+      next_power_cycle_us = now_us + exponentialUs(power_cycle_rate_per_s);
+    }
+
+    if (now_us >= next_stall_us) {
+      VirtualDevice& device = *devices[rng() % devices.size()];
+      uint32_t span = options.broker_stall_max_ms - options.broker_stall_min_ms;
+      device.injectBrokerStall(options.broker_stall_min_ms + (span ? (uint32_t)(rng() % (span + 1)) : 0));
+      next_stall_us = now_us + exponentialUs(stall_rate_per_s);
+    }
+
+    if (now_us >= next_command_us) {
+      VirtualDevice& device = *devices[rng() % devices.size()];
+      if (device.isMqttConnected()) {
+        static const char* const k_modes[] = {"cool", "dry", "fan", "auto"};
+        char topic[96];
+        char payload[192];
+        char id[24];
+        snprintf(id, sizeof(id), "c%llu", (unsigned long long)++command_seq);
+        snprintf(topic, sizeof(topic), "%s/%s/%s/%s", options.control_root.c_str(), device.floor(), device.room(), device.unit());
+        snprintf(payload, sizeof(payload),
+                 "{\"id\":\"%s\",\"state\":{\"fan_speed\":%u,\"temperature\":%u,\"mode\":\"%s\",\"louver\":%u,\"power\":true}}",
+                 id, (unsigned)(rng() % 4 + 1), (unsigned)(rng() % 10 + 18), k_modes[rng() % 4], (unsigned)(rng() % 5));
+        if (probe.publish(topic, payload)) {
+          counters.commands_sent++;
+          pending_commands[id] = PendingCommand{now_us};
+          command_order.emplace_back(now_us, id);
+        }
+      }
+      next_command_us = now_us + exponentialUs(options.cmd_rate);
+    }
+
+    probe.service(now_us);
+    if (!probe.isConnected()) {
+      fprintf(stderr, "fleet_sim: probe lost the broker, stopping\n");
+      break;
+    }
+
+    if (now_us >= next_report_us) {
+      report(now_us, false);
+      next_report_us += report_interval_us;
+    }
+  }
+
+  report(monotonicUs(), true);
+  devices.clear();
+  close(epoll_fd);
+  return (counters.steps_over_budget > 0) ? 3 : 0;
+}
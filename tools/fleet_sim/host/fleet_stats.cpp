@@ -0,0 +1,100 @@
+#include "fleet_stats.h"
+
+#include <math.h>
+
+namespace fleet {
+
+namespace {
+constexpr double k_bucket_ratio = 1.05;
+
+FleetStats g_fleet_stats;
+PublishTracker g_publish_tracker;
+} // namespace
+
+FleetStats& fleetStats() {
+  return g_fleet_stats;
+}
+
+PublishTracker& publishTracker() {
+  return g_publish_tracker;
+}
+
+// ─────────────────────────────────────────────
+// LatencyHistogram
+// ─────────────────────────────────────────────
+size_t LatencyHistogram::bucketFor(uint64_t us) {
+  if (us <= 1) return 0;
+  size_t bucket = (size_t)(log((double)us) / log(k_bucket_ratio)) + 1;
+  return (bucket < k_buckets) ? bucket : k_buckets - 1;
+}
+
+uint64_t LatencyHistogram::bucketUpper(size_t bucket) {
+  return (uint64_t)ceil(pow(k_bucket_ratio, (double)bucket));
+}
+
+void LatencyHistogram::record(uint64_t us) {
+  buckets_[bucketFor(us)]++;
+  count_++;
+  if (us > max_) max_ = us;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < k_buckets; ++i) buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  if (other.max_ > max_) max_ = other.max_;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+  if (count_ == 0) return 0;
+  uint64_t rank = (uint64_t)ceil(p / 100.0 * (double)count_);
+  if (rank == 0) rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < k_buckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      uint64_t upper = bucketUpper(i);
+      return (upper < max_) ? upper : max_;
+    }
+  }
+  return max_;
+}
+
+// ─────────────────────────────────────────────
+// PublishTracker
+// ─────────────────────────────────────────────
+void PublishTracker::onDevicePublish(uint64_t hash, uint64_t sent_us) {
+  pending_[hash].push_back(sent_us);
+  order_.emplace_back(sent_us, hash);
+  pending_count_++;
+}
+
+void PublishTracker::onProbeDelivery(uint64_t hash, uint64_t received_us) {
+  FleetCounters& counters = g_fleet_stats.counters;
+  auto it = pending_.find(hash);
+  if (it == pending_.end()) {
+    counters.probe_unmatched++;
+    return;
+  }
+  uint64_t sent_us = it->second.front();
+  it->second.pop_front();
+  if (it->second.empty()) pending_.erase(it);
+  pending_count_--;
+  g_fleet_stats.delivery_latency.record(received_us - sent_us);
+}
+
+void PublishTracker::expire(uint64_t now_us) {
+  while (!order_.empty() && order_.front().first + k_match_window_us < now_us) {
+    uint64_t sent_us = order_.front().first;
+    uint64_t hash = order_.front().second;
+    order_.pop_front();
+
+    auto it = pending_.find(hash);
+    if (it == pending_.end() || it->second.front() > sent_us) continue; // Already delivered
+    it->second.pop_front();
+    if (it->second.empty()) pending_.erase(it);
+    pending_count_--;
+    g_fleet_stats.counters.publishes_lost++;
+  }
+}
+
+} // namespace fleet
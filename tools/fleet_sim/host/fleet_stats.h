@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * fleet_stats.h
+ *
+ * Counters and latency histograms shared by the virtual devices and the
+ * probe, plus the tracker that pairs each PUBLISH a device put on the wire
+ * with the copy the broker delivered to the probe.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <deque>
+#include <unordered_map>
+
+namespace fleet {
+
+inline uint64_t monotonicUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Log-spaced buckets, each 5% wider than the last, from 1 us up
+class LatencyHistogram {
+public:
+  static constexpr size_t k_buckets = 512;
+
+  void record(uint64_t us);
+  void merge(const LatencyHistogram& other);
+  void clear() { *this = LatencyHistogram(); }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+  uint64_t percentile(double p) const; // Upper edge of the bucket holding the p-th sample
+
+private:
+  static size_t bucketFor(uint64_t us);
+  static uint64_t bucketUpper(size_t bucket);
+
+  uint32_t buckets_[k_buckets] = {0};
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+};
+
+struct FleetCounters {
+  // Device side, as written to and read from the device sockets
+  uint64_t tx_publishes = 0;
+  uint64_t tx_bytes = 0;
+  uint64_t rx_publishes = 0;
+  uint64_t rx_bytes = 0;
+  uint64_t mqtt_connects = 0;     // CONNECT packets sent
+  uint64_t mqtt_reconnects = 0;   // CONNECTs after the first of a boot
+  uint64_t mqtt_connacks_ok = 0;
+  uint64_t tcp_closed_by_peer = 0;
+
+  // Probe side, as delivered by the broker
+  uint64_t probe_publishes = 0;
+  uint64_t probe_bytes = 0;
+  uint64_t probe_retained = 0;    // Retained messages replayed when the probe subscribed
+  uint64_t probe_unmatched = 0;   // Live deliveries not seen leaving a device
+  uint64_t publishes_lost = 0;    // Left a device, never delivered within the match window
+
+  uint64_t commands_sent = 0;
+  uint64_t commands_unacked = 0;  // No ack within the match window
+  uint64_t acks_received = 0;
+  uint64_t acks_executed = 0;
+  uint64_t acks_ir_failed = 0;
+  uint64_t acks_other = 0;
+
+  uint64_t wifi_drops_injected = 0;
+  uint64_t wifi_links_lost = 0;
+  uint64_t ir_sends = 0;
+  uint64_t ir_failures_injected = 0;
+  uint64_t power_cycles = 0;
+  uint64_t broker_stalls_injected = 0;
+  uint64_t reboots = 0;           // ESP.restart() by the firmware
+  uint64_t wdt_resets = 0;        // Steps that went too long without feeding the soft WDT
+
+  uint64_t steps = 0;
+  uint64_t socket_waits = 0;      // Busy-waits on the socket that blocked the event loop
+  uint64_t steps_over_budget = 0; // Steps longer than --step-budget
+};
+
+// Histograms cover the current report interval; the host folds them into its totals
+struct FleetStats {
+  FleetCounters counters;
+  LatencyHistogram delivery_latency; // Device publish -> probe receipt
+  LatencyHistogram command_rtt;      // Probe command -> device ack at the probe
+  LatencyHistogram step_time;        // Host time spent inside one setup()/loop() step
+};
+
+FleetStats& fleetStats();
+
+// Pairs device publishes with probe deliveries by topic+payload hash
+class PublishTracker {
+public:
+  static constexpr uint64_t k_match_window_us = 30ULL * 1000000ULL;
+
+  void onDevicePublish(uint64_t hash, uint64_t sent_us);
+  void onProbeDelivery(uint64_t hash, uint64_t received_us);
+  void expire(uint64_t now_us); // Older unmatched publishes count as lost
+  size_t pending() const { return pending_count_; }
+
+private:
+  std::unordered_map<uint64_t, std::deque<uint64_t>> pending_;
+  std::deque<std::pair<uint64_t, uint64_t>> order_; // (sent_us, hash) in send order
+  size_t pending_count_ = 0;
+};
+
+PublishTracker& publishTracker();
+
+} // namespace fleet
@@ -0,0 +1,135 @@
+#pragma once
+
+/*
+ * mqtt_frame.h
+ *
+ * Incremental MQTT 3.1.1 packet splitter for the simulator host. Fed the raw
+ * bytes of one direction of a connection, it calls back once per complete
+ * packet; PUBLISH packets are decoded to topic and payload. Packets larger
+ * than the reassembly limit are counted and skipped.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace fleet {
+
+enum MqttPacketType : uint8_t {
+  k_mqtt_connect = 1,
+  k_mqtt_connack = 2,
+  k_mqtt_publish = 3,
+  k_mqtt_puback = 4,
+  k_mqtt_subscribe = 8,
+  k_mqtt_suback = 9,
+  k_mqtt_pingreq = 12,
+  k_mqtt_pingresp = 13,
+  k_mqtt_disconnect = 14
+};
+
+struct MqttPacket {
+  uint8_t type;
+  uint8_t flags;
+  const uint8_t* body;
+  size_t body_len;
+};
+
+struct MqttPublish {
+  const char* topic;     // Not NUL-terminated
+  size_t topic_len;
+  const uint8_t* payload;
+  size_t payload_len;
+  uint8_t qos;
+  bool is_retained;
+};
+
+inline bool decodeMqttPublish(const MqttPacket& packet, MqttPublish& out) {
+  if (packet.type != k_mqtt_publish || packet.body_len < 2) return false;
+  size_t topic_len = ((size_t)packet.body[0] << 8) | packet.body[1];
+  size_t offset = 2 + topic_len;
+  out.qos = (packet.flags >> 1) & 0x03;
+  out.is_retained = (packet.flags & 0x01) != 0;
+  if (out.qos > 0) offset += 2; // Packet identifier
+  if (offset > packet.body_len) return false;
+  out.topic = reinterpret_cast<const char*>(packet.body + 2);
+  out.topic_len = topic_len;
+  out.payload = packet.body + offset;
+  out.payload_len = packet.body_len - offset;
+  return true;
+}
+
+// FNV-1a over topic and payload: the key that pairs a device's publish with
+// the copy the broker delivers to the probe
+inline uint64_t hashMqttPublish(const MqttPublish& publish) {
+  uint64_t hash = 1469598103934665603ULL;
+  auto mix = [&hash](const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(reinterpret_cast<const uint8_t*>(publish.topic), publish.topic_len);
+  const uint8_t separator = 0;
+  mix(&separator, 1);
+  mix(publish.payload, publish.payload_len);
+  return hash;
+}
+
+inline size_t encodeMqttLength(size_t len, uint8_t* out) {
+  size_t n = 0;
+  do {
+    uint8_t digit = len % 128;
+    len /= 128;
+    out[n++] = len ? (digit | 0x80) : digit;
+  } while (len && n < 4);
+  return n;
+}
+
+class MqttFrameParser {
+public:
+  static constexpr size_t k_max_packet = 64 * 1024;
+
+  template <typename Fn>
+  void feed(const uint8_t* data, size_t len, Fn&& on_packet) {
+    buf_.insert(buf_.end(), data, data + len);
+    size_t pos = 0;
+    for (;;) {
+      size_t avail = buf_.size() - pos;
+      if (avail < 2) break;
+
+      size_t remaining = 0;
+      size_t header_len = 1;
+      bool is_complete = false;
+      for (size_t i = 0; i < 4 && header_len < avail; ++i) {
+        uint8_t digit = buf_[pos + header_len++];
+        remaining |= (size_t)(digit & 0x7F) << (7 * i);
+        if ((digit & 0x80) == 0) { is_complete = true; break; }
+      }
+      if (!is_complete) {
+        if (header_len >= 5) { reset(); oversized_++; return; } // Malformed length
+        break;
+      }
+      if (remaining > k_max_packet) { reset(); oversized_++; return; }
+      if (avail < header_len + remaining) break;
+
+      MqttPacket packet;
+      packet.type = buf_[pos] >> 4;
+      packet.flags = buf_[pos] & 0x0F;
+      packet.body = buf_.data() + pos + header_len;
+      packet.body_len = remaining;
+      on_packet(packet);
+      pos += header_len + remaining;
+    }
+    if (pos > 0) buf_.erase(buf_.begin(), buf_.begin() + pos);
+  }
+
+  void reset() { buf_.clear(); }
+  uint32_t oversized() const { return oversized_; }
+
+private:
+  std::vector<uint8_t> buf_;
+  uint32_t oversized_ = 0;
+};
+
+} // namespace fleet
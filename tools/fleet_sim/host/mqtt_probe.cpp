@@ -0,0 +1,165 @@
+#include "mqtt_probe.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fleet_stats.h"
+
+namespace fleet {
+
+namespace {
+void appendString(std::vector<uint8_t>& out, const char* str) {
+  size_t len = strlen(str);
+  out.push_back((uint8_t)(len >> 8));
+  out.push_back((uint8_t)len);
+  out.insert(out.end(), str, str + len);
+}
+} // namespace
+
+MqttProbe::~MqttProbe() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool MqttProbe::connect(const char* host, int port, const char* user, const char* pass,
+                        const char* client_id, const char* subscribe_filter) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  char port_str[8];
+  snprintf(port_str, sizeof(port_str), "%d", port);
+  addrinfo* result = nullptr;
+  if (getaddrinfo(host, port_str, &hints, &result) != 0 || result == nullptr) {
+    fprintf(stderr, "probe: cannot resolve %s\n", host);
+    return false;
+  }
+  fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  bool is_connected = fd_ >= 0 && ::connect(fd_, result->ai_addr, result->ai_addrlen) == 0;
+  freeaddrinfo(result);
+  if (!is_connected) {
+    fprintf(stderr, "probe: cannot connect to %s:%d (%s)\n", host, port, strerror(errno));
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  std::vector<uint8_t> body;
+  appendString(body, "MQTT");
+  body.push_back(4); // 3.1.1
+  uint8_t flags = 0x02; // Clean session
+  bool has_user = user != nullptr && user[0] != '\0';
+  if (has_user) flags |= 0x80 | ((pass != nullptr && pass[0] != '\0') ? 0x40 : 0);
+  body.push_back(flags);
+  body.push_back((uint8_t)(k_keepalive_s >> 8));
+  body.push_back((uint8_t)k_keepalive_s);
+  appendString(body, client_id);
+  if (flags & 0x80) appendString(body, user);
+  if (flags & 0x40) appendString(body, pass);
+  if (!sendPacket(k_mqtt_connect << 4, body) || !waitFor(k_mqtt_connack, 5000)) {
+    fprintf(stderr, "probe: no CONNACK from the broker\n");
+    return false;
+  }
+
+  body.clear();
+  body.push_back(0);
+  body.push_back(1); // Packet id
+  appendString(body, subscribe_filter);
+  body.push_back(0); // QoS 0
+  if (!sendPacket((k_mqtt_subscribe << 4) | 0x02, body) || !waitFor(k_mqtt_suback, 5000)) {
+    fprintf(stderr, "probe: no SUBACK for %s\n", subscribe_filter);
+    return false;
+  }
+  return true;
+}
+
+bool MqttProbe::publish(const char* topic, const char* payload) {
+  if (fd_ < 0) return false;
+  std::vector<uint8_t> body;
+  appendString(body, topic);
+  body.insert(body.end(), payload, payload + strlen(payload));
+  return sendPacket(k_mqtt_publish << 4, body);
+}
+
+void MqttProbe::onReadable() {
+  if (fd_ < 0) return;
+  uint8_t chunk[16384];
+  for (;;) {
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n > 0) {
+      uint64_t now_us = monotonicUs();
+      parser_.feed(chunk, (size_t)n, [&](const MqttPacket& packet) { dispatch(packet, now_us); });
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n < 0 && errno == EINTR) continue;
+    fprintf(stderr, "probe: connection to the broker closed\n");
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+}
+
+void MqttProbe::service(uint64_t now_us) {
+  if (fd_ < 0) return;
+  flush();
+  if (now_us - last_tx_us_ > (uint64_t)k_keepalive_s * 1000000 / 2) {
+    sendPacket(k_mqtt_pingreq << 4, std::vector<uint8_t>());
+  }
+}
+
+bool MqttProbe::sendPacket(uint8_t header, const std::vector<uint8_t>& body) {
+  uint8_t length[4];
+  size_t length_len = encodeMqttLength(body.size(), length);
+  out_.push_back(header);
+  out_.insert(out_.end(), length, length + length_len);
+  out_.insert(out_.end(), body.begin(), body.end());
+  last_tx_us_ = monotonicUs();
+  return flush();
+}
+
+bool MqttProbe::flush() {
+  size_t sent = 0;
+  while (sent < out_.size()) {
+    ssize_t n = send(fd_, out_.data() + sent, out_.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    out_.clear();
+    return false;
+  }
+  out_.erase(out_.begin(), out_.begin() + sent);
+  return true;
+}
+
+bool MqttProbe::waitFor(uint8_t packet_type, int timeout_ms) {
+  uint64_t deadline_us = monotonicUs() + (uint64_t)timeout_ms * 1000;
+  seen_types_ = 0;
+  while (fd_ >= 0 && monotonicUs() < deadline_us) {
+    pollfd pfd = {fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 100) == 1) {
+      onReadable();
+      if (seen_types_ & (1u << packet_type)) return true;
+    }
+  }
+  return false;
+}
+
+void MqttProbe::dispatch(const MqttPacket& packet, uint64_t received_us) {
+  if (packet.type == k_mqtt_connack && (packet.body_len < 2 || packet.body[1] != 0)) return; // Refused
+  seen_types_ |= 1u << packet.type;
+  if (packet.type != k_mqtt_publish) return;
+  MqttPublish publish;
+  if (decodeMqttPublish(packet, publish) && on_publish_) on_publish_(publish, received_us);
+}
+
+} // namespace fleet
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * mqtt_probe.h
+ *
+ * The simulator's own MQTT client: subscribes to the whole state tree to see
+ * what the broker delivers, and publishes the injected commands. The
+ * handshake blocks (it runs before any device boots); afterwards the socket
+ * is serviced from the event loop.
+ */
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "mqtt_frame.h"
+
+namespace fleet {
+
+class MqttProbe {
+public:
+  using PublishHandler = std::function<void(const MqttPublish& publish, uint64_t received_us)>;
+
+  ~MqttProbe();
+
+  bool connect(const char* host, int port, const char* user, const char* pass,
+               const char* client_id, const char* subscribe_filter);
+  void setPublishHandler(PublishHandler handler) { on_publish_ = handler; }
+
+  int fd() const { return fd_; }
+  bool isConnected() const { return fd_ >= 0; }
+  void onReadable();       // Drain the socket and dispatch deliveries
+  void service(uint64_t now_us); // Keepalive and pending writes
+  bool publish(const char* topic, const char* payload);
+
+private:
+  static constexpr uint16_t k_keepalive_s = 60;
+
+  bool sendPacket(uint8_t header, const std::vector<uint8_t>& body);
+  bool flush();
+  bool waitFor(uint8_t packet_type, int timeout_ms);
+  void dispatch(const MqttPacket& packet, uint64_t received_us);
+
+  int fd_ = -1;
+  std::vector<uint8_t> out_;
+  MqttFrameParser parser_;
+  PublishHandler on_publish_;
+  uint64_t last_tx_us_ = 0;
+  uint16_t seen_types_ = 0; // Packet types received, for the handshake
+};
+
+} // namespace fleet
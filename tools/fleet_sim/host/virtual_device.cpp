@@ -0,0 +1,691 @@
+#include "virtual_device.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "fleet_stats.h"
+
+namespace fleet {
+
+namespace {
+constexpr int k_wl_connected = 3;              // wl_status_t
+constexpr int k_wl_disconnected = 7;
+constexpr int k_scan_running = -1;
+constexpr int k_scan_failed = -2;
+constexpr uint32_t k_assoc_min_ms = 1500;      // Channel sweep + association + DHCP
+constexpr uint32_t k_assoc_max_ms = 3000;
+constexpr uint32_t k_assoc_pinned_min_ms = 500; // BSSID and channel given: no sweep
+constexpr uint32_t k_assoc_pinned_max_ms = 1000;
+constexpr uint32_t k_scan_ms = 2200;           // Async scan over all channels
+constexpr uint32_t k_yields_before_skew = 32;  // yield() calls per step before a busy-wait is assumed
+constexpr uint32_t k_empty_polls_before_wait = 4;
+constexpr int k_connect_timeout_ms = 5000;
+constexpr uint64_t k_write_timeout_us = 5000ULL * 1000ULL; // WiFiClient's default timeout
+constexpr uint64_t k_soft_wdt_us = 3200ULL * 1000ULL;
+constexpr uint32_t k_reason_soft_wdt = 3;      // rst_reason
+constexpr uint32_t k_reason_soft_restart = 4;
+constexpr size_t k_rx_window = 16 * 1024;      // Unread bytes before the host stops pulling
+constexpr size_t k_serial_line_max = 512;
+constexpr uint8_t k_channels[3] = {1, 6, 11};
+
+VirtualDevice* g_current = nullptr;
+std::unordered_set<int> g_abandoned;
+
+void registerSocket(int epoll_fd, int fd, uint64_t data) {
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  ev.data.u64 = data;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+bool resolveHost(const char* host, uint16_t port, sockaddr_in& out) {
+  static std::string cached_host;
+  static sockaddr_in cached_addr;
+  if (cached_host != host) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr) return false;
+    memcpy(&cached_addr, result->ai_addr, sizeof(cached_addr));
+    freeaddrinfo(result);
+    cached_host = host;
+  }
+  out = cached_addr;
+  out.sin_port = htons(port);
+  return true;
+}
+
+} // namespace
+
+// ─────────────────────────────────────────────
+// Abandoned connections
+// ─────────────────────────────────────────────
+void drainAbandonedSocket(int epoll_fd, int fd) {
+  uint8_t discard[4096];
+  for (;;) {
+    ssize_t n = recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+    if (n > 0) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    break; // Closed by the broker
+  }
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  g_abandoned.erase(fd);
+}
+
+size_t abandonedSocketCount() {
+  return g_abandoned.size();
+}
+
+// ─────────────────────────────────────────────
+// Lifecycle
+// ─────────────────────────────────────────────
+VirtualDevice::VirtualDevice(int index, const char* floor, const char* room, const char* unit, const FleetConfig& config)
+  : config_(config), index_(index), chip_id_(0x100000u + (uint32_t)index), rng_(config.seed * 7919u + (uint32_t)index) {
+  snprintf(floor_, sizeof(floor_), "%s", floor);
+  snprintf(room_, sizeof(room_), "%s", room);
+  snprintf(unit_, sizeof(unit_), "%s", unit);
+  rssi_base_ = -50 - (int32_t)(rng_() % 23); // -50..-72 dBm
+}
+
+VirtualDevice::~VirtualDevice() {
+  VirtualDevice* previous = g_current;
+  g_current = this; // Image destructors may still call into the host
+  image_.unload();
+  g_current = previous;
+  closeSocket(false);
+}
+
+VirtualDevice* VirtualDevice::current() {
+  return g_current;
+}
+
+bool VirtualDevice::boot(uint32_t reset_reason) {
+  closeSocket(true); // A reboot takes the connection down without a FIN
+  link_ = LinkState::Off;
+  scan_done_us_ = 0;
+  reset_reason_ = reset_reason;
+  if (reset_reason == 0) memset(rtc_memory_, 0, sizeof(rtc_memory_)); // Lost with power
+  boot_real_us_ = monotonicUs();
+  device_us_ = 0;
+  boot_connects_ = 0;
+  is_restart_pending_ = false;
+  wdt_unfed_us_ = 0;
+
+  VirtualDevice* previous = g_current;
+  g_current = this; // Static initialisers read the identity
+  bool is_loaded = image_.load();
+  g_current = previous;
+
+  is_setup_pending_ = is_loaded;
+  due_us_ = boot_real_us_;
+  return is_loaded;
+}
+
+void VirtualDevice::step() {
+  uint64_t start_us = monotonicUs();
+  step_yields_ = 0;
+  step_empty_polls_ = 0;
+  has_waited_since_yield_ = false;
+
+  g_current = this;
+  fed_device_us_ = deviceUs(); // The previous loop() returned
+  refreshLink();
+  pumpSocket();
+  flushTx();
+  if (is_setup_pending_) {
+    is_setup_pending_ = false;
+    image_.setup();
+  } else {
+    image_.loop();
+  }
+  flushTx();
+  checkWatchdog();
+  g_current = nullptr;
+
+  uint64_t end_us = monotonicUs();
+  FleetStats& stats = fleetStats();
+  stats.step_time.record(end_us - start_us);
+  stats.counters.steps++;
+  if (config_.step_budget_ms > 0 && end_us - start_us > (uint64_t)config_.step_budget_ms * 1000) {
+    stats.counters.steps_over_budget++;
+  }
+
+  if (wdt_unfed_us_ > 0) {
+    stats.counters.wdt_resets++;
+    if (index_ == config_.trace_device) {
+      printf("[dev %d] soft WDT reset after %.1f s without a feed\n", index_, (double)wdt_unfed_us_ / 1e6);
+    }
+    memcpy(rtc_memory_, rtc_at_wdt_, sizeof(rtc_memory_));
+    boot(k_reason_soft_wdt);
+    return;
+  }
+  if (is_restart_pending_) {
+    stats.counters.reboots++;
+    boot(k_reason_soft_restart);
+    return;
+  }
+
+  uint64_t device_now_us = boot_real_us_ + device_us_;
+  due_us_ = std::max(end_us, device_now_us) + (uint64_t)config_.step_ms * 1000;
+}
+
+// ─────────────────────────────────────────────
+// Clock
+// ─────────────────────────────────────────────
+uint64_t VirtualDevice::deviceUs() {
+  uint64_t real_us = monotonicUs() - boot_real_us_;
+  if (real_us > device_us_) device_us_ = real_us;
+  return device_us_;
+}
+
+void VirtualDevice::delayUs(uint64_t us) {
+  feedWatchdog();
+  device_us_ = deviceUs() + us;
+  fed_device_us_ = device_us_; // The core keeps feeding while delay() waits
+}
+
+void VirtualDevice::feedWatchdog() {
+  checkWatchdog();
+  fed_device_us_ = deviceUs();
+}
+
+void VirtualDevice::checkWatchdog() {
+  uint64_t unfed_us = deviceUs() - fed_device_us_;
+  if (wdt_unfed_us_ > 0 || unfed_us <= k_soft_wdt_us) return;
+  wdt_unfed_us_ = unfed_us;
+  memcpy(rtc_at_wdt_, rtc_memory_, sizeof(rtc_memory_));
+}
+
+void VirtualDevice::yieldNow() {
+  // A loop that only yields is waiting for millis() to move (e.g. the IR frame gap)
+  if (++step_yields_ > k_yields_before_skew && !has_waited_since_yield_) delayUs(1000);
+  has_waited_since_yield_ = false;
+}
+
+size_t VirtualDevice::serialWrite(const uint8_t* data, size_t len) {
+  if (index_ != config_.trace_device) return len;
+  for (size_t i = 0; i < len; ++i) {
+    char c = (char)data[i];
+    if (c == '\n' || serial_line_.size() >= k_serial_line_max) {
+      if (!serial_line_.empty() && serial_line_.back() == '\r') serial_line_.pop_back();
+      printf("[dev %d %8.3f] %s\n", index_, (double)deviceUs() / 1e6, serial_line_.c_str());
+      serial_line_.clear();
+      if (c == '\n') continue;
+    }
+    serial_line_ += c;
+  }
+  return len;
+}
+
+// ─────────────────────────────────────────────
+// Wi-Fi
+// ─────────────────────────────────────────────
+void VirtualDevice::refreshLink() {
+  bool is_outage = monotonicUs() < outage_until_real_us_;
+  if (link_ == LinkState::Up && is_outage) {
+    link_ = LinkState::Off;
+    fleetStats().counters.wifi_links_lost++;
+    closeSocket(true);
+  } else if (link_ == LinkState::Associating && !is_outage && deviceUs() >= assoc_done_us_) {
+    link_ = LinkState::Up;
+  }
+}
+
+void VirtualDevice::injectWifiDrop(uint32_t duration_ms) {
+  outage_until_real_us_ = monotonicUs() + (uint64_t)duration_ms * 1000;
+  fleetStats().counters.wifi_drops_injected++;
+  if (index_ == config_.trace_device) printf("[dev %d] injected Wi-Fi drop for %u ms\n", index_, duration_ms);
+}
+
+void VirtualDevice::injectBrokerStall(uint32_t duration_ms) {
+  if (fd_ < 0 || is_peer_closed_) return;
+  stall_until_real_us_ = monotonicUs() + (uint64_t)duration_ms * 1000;
+  fleetStats().counters.broker_stalls_injected++;
+  if (index_ == config_.trace_device) printf("[dev %d] injected broker stall for %u ms\n", index_, duration_ms);
+}
+
+int VirtualDevice::wifiStatus() {
+  refreshLink();
+  return (link_ == LinkState::Up) ? k_wl_connected : k_wl_disconnected;
+}
+
+void VirtualDevice::wifiBegin(const uint8_t* bssid) {
+  if (link_ == LinkState::Up) closeSocket(true);
+  ap_ = 0;
+  bool is_pinned = false;
+  if (bssid != nullptr) {
+    for (int ap = 0; ap < k_ap_count; ++ap) {
+      uint8_t candidate[6];
+      fillBssid(ap, candidate);
+      if (memcmp(candidate, bssid, sizeof(candidate)) == 0) {
+        ap_ = ap;
+        is_pinned = true;
+      }
+    }
+  }
+  fillBssid(ap_, bssid_);
+  uint32_t assoc_ms = is_pinned ? k_assoc_pinned_min_ms + rng_() % (k_assoc_pinned_max_ms - k_assoc_pinned_min_ms + 1)
+                                : k_assoc_min_ms + rng_() % (k_assoc_max_ms - k_assoc_min_ms + 1);
+  assoc_done_us_ = deviceUs() + (uint64_t)assoc_ms * 1000;
+  link_ = LinkState::Associating;
+}
+
+void VirtualDevice::wifiDisconnect() {
+  if (link_ == LinkState::Up) closeSocket(true);
+  link_ = LinkState::Off;
+}
+
+int32_t VirtualDevice::wifiRssi() {
+  if (link_ != LinkState::Up) return 31; // SDK value when not associated
+  return rssi_base_ - 8 * ap_ + (int32_t)(rng_() % 5) - 2;
+}
+
+uint32_t VirtualDevice::wifiIp() const {
+  if (link_ != LinkState::Up) return 0;
+  uint32_t host = (uint32_t)index_ + 2;
+  uint8_t bytes[4] = {10, (uint8_t)(host >> 16), (uint8_t)(host >> 8), (uint8_t)host};
+  uint32_t ip;
+  memcpy(&ip, bytes, sizeof(ip));
+  return ip;
+}
+
+int32_t VirtualDevice::wifiChannel() const {
+  return k_channels[(atoi(floor_) + ap_) % 3];
+}
+
+void VirtualDevice::fillBssid(int ap, uint8_t* bssid) const {
+  uint32_t floor_number = (uint32_t)atoi(floor_);
+  const uint8_t bytes[6] = {0x02, 0xF1, 0xEE, (uint8_t)(floor_number >> 8), (uint8_t)floor_number, (uint8_t)(ap + 1)};
+  memcpy(bssid, bytes, sizeof(bytes));
+}
+
+int VirtualDevice::wifiScanStart() {
+  scan_done_us_ = deviceUs() + (uint64_t)k_scan_ms * 1000;
+  return k_scan_running;
+}
+
+int VirtualDevice::wifiScanComplete() {
+  if (scan_done_us_ == 0) return k_scan_failed;
+  if (deviceUs() < scan_done_us_) return k_scan_running;
+  return (monotonicUs() < outage_until_real_us_) ? 0 : k_ap_count;
+}
+
+int VirtualDevice::wifiScanResult(int index, uint8_t* bssid, int32_t* channel, int32_t* rssi) {
+  if (index < 0 || index >= k_ap_count) return 0;
+  fillBssid(index, bssid);
+  *channel = k_channels[(atoi(floor_) + index) % 3];
+  *rssi = rssi_base_ - 8 * index + (int32_t)(rng_() % 5) - 2;
+  return 1;
+}
+
+// ─────────────────────────────────────────────
+// MQTT socket
+// ─────────────────────────────────────────────
+int VirtualDevice::tcpConnect(const char* host, uint16_t port) {
+  closeSocket(false);
+  refreshLink();
+  if (link_ != LinkState::Up) return 0;
+
+  sockaddr_in addr;
+  if (!resolveHost(host, port, addr)) return 0;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return 0;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  // The core's connect() blocks the sketch until the handshake completes
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    if (errno != EINPROGRESS) {
+      close(fd);
+      return 0;
+    }
+    pollfd pfd = {fd, POLLOUT, 0};
+    fleetStats().counters.socket_waits++;
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (poll(&pfd, 1, k_connect_timeout_ms) != 1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+      close(fd);
+      return 0;
+    }
+  }
+
+  fd_ = fd;
+  is_peer_closed_ = false;
+  registerSocket(config_.epoll_fd, fd_, epollData(k_epoll_device, (uint32_t)index_));
+  return 1;
+}
+
+// What does not fit the send buffer is waited for, up to the client timeout,
+// as in the core's ClientContext::write()
+size_t VirtualDevice::tcpWrite(const uint8_t* data, size_t len) {
+  uint64_t deadline_us = monotonicUs() + k_write_timeout_us;
+  size_t accepted = 0;
+  while (fd_ >= 0 && !is_peer_closed_) {
+    size_t room = k_tx_hold_max - std::min(tx_hold_.size(), k_tx_hold_max);
+    size_t n = std::min(len - accepted, room);
+    tx_hold_.insert(tx_hold_.end(), data + accepted, data + accepted + n);
+    accepted += n;
+    flushTx();
+    if (accepted == len || monotonicUs() >= deadline_us) break;
+    waitWritable();
+  }
+  return accepted;
+}
+
+int VirtualDevice::tcpAvailableForWrite() {
+  if (fd_ < 0 || is_peer_closed_) return 0;
+  flushTx();
+  return (int)(k_tx_hold_max - std::min(tx_hold_.size(), k_tx_hold_max));
+}
+
+int VirtualDevice::tcpAvailable() {
+  pumpSocket();
+  if (rx_pos_ < rx_buf_.size()) return (int)(rx_buf_.size() - rx_pos_);
+  if (++step_empty_polls_ > k_empty_polls_before_wait) waitSocket();
+  return (int)(rx_buf_.size() - rx_pos_);
+}
+
+int VirtualDevice::tcpRead(uint8_t* data, size_t len) {
+  if (rx_pos_ >= rx_buf_.size()) pumpSocket();
+  size_t n = std::min(len, rx_buf_.size() - rx_pos_);
+  if (n == 0) return -1;
+  memcpy(data, rx_buf_.data() + rx_pos_, n);
+  rx_pos_ += n;
+  if (rx_pos_ == rx_buf_.size()) {
+    rx_buf_.clear();
+    rx_pos_ = 0;
+  }
+  return (int)n;
+}
+
+int VirtualDevice::tcpConnected() {
+  if (fd_ < 0) return 0;
+  pumpSocket();
+  return (!is_peer_closed_ || rx_pos_ < rx_buf_.size() || !rx_held_.empty()) ? 1 : 0;
+}
+
+void VirtualDevice::tcpStop() {
+  closeSocket(false);
+}
+
+void VirtualDevice::onSocketReadable() {
+  pumpSocket();
+}
+
+// Busy-wait on an empty socket: the device really waits for the broker, and
+// the whole event loop with it (counted as a socket wait)
+void VirtualDevice::waitSocket() {
+  if (fd_ >= 0 && !is_peer_closed_) {
+    pollfd pfd = {fd_, POLLIN, 0};
+    poll(&pfd, 1, 1);
+    fleetStats().counters.socket_waits++;
+    has_waited_since_yield_ = true;
+    pumpSocket();
+  } else {
+    delayUs(1000);
+  }
+}
+
+// A blocked write: the device, and the whole event loop with it, waits for the send buffer
+void VirtualDevice::waitWritable() {
+  if (isBrokerStalled()) {
+    usleep(1000);
+  } else {
+    pollfd pfd = {fd_, POLLOUT, 0};
+    poll(&pfd, 1, 1);
+  }
+  fleetStats().counters.socket_waits++;
+  has_waited_since_yield_ = true;
+  feedWatchdog(); // The core yields while a write waits
+}
+
+bool VirtualDevice::isBrokerStalled() const {
+  return monotonicUs() < stall_until_real_us_;
+}
+
+void VirtualDevice::pumpSocket() {
+  releaseRx();
+  if (fd_ < 0 || is_peer_closed_) return;
+  uint8_t chunk[4096];
+  while (rx_buf_.size() - rx_pos_ < k_rx_window) {
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n > 0) {
+      if (config_.broker_latency_ms == 0 && rx_held_.empty() && !isBrokerStalled()) {
+        rx_buf_.insert(rx_buf_.end(), chunk, chunk + n);
+        tapRx(chunk, (size_t)n);
+      } else {
+        uint64_t due_real_us = monotonicUs() + (uint64_t)config_.broker_latency_ms * 1000;
+        rx_held_.push_back(HeldRx{due_real_us, std::vector<uint8_t>(chunk, chunk + n)});
+      }
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n < 0 && errno == EINTR) continue;
+    is_peer_closed_ = true;
+    is_mqtt_connected_ = false;
+    fleetStats().counters.tcp_closed_by_peer++;
+    epoll_ctl(config_.epoll_fd, EPOLL_CTL_DEL, fd_, nullptr);
+    return;
+  }
+}
+
+// Held broker data becomes visible once its latency has passed and no stall is on
+void VirtualDevice::releaseRx() {
+  if (rx_held_.empty() || isBrokerStalled()) return;
+  uint64_t now_us = monotonicUs();
+  while (!rx_held_.empty() && rx_held_.front().due_real_us <= now_us) {
+    const std::vector<uint8_t>& data = rx_held_.front().data;
+    rx_buf_.insert(rx_buf_.end(), data.begin(), data.end());
+    tapRx(data.data(), data.size());
+    rx_held_.pop_front();
+  }
+}
+
+bool VirtualDevice::flushTx() {
+  if (fd_ < 0 || tx_hold_.empty()) return true;
+  if (isBrokerStalled()) return false;
+  size_t sent = 0;
+  while (sent < tx_hold_.size()) {
+    ssize_t n = send(fd_, tx_hold_.data() + sent, tx_hold_.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    break;
+  }
+  tapTx(tx_hold_.data(), sent);
+  tx_hold_.erase(tx_hold_.begin(), tx_hold_.begin() + sent);
+  return tx_hold_.empty();
+}
+
+void VirtualDevice::closeSocket(bool is_link_lost) {
+  if (fd_ >= 0) {
+    if (is_link_lost && !is_peer_closed_) {
+      g_abandoned.insert(fd_); // Already registered; events now go to drainAbandonedSocket()
+      epoll_event ev;
+      ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+      ev.data.u64 = epollData(k_epoll_abandoned, (uint32_t)fd_);
+      epoll_ctl(config_.epoll_fd, EPOLL_CTL_MOD, fd_, &ev);
+      drainAbandonedSocket(config_.epoll_fd, fd_);
+    } else {
+      epoll_ctl(config_.epoll_fd, EPOLL_CTL_DEL, fd_, nullptr);
+      close(fd_);
+    }
+  }
+  fd_ = -1;
+  is_peer_closed_ = false;
+  is_mqtt_connected_ = false;
+  rx_buf_.clear();
+  rx_pos_ = 0;
+  rx_held_.clear();
+  stall_until_real_us_ = 0;
+  tx_hold_.clear();
+  tx_parser_.reset();
+  rx_parser_.reset();
+}
+
+void VirtualDevice::tapTx(const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  FleetCounters& counters = fleetStats().counters;
+  counters.tx_bytes += len;
+  uint64_t now_us = monotonicUs();
+  tx_parser_.feed(data, len, [&](const MqttPacket& packet) {
+    if (packet.type == k_mqtt_publish) {
+      MqttPublish publish;
+      if (!decodeMqttPublish(packet, publish)) return;
+      counters.tx_publishes++;
+      publishTracker().onDevicePublish(hashMqttPublish(publish), now_us);
+    } else if (packet.type == k_mqtt_connect) {
+      counters.mqtt_connects++;
+      if (boot_connects_++ > 0) counters.mqtt_reconnects++;
+    }
+  });
+}
+
+void VirtualDevice::tapRx(const uint8_t* data, size_t len) {
+  FleetCounters& counters = fleetStats().counters;
+  counters.rx_bytes += len;
+  rx_parser_.feed(data, len, [&](const MqttPacket& packet) {
+    if (packet.type == k_mqtt_publish) {
+      counters.rx_publishes++;
+    } else if (packet.type == k_mqtt_connack && packet.body_len >= 2 && packet.body[1] == 0) {
+      counters.mqtt_connacks_ok++;
+      is_mqtt_connected_ = true;
+    }
+  });
+}
+
+// ─────────────────────────────────────────────
+// Flash and IR
+// ─────────────────────────────────────────────
+uint8_t* VirtualDevice::eeprom(size_t size) {
+  if (eeprom_.size() < size) eeprom_.resize(size, 0xFF); // Erased flash
+  return eeprom_.data();
+}
+
+bool VirtualDevice::irTransmit(uint32_t airtime_us) {
+  FleetCounters& counters = fleetStats().counters;
+  counters.ir_sends++;
+  delayUs(airtime_us); // IRsend blocks for the frame
+  if (config_.ir_fail_rate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < config_.ir_fail_rate) {
+    counters.ir_failures_injected++;
+    return false;
+  }
+  return true;
+}
+
+} // namespace fleet
+
+// ─────────────────────────────────────────────
+// sim_env.h, on behalf of the device being stepped
+// ─────────────────────────────────────────────
+using fleet::VirtualDevice;
+
+extern "C" {
+
+uint32_t sim_millis(void) { return (uint32_t)(VirtualDevice::current()->deviceUs() / 1000); }
+uint32_t sim_micros(void) { return (uint32_t)VirtualDevice::current()->deviceUs(); }
+void sim_delay(uint32_t ms) {
+  VirtualDevice::current()->delayUs((uint64_t)ms * 1000);
+}
+void sim_yield(void) {
+  VirtualDevice* device = VirtualDevice::current();
+  device->yieldNow();
+  device->feedWatchdog();
+}
+void sim_wdt_feed(void) { VirtualDevice::current()->feedWatchdog(); }
+uint32_t* sim_rtc_memory(void) { return VirtualDevice::current()->rtcMemory(); }
+
+const char* sim_device_floor(void) { return VirtualDevice::current()->floor(); }
+const char* sim_device_room(void) { return VirtualDevice::current()->room(); }
+const char* sim_device_unit(void) { return VirtualDevice::current()->unit(); }
+uint32_t sim_chip_id(void) { return VirtualDevice::current()->chipId(); }
+const char* sim_broker_host(void) { return VirtualDevice::current()->config().broker_host; }
+int sim_broker_port(void) { return VirtualDevice::current()->config().broker_port; }
+const char* sim_broker_user(void) { return VirtualDevice::current()->config().broker_user; }
+const char* sim_broker_pass(void) { return VirtualDevice::current()->config().broker_pass; }
+uint32_t sim_reset_reason(void) { return VirtualDevice::current()->resetReason(); }
+void sim_restart(void) { VirtualDevice::current()->requestRestart(); }
+
+size_t sim_serial_write(const uint8_t* data, size_t len) { return VirtualDevice::current()->serialWrite(data, len); }
+
+int sim_wifi_status(void) { return VirtualDevice::current()->wifiStatus(); }
+void sim_wifi_begin(const uint8_t* bssid) { VirtualDevice::current()->wifiBegin(bssid); }
+void sim_wifi_disconnect(void) { VirtualDevice::current()->wifiDisconnect(); }
+int32_t sim_wifi_rssi(void) { return VirtualDevice::current()->wifiRssi(); }
+uint32_t sim_wifi_ip(void) { return VirtualDevice::current()->wifiIp(); }
+const uint8_t* sim_wifi_bssid(void) { return VirtualDevice::current()->wifiBssid(); }
+int32_t sim_wifi_channel(void) { return VirtualDevice::current()->wifiChannel(); }
+int sim_wifi_scan_start(void) { return VirtualDevice::current()->wifiScanStart(); }
+int sim_wifi_scan_complete(void) { return VirtualDevice::current()->wifiScanComplete(); }
+int sim_wifi_scan_result(int index, uint8_t* bssid, int32_t* channel, int32_t* rssi) {
+  return VirtualDevice::current()->wifiScanResult(index, bssid, channel, rssi);
+}
+
+int sim_tcp_connect(const char* host, uint16_t port) { return VirtualDevice::current()->tcpConnect(host, port); }
+size_t sim_tcp_write(const uint8_t* data, size_t len) { return VirtualDevice::current()->tcpWrite(data, len); }
+int sim_tcp_available_for_write(void) { return VirtualDevice::current()->tcpAvailableForWrite(); }
+int sim_tcp_available(void) { return VirtualDevice::current()->tcpAvailable(); }
+int sim_tcp_read(uint8_t* data, size_t len) { return VirtualDevice::current()->tcpRead(data, len); }
+int sim_tcp_connected(void) { return VirtualDevice::current()->tcpConnected(); }
+void sim_tcp_stop(void) { VirtualDevice::current()->tcpStop(); }
+
+uint8_t* sim_eeprom(size_t size) { return VirtualDevice::current()->eeprom(size); }
+
+int sim_fs_exists(const char* path) {
+  return VirtualDevice::current()->files().count(path) ? 1 : 0;
+}
+
+size_t sim_fs_read(const char* path, uint8_t* data, size_t offset, size_t len) {
+  auto& files = VirtualDevice::current()->files();
+  auto it = files.find(path);
+  if (it == files.end() || offset >= it->second.size()) return 0;
+  size_t n = std::min(len, it->second.size() - offset);
+  memcpy(data, it->second.data() + offset, n);
+  return n;
+}
+
+size_t sim_fs_size(const char* path) {
+  auto& files = VirtualDevice::current()->files();
+  auto it = files.find(path);
+  return (it == files.end()) ? 0 : it->second.size();
+}
+
+void sim_fs_write(const char* path, const uint8_t* data, size_t len) {
+  VirtualDevice::current()->files()[path].assign(data, data + len);
+}
+
+int sim_fs_remove(const char* path) {
+  return VirtualDevice::current()->files().erase(path) ? 1 : 0;
+}
+
+int sim_fs_rename(const char* from, const char* to) {
+  auto& files = VirtualDevice::current()->files();
+  auto it = files.find(from);
+  if (it == files.end()) return 0;
+  std::vector<uint8_t> data = std::move(it->second);
+  files.erase(it);
+  files[to] = std::move(data);
+  return 1;
+}
+
+int sim_ir_transmit(uint32_t airtime_us) { return VirtualDevice::current()->irTransmit(airtime_us) ? 1 : 0; }
+
+} // extern "C"
@@ -0,0 +1,215 @@
+#pragma once
+
+/*
+ * virtual_device.h
+ *
+ * One simulated module: its copy of the firmware image, identity, device
+ * clock, Wi-Fi link, MQTT socket and flash. The sim_* functions of sim_env.h
+ * act on the device the host is currently stepping.
+ *
+ * Device clock: time since boot never runs behind the host clock, and
+ * delay(), IR airtime and yield()-only busy-waits push it ahead. While a
+ * device is ahead, its next step waits for the host clock to catch up, so
+ * cadences such as the heartbeat keep real-time spacing.
+ *
+ * Link loss: like the ESP8266 core, which stops every WiFiClient when the
+ * station disconnects, the firmware's socket is gone at once, but nothing
+ * reaches the broker. The host keeps the abandoned connection open until the
+ * broker gives up on it (keepalive) or a reconnect takes the session over.
+ *
+ * Slow broker: what the broker sends can be held back for a fixed latency,
+ * and a broker stall silences the connection in both directions for a while
+ * (a half-open socket) without closing it. Writes that do not fit the send
+ * buffer block, as the core's WiFiClient::write() does.
+ *
+ * Soft WDT: returning from loop(), yield(), delay(), ESP.wdtFeed() and a
+ * blocked write feed it. A step that goes more than 3.2 s of device time
+ * without a feed ends in a reboot with REASON_SOFT_WDT_RST. The firmware
+ * cannot be stopped mid-step, so the reboot waits for the step to return, but
+ * RTC user memory comes back as it was when the WDT expired: writes made after
+ * that point would never have happened. RTC user memory survives that and
+ * ESP.restart(), but not a power cycle.
+ */
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "device_image.h"
+#include "mqtt_frame.h"
+
+namespace fleet {
+
+struct FleetConfig {
+  const char* broker_host = "127.0.0.1";
+  int broker_port = 1883;
+  const char* broker_user = "";
+  const char* broker_pass = "";
+  uint32_t step_ms = 50;       // loop() cadence of an idle device
+  double ir_fail_rate = 0.0;   // Probability that one IR transmission fails
+  uint32_t broker_latency_ms = 0; // Added to everything the broker sends a device
+  uint32_t step_budget_ms = 0; // Steps longer than this are counted; 0 = no budget
+  int trace_device = -1;       // Device whose serial output is printed
+  int epoll_fd = -1;           // Device sockets are registered here
+  uint32_t seed = 1;
+};
+
+// epoll_event.data.u64: tag in the high half, device index or fd in the low half
+enum EpollTag : uint32_t { k_epoll_device = 0, k_epoll_probe = 1, k_epoll_abandoned = 2 };
+
+inline uint64_t epollData(EpollTag tag, uint32_t id) {
+  return ((uint64_t)tag << 32) | id;
+}
+
+// Connections a device lost with its link: read and discarded until the broker closes them
+void drainAbandonedSocket(int epoll_fd, int fd);
+size_t abandonedSocketCount();
+
+class VirtualDevice {
+public:
+  VirtualDevice(int index, const char* floor, const char* room, const char* unit, const FleetConfig& config);
+  ~VirtualDevice();
+  VirtualDevice(const VirtualDevice&) = delete;
+  VirtualDevice& operator=(const VirtualDevice&) = delete;
+
+  // Power-on (or restart) with a fresh copy of the image; setup() runs in the first step
+  bool boot(uint32_t reset_reason);
+  void step();
+
+  bool isBooted() const { return image_.isLoaded(); }
+  uint64_t dueUs() const { return due_us_; }
+  void setDueUs(uint64_t due_us) { due_us_ = due_us; }
+  int socketFd() const { return fd_; }
+  void onSocketReadable(); // Pull what the broker sent; the caller steps the device soon
+
+  void injectWifiDrop(uint32_t duration_ms);
+  void injectBrokerStall(uint32_t duration_ms);
+  bool isWifiUp() const { return link_ == LinkState::Up; }
+  bool isMqttConnected() const { return is_mqtt_connected_; }
+
+  int index() const { return index_; }
+  const char* floor() const { return floor_; }
+  const char* room() const { return room_; }
+  const char* unit() const { return unit_; }
+  const FleetConfig& config() const { return config_; }
+
+  // sim_env.h services for the current device
+  static VirtualDevice* current();
+  uint64_t deviceUs();
+  void delayUs(uint64_t us);
+  void yieldNow();
+  uint32_t chipId() const { return chip_id_; }
+  uint32_t resetReason() const { return reset_reason_; }
+  void feedWatchdog();
+  uint32_t* rtcMemory() { checkWatchdog(); return rtc_memory_; }
+  void requestRestart() { is_restart_pending_ = true; }
+  size_t serialWrite(const uint8_t* data, size_t len);
+
+  int wifiStatus();
+  void wifiBegin(const uint8_t* bssid);
+  void wifiDisconnect();
+  int32_t wifiRssi();
+  uint32_t wifiIp() const;
+  const uint8_t* wifiBssid() const { return bssid_; }
+  int32_t wifiChannel() const;
+  int wifiScanStart();
+  int wifiScanComplete();
+  int wifiScanResult(int index, uint8_t* bssid, int32_t* channel, int32_t* rssi);
+
+  int tcpConnect(const char* host, uint16_t port);
+  size_t tcpWrite(const uint8_t* data, size_t len);
+  int tcpAvailableForWrite();
+  int tcpAvailable();
+  int tcpRead(uint8_t* data, size_t len);
+  int tcpConnected();
+  void tcpStop();
+
+  uint8_t* eeprom(size_t size);
+  std::map<std::string, std::vector<uint8_t>>& files() { return files_; }
+
+  bool irTransmit(uint32_t airtime_us);
+
+private:
+  enum class LinkState { Off, Associating, Up };
+
+  static constexpr int k_ap_count = 2;         // Access points visible on each floor
+  static constexpr size_t k_tx_hold_max = 5840; // lwIP send buffer (4 x MSS)
+  static constexpr size_t k_rtc_blocks = 128;  // 512 bytes of RTC user memory
+
+  struct HeldRx {
+    uint64_t due_real_us;
+    std::vector<uint8_t> data;
+  };
+
+  void checkWatchdog();
+  void refreshLink();
+  void fillBssid(int ap, uint8_t* bssid) const;
+  void closeSocket(bool is_link_lost);
+  void pumpSocket();
+  void releaseRx();
+  bool isBrokerStalled() const;
+  bool flushTx();
+  void tapTx(const uint8_t* data, size_t len);
+  void tapRx(const uint8_t* data, size_t len);
+  void waitSocket();
+  void waitWritable();
+
+  const FleetConfig& config_;
+  int index_;
+  char floor_[24];
+  char room_[24];
+  char unit_[24];
+  uint32_t chip_id_;
+  std::mt19937 rng_;
+
+  DeviceImage image_;
+  bool is_setup_pending_ = false;
+  bool is_restart_pending_ = false;
+  uint32_t reset_reason_ = 0;
+  uint32_t rtc_memory_[k_rtc_blocks] = {0};
+
+  // Clock
+  uint64_t boot_real_us_ = 0;
+  uint64_t device_us_ = 0;
+  uint64_t due_us_ = 0;
+  uint32_t step_yields_ = 0;
+  uint32_t step_empty_polls_ = 0;
+  bool has_waited_since_yield_ = false;
+  uint64_t fed_device_us_ = 0;       // Last soft WDT feed, device time
+  uint64_t wdt_unfed_us_ = 0;        // Set once the soft WDT has expired this step
+  uint32_t rtc_at_wdt_[k_rtc_blocks] = {0}; // RTC memory as it was when it expired
+
+  // Wi-Fi
+  LinkState link_ = LinkState::Off;
+  int ap_ = 0;
+  uint8_t bssid_[6] = {0};
+  uint64_t assoc_done_us_ = 0;       // Device time
+  uint64_t outage_until_real_us_ = 0;
+  uint64_t scan_done_us_ = 0;        // Device time; 0 = no scan
+  int32_t rssi_base_;
+
+  // MQTT socket
+  int fd_ = -1;
+  std::vector<uint8_t> rx_buf_;
+  size_t rx_pos_ = 0;
+  std::vector<uint8_t> tx_hold_;     // Written by the firmware, not yet accepted by the host socket
+  std::deque<HeldRx> rx_held_;       // Received from the broker, not yet visible to the firmware
+  uint64_t stall_until_real_us_ = 0;
+  bool is_peer_closed_ = false;
+  MqttFrameParser tx_parser_;
+  MqttFrameParser rx_parser_;
+  uint32_t boot_connects_ = 0;
+  bool is_mqtt_connected_ = false;
+
+  // Flash
+  std::vector<uint8_t> eeprom_;
+  std::map<std::string, std::vector<uint8_t>> files_;
+
+  std::string serial_line_;
+};
+
+} // namespace fleet
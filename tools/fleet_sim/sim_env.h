@@ -0,0 +1,92 @@
+/*
+ * sim_env.h
+ *
+ * Boundary between a virtual device and the fleet simulator host.
+ *
+ * Every virtual device runs its own copy of the firmware image (src/ and lib/
+ * built with the shims in device/), so each one has private globals exactly as
+ * on the module. The shims reach the outside world only through the functions
+ * below, which the host implements for the device it is currently stepping:
+ * clock, Wi-Fi, the single TCP connection, flash-backed storage and the IR LED.
+ * The image exports the sim_image_* entry points the host calls.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ─────────────────────────────────────────────
+// Host services (called from the device image)
+// ─────────────────────────────────────────────
+
+// Device clock: real time since boot plus the time spent in delay() and busy-waits
+uint32_t sim_millis(void);
+uint32_t sim_micros(void);
+void sim_delay(uint32_t ms);  // Also feeds the soft WDT
+void sim_yield(void);         // Also feeds the soft WDT
+void sim_wdt_feed(void);
+
+// Identity (the build-time secrets.h values of a real module)
+const char* sim_device_floor(void);
+const char* sim_device_room(void);
+const char* sim_device_unit(void);
+uint32_t sim_chip_id(void);
+const char* sim_broker_host(void);
+int sim_broker_port(void);
+const char* sim_broker_user(void);
+const char* sim_broker_pass(void);
+uint32_t sim_reset_reason(void); // rst_reason of the current boot
+uint32_t* sim_rtc_memory(void);  // 128 blocks of RTC user memory, kept over resets but not power cycles
+void sim_restart(void);          // Reboot once the current step returns
+
+size_t sim_serial_write(const uint8_t* data, size_t len);
+
+// Station interface; status values are wl_status_t
+int sim_wifi_status(void);
+void sim_wifi_begin(const uint8_t* bssid); // nullptr: any access point
+void sim_wifi_disconnect(void);
+int32_t sim_wifi_rssi(void);
+uint32_t sim_wifi_ip(void);         // Network byte order
+const uint8_t* sim_wifi_bssid(void);
+int32_t sim_wifi_channel(void);
+int sim_wifi_scan_start(void);
+int sim_wifi_scan_complete(void);   // -1 running, -2 failed/none, else BSS count
+int sim_wifi_scan_result(int index, uint8_t* bssid, int32_t* channel, int32_t* rssi);
+
+// The device's one TCP connection (the MQTT socket)
+int sim_tcp_connect(const char* host, uint16_t port);
+size_t sim_tcp_write(const uint8_t* data, size_t len);     // Blocks like the core when the send buffer is full
+int sim_tcp_available_for_write(void);
+int sim_tcp_available(void);
+int sim_tcp_read(uint8_t* data, size_t len);
+int sim_tcp_connected(void);
+void sim_tcp_stop(void);
+
+// Storage that survives reboots
+uint8_t* sim_eeprom(size_t size);
+int sim_fs_exists(const char* path);
+size_t sim_fs_read(const char* path, uint8_t* data, size_t offset, size_t len); // Bytes copied
+size_t sim_fs_size(const char* path);
+void sim_fs_write(const char* path, const uint8_t* data, size_t len);          // Replaces the file
+int sim_fs_remove(const char* path);
+int sim_fs_rename(const char* from, const char* to);
+
+// IR LED: airtime of one transmission; false when a failure is injected
+int sim_ir_transmit(uint32_t airtime_us);
+
+// ─────────────────────────────────────────────
+// Image entry points (called by the host)
+// ─────────────────────────────────────────────
+typedef void (*SimImageFn)(void);
+
+void sim_image_setup(void);  // Arduino setup()
+void sim_image_loop(void);   // SDK callbacks that are due, then Arduino loop()
+
+#ifdef __cplusplus
+}
+#endif